@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+
+using namespace benchmarks;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    // Each bucket is split into 256 sub buckets of which the top half are used once
+    // past the first bucket, so every bucket covers values within 1/128th of each other.
+    const int SUB_BUCKET_HALF_COUNT_MAGNITUDE = 7;
+    const int SUB_BUCKET_HALF_COUNT = 1 << SUB_BUCKET_HALF_COUNT_MAGNITUDE;
+    const long long SUB_BUCKET_MASK = (1LL << (SUB_BUCKET_HALF_COUNT_MAGNITUDE + 1)) - 1;
+
+    // Values past 2^40 (twelve days in microseconds) are counted in the last bucket.
+    const int HIGHEST_MAGNITUDE = 40;
+    const long long HIGHEST_TRACKABLE_VALUE = (1LL << HIGHEST_MAGNITUDE) - 1;
+    const int BUCKET_COUNT = HIGHEST_MAGNITUDE - SUB_BUCKET_HALF_COUNT_MAGNITUDE;
+
+    const int PERCENTILE_TICKS_PER_HALF_DISTANCE = 5;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LatencyHistogram::LatencyHistogram() :
+    counts((BUCKET_COUNT + 1) * SUB_BUCKET_HALF_COUNT, 0), totalCount(0), minValue(0), maxValue(0), sum(0) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::recordValue(long long value) {
+
+    if (value < 0) {
+        value = 0;
+    }
+
+    this->counts[getCountsIndex(value < HIGHEST_TRACKABLE_VALUE ? value : HIGHEST_TRACKABLE_VALUE)]++;
+
+    if (this->totalCount == 0 || value < this->minValue) {
+        this->minValue = value;
+    }
+
+    if (value > this->maxValue) {
+        this->maxValue = value;
+    }
+
+    this->totalCount++;
+    this->sum += (double) value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::recordValueWithExpectedInterval(long long value, long long expectedInterval) {
+
+    recordValue(value);
+
+    if (expectedInterval <= 0) {
+        return;
+    }
+
+    for (long long missed = value - expectedInterval; missed >= expectedInterval; missed -= expectedInterval) {
+        recordValue(missed);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::add(const LatencyHistogram& other) {
+
+    if (other.totalCount == 0) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < this->counts.size(); ++i) {
+        this->counts[i] += other.counts[i];
+    }
+
+    if (this->totalCount == 0 || other.minValue < this->minValue) {
+        this->minValue = other.minValue;
+    }
+
+    if (other.maxValue > this->maxValue) {
+        this->maxValue = other.maxValue;
+    }
+
+    this->totalCount += other.totalCount;
+    this->sum += other.sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::reset() {
+
+    this->counts.assign(this->counts.size(), 0);
+    this->totalCount = 0;
+    this->minValue = 0;
+    this->maxValue = 0;
+    this->sum = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+double LatencyHistogram::getMean() const {
+    return this->totalCount == 0 ? 0.0 : this->sum / (double) this->totalCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long LatencyHistogram::getValueAtPercentile(double percentile) const {
+
+    if (this->totalCount == 0) {
+        return 0;
+    }
+
+    if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    long long target = (long long) std::ceil(percentile / 100.0 * (double) this->totalCount);
+    if (target < 1) {
+        target = 1;
+    }
+
+    long long seen = 0;
+
+    for (std::size_t i = 0; i < this->counts.size(); ++i) {
+
+        seen += this->counts[i];
+
+        if (seen >= target) {
+            long long value = getHighestEquivalentValue((int) i);
+            return value < this->maxValue ? value : this->maxValue;
+        }
+    }
+
+    return this->maxValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LatencyHistogram::writePercentileDistribution(std::ostream& out, double scale) const {
+
+    out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile" << " "
+        << std::setw(10) << "TotalCount" << " " << std::setw(14) << "1/(1-Percentile)" << "\n\n";
+
+    out << std::fixed;
+
+    double percentile = 0.0;
+
+    while (this->totalCount > 0) {
+
+        long long value = getValueAtPercentile(percentile);
+
+        // The count of values at or below the reported value.
+        long long countAtValue = 0;
+        for (std::size_t i = 0; i < this->counts.size() && getValueFromIndex((int) i) <= value; ++i) {
+            countAtValue += this->counts[i];
+        }
+
+        if (countAtValue >= this->totalCount) {
+            out << std::setw(12) << std::setprecision(3) << (double) this->maxValue / scale << " "
+                << std::setw(14) << std::setprecision(12) << 1.0 << " "
+                << std::setw(10) << this->totalCount << "\n";
+            break;
+        }
+
+        out << std::setw(12) << std::setprecision(3) << (double) value / scale << " "
+            << std::setw(14) << std::setprecision(12) << percentile / 100.0 << " "
+            << std::setw(10) << countAtValue << " "
+            << std::setw(14) << std::setprecision(2) << 1.0 / (1.0 - percentile / 100.0) << "\n";
+
+        double halfDistance = std::pow(2.0, std::floor(std::log(100.0 / (100.0 - percentile)) / std::log(2.0)) + 1);
+        percentile += 100.0 / (halfDistance * PERCENTILE_TICKS_PER_HALF_DISTANCE);
+    }
+
+    out << std::setprecision(3)
+        << "#[Mean    = " << std::setw(12) << getMean() / scale
+        << ", Max            = " << std::setw(12) << (double) this->maxValue / scale << "]\n"
+        << "#[Total count    = " << std::setw(12) << this->totalCount << "]\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int LatencyHistogram::getBucketIndex(long long value) {
+
+    int magnitude = 63 - __builtin_clzll((unsigned long long) (value | SUB_BUCKET_MASK));
+    return magnitude - SUB_BUCKET_HALF_COUNT_MAGNITUDE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int LatencyHistogram::getCountsIndex(long long value) {
+
+    int bucketIndex = getBucketIndex(value);
+    int subBucketIndex = (int) (value >> bucketIndex);
+
+    return (bucketIndex + 1) * SUB_BUCKET_HALF_COUNT + (subBucketIndex - SUB_BUCKET_HALF_COUNT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long LatencyHistogram::getValueFromIndex(int index) {
+
+    int bucketIndex = (index >> SUB_BUCKET_HALF_COUNT_MAGNITUDE) - 1;
+    long long subBucketIndex = (index & (SUB_BUCKET_HALF_COUNT - 1)) + SUB_BUCKET_HALF_COUNT;
+
+    if (bucketIndex < 0) {
+        subBucketIndex -= SUB_BUCKET_HALF_COUNT;
+        bucketIndex = 0;
+    }
+
+    return subBucketIndex << bucketIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long LatencyHistogram::getHighestEquivalentValue(int index) {
+
+    int bucketIndex = (index >> SUB_BUCKET_HALF_COUNT_MAGNITUDE) - 1;
+    if (bucketIndex < 0) {
+        bucketIndex = 0;
+    }
+
+    return getValueFromIndex(index) + (1LL << bucketIndex) - 1;
+}
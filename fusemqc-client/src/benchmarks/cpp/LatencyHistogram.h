@@ -0,0 +1,112 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BENCHMARKS_LATENCYHISTOGRAM_H_
+#define _BENCHMARKS_LATENCYHISTOGRAM_H_
+
+#include <iosfwd>
+#include <vector>
+
+namespace benchmarks {
+
+    /**
+     * A fixed memory latency histogram laid out the same way as an HdrHistogram with two
+     * significant digits, values up to 255 are counted exactly and larger values land in
+     * buckets no wider than 1/128th of the value.  Values are unitless, the tools record
+     * microseconds.  Not thread safe, give each thread its own and add() them together.
+     */
+    class LatencyHistogram {
+    private:
+
+        std::vector<long long> counts;
+        long long totalCount;
+        long long minValue;
+        long long maxValue;
+        double sum;
+
+    public:
+
+        LatencyHistogram();
+
+        /**
+         * Records a single value, negative values are recorded as zero.
+         */
+        void recordValue(long long value);
+
+        /**
+         * Records a value measured by a loop that waits for each operation before starting
+         * the next, along with the values that the operations which should have started
+         * during a stall would have seen.  Without this a single long stall is counted once
+         * and the higher percentiles are badly understated (coordinated omission).
+         *
+         * @param expectedInterval
+         *      The interval at which operations would normally start, zero disables the
+         *      correction.
+         */
+        void recordValueWithExpectedInterval(long long value, long long expectedInterval);
+
+        /**
+         * Adds every value recorded in the other histogram to this one.
+         */
+        void add(const LatencyHistogram& other);
+
+        void reset();
+
+        long long getTotalCount() const {
+            return this->totalCount;
+        }
+
+        long long getMinValue() const {
+            return this->totalCount == 0 ? 0 : this->minValue;
+        }
+
+        long long getMaxValue() const {
+            return this->maxValue;
+        }
+
+        double getMean() const;
+
+        /**
+         * @returns the value at or below which the given percentage of recorded values fall,
+         *          reported as the highest value in the bucket the percentile lands in.
+         */
+        long long getValueAtPercentile(double percentile) const;
+
+        /**
+         * Writes the percentile distribution in the HdrHistogram text format so it can be
+         * plotted with the usual HdrHistogram tools.
+         *
+         * @param scale
+         *      Recorded values are divided by this before being written.
+         */
+        void writePercentileDistribution(std::ostream& out, double scale) const;
+
+    private:
+
+        static int getBucketIndex(long long value);
+
+        static int getCountsIndex(long long value);
+
+        static long long getValueFromIndex(int index);
+
+        static long long getHighestEquivalentValue(int index);
+
+    };
+
+}
+
+#endif /* _BENCHMARKS_LATENCYHISTOGRAM_H_ */
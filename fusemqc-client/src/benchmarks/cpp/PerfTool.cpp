@@ -0,0 +1,711 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * cms-perf drives producers and consumers through the C API and reports throughput and
+ * end to end latency.  Producers stamp each message with the wall clock time it was sent
+ * and consumers record the difference on arrival, so when the two sides run as separate
+ * processes their clocks need to be synchronized.  With the default loop:// broker both
+ * sides run in this process and no network is involved.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <cms.h>
+#include <CMS_ConnectionFactory.h>
+#include <CMS_Connection.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+
+#include <decaf/lang/Runnable.h>
+#include <decaf/lang/System.h>
+#include <decaf/lang/Thread.h>
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace benchmarks;
+using decaf::lang::System;
+using decaf::lang::Thread;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const std::string DEFAULT_BROKER_URI = "loop://cms-perf";
+    const char* SEND_TIME_PROPERTY = "PerfSendTime";
+    const char* SIZE_PROPERTY = "PerfSize";
+
+    struct Options {
+
+        std::string brokerUri;
+        std::string mode;
+        std::string destination;
+        std::string type;
+        std::string histogram;
+        int destinations;
+        bool topic;
+        int minSize;
+        int maxSize;
+        bool persistent;
+        CMS_ACKNOWLEDGMENT_MODE ackMode;
+        int batch;
+        int producers;
+        int consumers;
+        double rate;
+        long long messages;
+        int timeout;
+
+        Options() : brokerUri(DEFAULT_BROKER_URI), mode("both"), destination("cms.perf"), type("text"), histogram(),
+                    destinations(1), topic(false), minSize(1024), maxSize(1024), persistent(false),
+                    ackMode(CMS_AUTO_ACKNOWLEDGE), batch(1), producers(1), consumers(1), rate(0),
+                    messages(100000), timeout(10) {}
+
+        bool runProducers() const {
+            return this->mode == "producer" || this->mode == "both";
+        }
+
+        bool runConsumers() const {
+            return this->mode == "consumer" || this->mode == "both";
+        }
+
+        std::string getDestinationName(int worker) const {
+
+            if (this->destinations == 1) {
+                return this->destination;
+            }
+
+            std::ostringstream name;
+            name << this->destination << "." << worker % this->destinations;
+            return name.str();
+        }
+
+        /**
+         * @returns the number of messages the consumers should see in total, a Topic
+         *          delivers a copy of each message to every consumer on its destination.
+         */
+        long long getExpectedDeliveries() const {
+
+            long long total = 0;
+
+            for (int destination = 0; destination < this->destinations; ++destination) {
+
+                long long sent = 0;
+                for (int producer = destination; producer < this->producers; producer += this->destinations) {
+                    sent += this->messages;
+                }
+
+                long long subscribers = 0;
+                for (int consumer = destination; consumer < this->consumers; consumer += this->destinations) {
+                    subscribers++;
+                }
+
+                if (this->topic) {
+                    total += sent * subscribers;
+                } else if (subscribers > 0) {
+                    total += sent;
+                }
+            }
+
+            return total;
+        }
+    };
+
+    void check(cms_status status, const char* operation) {
+
+        if (status != CMS_SUCCESS) {
+            std::ostringstream message;
+            message << operation << " failed with status " << status;
+            throw std::runtime_error(message.str());
+        }
+    }
+
+    /**
+     * Wall clock time, which unlike System::nanoTime() can be compared across processes.
+     */
+    long long currentTimeMicros() {
+
+        struct timeval now;
+        ::gettimeofday(&now, NULL);
+        return (long long) now.tv_sec * 1000000LL + now.tv_usec;
+    }
+
+    /**
+     * A small xorshift generator so each thread can pick message sizes without locking.
+     */
+    class Random {
+    private:
+
+        unsigned long long state;
+
+    public:
+
+        explicit Random(unsigned long long seed) : state(seed == 0 ? 88172645463325252ULL : seed) {}
+
+        int nextInt(int min, int max) {
+
+            if (max <= min) {
+                return min;
+            }
+
+            this->state ^= this->state << 13;
+            this->state ^= this->state >> 7;
+            this->state ^= this->state << 17;
+
+            return min + (int) (this->state % (unsigned long long) (max - min + 1));
+        }
+    };
+
+    /**
+     * Each worker runs on its own Thread with its own Session on the shared Connection.
+     */
+    class Worker : public decaf::lang::Runnable {
+    protected:
+
+        const Options& options;
+        CMS_Connection* connection;
+        int index;
+
+        CMS_Session* session;
+        CMS_Destination* destination;
+
+    public:
+
+        long long count;
+        long long bytes;
+        long long startTime;
+        long long endTime;
+        std::string error;
+
+    public:
+
+        Worker(const Options& options, CMS_Connection* connection, int index) :
+            options(options), connection(connection), index(index), session(NULL), destination(NULL),
+            count(0), bytes(0), startTime(0), endTime(0), error() {}
+
+        virtual ~Worker() {
+            cms_destroyDestination(this->destination);
+            cms_destroySession(this->session);
+        }
+
+        /**
+         * Creates the Session and Destination, called on the main thread so that every
+         * consumer exists before the first message is sent.
+         */
+        virtual void setUp() {
+
+            check(cms_createSession(this->connection, &this->session, this->options.ackMode), "cms_createSession");
+            check(cms_createDestination(this->session, this->options.topic ? CMS_TOPIC : CMS_QUEUE,
+                                        this->options.getDestinationName(this->index).c_str(),
+                                        &this->destination), "cms_createDestination");
+        }
+
+        virtual void run() {
+
+            try {
+                execute();
+            } catch (std::exception& ex) {
+                this->error = ex.what();
+            }
+
+            if (this->endTime == 0) {
+                this->endTime = System::nanoTime();
+            }
+        }
+
+    protected:
+
+        virtual void execute() = 0;
+
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    class ProducerWorker : public Worker {
+    private:
+
+        CMS_MessageProducer* producer;
+        std::vector<char> body;
+        Random random;
+
+    public:
+
+        ProducerWorker(const Options& options, CMS_Connection* connection, int index) :
+            Worker(options, connection, index), producer(NULL), body(options.maxSize + 1, 'x'),
+            random((unsigned long long) currentTimeMicros() + index) {}
+
+        virtual ~ProducerWorker() {
+            cms_destroyProducer(this->producer);
+        }
+
+        virtual void setUp() {
+            Worker::setUp();
+            check(cms_createProducer(this->session, this->destination, &this->producer), "cms_createProducer");
+        }
+
+    protected:
+
+        virtual void execute() {
+
+            int deliveryMode = this->options.persistent ? CMS_MSG_PERSISTENT : CMS_MSG_NON_PERSISTENT;
+
+            // The rate is shared between the producers, each sends on a fixed schedule and
+            // catches up if it falls behind rather than dropping the missed sends.
+            long long interval = 0;
+            if (this->options.rate > 0) {
+                interval = (long long) (1000000000.0 * this->options.producers / this->options.rate);
+            }
+
+            this->startTime = System::nanoTime();
+
+            for (long long i = 0; i < this->options.messages; ++i) {
+
+                if (interval > 0) {
+                    pace(this->startTime + i * interval);
+                }
+
+                int size = this->random.nextInt(this->options.minSize, this->options.maxSize);
+                CMS_Message* message = createMessage(size);
+
+                cms_status status = cms_setMessageLongProperty(message, SEND_TIME_PROPERTY, currentTimeMicros());
+                if (status == CMS_SUCCESS) {
+                    status = cms_setMessageIntProperty(message, SIZE_PROPERTY, size);
+                }
+                if (status == CMS_SUCCESS) {
+                    status = cms_producerSend(this->producer, message, deliveryMode, 4, 0);
+                }
+
+                cms_destroyMessage(message);
+                check(status, "cms_producerSend");
+
+                this->count++;
+                this->bytes += size;
+
+                if (this->options.ackMode == CMS_SESSION_TRANSACTED && this->count % this->options.batch == 0) {
+                    check(cms_commitSession(this->session), "cms_commitSession");
+                }
+            }
+
+            if (this->options.ackMode == CMS_SESSION_TRANSACTED && this->count % this->options.batch != 0) {
+                check(cms_commitSession(this->session), "cms_commitSession");
+            }
+
+            this->endTime = System::nanoTime();
+        }
+
+    private:
+
+        CMS_Message* createMessage(int size) {
+
+            CMS_Message* message = NULL;
+
+            if (this->options.type == "bytes") {
+                check(cms_createBytesMessage(this->session, &message, (unsigned char*) &this->body[0], size),
+                      "cms_createBytesMessage");
+            } else {
+                this->body[size] = '\0';
+                cms_status status = cms_createTextMessage(this->session, &message, &this->body[0]);
+                this->body[size] = 'x';
+                check(status, "cms_createTextMessage");
+            }
+
+            return message;
+        }
+
+        static void pace(long long deadline) {
+
+            while (true) {
+
+                long long remaining = deadline - System::nanoTime();
+
+                if (remaining <= 0) {
+                    return;
+                } else if (remaining > 2000000) {
+                    Thread::sleep(1);
+                } else {
+                    Thread::yield();
+                }
+            }
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    class ConsumerWorker : public Worker {
+    private:
+
+        CMS_MessageConsumer* consumer;
+        volatile long long* received;
+        long long expected;
+
+    public:
+
+        LatencyHistogram latency;
+
+    public:
+
+        ConsumerWorker(const Options& options, CMS_Connection* connection, int index,
+                       volatile long long* received, long long expected) :
+            Worker(options, connection, index), consumer(NULL), received(received), expected(expected), latency() {}
+
+        virtual ~ConsumerWorker() {
+            cms_destroyConsumer(this->consumer);
+        }
+
+        virtual void setUp() {
+            Worker::setUp();
+            check(cms_createDefaultConsumer(this->session, this->destination, &this->consumer), "cms_createDefaultConsumer");
+        }
+
+    protected:
+
+        virtual void execute() {
+
+            long long idleTimeout = (long long) this->options.timeout * 1000;
+            long long lastReceived = System::currentTimeMillis();
+            long long pending = 0;
+
+            while (__sync_fetch_and_add(this->received, 0LL) < this->expected) {
+
+                CMS_Message* message = NULL;
+                cms_status status = cms_consumerReceiveWithTimeout(this->consumer, &message, 100);
+
+                if (status == CMS_RECEIVE_TIMEDOUT || (status == CMS_SUCCESS && message == NULL)) {
+                    if (System::currentTimeMillis() - lastReceived > idleTimeout) {
+                        break;
+                    }
+                    continue;
+                }
+
+                check(status, "cms_consumerReceiveWithTimeout");
+
+                long long now = currentTimeMicros();
+                lastReceived = System::currentTimeMillis();
+
+                if (this->count == 0) {
+                    this->startTime = System::nanoTime();
+                }
+
+                long long sendTime = 0;
+                if (cms_getMessageLongProperty(message, SEND_TIME_PROPERTY, &sendTime) == CMS_SUCCESS) {
+                    this->latency.recordValue(now - sendTime);
+                }
+
+                int size = 0;
+                if (cms_getMessageIntProperty(message, SIZE_PROPERTY, &size) == CMS_SUCCESS) {
+                    this->bytes += size;
+                }
+
+                this->count++;
+                this->endTime = System::nanoTime();
+                bool last = __sync_add_and_fetch(this->received, 1LL) >= this->expected;
+
+                if (this->options.ackMode == CMS_INDIVIDUAL_ACKNOWLEDGE) {
+                    status = cms_acknowledgeMessage(message);
+                } else if (++pending == this->options.batch || last) {
+                    status = complete(message);
+                    pending = 0;
+                }
+
+                cms_destroyMessage(message);
+                check(status, "acknowledge");
+            }
+
+            // Another consumer took the last message or the producers went quiet, commit
+            // whatever is left of a partial batch.
+            if (pending > 0 && this->options.ackMode == CMS_SESSION_TRANSACTED) {
+                check(cms_commitSession(this->session), "cms_commitSession");
+            }
+        }
+
+    private:
+
+        cms_status complete(CMS_Message* message) {
+
+            if (this->options.ackMode == CMS_SESSION_TRANSACTED) {
+                return cms_commitSession(this->session);
+            } else if (this->options.ackMode == CMS_CLIENT_ACKNOWLEDGE) {
+                return cms_acknowledgeMessage(message);
+            }
+
+            return CMS_SUCCESS;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    template<typename T>
+    void summarize(const char* side, const std::vector<T*>& workers) {
+
+        long long count = 0;
+        long long bytes = 0;
+        long long start = 0;
+        long long end = 0;
+
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+
+            if (!workers[i]->error.empty()) {
+                std::cout << side << " " << i << " failed: " << workers[i]->error << std::endl;
+            }
+
+            if (workers[i]->count == 0) {
+                continue;
+            }
+
+            count += workers[i]->count;
+            bytes += workers[i]->bytes;
+
+            if (start == 0 || workers[i]->startTime < start) {
+                start = workers[i]->startTime;
+            }
+            if (workers[i]->endTime > end) {
+                end = workers[i]->endTime;
+            }
+        }
+
+        double seconds = (double) (end - start) / 1000000000.0;
+        if (seconds <= 0) {
+            seconds = 1e-9;
+        }
+
+        std::cout << std::left << std::setw(10) << side << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << count << " msgs"
+                  << std::setw(14) << (double) count / seconds << " msgs/s"
+                  << std::setw(12) << ((double) bytes / (1024.0 * 1024.0)) / seconds << " MB/s"
+                  << std::setprecision(3) << std::setw(10) << seconds << " s" << std::endl;
+    }
+
+    void reportLatency(const LatencyHistogram& latency) {
+
+        std::cout << "latency (us) over " << latency.getTotalCount() << " msgs:"
+                  << " p50=" << latency.getValueAtPercentile(50.0)
+                  << " p90=" << latency.getValueAtPercentile(90.0)
+                  << " p99=" << latency.getValueAtPercentile(99.0)
+                  << " p99.9=" << latency.getValueAtPercentile(99.9)
+                  << " max=" << latency.getMaxValue() << std::endl;
+    }
+
+    bool parseAckMode(const std::string& value, CMS_ACKNOWLEDGMENT_MODE& mode) {
+
+        if (value == "auto") {
+            mode = CMS_AUTO_ACKNOWLEDGE;
+        } else if (value == "dups_ok") {
+            mode = CMS_DUPS_OK_ACKNOWLEDGE;
+        } else if (value == "client") {
+            mode = CMS_CLIENT_ACKNOWLEDGE;
+        } else if (value == "individual") {
+            mode = CMS_INDIVIDUAL_ACKNOWLEDGE;
+        } else if (value == "transacted") {
+            mode = CMS_SESSION_TRANSACTED;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    void parseSize(const std::string& value, Options& options) {
+
+        std::string::size_type separator = value.find(':');
+
+        if (separator == std::string::npos) {
+            options.minSize = options.maxSize = ::atoi(value.c_str());
+        } else {
+            options.minSize = ::atoi(value.substr(0, separator).c_str());
+            options.maxSize = ::atoi(value.substr(separator + 1).c_str());
+        }
+    }
+
+    void usage() {
+        std::cout << "usage: cms-perf [-broker <uri>] [-mode producer|consumer|both]"
+                  << " [-destination <name>] [-destinations <n>] [-topic]"
+                  << " [-type text|bytes] [-size <bytes>|<min>:<max>] [-persistent]"
+                  << " [-ack auto|dups_ok|client|individual|transacted] [-batch <n>]"
+                  << " [-producers <n>] [-consumers <n>] [-rate <msgs/s>] [-messages <n>]"
+                  << " [-timeout <secs>] [-histogram <file>]" << std::endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+
+        const std::string arg(argv[i]);
+
+        if (arg == "-topic") {
+            options.topic = true;
+            continue;
+        } else if (arg == "-persistent") {
+            options.persistent = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            usage();
+            return -1;
+        }
+
+        const std::string value(argv[++i]);
+
+        if (arg == "-broker") {
+            options.brokerUri = value;
+        } else if (arg == "-mode") {
+            options.mode = value;
+        } else if (arg == "-destination") {
+            options.destination = value;
+        } else if (arg == "-destinations") {
+            options.destinations = ::atoi(value.c_str());
+        } else if (arg == "-type") {
+            options.type = value;
+        } else if (arg == "-size") {
+            parseSize(value, options);
+        } else if (arg == "-ack") {
+            if (!parseAckMode(value, options.ackMode)) {
+                usage();
+                return -1;
+            }
+        } else if (arg == "-batch") {
+            options.batch = ::atoi(value.c_str());
+        } else if (arg == "-producers") {
+            options.producers = ::atoi(value.c_str());
+        } else if (arg == "-consumers") {
+            options.consumers = ::atoi(value.c_str());
+        } else if (arg == "-rate") {
+            options.rate = ::atof(value.c_str());
+        } else if (arg == "-messages") {
+            options.messages = ::atol(value.c_str());
+        } else if (arg == "-timeout") {
+            options.timeout = ::atoi(value.c_str());
+        } else if (arg == "-histogram") {
+            options.histogram = value;
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    if ((!options.runProducers() && !options.runConsumers()) ||
+        (options.type != "text" && options.type != "bytes") ||
+        options.destinations <= 0 || options.batch <= 0 || options.producers <= 0 ||
+        options.consumers <= 0 || options.messages <= 0 || options.timeout <= 0 ||
+        options.minSize < 0 || options.maxSize < options.minSize) {
+
+        usage();
+        return -1;
+    }
+
+    cms_initialize();
+
+    CMS_ConnectionFactory* factory = NULL;
+    CMS_Connection* connection = NULL;
+    std::vector<ProducerWorker*> producers;
+    std::vector<ConsumerWorker*> consumers;
+    std::vector<Thread*> threads;
+    volatile long long received = 0;
+    int exitCode = 0;
+
+    try {
+
+        check(cms_createConnectionFactory(&factory, options.brokerUri.c_str(), NULL, NULL), "cms_createConnectionFactory");
+        check(cms_createDefaultConnection(factory, &connection), "cms_createDefaultConnection");
+
+        if (options.runConsumers()) {
+            long long expected = options.getExpectedDeliveries();
+            for (int i = 0; i < options.consumers; ++i) {
+                consumers.push_back(new ConsumerWorker(options, connection, i, &received, expected));
+                consumers.back()->setUp();
+            }
+        }
+
+        if (options.runProducers()) {
+            for (int i = 0; i < options.producers; ++i) {
+                producers.push_back(new ProducerWorker(options, connection, i));
+                producers.back()->setUp();
+            }
+        }
+
+        check(cms_startConnection(connection), "cms_startConnection");
+
+        for (std::size_t i = 0; i < consumers.size(); ++i) {
+            threads.push_back(new Thread(consumers[i], "cms-perf consumer"));
+        }
+        for (std::size_t i = 0; i < producers.size(); ++i) {
+            threads.push_back(new Thread(producers[i], "cms-perf producer"));
+        }
+
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            threads[i]->start();
+        }
+        for (std::size_t i = 0; i < threads.size(); ++i) {
+            threads[i]->join();
+        }
+
+        if (!producers.empty()) {
+            summarize("producer", producers);
+        }
+
+        if (!consumers.empty()) {
+
+            summarize("consumer", consumers);
+
+            LatencyHistogram latency;
+            for (std::size_t i = 0; i < consumers.size(); ++i) {
+                latency.add(consumers[i]->latency);
+            }
+
+            reportLatency(latency);
+
+            if (!options.histogram.empty()) {
+                std::ofstream file(options.histogram.c_str());
+                latency.writePercentileDistribution(file, 1.0);
+                std::cout << "Latency distribution written to " << options.histogram << std::endl;
+            }
+        }
+
+    } catch (std::exception& ex) {
+        std::cout << "cms-perf failed: " << ex.what() << std::endl;
+        exitCode = 1;
+    }
+
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        delete threads[i];
+    }
+    for (std::size_t i = 0; i < producers.size(); ++i) {
+        delete producers[i];
+    }
+    for (std::size_t i = 0; i < consumers.size(); ++i) {
+        delete consumers[i];
+    }
+
+    cms_destroyConnection(connection);
+    cms_destroyConnectionFactory(factory);
+
+    cms_terminate();
+
+    return exitCode;
+}
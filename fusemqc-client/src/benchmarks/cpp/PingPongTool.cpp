@@ -0,0 +1,633 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * cms-pingpong measures request/reply round trip times through the C API.  The requester
+ * sends one request at a time with a temporary reply Queue and a correlation ID, the
+ * responder answers through cms_borrowCMSMessageReplyTo and the requester times the wait
+ * for the matching reply.  Both sides run in this process by default, use -mode requester
+ * and -mode responder to run them as separate processes against a real broker.
+ *
+ * Two distributions are reported.  The service time is what each request actually took.
+ * The corrected distribution also accounts for the requests that a stall held back: when
+ * sending at a fixed -interval every request is timed from when it should have been sent,
+ * and when sending back to back the requests that would have been issued during a long
+ * round trip are back filled using the mean round trip time seen during the warm up.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <Config.h>
+#include <cms.h>
+#include <CMS_ConnectionFactory.h>
+#include <CMS_Connection.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+
+#include <decaf/lang/Runnable.h>
+#include <decaf/lang/System.h>
+#include <decaf/lang/Thread.h>
+
+#include <stdlib.h>
+
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace benchmarks;
+using decaf::lang::System;
+using decaf::lang::Thread;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const std::string DEFAULT_BROKER_URI = "loop://cms-pingpong";
+    const char* DONE_PROPERTY = "PingPongDone";
+
+    struct Options {
+
+        std::string brokerUri;
+        std::string mode;
+        std::string destination;
+        std::string histogram;
+        int size;
+        bool persistent;
+        CMS_ACKNOWLEDGMENT_MODE ackMode;
+        long long iterations;
+        long long warmup;
+        long long interval;
+        int timeout;
+        int requesterCpu;
+        int responderCpu;
+
+        Options() : brokerUri(DEFAULT_BROKER_URI), mode("both"), destination("cms.pingpong"), histogram(),
+                    size(64), persistent(false), ackMode(CMS_AUTO_ACKNOWLEDGE), iterations(1000000),
+                    warmup(10000), interval(0), timeout(5000), requesterCpu(-1), responderCpu(-1) {}
+
+        bool runRequester() const {
+            return this->mode == "requester" || this->mode == "both";
+        }
+
+        bool runResponder() const {
+            return this->mode == "responder" || this->mode == "both";
+        }
+
+        int getDeliveryMode() const {
+            return this->persistent ? CMS_MSG_PERSISTENT : CMS_MSG_NON_PERSISTENT;
+        }
+    };
+
+    void check(cms_status status, const char* operation) {
+
+        if (status != CMS_SUCCESS) {
+            std::ostringstream message;
+            message << operation << " failed with status " << status;
+            throw std::runtime_error(message.str());
+        }
+    }
+
+    /**
+     * Pins the calling thread to the given CPU, a negative CPU leaves it alone.
+     */
+    void pinToCpu(int cpu, const char* who) {
+
+        if (cpu < 0) {
+            return;
+        }
+
+#ifdef HAVE_SCHED_SETAFFINITY
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+
+        if (::sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+            std::cout << "Could not pin the " << who << " to CPU " << cpu << std::endl;
+        }
+#else
+        std::cout << "CPU pinning is not supported on this platform, the " << who << " is not pinned" << std::endl;
+#endif
+    }
+
+    /**
+     * Commits or acknowledges a received Message as the Session's ack mode requires,
+     * every round trip is its own batch.
+     */
+    cms_status complete(const Options& options, CMS_Session* session, CMS_Message* message) {
+
+        if (options.ackMode == CMS_SESSION_TRANSACTED) {
+            return cms_commitSession(session);
+        } else if (options.ackMode == CMS_CLIENT_ACKNOWLEDGE || options.ackMode == CMS_INDIVIDUAL_ACKNOWLEDGE) {
+            return cms_acknowledgeMessage(message);
+        }
+
+        return CMS_SUCCESS;
+    }
+
+    /**
+     * Answers every request with a message of the configured size carrying the request's
+     * correlation ID until the requester says it is done.
+     */
+    class Responder : public decaf::lang::Runnable {
+    private:
+
+        const Options& options;
+        CMS_Session* session;
+        CMS_Destination* destination;
+        CMS_MessageConsumer* consumer;
+        CMS_MessageProducer* producer;
+        std::vector<unsigned char> body;
+
+    public:
+
+        long long count;
+        std::string error;
+
+    public:
+
+        Responder(const Options& options) :
+            options(options), session(NULL), destination(NULL), consumer(NULL), producer(NULL),
+            body(options.size > 0 ? options.size : 1, 'x'), count(0), error() {}
+
+        virtual ~Responder() {
+            cms_destroyProducer(this->producer);
+            cms_destroyConsumer(this->consumer);
+            cms_destroyDestination(this->destination);
+            cms_destroySession(this->session);
+        }
+
+        void setUp(CMS_Connection* connection) {
+
+            check(cms_createSession(connection, &this->session, this->options.ackMode), "cms_createSession");
+            check(cms_createDestination(this->session, CMS_QUEUE, this->options.destination.c_str(),
+                                        &this->destination), "cms_createDestination");
+            check(cms_createDefaultConsumer(this->session, this->destination, &this->consumer), "cms_createDefaultConsumer");
+            check(cms_createProducer(this->session, NULL, &this->producer), "cms_createProducer");
+        }
+
+        virtual void run() {
+
+            pinToCpu(this->options.responderCpu, "responder");
+
+            try {
+                respond();
+            } catch (std::exception& ex) {
+                this->error = ex.what();
+            }
+        }
+
+    private:
+
+        void respond() {
+
+            long long idleTimeout = (long long) this->options.timeout;
+            long long lastReceived = System::currentTimeMillis();
+
+            while (true) {
+
+                CMS_Message* request = NULL;
+                cms_status status = cms_consumerReceiveWithTimeout(this->consumer, &request, 100);
+
+                // Waits as long as it takes for the first request so the responder can be
+                // started ahead of the requester.
+                if (status == CMS_RECEIVE_TIMEDOUT || (status == CMS_SUCCESS && request == NULL)) {
+                    if (this->count > 0 && System::currentTimeMillis() - lastReceived > idleTimeout) {
+                        throw std::runtime_error("timed out waiting for a request");
+                    }
+                    continue;
+                }
+
+                check(status, "cms_consumerReceiveWithTimeout");
+                lastReceived = System::currentTimeMillis();
+
+                int done = 0;
+                cms_getMessageBooleanProperty(request, DONE_PROPERTY, &done);
+
+                if (!done) {
+                    status = reply(request);
+                }
+
+                if (status == CMS_SUCCESS) {
+                    status = complete(this->options, this->session, request);
+                }
+
+                cms_destroyMessage(request);
+                check(status, "reply");
+
+                if (done) {
+                    return;
+                }
+
+                this->count++;
+            }
+        }
+
+        cms_status reply(CMS_Message* request) {
+
+            char correlationId[64];
+            CMS_Destination* replyTo = NULL;
+            CMS_Message* response = NULL;
+
+            cms_status status = cms_getCMSMessageCorrelationID(request, correlationId, (int) sizeof(correlationId));
+            if (status == CMS_SUCCESS) {
+                status = cms_borrowCMSMessageReplyTo(request, &replyTo);
+            }
+            if (status == CMS_SUCCESS && replyTo == NULL) {
+                status = CMS_ERROR;
+            }
+            if (status == CMS_SUCCESS) {
+                status = cms_createBytesMessage(this->session, &response, &this->body[0], this->options.size);
+            }
+            if (status == CMS_SUCCESS) {
+                status = cms_setCMSMessageCorrelationID(response, correlationId);
+            }
+            if (status == CMS_SUCCESS) {
+                status = cms_producerSendToDestination(this->producer, response, replyTo,
+                                                       this->options.getDeliveryMode(), 4, 0);
+            }
+
+            cms_destroyMessage(response);
+
+            return status;
+        }
+    };
+
+    /**
+     * Sends the requests one at a time and times each round trip.
+     */
+    class Requester {
+    private:
+
+        const Options& options;
+        CMS_Session* session;
+        CMS_Destination* destination;
+        CMS_Destination* replyTo;
+        CMS_MessageProducer* producer;
+        CMS_MessageConsumer* consumer;
+        std::vector<unsigned char> body;
+
+    public:
+
+        LatencyHistogram serviceTime;
+        LatencyHistogram correctedTime;
+        long long elapsed;
+
+    public:
+
+        Requester(const Options& options) :
+            options(options), session(NULL), destination(NULL), replyTo(NULL), producer(NULL), consumer(NULL),
+            body(options.size > 0 ? options.size : 1, 'x'), serviceTime(), correctedTime(), elapsed(0) {}
+
+        ~Requester() {
+            cms_destroyConsumer(this->consumer);
+            cms_destroyProducer(this->producer);
+            cms_destroyDestination(this->replyTo);
+            cms_destroyDestination(this->destination);
+            cms_destroySession(this->session);
+        }
+
+        void setUp(CMS_Connection* connection) {
+
+            check(cms_createSession(connection, &this->session, this->options.ackMode), "cms_createSession");
+            check(cms_createDestination(this->session, CMS_QUEUE, this->options.destination.c_str(),
+                                        &this->destination), "cms_createDestination");
+            check(cms_createTemporaryDestination(this->session, CMS_TEMPORARY_QUEUE, &this->replyTo),
+                  "cms_createTemporaryDestination");
+            check(cms_createProducer(this->session, this->destination, &this->producer), "cms_createProducer");
+            check(cms_setProducerDisableMessageTimeStamp(this->producer, 1), "cms_setProducerDisableMessageTimeStamp");
+            check(cms_createDefaultConsumer(this->session, this->replyTo, &this->consumer), "cms_createDefaultConsumer");
+        }
+
+        void run() {
+
+            pinToCpu(this->options.requesterCpu, "requester");
+
+            // The warm up also gives the typical round trip used to back fill stalls when
+            // there is no fixed interval to measure against.
+            LatencyHistogram warmup;
+            long long sequence = 0;
+
+            for (long long i = 0; i < this->options.warmup; ++i) {
+                long long start = System::nanoTime();
+                roundTrip(sequence++);
+                warmup.recordValue(System::nanoTime() - start);
+            }
+
+            long long expectedInterval = this->options.interval > 0 ? 0 : (long long) warmup.getMean();
+            long long interval = this->options.interval * 1000;
+            long long start = System::nanoTime();
+
+            for (long long i = 0; i < this->options.iterations; ++i) {
+
+                long long intended = start + i * interval;
+                if (interval > 0) {
+                    while (System::nanoTime() < intended) {
+                        Thread::yield();
+                    }
+                }
+
+                long long sent = System::nanoTime();
+                roundTrip(sequence++);
+                long long now = System::nanoTime();
+
+                this->serviceTime.recordValue(now - sent);
+
+                if (interval > 0) {
+                    this->correctedTime.recordValue(now - intended);
+                } else {
+                    this->correctedTime.recordValueWithExpectedInterval(now - sent, expectedInterval);
+                }
+            }
+
+            this->elapsed = System::nanoTime() - start;
+        }
+
+        /**
+         * Tells the responder to stop.
+         */
+        void finish() {
+
+            CMS_Message* message = NULL;
+
+            check(cms_createMessage(this->session, &message), "cms_createMessage");
+            cms_status status = cms_setMessageBooleanProperty(message, DONE_PROPERTY, 1);
+            if (status == CMS_SUCCESS) {
+                status = cms_producerSend(this->producer, message, this->options.getDeliveryMode(), 4, 0);
+            }
+            if (status == CMS_SUCCESS && this->options.ackMode == CMS_SESSION_TRANSACTED) {
+                status = cms_commitSession(this->session);
+            }
+
+            cms_destroyMessage(message);
+            check(status, "cms_producerSend");
+        }
+
+    private:
+
+        void roundTrip(long long sequence) {
+
+            std::ostringstream correlationId;
+            correlationId << "pingpong-" << sequence;
+
+            CMS_Message* request = NULL;
+            check(cms_createBytesMessage(this->session, &request, &this->body[0], this->options.size),
+                  "cms_createBytesMessage");
+
+            cms_status status = cms_setCMSMessageCorrelationID(request, correlationId.str().c_str());
+            if (status == CMS_SUCCESS) {
+                status = cms_setCMSMessageReplyTo(request, this->replyTo);
+            }
+            if (status == CMS_SUCCESS) {
+                status = cms_producerSend(this->producer, request, this->options.getDeliveryMode(), 4, 0);
+            }
+            if (status == CMS_SUCCESS && this->options.ackMode == CMS_SESSION_TRANSACTED) {
+                status = cms_commitSession(this->session);
+            }
+
+            cms_destroyMessage(request);
+            check(status, "cms_producerSend");
+
+            // Replies to requests that timed out earlier can still arrive, skip them.
+            while (true) {
+
+                CMS_Message* reply = NULL;
+                status = cms_consumerReceiveWithTimeout(this->consumer, &reply, this->options.timeout);
+
+                if (status == CMS_SUCCESS && reply == NULL) {
+                    status = CMS_RECEIVE_TIMEDOUT;
+                }
+                check(status, "cms_consumerReceiveWithTimeout");
+
+                char received[64];
+                status = cms_getCMSMessageCorrelationID(reply, received, (int) sizeof(received));
+                bool matched = status == CMS_SUCCESS && correlationId.str() == received;
+
+                if (status == CMS_SUCCESS) {
+                    status = complete(this->options, this->session, reply);
+                }
+
+                cms_destroyMessage(reply);
+                check(status, "reply");
+
+                if (matched) {
+                    return;
+                }
+            }
+        }
+    };
+
+    void report(const char* name, const LatencyHistogram& latency) {
+
+        std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(1)
+                  << " p50=" << latency.getValueAtPercentile(50.0) / 1000.0
+                  << " p90=" << latency.getValueAtPercentile(90.0) / 1000.0
+                  << " p99=" << latency.getValueAtPercentile(99.0) / 1000.0
+                  << " p99.9=" << latency.getValueAtPercentile(99.9) / 1000.0
+                  << " p99.99=" << latency.getValueAtPercentile(99.99) / 1000.0
+                  << " max=" << latency.getMaxValue() / 1000.0 << " (us)" << std::endl;
+    }
+
+    bool parseAckMode(const std::string& value, CMS_ACKNOWLEDGMENT_MODE& mode) {
+
+        if (value == "auto") {
+            mode = CMS_AUTO_ACKNOWLEDGE;
+        } else if (value == "dups_ok") {
+            mode = CMS_DUPS_OK_ACKNOWLEDGE;
+        } else if (value == "client") {
+            mode = CMS_CLIENT_ACKNOWLEDGE;
+        } else if (value == "individual") {
+            mode = CMS_INDIVIDUAL_ACKNOWLEDGE;
+        } else if (value == "transacted") {
+            mode = CMS_SESSION_TRANSACTED;
+        } else {
+            return false;
+        }
+
+        return true;
+    }
+
+    void usage() {
+        std::cout << "usage: cms-pingpong [-broker <uri>] [-mode requester|responder|both]"
+                  << " [-destination <name>] [-size <bytes>] [-persistent]"
+                  << " [-ack auto|dups_ok|client|individual|transacted]"
+                  << " [-iterations <n>] [-warmup <n>] [-interval <us>] [-timeout <ms>]"
+                  << " [-requester-cpu <n>] [-responder-cpu <n>] [-histogram <file>]" << std::endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+
+        const std::string arg(argv[i]);
+
+        if (arg == "-persistent") {
+            options.persistent = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            usage();
+            return -1;
+        }
+
+        const std::string value(argv[++i]);
+
+        if (arg == "-broker") {
+            options.brokerUri = value;
+        } else if (arg == "-mode") {
+            options.mode = value;
+        } else if (arg == "-destination") {
+            options.destination = value;
+        } else if (arg == "-size") {
+            options.size = ::atoi(value.c_str());
+        } else if (arg == "-ack") {
+            if (!parseAckMode(value, options.ackMode)) {
+                usage();
+                return -1;
+            }
+        } else if (arg == "-iterations") {
+            options.iterations = ::atol(value.c_str());
+        } else if (arg == "-warmup") {
+            options.warmup = ::atol(value.c_str());
+        } else if (arg == "-interval") {
+            options.interval = ::atol(value.c_str());
+        } else if (arg == "-timeout") {
+            options.timeout = ::atoi(value.c_str());
+        } else if (arg == "-requester-cpu") {
+            options.requesterCpu = ::atoi(value.c_str());
+        } else if (arg == "-responder-cpu") {
+            options.responderCpu = ::atoi(value.c_str());
+        } else if (arg == "-histogram") {
+            options.histogram = value;
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    if ((!options.runRequester() && !options.runResponder()) || options.size < 0 ||
+        options.iterations <= 0 || options.warmup < 0 || options.interval < 0 || options.timeout <= 0) {
+
+        usage();
+        return -1;
+    }
+
+    cms_initialize();
+
+    CMS_ConnectionFactory* factory = NULL;
+    CMS_Connection* connection = NULL;
+    std::auto_ptr<Responder> responder;
+    std::auto_ptr<Requester> requester;
+    std::auto_ptr<Thread> responderThread;
+    int exitCode = 0;
+
+    try {
+
+        check(cms_createConnectionFactory(&factory, options.brokerUri.c_str(), NULL, NULL), "cms_createConnectionFactory");
+        check(cms_createDefaultConnection(factory, &connection), "cms_createDefaultConnection");
+
+        if (options.runResponder()) {
+            responder.reset(new Responder(options));
+            responder->setUp(connection);
+        }
+
+        if (options.runRequester()) {
+            requester.reset(new Requester(options));
+            requester->setUp(connection);
+        }
+
+        check(cms_startConnection(connection), "cms_startConnection");
+
+        if (responder.get() != NULL) {
+            responderThread.reset(new Thread(responder.get(), "cms-pingpong responder"));
+            responderThread->start();
+        }
+
+        if (requester.get() != NULL) {
+
+            try {
+                requester->run();
+            } catch (...) {
+                requester->finish();
+                throw;
+            }
+
+            requester->finish();
+
+            double seconds = (double) requester->elapsed / 1000000000.0;
+            std::cout << options.iterations << " round trips in " << std::fixed << std::setprecision(3) << seconds
+                      << " s, " << std::setprecision(1) << (double) options.iterations / seconds << " per second"
+                      << std::endl;
+
+            report("service time", requester->serviceTime);
+            report("corrected", requester->correctedTime);
+
+            if (!options.histogram.empty()) {
+                std::ofstream file(options.histogram.c_str());
+                requester->correctedTime.writePercentileDistribution(file, 1000.0);
+                std::cout << "Corrected latency distribution written to " << options.histogram << std::endl;
+            }
+        }
+
+        if (responderThread.get() != NULL) {
+
+            responderThread->join();
+
+            if (!responder->error.empty()) {
+                throw std::runtime_error(responder->error);
+            }
+
+            if (requester.get() == NULL) {
+                std::cout << "Answered " << responder->count << " requests" << std::endl;
+            }
+        }
+
+    } catch (std::exception& ex) {
+        std::cout << "cms-pingpong failed: " << ex.what() << std::endl;
+        exitCode = 1;
+    }
+
+    if (responderThread.get() != NULL) {
+        responderThread->join();
+    }
+
+    requester.reset();
+    responderThread.reset();
+    responder.reset();
+
+    cms_destroyConnection(connection);
+    cms_destroyConnectionFactory(factory);
+
+    cms_terminate();
+
+    return exitCode;
+}
@@ -0,0 +1,508 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Sweeps the number of threads and the number of connections they are spread over and
+ * measures send and receive throughput for each combination.  Every thread owns its own
+ * Session, so the sessions per connection are threads / connections, one connection is
+ * N threads sharing a CMS_Connection and connections == threads is a connection each.
+ *
+ * The locks inside ActiveMQ-CPP's transport and session executor cannot be timed from
+ * the outside, so each thread also reports how much of its wall time it spent off the
+ * CPU and how often it blocked (voluntary context switches).  A cell whose throughput
+ * stops growing while the off CPU share and the blocks per message climb is waiting on
+ * a lock shared through the Connection.
+ */
+
+#include <cms.h>
+#include <CMS_ConnectionFactory.h>
+#include <CMS_Connection.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+
+#include <decaf/lang/Runnable.h>
+#include <decaf/lang/System.h>
+#include <decaf/lang/Thread.h>
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using decaf::lang::System;
+using decaf::lang::Thread;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const std::string DEFAULT_BROKER_URI = "loop://scaling-benchmark";
+    const std::string DEFAULT_OUTPUT = "scaling-benchmark.json";
+    const char* MESSAGE_BODY = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+    void check(cms_status status, const char* operation) {
+
+        if (status != CMS_SUCCESS) {
+            std::ostringstream message;
+            message << operation << " failed with status " << status;
+            throw std::runtime_error(message.str());
+        }
+    }
+
+    /**
+     * CPU time consumed by the calling thread, or -1 where it can't be read.
+     */
+    long long threadCpuNanos() {
+
+#ifdef CLOCK_THREAD_CPUTIME_ID
+        struct timespec now;
+        if (::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) == 0) {
+            return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+        }
+#endif
+        return -1;
+    }
+
+    /**
+     * The number of times the calling thread gave up the CPU to wait, or -1 where it
+     * can't be read.
+     */
+    long long threadBlocks() {
+
+#ifdef RUSAGE_THREAD
+        struct rusage usage;
+        if (::getrusage(RUSAGE_THREAD, &usage) == 0) {
+            return usage.ru_nvcsw;
+        }
+#endif
+        return -1;
+    }
+
+    std::vector<int> parseList(const std::string& value) {
+
+        std::vector<int> values;
+        std::istringstream stream(value);
+        std::string item;
+
+        while (std::getline(stream, item, ',')) {
+            values.push_back(::atoi(item.c_str()));
+        }
+
+        return values;
+    }
+
+    /**
+     * One thread's Session, producer or consumer and its own Queue.  The workers of a cell
+     * spin until released together so that thread start up isn't timed.
+     */
+    class Worker : public decaf::lang::Runnable {
+    private:
+
+        bool send;
+        long long messages;
+        volatile int* go;
+
+        CMS_Session* session;
+        CMS_Destination* destination;
+        CMS_MessageProducer* producer;
+        CMS_MessageConsumer* consumer;
+        CMS_Message* message;
+
+    public:
+
+        long long wallTime;
+        long long cpuTime;
+        long long blocks;
+        std::string error;
+
+    public:
+
+        Worker(bool send, long long messages, volatile int* go) :
+            send(send), messages(messages), go(go), session(NULL), destination(NULL), producer(NULL),
+            consumer(NULL), message(NULL), wallTime(0), cpuTime(-1), blocks(-1), error() {}
+
+        virtual ~Worker() {
+            cms_destroyMessage(this->message);
+            cms_destroyConsumer(this->consumer);
+            cms_destroyProducer(this->producer);
+            cms_destroyDestination(this->destination);
+            cms_destroySession(this->session);
+        }
+
+        /**
+         * Creates the Session and, for the receive workload, fills the Queue so that the
+         * timed part only receives.
+         */
+        void setUp(CMS_Connection* connection, const std::string& name) {
+
+            check(cms_createDefaultSession(connection, &this->session), "cms_createDefaultSession");
+            check(cms_createTextMessage(this->session, &this->message, MESSAGE_BODY), "cms_createTextMessage");
+
+            if (this->send) {
+
+                // Nothing subscribes to the Topic so the broker discards the messages and
+                // only the client side of the send is measured.
+                check(cms_createDestination(this->session, CMS_TOPIC, name.c_str(), &this->destination),
+                      "cms_createDestination");
+                check(cms_createProducer(this->session, this->destination, &this->producer), "cms_createProducer");
+
+            } else {
+
+                check(cms_createDestination(this->session, CMS_QUEUE, name.c_str(), &this->destination),
+                      "cms_createDestination");
+                check(cms_createProducer(this->session, this->destination, &this->producer), "cms_createProducer");
+                check(cms_createDefaultConsumer(this->session, this->destination, &this->consumer),
+                      "cms_createDefaultConsumer");
+
+                for (long long i = 0; i < this->messages; ++i) {
+                    check(cms_producerSend(this->producer, this->message, CMS_MSG_NON_PERSISTENT, 4, 0),
+                          "cms_producerSend");
+                }
+            }
+        }
+
+        virtual void run() {
+
+            while (__sync_fetch_and_add(this->go, 0) == 0) {
+                Thread::yield();
+            }
+
+            long long startCpu = threadCpuNanos();
+            long long startBlocks = threadBlocks();
+            long long start = System::nanoTime();
+
+            try {
+
+                if (this->send) {
+                    for (long long i = 0; i < this->messages; ++i) {
+                        check(cms_producerSend(this->producer, this->message, CMS_MSG_NON_PERSISTENT, 4, 0),
+                              "cms_producerSend");
+                    }
+                } else {
+                    for (long long i = 0; i < this->messages; ++i) {
+                        CMS_Message* received = NULL;
+                        check(cms_consumerReceiveWithTimeout(this->consumer, &received, 5000),
+                              "cms_consumerReceiveWithTimeout");
+                        cms_destroyMessage(received);
+                    }
+                }
+
+            } catch (std::exception& ex) {
+                this->error = ex.what();
+            }
+
+            this->wallTime = System::nanoTime() - start;
+
+            long long endCpu = threadCpuNanos();
+            if (startCpu >= 0 && endCpu >= 0) {
+                this->cpuTime = endCpu - startCpu;
+            }
+
+            long long endBlocks = threadBlocks();
+            if (startBlocks >= 0 && endBlocks >= 0) {
+                this->blocks = endBlocks - startBlocks;
+            }
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    struct Result {
+
+        std::string workload;
+        int threads;
+        int connections;
+        long long messages;
+        double throughput;
+        double efficiency;
+        double offCpu;
+        double blocksPerThousand;
+
+        Result() : workload(), threads(0), connections(0), messages(0), throughput(0),
+                   efficiency(0), offCpu(-1), blocksPerThousand(-1) {}
+    };
+
+    /**
+     * Runs one cell of the matrix on fresh Connections and Destinations.
+     */
+    Result measure(CMS_ConnectionFactory* factory, bool send, int threads, int connections,
+                   long long messages, int cell) {
+
+        std::vector<CMS_Connection*> connectionList(connections, (CMS_Connection*) NULL);
+        std::vector<Worker*> workers;
+        std::vector<Thread*> threadList;
+        volatile int go = 0;
+        std::string error;
+
+        try {
+
+            for (int i = 0; i < connections; ++i) {
+                check(cms_createDefaultConnection(factory, &connectionList[i]), "cms_createDefaultConnection");
+                check(cms_startConnection(connectionList[i]), "cms_startConnection");
+            }
+
+            for (int i = 0; i < threads; ++i) {
+
+                std::ostringstream name;
+                name << "scaling." << cell << "." << i;
+
+                workers.push_back(new Worker(send, messages, &go));
+                workers.back()->setUp(connectionList[i % connections], name.str());
+                threadList.push_back(new Thread(workers.back(), "scaling-benchmark worker"));
+                threadList.back()->start();
+            }
+
+        } catch (std::exception& ex) {
+            error = ex.what();
+        }
+
+        __sync_fetch_and_add(&go, 1);
+
+        for (std::size_t i = 0; i < threadList.size(); ++i) {
+            threadList[i]->join();
+            delete threadList[i];
+        }
+
+        Result result;
+        result.workload = send ? "send" : "receive";
+        result.threads = threads;
+        result.connections = connections;
+        result.messages = messages * threads;
+
+        long long slowest = 0;
+        long long wall = 0;
+        long long cpu = 0;
+        long long blocks = 0;
+        bool haveCpu = true;
+        bool haveBlocks = true;
+
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+
+            if (error.empty() && !workers[i]->error.empty()) {
+                error = workers[i]->error;
+            }
+
+            slowest = std::max(slowest, workers[i]->wallTime);
+            wall += workers[i]->wallTime;
+            cpu += workers[i]->cpuTime;
+            blocks += workers[i]->blocks;
+            haveCpu = haveCpu && workers[i]->cpuTime >= 0;
+            haveBlocks = haveBlocks && workers[i]->blocks >= 0;
+
+            delete workers[i];
+        }
+
+        for (int i = 0; i < connections; ++i) {
+            cms_destroyConnection(connectionList[i]);
+        }
+
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+
+        result.throughput = slowest > 0 ? (double) result.messages * 1000000000.0 / (double) slowest : 0;
+
+        if (haveCpu && wall > 0) {
+            result.offCpu = 100.0 * (1.0 - (double) cpu / (double) wall);
+            if (result.offCpu < 0) {
+                result.offCpu = 0;
+            }
+        }
+
+        if (haveBlocks) {
+            result.blocksPerThousand = 1000.0 * (double) blocks / (double) result.messages;
+        }
+
+        return result;
+    }
+
+    std::string escape(const std::string& value) {
+
+        std::string escaped;
+
+        for (std::string::const_iterator iter = value.begin(); iter != value.end(); ++iter) {
+            if (*iter == '"' || *iter == '\\') {
+                escaped += '\\';
+            }
+            escaped += *iter;
+        }
+
+        return escaped;
+    }
+
+    void writeResults(std::ostream& out, const std::string& brokerUri, const std::vector<Result>& results) {
+
+        out << "{\n";
+        out << "  \"suite\": \"scaling\",\n";
+        out << "  \"broker\": \"" << escape(brokerUri) << "\",\n";
+        out << "  \"results\": [\n";
+
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            out << "    {\"workload\": \"" << results[i].workload << "\", "
+                << "\"threads\": " << results[i].threads << ", "
+                << "\"connections\": " << results[i].connections << ", "
+                << "\"messages\": " << results[i].messages << ", "
+                << std::fixed << std::setprecision(2)
+                << "\"msgs_per_sec\": " << results[i].throughput << ", "
+                << "\"efficiency\": " << results[i].efficiency << ", "
+                << "\"off_cpu_percent\": " << results[i].offCpu << ", "
+                << "\"blocks_per_1k_msgs\": " << results[i].blocksPerThousand << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+
+        out << "  ]\n";
+        out << "}\n";
+    }
+
+    void printHeader() {
+        std::cout << std::left << std::setw(9) << "workload" << std::right
+                  << std::setw(8) << "threads" << std::setw(7) << "conns" << std::setw(11) << "sess/conn"
+                  << std::setw(14) << "msgs/s" << std::setw(14) << "msgs/s/thr" << std::setw(11) << "scaling"
+                  << std::setw(10) << "off-cpu%" << std::setw(12) << "blocks/1k" << std::endl;
+    }
+
+    void printResult(const Result& result) {
+        std::cout << std::left << std::setw(9) << result.workload << std::right
+                  << std::setw(8) << result.threads << std::setw(7) << result.connections
+                  << std::setw(11) << (result.threads + result.connections - 1) / result.connections
+                  << std::fixed << std::setprecision(0)
+                  << std::setw(14) << result.throughput << std::setw(14) << result.throughput / result.threads
+                  << std::setprecision(2) << std::setw(11) << result.efficiency
+                  << std::setprecision(1) << std::setw(10) << result.offCpu
+                  << std::setw(12) << result.blocksPerThousand << std::endl;
+    }
+
+    void usage() {
+        std::cout << "usage: scaling-benchmark [-broker <uri>] [-threads <n,n,...>] [-connections <n,n,...>]"
+                  << " [-messages <per thread>] [-workload send|receive|both] [-output <file>]" << std::endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+
+    std::string brokerUri = DEFAULT_BROKER_URI;
+    std::string output = DEFAULT_OUTPUT;
+    std::string workload = "both";
+    std::vector<int> threadCounts = parseList("1,2,4,8,16,32,64");
+    std::vector<int> connectionCounts = parseList("1,2,4,8,16,32,64");
+    long long messages = 20000;
+
+    for (int i = 1; i < argc; ++i) {
+
+        const std::string arg(argv[i]);
+
+        if (i + 1 >= argc) {
+            usage();
+            return -1;
+        }
+
+        if (arg == "-broker") {
+            brokerUri = argv[++i];
+        } else if (arg == "-threads") {
+            threadCounts = parseList(argv[++i]);
+        } else if (arg == "-connections") {
+            connectionCounts = parseList(argv[++i]);
+        } else if (arg == "-messages") {
+            messages = ::atol(argv[++i]);
+        } else if (arg == "-workload") {
+            workload = argv[++i];
+        } else if (arg == "-output") {
+            output = argv[++i];
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    if (messages <= 0 || threadCounts.empty() || connectionCounts.empty() ||
+        (workload != "send" && workload != "receive" && workload != "both")) {
+
+        usage();
+        return -1;
+    }
+
+    cms_initialize();
+
+    CMS_ConnectionFactory* factory = NULL;
+    std::vector<Result> results;
+    int exitCode = 0;
+    int cell = 0;
+
+    try {
+
+        check(cms_createConnectionFactory(&factory, brokerUri.c_str(), NULL, NULL), "cms_createConnectionFactory");
+
+        printHeader();
+
+        for (int pass = 0; pass < 2; ++pass) {
+
+            bool send = pass == 0;
+
+            if ((send && workload == "receive") || (!send && workload == "send")) {
+                continue;
+            }
+
+            // Scaling is relative to a single thread on a single connection.
+            double baseline = measure(factory, send, 1, 1, messages, cell++).throughput;
+
+            for (std::size_t t = 0; t < threadCounts.size(); ++t) {
+                for (std::size_t c = 0; c < connectionCounts.size(); ++c) {
+
+                    int threads = threadCounts[t];
+                    int connections = connectionCounts[c];
+
+                    // More connections than threads would leave some of them idle.
+                    if (threads <= 0 || connections <= 0 || connections > threads) {
+                        continue;
+                    }
+
+                    Result result = measure(factory, send, threads, connections, messages, cell++);
+                    result.efficiency = baseline > 0 ? result.throughput / (baseline * threads) : 0;
+
+                    printResult(result);
+                    results.push_back(result);
+                }
+            }
+        }
+
+        std::ofstream file(output.c_str());
+        writeResults(file, brokerUri, results);
+
+        std::cout << "Results written to " << output << std::endl;
+
+    } catch (std::exception& ex) {
+        std::cout << "Benchmark failed: " << ex.what() << std::endl;
+        exitCode = 1;
+    }
+
+    cms_destroyConnectionFactory(factory);
+
+    cms_terminate();
+
+    return exitCode;
+}
@@ -0,0 +1,706 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the cost of the hot C API entry points in nanoseconds and heap allocations
+ * per call.  By default the benchmarks run against the in-process loop:// broker so no
+ * network time is included, the numbers are the wrapper plus the CMS objects beneath it.
+ * Results are printed and written to a JSON file so releases can be compared.
+ */
+
+#include <Config.h>
+#include <cms.h>
+#include <CMS_ConnectionFactory.h>
+#include <CMS_Connection.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
+#include <CMS_BytesMessage.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+
+#include <decaf/lang/System.h>
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if __cplusplus >= 201103L
+#define BENCHMARK_THROWS_BAD_ALLOC
+#define BENCHMARK_NO_THROW noexcept
+#else
+#define BENCHMARK_THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define BENCHMARK_NO_THROW throw()
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Every heap allocation in the process, including those made inside ActiveMQ-CPP,
+// goes through these so the benchmarks can report allocations per call.
+namespace {
+
+    volatile long long allocations = 0;
+
+    void* countedAllocate(std::size_t size) {
+
+        __sync_fetch_and_add(&allocations, 1LL);
+
+        void* memory = ::malloc(size == 0 ? 1 : size);
+        if (memory == NULL) {
+            throw std::bad_alloc();
+        }
+
+        return memory;
+    }
+
+    long long getAllocations() {
+        return __sync_fetch_and_add(&allocations, 0LL);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* operator new(std::size_t size) BENCHMARK_THROWS_BAD_ALLOC {
+    return countedAllocate(size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* operator new[](std::size_t size) BENCHMARK_THROWS_BAD_ALLOC {
+    return countedAllocate(size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* operator new(std::size_t size, const std::nothrow_t&) BENCHMARK_NO_THROW {
+    try {
+        return countedAllocate(size);
+    } catch (std::bad_alloc&) {
+        return NULL;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void* operator new[](std::size_t size, const std::nothrow_t&) BENCHMARK_NO_THROW {
+    try {
+        return countedAllocate(size);
+    } catch (std::bad_alloc&) {
+        return NULL;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void operator delete(void* memory) BENCHMARK_NO_THROW {
+    ::free(memory);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void operator delete[](void* memory) BENCHMARK_NO_THROW {
+    ::free(memory);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void operator delete(void* memory, const std::nothrow_t&) BENCHMARK_NO_THROW {
+    ::free(memory);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void operator delete[](void* memory, const std::nothrow_t&) BENCHMARK_NO_THROW {
+    ::free(memory);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const std::string DEFAULT_BROKER_URI = "loop://wrapper-benchmark";
+    const std::string DEFAULT_OUTPUT = "wrapper-benchmark.json";
+    const char* MESSAGE_BODY = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+    void check(cms_status status, const char* operation) {
+
+        if (status != CMS_SUCCESS) {
+            std::ostringstream message;
+            message << operation << " failed with status " << status;
+            throw std::runtime_error(message.str());
+        }
+    }
+
+    /**
+     * The Connection and Session shared by every benchmark.
+     */
+    struct Fixture {
+
+        CMS_ConnectionFactory* factory;
+        CMS_Connection* connection;
+        CMS_Session* session;
+        int runs;
+
+        Fixture() : factory(NULL), connection(NULL), session(NULL), runs(0) {}
+
+        /**
+         * @returns a Destination name that no earlier run has used.
+         */
+        std::string uniqueName(const std::string& prefix) {
+            std::ostringstream name;
+            name << prefix << "." << ++runs;
+            return name.str();
+        }
+    };
+
+    /**
+     * A benchmark times run() over a number of calls.  Work that has to happen before the
+     * calls can be made, such as filling a Queue, is done in prepare() which is not timed
+     * and is called for every batch of at most getBatchSize() calls.
+     */
+    class Benchmark {
+    public:
+
+        virtual ~Benchmark() {}
+
+        virtual const char* getName() const = 0;
+
+        virtual long long getBatchSize() const {
+            return 0;
+        }
+
+        virtual void setUp(Fixture& fixture AMQC_UNUSED) {}
+
+        virtual void prepare(Fixture& fixture AMQC_UNUSED, long long count AMQC_UNUSED) {}
+
+        virtual void run(Fixture& fixture, long long count) = 0;
+
+        virtual void tearDown(Fixture& fixture AMQC_UNUSED) {}
+
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    class CreateTextMessageBenchmark : public Benchmark {
+    public:
+
+        virtual const char* getName() const {
+            return "cms_createTextMessage+cms_destroyMessage";
+        }
+
+        virtual void run(Fixture& fixture, long long count) {
+
+            for (long long i = 0; i < count; ++i) {
+                CMS_Message* message = NULL;
+                check(cms_createTextMessage(fixture.session, &message, MESSAGE_BODY), "cms_createTextMessage");
+                cms_destroyMessage(message);
+            }
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    class SetIntPropertyBenchmark : public Benchmark {
+    private:
+
+        CMS_Message* message;
+
+    public:
+
+        SetIntPropertyBenchmark() : message(NULL) {}
+
+        virtual const char* getName() const {
+            return "cms_setMessageIntProperty";
+        }
+
+        virtual void setUp(Fixture& fixture) {
+            check(cms_createTextMessage(fixture.session, &message, MESSAGE_BODY), "cms_createTextMessage");
+        }
+
+        virtual void run(Fixture& fixture AMQC_UNUSED, long long count) {
+
+            for (long long i = 0; i < count; ++i) {
+                check(cms_setMessageIntProperty(message, "sequence", (int) i), "cms_setMessageIntProperty");
+            }
+        }
+
+        virtual void tearDown(Fixture& fixture AMQC_UNUSED) {
+            cms_destroyMessage(message);
+            message = NULL;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    class GetMessageTextBenchmark : public Benchmark {
+    private:
+
+        CMS_Message* message;
+
+    public:
+
+        GetMessageTextBenchmark() : message(NULL) {}
+
+        virtual const char* getName() const {
+            return "cms_getMessageText";
+        }
+
+        virtual void setUp(Fixture& fixture) {
+            check(cms_createTextMessage(fixture.session, &message, MESSAGE_BODY), "cms_createTextMessage");
+        }
+
+        virtual void run(Fixture& fixture AMQC_UNUSED, long long count) {
+
+            char buffer[128];
+
+            for (long long i = 0; i < count; ++i) {
+                check(cms_getMessageText(message, buffer, (int) sizeof(buffer)), "cms_getMessageText");
+            }
+        }
+
+        virtual void tearDown(Fixture& fixture AMQC_UNUSED) {
+            cms_destroyMessage(message);
+            message = NULL;
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Each batch reads values back from a BytesMessage written and reset in prepare().
+    template<typename Reader>
+    class BytesReadBenchmark : public Benchmark {
+    private:
+
+        CMS_Message* message;
+
+    public:
+
+        BytesReadBenchmark() : message(NULL) {}
+
+        virtual const char* getName() const {
+            return Reader::name();
+        }
+
+        virtual long long getBatchSize() const {
+            return 4096;
+        }
+
+        virtual void prepare(Fixture& fixture, long long count) {
+
+            cms_destroyMessage(message);
+            message = NULL;
+
+            check(cms_createBytesMessage(fixture.session, &message, NULL, 0), "cms_createBytesMessage");
+
+            for (long long i = 0; i < count; ++i) {
+                Reader::write(message);
+            }
+
+            check(cms_resetBytesMessage(message), "cms_resetBytesMessage");
+        }
+
+        virtual void run(Fixture& fixture AMQC_UNUSED, long long count) {
+
+            for (long long i = 0; i < count; ++i) {
+                Reader::read(message);
+            }
+        }
+
+        virtual void tearDown(Fixture& fixture AMQC_UNUSED) {
+            cms_destroyMessage(message);
+            message = NULL;
+        }
+    };
+
+    struct IntReader {
+
+        static const char* name() {
+            return "cms_readIntFromBytesMessage";
+        }
+
+        static void write(CMS_Message* message) {
+            check(cms_writeIntToBytesMessage(message, 42), "cms_writeIntToBytesMessage");
+        }
+
+        static void read(CMS_Message* message) {
+            int value = 0;
+            check(cms_readIntFromBytesMessage(message, &value), "cms_readIntFromBytesMessage");
+        }
+    };
+
+    struct LongReader {
+
+        static const char* name() {
+            return "cms_readLongFromBytesMessage";
+        }
+
+        static void write(CMS_Message* message) {
+            check(cms_writeLongToBytesMessage(message, 42LL), "cms_writeLongToBytesMessage");
+        }
+
+        static void read(CMS_Message* message) {
+            long long value = 0;
+            check(cms_readLongFromBytesMessage(message, &value), "cms_readLongFromBytesMessage");
+        }
+    };
+
+    struct DoubleReader {
+
+        static const char* name() {
+            return "cms_readDoubleFromBytesMessage";
+        }
+
+        static void write(CMS_Message* message) {
+            check(cms_writeDoubleToBytesMessage(message, 42.0), "cms_writeDoubleToBytesMessage");
+        }
+
+        static void read(CMS_Message* message) {
+            double value = 0;
+            check(cms_readDoubleFromBytesMessage(message, &value), "cms_readDoubleFromBytesMessage");
+        }
+    };
+
+    struct BytesReader {
+
+        static const char* name() {
+            return "cms_readBytesFromBytesMessage[64]";
+        }
+
+        static void write(CMS_Message* message) {
+            check(cms_writeBytesToBytesMessage(message, (const unsigned char*) MESSAGE_BODY, 0, 64),
+                  "cms_writeBytesToBytesMessage");
+        }
+
+        static void read(CMS_Message* message) {
+            unsigned char buffer[64];
+            check(cms_readBytesFromBytesMessage(message, buffer, (int) sizeof(buffer)),
+                  "cms_readBytesFromBytesMessage");
+        }
+    };
+
+    struct UTFReader {
+
+        static const char* name() {
+            return "cms_readUTFFromBytesMessage[64]";
+        }
+
+        static void write(CMS_Message* message) {
+            check(cms_writeUTFToBytesMessage(message, MESSAGE_BODY), "cms_writeUTFToBytesMessage");
+        }
+
+        static void read(CMS_Message* message) {
+            char buffer[128];
+            check(cms_readUTFFromBytesMessage(message, buffer, (int) sizeof(buffer)), "cms_readUTFFromBytesMessage");
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Sends to a Topic nobody subscribes to so the broker discards each Message.
+    class ProducerSendBenchmark : public Benchmark {
+    private:
+
+        CMS_Destination* destination;
+        CMS_MessageProducer* producer;
+        CMS_Message* message;
+
+    public:
+
+        ProducerSendBenchmark() : destination(NULL), producer(NULL), message(NULL) {}
+
+        virtual const char* getName() const {
+            return "cms_producerSend";
+        }
+
+        virtual void setUp(Fixture& fixture) {
+
+            std::string name = fixture.uniqueName("benchmark.wrapper.send");
+
+            check(cms_createDestination(fixture.session, CMS_TOPIC, name.c_str(), &destination), "cms_createDestination");
+            check(cms_createProducer(fixture.session, destination, &producer), "cms_createProducer");
+            check(cms_createTextMessage(fixture.session, &message, MESSAGE_BODY), "cms_createTextMessage");
+        }
+
+        virtual void run(Fixture& fixture AMQC_UNUSED, long long count) {
+
+            for (long long i = 0; i < count; ++i) {
+                check(cms_producerSend(producer, message, CMS_MSG_NON_PERSISTENT, 4, 0), "cms_producerSend");
+            }
+        }
+
+        virtual void tearDown(Fixture& fixture AMQC_UNUSED) {
+            cms_destroyMessage(message);
+            cms_destroyProducer(producer);
+            cms_destroyDestination(destination);
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Each batch receives Messages that prepare() queued ahead of time.
+    class ConsumerReceiveBenchmark : public Benchmark {
+    private:
+
+        CMS_Destination* destination;
+        CMS_MessageProducer* producer;
+        CMS_MessageConsumer* consumer;
+        CMS_Message* message;
+
+    public:
+
+        ConsumerReceiveBenchmark() : destination(NULL), producer(NULL), consumer(NULL), message(NULL) {}
+
+        virtual const char* getName() const {
+            return "cms_consumerReceiveWithTimeout+cms_destroyMessage";
+        }
+
+        virtual long long getBatchSize() const {
+            return 4096;
+        }
+
+        virtual void setUp(Fixture& fixture) {
+
+            std::string name = fixture.uniqueName("benchmark.wrapper.receive");
+
+            check(cms_createDestination(fixture.session, CMS_QUEUE, name.c_str(), &destination), "cms_createDestination");
+            check(cms_createProducer(fixture.session, destination, &producer), "cms_createProducer");
+            check(cms_createDefaultConsumer(fixture.session, destination, &consumer), "cms_createDefaultConsumer");
+            check(cms_createTextMessage(fixture.session, &message, MESSAGE_BODY), "cms_createTextMessage");
+        }
+
+        virtual void prepare(Fixture& fixture AMQC_UNUSED, long long count) {
+
+            for (long long i = 0; i < count; ++i) {
+                check(cms_producerSend(producer, message, CMS_MSG_NON_PERSISTENT, 4, 0), "cms_producerSend");
+            }
+        }
+
+        virtual void run(Fixture& fixture AMQC_UNUSED, long long count) {
+
+            for (long long i = 0; i < count; ++i) {
+                CMS_Message* received = NULL;
+                check(cms_consumerReceiveWithTimeout(consumer, &received, 5000), "cms_consumerReceiveWithTimeout");
+                cms_destroyMessage(received);
+            }
+        }
+
+        virtual void tearDown(Fixture& fixture AMQC_UNUSED) {
+            cms_destroyMessage(message);
+            cms_destroyConsumer(consumer);
+            cms_destroyProducer(producer);
+            cms_destroyDestination(destination);
+        }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    struct Result {
+
+        std::string name;
+        long long iterations;
+        double nanosPerOp;
+        double allocationsPerOp;
+
+        Result() : name(), iterations(0), nanosPerOp(0), allocationsPerOp(0) {}
+    };
+
+    /**
+     * Runs the benchmark once and returns the time and allocations of the timed calls.
+     */
+    Result measure(Benchmark& benchmark, Fixture& fixture, long long iterations) {
+
+        long long elapsed = 0;
+        long long allocated = 0;
+        long long batchSize = benchmark.getBatchSize() > 0 ? benchmark.getBatchSize() : iterations;
+
+        benchmark.setUp(fixture);
+
+        for (long long done = 0; done < iterations; ) {
+
+            long long count = std::min(batchSize, iterations - done);
+
+            benchmark.prepare(fixture, count);
+
+            long long startAllocations = getAllocations();
+            long long start = decaf::lang::System::nanoTime();
+
+            benchmark.run(fixture, count);
+
+            elapsed += decaf::lang::System::nanoTime() - start;
+            allocated += getAllocations() - startAllocations;
+            done += count;
+        }
+
+        benchmark.tearDown(fixture);
+
+        Result result;
+        result.name = benchmark.getName();
+        result.iterations = iterations;
+        result.nanosPerOp = (double) elapsed / (double) iterations;
+        result.allocationsPerOp = (double) allocated / (double) iterations;
+
+        return result;
+    }
+
+    std::string escape(const std::string& value) {
+
+        std::string escaped;
+
+        for (std::string::const_iterator iter = value.begin(); iter != value.end(); ++iter) {
+            if (*iter == '"' || *iter == '\\') {
+                escaped += '\\';
+            }
+            escaped += *iter;
+        }
+
+        return escaped;
+    }
+
+    void writeResults(std::ostream& out, const std::string& brokerUri, int repeat, const std::vector<Result>& results) {
+
+        out << "{\n";
+        out << "  \"suite\": \"wrapper\",\n";
+        out << "  \"broker\": \"" << escape(brokerUri) << "\",\n";
+        out << "  \"repeat\": " << repeat << ",\n";
+        out << "  \"results\": [\n";
+
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            out << "    {\"name\": \"" << escape(results[i].name) << "\", "
+                << "\"iterations\": " << results[i].iterations << ", "
+                << std::fixed << std::setprecision(2)
+                << "\"ns_per_op\": " << results[i].nanosPerOp << ", "
+                << "\"allocs_per_op\": " << results[i].allocationsPerOp << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+
+        out << "  ]\n";
+        out << "}\n";
+    }
+
+    void usage() {
+        std::cout << "usage: wrapper-benchmark [-broker <uri>] [-iterations <n>] [-repeat <n>]"
+                  << " [-filter <text>] [-output <file>]" << std::endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int main(int argc, char** argv) {
+
+    std::string brokerUri = DEFAULT_BROKER_URI;
+    std::string output = DEFAULT_OUTPUT;
+    std::string filter;
+    long long iterations = 200000;
+    int repeat = 5;
+
+    for (int i = 1; i < argc; ++i) {
+
+        const std::string arg(argv[i]);
+
+        if (i + 1 >= argc) {
+            usage();
+            return -1;
+        }
+
+        if (arg == "-broker") {
+            brokerUri = argv[++i];
+        } else if (arg == "-iterations") {
+            iterations = ::atol(argv[++i]);
+        } else if (arg == "-repeat") {
+            repeat = ::atoi(argv[++i]);
+        } else if (arg == "-filter") {
+            filter = argv[++i];
+        } else if (arg == "-output") {
+            output = argv[++i];
+        } else {
+            usage();
+            return -1;
+        }
+    }
+
+    if (iterations <= 0 || repeat <= 0) {
+        usage();
+        return -1;
+    }
+
+    cms_initialize();
+
+    CreateTextMessageBenchmark createTextMessage;
+    SetIntPropertyBenchmark setIntProperty;
+    GetMessageTextBenchmark getMessageText;
+    BytesReadBenchmark<IntReader> readInt;
+    BytesReadBenchmark<LongReader> readLong;
+    BytesReadBenchmark<DoubleReader> readDouble;
+    BytesReadBenchmark<BytesReader> readBytes;
+    BytesReadBenchmark<UTFReader> readUTF;
+    ProducerSendBenchmark producerSend;
+    ConsumerReceiveBenchmark consumerReceive;
+
+    Benchmark* benchmarks[] = {
+        &createTextMessage, &setIntProperty, &getMessageText,
+        &readInt, &readLong, &readDouble, &readBytes, &readUTF,
+        &producerSend, &consumerReceive
+    };
+
+    std::vector<Result> results;
+    Fixture fixture;
+    int exitCode = 0;
+
+    try {
+
+        check(cms_createConnectionFactory(&fixture.factory, brokerUri.c_str(), NULL, NULL), "cms_createConnectionFactory");
+        check(cms_createDefaultConnection(fixture.factory, &fixture.connection), "cms_createDefaultConnection");
+        check(cms_createDefaultSession(fixture.connection, &fixture.session), "cms_createDefaultSession");
+        check(cms_startConnection(fixture.connection), "cms_startConnection");
+
+        std::cout << std::left << std::setw(52) << "benchmark"
+                  << std::right << std::setw(12) << "ns/op" << std::setw(12) << "allocs/op" << std::endl;
+
+        for (std::size_t i = 0; i < sizeof(benchmarks) / sizeof(Benchmark*); ++i) {
+
+            Benchmark& benchmark = *benchmarks[i];
+
+            if (!filter.empty() && std::string(benchmark.getName()).find(filter) == std::string::npos) {
+                continue;
+            }
+
+            // A short warm up run, then the fastest of the measured runs is reported.
+            measure(benchmark, fixture, std::max(1LL, iterations / 10));
+
+            Result best = measure(benchmark, fixture, iterations);
+            for (int run = 1; run < repeat; ++run) {
+                Result next = measure(benchmark, fixture, iterations);
+                if (next.nanosPerOp < best.nanosPerOp) {
+                    best = next;
+                }
+            }
+
+            std::cout << std::left << std::setw(52) << best.name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(12) << best.nanosPerOp << std::setw(12) << best.allocationsPerOp << std::endl;
+
+            results.push_back(best);
+        }
+
+        std::ofstream file(output.c_str());
+        writeResults(file, brokerUri, repeat, results);
+
+        std::cout << "Results written to " << output << std::endl;
+
+    } catch (std::exception& ex) {
+        std::cout << "Benchmark failed: " << ex.what() << std::endl;
+        exitCode = 1;
+    }
+
+    cms_destroySession(fixture.session);
+    cms_destroyConnection(fixture.connection);
+    cms_destroyConnectionFactory(fixture.factory);
+
+    cms_terminate();
+
+    return exitCode;
+}
@@ -21,6 +21,8 @@
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Compression.h>
+#include <private/CMS_SharedBody.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
@@ -34,6 +36,22 @@
 
 #include <memory>
 
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    /**
+     * Gets the BytesMessage whose body is about to be accessed, first giving the Message a
+     * body of its own if it shares one and decompressing that body if needed.
+     */
+    cms::BytesMessage* accessBody(CMS_Message* message) {
+
+        cms_unshareMessageBody(message);
+        cms_decompressMessageBody(message);
+
+        return dynamic_cast<cms::BytesMessage*>( message->message );
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_getBytesMessageBodyLength(CMS_Message* message, int* length) {
 
@@ -45,9 +63,8 @@ cms_status cms_getBytesMessageBodyLength(CMS_Message* message, int* length) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try {
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *length = bytesMessage->getBodyLength();
             result = CMS_SUCCESS;
         }
@@ -68,9 +85,8 @@ cms_status cms_resetBytesMessage(CMS_Message* message) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->reset();
             result = CMS_SUCCESS;
         }
@@ -91,9 +107,8 @@ cms_status cms_readBooleanFromBytesMessage(CMS_Message* message, int* value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readBoolean();
             result = CMS_SUCCESS;
         }
@@ -114,9 +129,8 @@ cms_status cms_writeBooleanToBytesMessage(CMS_Message* message, int value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeBoolean((bool)value);
             result = CMS_SUCCESS;
         }
@@ -137,9 +151,8 @@ cms_status cms_readByteFromBytesMessage(CMS_Message* message, unsigned char* val
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readByte();
             result = CMS_SUCCESS;
         }
@@ -160,9 +173,8 @@ cms_status cms_writeByteToBytesMessage(CMS_Message* message, unsigned char value
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeByte(value);
             result = CMS_SUCCESS;
         }
@@ -183,9 +195,8 @@ cms_status cms_readCharFromBytesMessage(CMS_Message* message, char* value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readChar();
             result = CMS_SUCCESS;
         }
@@ -206,9 +217,8 @@ cms_status cms_writeCharToBytesMessage(CMS_Message* message, char value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeChar(value);
             result = CMS_SUCCESS;
         }
@@ -229,9 +239,8 @@ cms_status cms_readFloatFromBytesMessage(CMS_Message* message, float* value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readFloat();
             result = CMS_SUCCESS;
         }
@@ -252,9 +261,8 @@ cms_status cms_writeFloatToBytesMessage(CMS_Message* message, float value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeFloat(value);
             result = CMS_SUCCESS;
         }
@@ -275,9 +283,8 @@ cms_status cms_readDoubleFromBytesMessage(CMS_Message* message, double* value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readDouble();
             result = CMS_SUCCESS;
         }
@@ -298,9 +305,8 @@ cms_status cms_writeDoubleToBytesMessage(CMS_Message* message, double value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeDouble(value);
             result = CMS_SUCCESS;
         }
@@ -321,9 +327,8 @@ cms_status cms_readShortFromBytesMessage(CMS_Message* message, short* value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readShort();
             result = CMS_SUCCESS;
         }
@@ -344,9 +349,8 @@ cms_status cms_writeShortToBytesMessage(CMS_Message* message, short value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeShort(value);
             result = CMS_SUCCESS;
         }
@@ -367,9 +371,8 @@ cms_status cms_readIntFromBytesMessage(CMS_Message* message, int* value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readInt();
             result = CMS_SUCCESS;
         }
@@ -390,9 +393,8 @@ cms_status cms_writeIntToBytesMessage(CMS_Message* message, int value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeInt(value);
             result = CMS_SUCCESS;
         }
@@ -413,9 +415,8 @@ cms_status cms_readLongFromBytesMessage(CMS_Message* message, long long* value)
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             *value = bytesMessage->readLong();
             result = CMS_SUCCESS;
         }
@@ -436,9 +437,8 @@ cms_status cms_writeLongToBytesMessage(CMS_Message* message, long long value) {
             return CMS_INVALID_MESSAGE_TYPE;
         }
 
-        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
-
         try{
+            cms::BytesMessage* bytesMessage = accessBody(message);
             bytesMessage->writeLong(value);
             result = CMS_SUCCESS;
         }
@@ -456,12 +456,11 @@ cms_status cms_readBytesFromBytesMessage(CMS_Message* message, unsigned char* va
     if(message != NULL && message->message != NULL && value != NULL) {
 
         try{
-
             if( message->type != CMS_BYTES_MESSAGE ) {
                 return CMS_INVALID_MESSAGE_TYPE;
             }
 
-            cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+            cms::BytesMessage* bytesMessage = accessBody(message);
 
             int readCount = bytesMessage->readBytes(value, size);
 
@@ -491,7 +490,7 @@ cms_status cms_writeBytesToBytesMessage(CMS_Message* message, const unsigned cha
                 return CMS_INVALID_MESSAGE_TYPE;
             }
 
-            cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+            cms::BytesMessage* bytesMessage = accessBody(message);
 
             bytesMessage->writeBytes(value, offset, length);
             result = CMS_SUCCESS;
@@ -511,7 +510,6 @@ cms_status cms_readStringFromBytesMessage(CMS_Message* message, char* value, int
     if(message != NULL && message->message != NULL && value != NULL) {
 
         try{
-
             if( message->type != CMS_BYTES_MESSAGE ) {
                 return CMS_INVALID_MESSAGE_TYPE;
             }
@@ -520,7 +518,7 @@ cms_status cms_readStringFromBytesMessage(CMS_Message* message, char* value, int
                 return CMS_ERROR;
             }
 
-            cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+            cms::BytesMessage* bytesMessage = accessBody(message);
 
             std::string str = bytesMessage->readString();
 
@@ -558,7 +556,7 @@ cms_status cms_writeStringToBytesMessage(CMS_Message* message, const char* value
                 return CMS_INVALID_MESSAGE_TYPE;
             }
 
-            cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+            cms::BytesMessage* bytesMessage = accessBody(message);
 
             if(strlen(value) > 0) {
                 bytesMessage->writeString(value);
@@ -581,7 +579,6 @@ cms_status cms_readUTFFromBytesMessage(CMS_Message* message, char* value, int si
     if(message != NULL && message->message != NULL && value != NULL) {
 
         try{
-
             if( message->type != CMS_BYTES_MESSAGE ) {
                 return CMS_INVALID_MESSAGE_TYPE;
             }
@@ -590,7 +587,7 @@ cms_status cms_readUTFFromBytesMessage(CMS_Message* message, char* value, int si
                 return CMS_ERROR;
             }
 
-            cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+            cms::BytesMessage* bytesMessage = accessBody(message);
 
             std::string str = bytesMessage->readUTF();
 
@@ -628,7 +625,7 @@ cms_status cms_writeUTFToBytesMessage(CMS_Message* message, const char* value) {
                 return CMS_INVALID_MESSAGE_TYPE;
             }
 
-            cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+            cms::BytesMessage* bytesMessage = accessBody(message);
 
             if(strlen(value) > 0) {
                 bytesMessage->writeUTF(value);
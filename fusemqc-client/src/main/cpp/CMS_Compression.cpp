@@ -0,0 +1,278 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CMS_Compression.h>
+
+#include <Config.h>
+#include <private/CMS_Types.h>
+#include <private/CMS_Utils.h>
+#include <private/CMS_Compression.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    // The window of a zlib stream, content of a dictionary beyond it is never referenced.
+    const int MAX_DICTIONARY_SIZE = 32 * 1024;
+
+    // The length of the substrings whose recurrence across the sample is counted.
+    const std::size_t GRAM_LENGTH = 8;
+
+    typedef std::pair<long long, std::string> Segment;
+
+    bool higherScore(const Segment& left, const Segment& right) {
+        if (left.first != right.first) {
+            return left.first > right.first;
+        }
+
+        return left.second.size() > right.second.size();
+    }
+
+    /**
+     * Counts every substring of GRAM_LENGTH bytes by the number of bodies containing it.
+     */
+    void countGrams(const std::vector<std::string>& bodies, std::map<std::string, int>& counts) {
+
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+
+            const std::string& body = bodies[i];
+            std::set<std::string> grams;
+
+            for (std::size_t offset = 0; offset + GRAM_LENGTH <= body.size(); ++offset) {
+                grams.insert(body.substr(offset, GRAM_LENGTH));
+            }
+
+            for (std::set<std::string>::const_iterator gram = grams.begin(); gram != grams.end(); ++gram) {
+                ++counts[*gram];
+            }
+        }
+    }
+
+    /**
+     * Cuts every body into the runs of bytes covered by substrings that recur in at least
+     * minimum bodies, each run scored by how often its substrings recur.  Identical runs
+     * of different bodies add up their scores.
+     */
+    void findSegments(const std::vector<std::string>& bodies, const std::map<std::string, int>& counts,
+                      int minimum, std::vector<Segment>& segments) {
+
+        std::map<std::string, long long> scores;
+
+        for (std::size_t i = 0; i < bodies.size(); ++i) {
+
+            const std::string& body = bodies[i];
+            std::size_t start = 0;
+            std::size_t end = 0;
+            long long score = 0;
+
+            for (std::size_t offset = 0; offset + GRAM_LENGTH <= body.size(); ++offset) {
+
+                int count = counts.find(body.substr(offset, GRAM_LENGTH))->second;
+
+                if (count < minimum) {
+                    continue;
+                }
+
+                if (offset > end || score == 0) {
+
+                    if (score > 0) {
+                        scores[body.substr(start, end - start)] += score;
+                    }
+
+                    start = offset;
+                    score = 0;
+                }
+
+                end = offset + GRAM_LENGTH;
+                score += count;
+            }
+
+            if (score > 0) {
+                scores[body.substr(start, end - start)] += score;
+            }
+        }
+
+        for (std::map<std::string, long long>::const_iterator iter = scores.begin(); iter != scores.end(); ++iter) {
+            segments.push_back(Segment(iter->second, iter->first));
+        }
+
+        std::sort(segments.begin(), segments.end(), higherScore);
+    }
+
+    /**
+     * Fills the dictionary with the best scoring segments that fit, the best last as zlib
+     * encodes references to the end of the dictionary in the fewest bits.
+     */
+    std::string selectSegments(const std::vector<Segment>& segments, std::size_t size) {
+
+        std::vector<const std::string*> selected;
+        std::string content;
+
+        for (std::size_t i = 0; i < segments.size() && content.size() < size; ++i) {
+
+            const std::string& segment = segments[i].second;
+
+            if (content.size() + segment.size() > size || content.find(segment) != std::string::npos) {
+                continue;
+            }
+
+            selected.push_back(&segment);
+            content.append(segment);
+        }
+
+        std::string dictionary;
+        dictionary.reserve(content.size());
+
+        for (std::vector<const std::string*>::reverse_iterator iter = selected.rbegin(); iter != selected.rend(); ++iter) {
+            dictionary.append(**iter);
+        }
+
+        return dictionary;
+    }
+
+    CMS_CompressionDictionary* createDictionary(const unsigned char* data, std::size_t length) {
+
+        if (length > (std::size_t) MAX_DICTIONARY_SIZE) {
+            data += length - MAX_DICTIONARY_SIZE;
+            length = MAX_DICTIONARY_SIZE;
+        }
+
+        std::auto_ptr<CMS_CompressionDictionary> dictionary( new CMS_CompressionDictionary );
+
+        dictionary->data.assign(data, data + length);
+        dictionary->id = cms_compressionDictionaryId(data, length);
+        dictionary->references.set(1);
+
+        return dictionary.release();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_createCompressionDictionary(const unsigned char* data, int length,
+                                           CMS_CompressionDictionary** dictionary) {
+
+    cms_status result = CMS_SUCCESS;
+
+    if (data == NULL || length <= 0 || dictionary == NULL) {
+        return CMS_ERROR;
+    }
+
+    try{
+        *dictionary = createDictionary(data, (std::size_t) length);
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_trainCompressionDictionary(CMS_Message** samples, int count, int size,
+                                          CMS_CompressionDictionary** dictionary) {
+
+    cms_status result = CMS_SUCCESS;
+
+    if (samples == NULL || count <= 0 || size <= 0 || dictionary == NULL) {
+        return CMS_ERROR;
+    }
+
+    try{
+
+        std::vector<std::string> bodies;
+        std::string body;
+
+        for (int i = 0; i < count; ++i) {
+
+            if (samples[i] == NULL || samples[i]->message == NULL ||
+                (samples[i]->type != CMS_TEXT_MESSAGE && samples[i]->type != CMS_BYTES_MESSAGE)) {
+
+                continue;
+            }
+
+            cms_readMessageBody(samples[i], body);
+
+            if (!body.empty()) {
+                bodies.push_back(body);
+            }
+        }
+
+        if (bodies.empty()) {
+            return CMS_ERROR;
+        }
+
+        std::map<std::string, int> counts;
+        std::vector<Segment> segments;
+
+        countGrams(bodies, counts);
+        findSegments(bodies, counts, bodies.size() > 1 ? 2 : 1, segments);
+
+        std::string content = selectSegments(segments, (std::size_t) std::min(size, MAX_DICTIONARY_SIZE));
+
+        // Bodies with nothing in common, or shorter than a gram, are best served by the
+        // most recent of them as it is.
+        if (content.empty()) {
+            content = bodies.back().substr(0, (std::size_t) std::min(size, MAX_DICTIONARY_SIZE));
+        }
+
+        *dictionary = createDictionary((const unsigned char*) content.data(), content.size());
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getCompressionDictionaryId(CMS_CompressionDictionary* dictionary, long long* id) {
+
+    cms_status result = CMS_ERROR;
+
+    if (dictionary != NULL && id != NULL) {
+        *id = (long long) dictionary->id;
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getCompressionDictionaryData(CMS_CompressionDictionary* dictionary,
+                                            const unsigned char** data, int* length) {
+
+    cms_status result = CMS_ERROR;
+
+    if (dictionary != NULL && data != NULL && length != NULL) {
+        *data = dictionary->data.empty() ? NULL : &dictionary->data[0];
+        *length = (int) dictionary->data.size();
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_destroyCompressionDictionary(CMS_CompressionDictionary* dictionary) {
+
+    cms_releaseCompressionDictionary(dictionary);
+
+    return CMS_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cms.h>
+
+#ifndef _CMS_COMPRESSION_WRAPPER_H_
+#define _CMS_COMPRESSION_WRAPPER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A compression dictionary holds content that is typical of a stream of Messages, the
+ * shared structure of their bodies, so that small bodies compress well without each
+ * having to carry that structure itself.  The Producer that compresses against a
+ * dictionary marks each body with the dictionary's identifier and every Consumer of those
+ * Messages must be given the same dictionary with cms_addConsumerCompressionDictionary.
+ *
+ * Dictionaries are reference counted, a Producer, Consumer or received Message that uses
+ * one keeps it alive so the caller can destroy its own reference at any time.
+ */
+
+/**
+ * Creates a dictionary from content that was trained or distributed beforehand, the
+ * content is copied.  At most the last 32 KB of the content are used.
+ *
+ * @param data
+ *      The content of the dictionary.
+ * @param length
+ *      The length of the content in bytes.
+ * @param dictionary
+ *      The address of the memory to store the dictionary at once created.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_createCompressionDictionary(const unsigned char* data, int length,
+                                           CMS_CompressionDictionary** dictionary);
+
+/**
+ * Trains a dictionary from a sample of the Messages that are to be compressed with it,
+ * the bodies of the TextMessages and BytesMessages in the sample are searched for the
+ * content they have in common.  The more representative the sample the better, a few
+ * hundred recent Messages is usually enough.  Other types of Message are skipped, the
+ * BytesMessages of the sample are reset so they read from the start of their body.
+ *
+ * @param samples
+ *      The sample Messages.
+ * @param count
+ *      The number of Messages in the sample.
+ * @param size
+ *      The largest size of the dictionary in bytes, at most 32 KB.
+ * @param dictionary
+ *      The address of the memory to store the dictionary at once created.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_trainCompressionDictionary(CMS_Message** samples, int count, int size,
+                                          CMS_CompressionDictionary** dictionary);
+
+/**
+ * Gets the identifier of a dictionary, a checksum of its content that compressed Messages
+ * carry in their CMS_COMPRESSION_DICTIONARY_PROPERTY.
+ *
+ * @param dictionary
+ *      The dictionary to use for this operation.
+ * @param id
+ *      The address where the identifier is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getCompressionDictionaryId(CMS_CompressionDictionary* dictionary, long long* id);
+
+/**
+ * Gets the content of a dictionary so it can be distributed to the Consumers that need it.
+ *
+ * @param dictionary
+ *      The dictionary to use for this operation.
+ * @param data
+ *      The address where a pointer to the content is written, it is valid for as long as
+ *      the caller holds its reference to the dictionary.
+ * @param length
+ *      The address where the length of the content in bytes is written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getCompressionDictionaryData(CMS_CompressionDictionary* dictionary,
+                                            const unsigned char** data, int* length);
+
+/**
+ * Releases the caller's reference to a dictionary, it is destroyed once no Producer,
+ * Consumer or Message is using it either.
+ *
+ * @param dictionary
+ *      The dictionary to release.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_destroyCompressionDictionary(CMS_CompressionDictionary* dictionary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CMS_COMPRESSION_WRAPPER_H_ */
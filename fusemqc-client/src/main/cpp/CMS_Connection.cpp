@@ -20,12 +20,16 @@
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Readiness.h>
+#include <private/CMS_Statistics.h>
 
 #include <activemq/core/ActiveMQConnection.h>
 
 #include <cms/IllegalStateException.h>
 #include <cms/InvalidClientIdException.h>
 
+#include <decaf/util/concurrent/Lock.h>
+
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
@@ -54,6 +58,9 @@ namespace {
             }
 
             this->parent->lastException = new CMSException(ex);
+
+            decaf::util::concurrent::Lock lock(&this->parent->exceptionFdLock);
+            cms_raiseReadyFd(this->parent->exceptionFd);
         }
 
     };
@@ -70,6 +77,8 @@ cms_status cms_createDefaultConnection(CMS_ConnectionFactory* factory, CMS_Conne
         if (factory != NULL && connection != NULL) {
             wrapper->connection = factory->factory->createConnection();
             wrapper->lastException = NULL;
+            wrapper->exceptionFd = -1;
+            wrapper->statistics = cms_createConnectionStatistics();
             wrapper->asyncExListener = new CMSExceptionListener(wrapper.get());
             wrapper->connection->setExceptionListener(wrapper->asyncExListener);
             *connection = wrapper.release();
@@ -101,6 +110,8 @@ cms_status cms_createConnection(CMS_ConnectionFactory* factory,
 
             wrapper->connection = factory->factory->createConnection(user, pass, id);
             wrapper->lastException = NULL;
+            wrapper->exceptionFd = -1;
+            wrapper->statistics = cms_createConnectionStatistics();
             wrapper->asyncExListener = new CMSExceptionListener(wrapper.get());
             wrapper->connection->setExceptionListener(wrapper->asyncExListener);
             *connection = wrapper.release();
@@ -125,6 +136,8 @@ cms_status cms_destroyConnection(CMS_Connection* connection) {
             delete connection->connection;
             delete connection->asyncExListener;
             delete connection->lastException;
+            cms_closeReadyFd(connection->exceptionFd);
+            cms_destroyConnectionStatistics(connection->statistics);
             delete connection;
             result = CMS_SUCCESS;
         }
@@ -188,6 +201,46 @@ cms_status cms_closeConnection(CMS_Connection* connection) {
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getConnectionExceptionFd(CMS_Connection* connection, int* fd) {
+
+    cms_status result = CMS_ERROR;
+
+    if (connection != NULL && connection->connection != NULL && fd != NULL) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+        decaf::util::concurrent::Lock lock(&connection->exceptionFdLock);
+
+        if (connection->exceptionFd == -1) {
+            connection->exceptionFd = cms_createReadyFd();
+        }
+
+        if (connection->exceptionFd != -1) {
+            *fd = connection->exceptionFd;
+            result = CMS_SUCCESS;
+        }
+#else
+        result = CMS_UNSUPPORTEDOP;
+#endif
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_clearConnectionExceptionFd(CMS_Connection* connection) {
+
+    cms_status result = CMS_ERROR;
+
+    if (connection != NULL) {
+        decaf::util::concurrent::Lock lock(&connection->exceptionFdLock);
+        cms_clearReadyFd(connection->exceptionFd);
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_setConnectionClientId(CMS_Connection* connection, const char* clientId) {
 
@@ -232,6 +285,32 @@ cms_status cms_getConnectionClientId(CMS_Connection* connection, char* clientId,
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getConnectionStatistics(CMS_Connection* connection, CMS_ConnectionStats* stats) {
+
+    cms_status result = CMS_ERROR;
+
+    if (connection != NULL && connection->statistics != NULL && stats != NULL) {
+        cms_statisticsSnapshot(connection->statistics, stats);
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_resetConnectionStatistics(CMS_Connection* connection) {
+
+    cms_status result = CMS_ERROR;
+
+    if (connection != NULL && connection->statistics != NULL) {
+        cms_statisticsReset(connection->statistics);
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 char* cms_getErrorString(CMS_Connection* connection, char* buffer, int length) {
 
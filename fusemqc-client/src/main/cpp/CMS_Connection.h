@@ -24,6 +24,50 @@
 extern "C" {
 #endif
 
+/**
+ * A snapshot of the runtime statistics of a Connection, totalled over every Session,
+ * Producer and Consumer created from it.  Latencies are measured in nanoseconds.
+ */
+typedef struct {
+
+    /** Messages sent successfully, asynchronous sends are counted once the broker acknowledges them. */
+    long long messagesSent;
+
+    /** The total encoded size of the Messages that were sent. */
+    long long bytesSent;
+
+    /** Sends that failed, timed out or were cancelled. */
+    long long sendErrors;
+
+    /** Messages returned from the receive calls of the Connection's Consumers. */
+    long long messagesReceived;
+
+    /** The total encoded size of the Messages that were received. */
+    long long bytesReceived;
+
+    /** Calls to cms_consumerReceiveWithTimeout that returned without a Message. */
+    long long receiveTimeouts;
+
+    /**
+     * Received Messages that have been acknowledged, automatically on delivery, by
+     * cms_acknowledgeMessage or by the commit of their Session's transaction.
+     */
+    long long acknowledgements;
+
+    /** Successful commits of the Connection's transacted Sessions. */
+    long long commits;
+
+    /** Successful rollbacks of the Connection's transacted Sessions. */
+    long long rollbacks;
+
+    /** The time taken by each successful send call, or to completion for asynchronous sends. */
+    CMS_LatencyHistogram sendLatency;
+
+    /** The time each receive call that returned a Message spent waiting for it. */
+    CMS_LatencyHistogram receiveWait;
+
+} CMS_ConnectionStats;
+
 /**
  * Creates a new Connection from the given ConnectionFactory instance using the defaults
  * that are configured in the given Connection Factory.
@@ -106,6 +150,36 @@ cms_status cms_stopConnection(CMS_Connection* connection);
  */
 cms_status cms_closeConnection(CMS_Connection* connection);
 
+/**
+ * Gets an event descriptor that becomes readable when the Connection reports an
+ * asynchronous exception such as the loss of its transport, allowing an application's
+ * event loop to notice the failure without a thread blocked on the Connection.  The
+ * error can then be retrieved with cms_getErrorString.  The descriptor should be requested
+ * before the Connection is started, it is closed when the Connection is destroyed and the
+ * application must not close it.
+ *
+ * This method returns CMS_UNSUPPORTEDOP on platforms without event descriptors.
+ *
+ * @param connection
+ *      The Connection whose descriptor is requested.
+ * @param fd
+ *      The address where the descriptor is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getConnectionExceptionFd(CMS_Connection* connection, int* fd);
+
+/**
+ * Resets the Connection's exception descriptor once the application has handled the
+ * exception so that it is no longer readable.
+ *
+ * @param connection
+ *      The Connection whose exception descriptor is to be reset.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_clearConnectionExceptionFd(CMS_Connection* connection);
+
 /**
  * Sets the Client Id for the given Connection instance.  The client Id must be
  * set before a call to start the Connection or creation of any Sessions by the
@@ -136,6 +210,31 @@ cms_status cms_setConnectionClientId(CMS_Connection* connection, const char* cli
  */
 cms_status cms_getConnectionClientId(CMS_Connection* connection, char* clientId, int size);
 
+/**
+ * Takes a snapshot of the runtime statistics of the given Connection.  The statistics are
+ * gathered with atomic counters that the sending and receiving threads update without
+ * locking, so the snapshot may not include operations that complete while it is taken.
+ *
+ * @param connection
+ *      The Connection whose statistics are requested.
+ * @param stats
+ *      The address of the structure that the statistics are written to.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getConnectionStatistics(CMS_Connection* connection, CMS_ConnectionStats* stats);
+
+/**
+ * Sets every statistic of the given Connection back to zero, operations that complete while
+ * the reset is in progress may or may not be counted afterwards.
+ *
+ * @param connection
+ *      The Connection whose statistics are to be reset.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_resetConnectionStatistics(CMS_Connection* connection);
+
 /**
  * Returns a human readable error message that describes the last error that was encounted.
  * The caller provides a buffer for the error string and the client will fill the buffer up
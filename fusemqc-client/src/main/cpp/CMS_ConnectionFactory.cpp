@@ -22,6 +22,7 @@
 #include <private/CMS_Utils.h>
 
 #include <activemq/core/ActiveMQConnectionFactory.h>
+#include <loopback/LoopbackConnectionFactory.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
@@ -57,6 +58,8 @@ cms_status cms_createConnectionFactory(CMS_ConnectionFactory** factory,
 
         if (brokerUri == NULL) {
             wrapper->factory = new activemq::core::ActiveMQConnectionFactory();
+        } else if (loopback::LoopbackConnectionFactory::isLoopbackURI(brokerUri)) {
+            wrapper->factory = new loopback::LoopbackConnectionFactory( brokerUri );
         } else {
 
             std::string user = username == NULL ? "" : std::string(username);
@@ -23,11 +23,64 @@
 
 #include <activemq/core/ActiveMQConnection.h>
 
+#include <decaf/util/concurrent/Lock.h>
+
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
 
+#include <map>
 #include <memory>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const std::string QUEUE_PREFIX = "queue://";
+    const std::string TOPIC_PREFIX = "topic://";
+
+    /**
+     * Finds the cached Destination with the given qualified name, creating it on the first
+     * lookup.  The Session's lock is held only around the cache itself, the Destination is
+     * created outside of it and a thread that loses the race to cache it discards its own.
+     */
+    CMS_Destination* findDestination(CMS_Session* session, const std::string& qualifiedName) {
+
+        {
+            decaf::util::concurrent::Lock lock(&session->destinationsLock);
+
+            std::map<std::string, CMS_Destination*>::const_iterator iter = session->destinations.find(qualifiedName);
+            if (iter != session->destinations.end()) {
+                return iter->second;
+            }
+        }
+
+        std::auto_ptr<CMS_Destination> wrapper( new CMS_Destination );
+
+        if (qualifiedName.compare(0, TOPIC_PREFIX.size(), TOPIC_PREFIX) == 0) {
+            wrapper->destination = session->session->createTopic(qualifiedName.substr(TOPIC_PREFIX.size()));
+            wrapper->type = CMS_TOPIC;
+        } else {
+            wrapper->destination = session->session->createQueue(qualifiedName.substr(QUEUE_PREFIX.size()));
+            wrapper->type = CMS_QUEUE;
+        }
+
+        wrapper->borrowed = true;
+
+        decaf::util::concurrent::Lock lock(&session->destinationsLock);
+
+        CMS_Destination*& entry = session->destinations[qualifiedName];
+
+        if (entry != NULL) {
+            delete wrapper->destination;
+            return entry;
+        }
+
+        entry = wrapper.release();
+
+        return entry;
+    }
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_createDestination(CMS_Session* session, CMS_DESTINATION_TYPE type,
@@ -83,12 +136,59 @@ cms_status cms_createTemporaryDestination(CMS_Session* session, CMS_DESTINATION_
     return cms_createDestination(session, type, NULL, destination);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getCachedDestination(CMS_Session* session, CMS_DESTINATION_TYPE type,
+                                    const char* name, CMS_Destination** destination) {
+
+    if (session == NULL || name == NULL || destination == NULL ||
+        (type != CMS_QUEUE && type != CMS_TOPIC)) {
+
+        return CMS_ERROR;
+    }
+
+    cms_status result = CMS_SUCCESS;
+
+    try{
+        *destination = findDestination(session, (type == CMS_TOPIC ? TOPIC_PREFIX : QUEUE_PREFIX) + name);
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getDestinationByName(CMS_Session* session, const char* name, CMS_Destination** destination) {
+
+    if (session == NULL || name == NULL || destination == NULL) {
+        return CMS_ERROR;
+    }
+
+    cms_status result = CMS_SUCCESS;
+
+    try{
+
+        std::string qualifiedName(name);
+
+        if (qualifiedName.compare(0, QUEUE_PREFIX.size(), QUEUE_PREFIX) != 0 &&
+            qualifiedName.compare(0, TOPIC_PREFIX.size(), TOPIC_PREFIX) != 0) {
+
+            qualifiedName.insert(0, QUEUE_PREFIX);
+        }
+
+        *destination = findDestination(session, qualifiedName);
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_destroyDestination(CMS_Destination* destination) {
 
     cms_status result = CMS_SUCCESS;
 
-    if(destination != NULL) {
+    // Borrowed handles are destroyed by the Session or Message that owns them.
+    if(destination != NULL && !destination->borrowed) {
 
         try{
             delete destination->destination;
@@ -62,7 +62,48 @@ cms_status cms_createDestination(CMS_Session* session, CMS_DESTINATION_TYPE type
 cms_status cms_createTemporaryDestination(CMS_Session* session, CMS_DESTINATION_TYPE type, CMS_Destination** destination);
 
 /**
- * Destroy the given Destination instance.
+ * Gets the Destination of the given type and name from the Session's cache of Destinations,
+ * creating it the first time it is asked for.  The handle is owned by the Session and stays
+ * valid until the Session is destroyed, every lookup of the same Destination returns the
+ * same handle so code that picks a Destination per Message neither leaks handles nor
+ * creates them over and over.  The cache can be used from any thread.  Nothing is evicted
+ * from the cache, it grows by one entry for every distinct Destination looked up until the
+ * Session is destroyed, so names that are generated without bound, such as one per request,
+ * are better created with cms_createDestination and destroyed after use.
+ *
+ * @param session
+ *      The Session whose cache is used.
+ * @param type
+ *      The Type of Destination, either CMS_QUEUE or CMS_TOPIC.
+ * @param name
+ *      The name of the Destination.
+ * @param destination
+ *      The address of the location to store the cached Destination handle.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getCachedDestination(CMS_Session* session, CMS_DESTINATION_TYPE type,
+                                    const char* name, CMS_Destination** destination);
+
+/**
+ * Gets a Destination from the Session's cache by a name that carries its type, such as
+ * "queue://orders.eu" or "topic://prices", a name without either prefix names a Queue.
+ * The handle is owned by the Session and is never evicted, as with cms_getCachedDestination.
+ *
+ * @param session
+ *      The Session whose cache is used.
+ * @param name
+ *      The name of the Destination with its queue:// or topic:// prefix.
+ * @param destination
+ *      The address of the location to store the cached Destination handle.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getDestinationByName(CMS_Session* session, const char* name, CMS_Destination** destination);
+
+/**
+ * Destroy the given Destination instance, handles that are owned by a Session's cache of
+ * Destinations or lent out by a Message are left alone.
  *
  * @param destination
  *      The Destination to destroy.
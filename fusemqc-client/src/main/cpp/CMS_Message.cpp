@@ -20,6 +20,14 @@
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Statistics.h>
+#include <private/CMS_Trace.h>
+#include <private/CMS_Compression.h>
+#include <private/CMS_SharedBody.h>
+
+#include <cms/TextMessage.h>
+
+#include <decaf/util/concurrent/Lock.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
@@ -33,6 +41,67 @@
 
 #include <memory>
 
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    CMS_DESTINATION_TYPE destinationType(const cms::Destination* destination) {
+
+        switch(destination->getDestinationType()) {
+            case cms::Destination::TOPIC:
+                return CMS_TOPIC;
+            case cms::Destination::TEMPORARY_QUEUE:
+                return CMS_TEMPORARY_QUEUE;
+            case cms::Destination::TEMPORARY_TOPIC:
+                return CMS_TEMPORARY_TOPIC;
+            default:
+                return CMS_QUEUE;
+        }
+    }
+
+    /**
+     * Points a handle of the Message at the Destination now held by one of its headers,
+     * returns NULL when the header holds none.
+     */
+    CMS_Destination* lendDestination(CMS_Destination* handle, const cms::Destination* destination) {
+
+        handle->destination = const_cast<cms::Destination*>(destination);
+
+        if (destination == NULL) {
+            return NULL;
+        }
+
+        handle->type = destinationType(destination);
+
+        return handle;
+    }
+
+    /**
+     * Removes a received Message from its Consumer's list of the Messages still alive.
+     */
+    void forgetReceived(CMS_Message* message) {
+
+        CMS_MessageConsumer* consumer = message->consumer;
+
+        if (consumer == NULL) {
+            return;
+        }
+
+        decaf::util::concurrent::Lock lock(&consumer->receivedLock);
+
+        if (message->previousReceived != NULL) {
+            message->previousReceived->nextReceived = message->nextReceived;
+        } else {
+            consumer->received = message->nextReceived;
+        }
+
+        if (message->nextReceived != NULL) {
+            message->nextReceived->previousReceived = message->previousReceived;
+        }
+
+        message->consumer = NULL;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_createMessage(CMS_Session* session, CMS_Message** message) {
 
@@ -162,10 +231,14 @@ cms_status cms_destroyMessage(CMS_Message* message) {
 
     cms_status result = CMS_SUCCESS;
 
-    if(message != NULL) {
+    if(message != NULL && message->references.decrementAndGet() == 0) {
 
         try{
+            forgetReceived(message);
+            cms_releaseCompressionDictionary(message->dictionary);
+
             delete message->message;
+            cms_releaseSharedBody(message->sharedBody);
             delete message;
         }
         CMS_CATCH_EXCEPTION( result )
@@ -174,6 +247,38 @@ cms_status cms_destroyMessage(CMS_Message* message) {
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_retainMessage(CMS_Message* message) {
+
+    cms_status result = CMS_ERROR;
+
+    if(message != NULL && message->message != NULL) {
+
+        try{
+
+            // Lazily decoded state is settled now, while the caller still has the Message
+            // to itself, so that the readers it is shared with never modify it.
+            cms_decompressMessageBody(message);
+
+            cms::TextMessage* textMessage = dynamic_cast<cms::TextMessage*>(message->message);
+            if (textMessage != NULL) {
+                textMessage->getText();
+            }
+
+            message->references.incrementAndGet();
+            result = CMS_SUCCESS;
+        }
+        CMS_CATCH_EXCEPTION( result )
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_releaseMessage(CMS_Message* message) {
+    return cms_destroyMessage(message);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_cloneMessage(CMS_Message* original, CMS_Message** clone) {
 
@@ -184,8 +289,15 @@ cms_status cms_cloneMessage(CMS_Message* original, CMS_Message** clone) {
         std::auto_ptr<CMS_Message> wrapper( new CMS_Message );
 
         try{
-            wrapper->message = original->message->clone();
+            if (cms_isSharingBody(original)) {
+                wrapper->message = cms_createFullCopy(original);
+            } else {
+                wrapper->message = original->message->clone();
+            }
+
             wrapper->type = original->type;
+            wrapper->compression = original->compression;
+            wrapper->dictionary = cms_retainCompressionDictionary(original->dictionary);
             *clone = wrapper.release();
         }
         CMS_CATCH_EXCEPTION( result )
@@ -194,6 +306,33 @@ cms_status cms_cloneMessage(CMS_Message* original, CMS_Message** clone) {
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_cloneMessageShallow(CMS_Message* original, CMS_Message** clone) {
+
+    if(original == NULL || original->message == NULL || clone == NULL) {
+        return CMS_ERROR;
+    }
+
+    // Only plain Text and Bytes bodies are shared, anything else is copied outright.
+    if((original->type != CMS_TEXT_MESSAGE && original->type != CMS_BYTES_MESSAGE) ||
+       original->compression != CMS_BODY_PLAIN) {
+
+        return cms_cloneMessage(original, clone);
+    }
+
+    cms_status result = CMS_SUCCESS;
+
+    std::auto_ptr<CMS_Message> wrapper( new CMS_Message );
+
+    try{
+        cms_shareMessageBody(original, wrapper.get());
+        *clone = wrapper.release();
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_getMessageType(CMS_Message* message, int* type) {
 
@@ -215,15 +354,35 @@ cms_status cms_getMessageType(CMS_Message* message, int* type) {
 cms_status cms_acknowledgeMessage(CMS_Message* message) {
 
     cms_status result = CMS_SUCCESS;
+    long long start = cms_traceAcknowledgeStart(message);
 
     if(message != NULL && message->message != NULL) {
 
         try{
             message->message->acknowledge();
+
+            // Messages of the other modes were counted as acknowledged when received or
+            // are counted when their transaction commits.  Nothing is counted once the
+            // Consumer or its Session is destroyed, their statistics went with them.
+            CMS_MessageConsumer* consumer = message->consumer;
+
+            if (consumer != NULL && consumer->session != NULL) {
+
+                CMS_Session* session = consumer->session;
+                cms::Session::AcknowledgeMode mode = session->session->getAcknowledgeMode();
+
+                if (mode == cms::Session::INDIVIDUAL_ACKNOWLEDGE) {
+                    cms_statisticsAcknowledged(session, consumer);
+                } else if (mode == cms::Session::CLIENT_ACKNOWLEDGE) {
+                    cms_statisticsAcknowledged(session, NULL);
+                }
+            }
         }
         CMS_CATCH_EXCEPTION( result )
     }
 
+    cms_traceAcknowledgeDone(message, result, start);
+
     return result;
 }
 
@@ -235,7 +394,14 @@ cms_status cms_clearMessageBody(CMS_Message* message) {
     if(message != NULL && message->message != NULL) {
 
         try{
+            cms_discardSharedBody(message);
             message->message->clearBody();
+
+            // The compression properties no longer describe the body.
+            if (message->compression == CMS_BODY_COMPRESSED) {
+                message->compression = CMS_BODY_DECOMPRESSED;
+            }
+
             result = CMS_SUCCESS;
         }
         CMS_CATCH_EXCEPTION( result )
@@ -252,6 +418,8 @@ cms_status cms_clearMessageProperties(CMS_Message* message) {
     if(message != NULL && message->message != NULL) {
 
         try{
+            // The body can't be decompressed once the properties describing it are gone.
+            cms_decompressMessageBody(message);
             message->message->clearProperties();
             result = CMS_SUCCESS;
         }
@@ -802,6 +970,7 @@ cms_status cms_getCMSMessageDestination(CMS_Message* message, CMS_Destination**
 
             if (dest != NULL) {
                 wrapper->destination = dest->clone();
+                wrapper->type = destinationType(dest);
                 *destination = wrapper.release();
             } else {
                 *destination = NULL;
@@ -816,6 +985,23 @@ cms_status cms_getCMSMessageDestination(CMS_Message* message, CMS_Destination**
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_borrowCMSMessageDestination(CMS_Message* message, CMS_Destination** destination) {
+
+    cms_status result = CMS_ERROR;
+
+    if(message != NULL && message->message != NULL && destination != NULL) {
+
+        try{
+            *destination = lendDestination(&message->destinationHandle, message->message->getCMSDestination());
+            result = CMS_SUCCESS;
+        }
+        CMS_CATCH_EXCEPTION( result )
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_setCMSMessageDestination(CMS_Message* message, CMS_Destination* destination) {
 
@@ -831,6 +1017,11 @@ cms_status cms_setCMSMessageDestination(CMS_Message* message, CMS_Destination* d
                 message->message->setCMSDestination(NULL);
             }
 
+            // A handle that was lent out follows the header rather than dangle.
+            if (message->destinationHandle.destination != NULL) {
+                lendDestination(&message->destinationHandle, message->message->getCMSDestination());
+            }
+
             result = CMS_SUCCESS;
 
         }
@@ -1010,6 +1201,7 @@ cms_status cms_getCMSMessageReplyTo(CMS_Message* message, CMS_Destination** dest
 
             if (dest != NULL) {
                 wrapper->destination = dest->clone();
+                wrapper->type = destinationType(dest);
                 *destination = wrapper.release();
             } else {
                 *destination = NULL;
@@ -1024,6 +1216,23 @@ cms_status cms_getCMSMessageReplyTo(CMS_Message* message, CMS_Destination** dest
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_borrowCMSMessageReplyTo(CMS_Message* message, CMS_Destination** destination) {
+
+    cms_status result = CMS_ERROR;
+
+    if(message != NULL && message->message != NULL && destination != NULL) {
+
+        try{
+            *destination = lendDestination(&message->replyToHandle, message->message->getCMSReplyTo());
+            result = CMS_SUCCESS;
+        }
+        CMS_CATCH_EXCEPTION( result )
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_setCMSMessageReplyTo(CMS_Message* message, CMS_Destination* destination) {
 
@@ -1039,6 +1248,11 @@ cms_status cms_setCMSMessageReplyTo(CMS_Message* message, CMS_Destination* desti
                 message->message->setCMSReplyTo(NULL);
             }
 
+            // A handle that was lent out follows the header rather than dangle.
+            if (message->replyToHandle.destination != NULL) {
+                lendDestination(&message->replyToHandle, message->message->getCMSReplyTo());
+            }
+
             result = CMS_SUCCESS;
 
         }
@@ -97,7 +97,9 @@ cms_status cms_createMapMessage(CMS_Session* session, CMS_Message** message);
 cms_status cms_createStreamMessage(CMS_Session* session, CMS_Message** message);
 
 /**
- * Destroy the given Message instance.
+ * Destroy the given Message instance.  When the Message was shared with cms_retainMessage
+ * this only releases the caller's reference, the Message is destroyed once the last
+ * reference to it is released.
  *
  * @param message
  *      The Message to destroy.
@@ -106,6 +108,35 @@ cms_status cms_createStreamMessage(CMS_Session* session, CMS_Message** message);
  */
 cms_status cms_destroyMessage(CMS_Message* message);
 
+/**
+ * Takes another reference to the given Message so that it can be shared, with other
+ * threads for instance, without being copied.  Each reference is dropped with
+ * cms_releaseMessage, or cms_destroyMessage, and the Message is destroyed when the last
+ * one is.  Any compressed body is decompressed here.
+ *
+ * The holders of a shared Message may read its headers, properties and text from any
+ * thread at once as long as none of them modifies it.  The body of a BytesMessage, Map or
+ * StreamMessage is read through a position that is part of the Message and so must only be
+ * read by one thread at a time, and acknowledging the Message acknowledges it for everyone.
+ *
+ * @param message
+ *      The Message to retain.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_retainMessage(CMS_Message* message);
+
+/**
+ * Releases a reference to the given Message taken by cms_retainMessage, or the creator's
+ * own reference, destroying the Message when it was the last one.
+ *
+ * @param message
+ *      The Message to release.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_releaseMessage(CMS_Message* message);
+
 /**
  * Creates a Copy of the given Message instance.
  *
@@ -118,6 +149,27 @@ cms_status cms_destroyMessage(CMS_Message* message);
  */
 cms_status cms_cloneMessage(CMS_Message* original, CMS_Message** clone);
 
+/**
+ * Creates a shallow Copy of the given Message instance, the copy has its own headers and
+ * properties but shares the body of the original until either of them modifies it, or
+ * reads a BytesMessage body, at which point that one is given a copy of the body of its
+ * own.  Fanning a large Message out with different headers or properties to many
+ * destinations so never copies its body, the Messages that share a body are sent from it
+ * one at a time.
+ *
+ * Only TextMessages and BytesMessages whose body is not compressed are shared, any other
+ * Message is copied as cms_cloneMessage does.  A copy is never acknowledged along with
+ * the original, and like the original it may only be used by one thread at a time.
+ *
+ * @param original
+ *      The Message to clone.
+ * @param clone
+ *      The address of the location to store the new Message instance.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_cloneMessageShallow(CMS_Message* original, CMS_Message** clone);
+
 /**
  * Gets the Message Type of the Wrapped CMS Message object.  If the CMS_Message
  * is not initialized then this method returns CMS_ERROR.
@@ -501,6 +553,24 @@ cms_status cms_setCMSMessageDeliveryMode(CMS_Message* message, int mode);
  */
 cms_status cms_getCMSMessageDestination(CMS_Message* message, CMS_Destination** destination);
 
+/**
+ * Gets the Destination that is assigned to this Message as a handle that is owned by the
+ * Message, no Destination is created or copied.  The handle can be used wherever a
+ * Destination is accepted, for instance to send to, and is valid until the Message is
+ * destroyed.  Calling cms_destroyDestination on it does nothing.  Setting the Destination
+ * with cms_setCMSMessageDestination updates the handle, sending the Message assigns its
+ * Destination anew so the handle must be borrowed again after the Message is sent.
+ *
+ * @param message
+ *      The message to retrieve the Destination from.
+ * @param destination
+ *      The address where the handle is to be written, NULL is written when the Message
+ *      has no Destination.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_borrowCMSMessageDestination(CMS_Message* message, CMS_Destination** destination);
+
 /**
  * Sets the Destination that is assigned to this Message.
  *
@@ -624,6 +694,24 @@ cms_status cms_setCMSMessageRedelivered(CMS_Message* message, int redelivered);
  */
 cms_status cms_getCMSMessageReplyTo(CMS_Message* message, CMS_Destination** destination);
 
+/**
+ * Gets the Reply To Destination that is assigned to this Message as a handle that is owned
+ * by the Message, no Destination is created or copied, which suits a server that replies
+ * to every request it receives.  The handle can be passed to the Producer sending the reply
+ * and is valid until the Message is destroyed, calling cms_destroyDestination on it does
+ * nothing.  Setting the Reply To Destination with cms_setCMSMessageReplyTo updates the
+ * handle.
+ *
+ * @param message
+ *      The message to retrieve the Reply To Destination from.
+ * @param destination
+ *      The address where the handle is to be written, NULL is written when the Message
+ *      has no Reply To Destination.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_borrowCMSMessageReplyTo(CMS_Message* message, CMS_Destination** destination);
+
 /**
  * Sets the Reply To Destination that is assigned to this Message.
  *
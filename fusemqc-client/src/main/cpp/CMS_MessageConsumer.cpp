@@ -16,22 +16,383 @@
  */
 
 #include <CMS_MessageConsumer.h>
+#include <CMS_Message.h>
+#include <CMS_BytesMessage.h>
 
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Readiness.h>
+#include <private/CMS_Statistics.h>
+#include <private/CMS_Trace.h>
+#include <private/CMS_Compression.h>
 
 #include <cms/Message.h>
 #include <cms/TextMessage.h>
 #include <cms/BytesMessage.h>
 #include <cms/StreamMessage.h>
 #include <cms/MapMessage.h>
+#include <cms/MessageAvailableListener.h>
+
+#include <activemq/core/ActiveMQConsumer.h>
+
+#include <loopback/LoopbackConsumer.h>
+
+#include <decaf/lang/System.h>
+#include <decaf/util/concurrent/Lock.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
 
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    class CMSMessageAvailableListener : public cms::MessageAvailableListener {
+    private:
+
+        CMS_MessageConsumer* parent;
+
+    public:
+
+        CMSMessageAvailableListener(CMS_MessageConsumer* parent) : cms::MessageAvailableListener(), parent(parent) {}
+        virtual ~CMSMessageAvailableListener() {}
+
+        virtual void onMessageAvailable(cms::MessageConsumer* consumer AMQC_UNUSED) {
+            cms_signalConsumerAvailable(this->parent);
+        }
+
+    };
+
+    /**
+     * Gets the number of Messages in the prefetch buffer of the CMS Consumer, -1 when the
+     * Consumer can't tell.
+     */
+    int prefetchedCount(const cms::MessageConsumer* consumer) {
+
+        const activemq::core::ActiveMQConsumer* amqConsumer =
+            dynamic_cast<const activemq::core::ActiveMQConsumer*>(consumer);
+
+        if (amqConsumer != NULL) {
+            return amqConsumer->getMessageAvailableCount();
+        }
+
+        const loopback::LoopbackConsumer* loopConsumer = dynamic_cast<const loopback::LoopbackConsumer*>(consumer);
+
+        if (loopConsumer != NULL) {
+            return loopConsumer->getMessageAvailableCount();
+        }
+
+        return -1;
+    }
+
+    /**
+     * Links a newly created Consumer wrapper to its Session and starts tracking the
+     * Messages that are dispatched into its prefetch buffer.
+     */
+    void attachConsumer(CMS_Session* session, CMS_MessageConsumer* wrapper) {
+
+        wrapper->session = session;
+        wrapper->readyFd = -1;
+        cms_clearEndpointStatistics(&wrapper->statistics);
+        wrapper->connectionStatistics = session->connection->statistics;
+        wrapper->measureLatency = false;
+        wrapper->received = NULL;
+        wrapper->availableListener = new CMSMessageAvailableListener(wrapper);
+        wrapper->consumer->setMessageAvailableListener(wrapper->availableListener);
+
+        // Messages dispatched before the listener was set were never signalled, the count
+        // is seeded from the buffer.  A dispatch between reading the count and storing it
+        // fails the exchange so the buffer is counted again.
+        int observed = 0;
+        int prefetched = 0;
+
+        do {
+            observed = wrapper->available.get();
+            prefetched = prefetchedCount(wrapper->consumer);
+        } while (prefetched > observed && !wrapper->available.compareAndSet(observed, prefetched));
+
+        Lock lock(&session->consumersLock);
+        session->consumers.push_back(wrapper);
+    }
+
+    /**
+     * Accounts for a Message taken out of the prefetch buffer, the hint never drops below
+     * zero since Messages returned by a rollback may be received without being counted.
+     */
+    void consumeAvailable(CMS_MessageConsumer* consumer) {
+
+        int current = consumer->available.get();
+        while (current > 0 && !consumer->available.compareAndSet(current, current - 1)) {
+            current = consumer->available.get();
+        }
+    }
+
+    /**
+     * Measures the time from the send of the Message to now, a Message whose send time
+     * can't be read is counted as unmeasured rather than failing its receive.
+     */
+    void recordLatency(CMS_MessageConsumer* consumer, const cms::Message* message) {
+
+        long long latency = 0;
+
+        try{
+
+            if (message->propertyExists(CMS_SEND_TIME_PROPERTY)) {
+                latency = cms_statisticsWallTime() - message->getLongProperty(CMS_SEND_TIME_PROPERTY);
+            } else if (message->getCMSTimestamp() != 0) {
+                latency = (System::currentTimeMillis() - message->getCMSTimestamp()) * 1000000LL;
+            } else {
+                cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_UNMEASURED, 1);
+                return;
+            }
+
+        } catch(cms::CMSException&) {
+            cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_UNMEASURED, 1);
+            return;
+        }
+
+        cms_endpointStatisticsSet(&consumer->statistics, CMS_STAT_LAST_LATENCY, latency);
+        cms_endpointStatisticsRecord(&consumer->statistics, CMS_STAT_END_TO_END_LATENCY, latency);
+    }
+
+    /**
+     * Counts a received Message in the statistics of the Consumer and its Connection, the
+     * Message keeps its Consumer so that its acknowledgement can be counted.
+     */
+    void recordReceive(CMS_MessageConsumer* consumer, CMS_Message* message, long long start) {
+
+        CMS_ConnectionStatistics* statistics = consumer->connectionStatistics;
+        long long wait = cms_statisticsTime() - start;
+
+        cms_inspectReceivedMessage(message, consumer);
+
+        cms_statisticsAdd(statistics, CMS_STAT_MESSAGES_RECEIVED, 1);
+        cms_statisticsAdd(statistics, CMS_STAT_BYTES_RECEIVED, cms_statisticsMessageSize(message->message));
+        cms_statisticsRecord(statistics, CMS_STAT_RECEIVE_WAIT, wait);
+
+        cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_MESSAGES_RECEIVED, 1);
+        cms_endpointStatisticsRecord(&consumer->statistics, CMS_STAT_RECEIVE_WAIT, wait);
+
+        if (message->message->getCMSRedelivered()) {
+            cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_REDELIVERED, 1);
+        }
+
+        if (consumer->measureLatency) {
+            recordLatency(consumer, message->message);
+        }
+
+        Lock lock(&consumer->receivedLock);
+
+        message->consumer = consumer;
+        message->previousReceived = NULL;
+        message->nextReceived = consumer->received;
+
+        if (consumer->received != NULL) {
+            consumer->received->previousReceived = message;
+        }
+
+        consumer->received = message;
+
+        // Without a transaction or client acknowledgement the Message was acknowledged
+        // as it was received.
+        cms::Session::AcknowledgeMode mode = consumer->session->session->getAcknowledgeMode();
+
+        if (mode == cms::Session::AUTO_ACKNOWLEDGE || mode == cms::Session::DUPS_OK_ACKNOWLEDGE) {
+            cms_statisticsAdd(statistics, CMS_STAT_ACKNOWLEDGEMENTS, 1);
+            cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_ACKNOWLEDGEMENTS, 1);
+        } else {
+            cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_UNACKNOWLEDGED, 1);
+        }
+    }
+
+    /**
+     * Called when a receive found the prefetch buffer empty.  Every Message that was
+     * counted before the receive started had already been enqueued, so unless more were
+     * dispatched since then the count is stale and is reset.
+     */
+    void resetAvailable(CMS_MessageConsumer* consumer, int observed) {
+
+        if (consumer->available.compareAndSet(observed, 0)) {
+
+            Lock lock(&consumer->pollersLock);
+
+            if (consumer->readyFd != -1) {
+                cms_clearReadyFd(consumer->readyFd);
+
+                // A dispatch that raced with the reset must leave the descriptor readable.
+                if (consumer->available.get() > 0) {
+                    cms_raiseReadyFd(consumer->readyFd);
+                }
+            }
+        }
+    }
+
+    /**
+     * Writes the chunks of one payload to a sink, checking that each chunk follows on from
+     * the one before it.
+     */
+    class ChunkAssembler {
+    private:
+
+        const CMS_ChunkSink* sink;
+        std::vector<unsigned char> buffer;
+
+    public:
+
+        std::string group;
+        long long written;
+        bool complete;
+
+    private:
+
+        ChunkAssembler(const ChunkAssembler&);
+        ChunkAssembler& operator=(const ChunkAssembler&);
+
+        cms_status write(CMS_Message* chunk, int length) {
+
+            cms_status result = CMS_SUCCESS;
+
+            if (this->sink->type == CMS_CHUNK_SINK_MEMORY) {
+
+                if (this->sink->buffer == NULL || length > this->sink->capacity - this->written) {
+                    return CMS_ERROR;
+                }
+
+                return length == 0 ? CMS_SUCCESS :
+                    cms_readBytesFromBytesMessage(chunk, this->sink->buffer + this->written, length);
+            }
+
+            this->buffer.resize(length);
+
+            if (length > 0) {
+                result = cms_readBytesFromBytesMessage(chunk, &this->buffer[0], length);
+            }
+
+            if (result != CMS_SUCCESS || length == 0) {
+                return result;
+            }
+
+            if (this->sink->type == CMS_CHUNK_SINK_CALLBACK) {
+
+                if (this->sink->write == NULL ||
+                    this->sink->write(&this->buffer[0], length, this->written, this->sink->userData) != 0) {
+
+                    result = CMS_ERROR;
+                }
+
+            } else if (this->sink->type == CMS_CHUNK_SINK_FD) {
+
+                int done = 0;
+                while (done < length && result == CMS_SUCCESS) {
+
+                    ssize_t count = ::write(this->sink->fd, &this->buffer[done], (std::size_t) (length - done));
+
+                    if (count > 0) {
+                        done += (int) count;
+                    } else if (count < 0 && errno != EINTR) {
+                        result = CMS_ERROR;
+                    }
+                }
+
+            } else {
+                result = CMS_ERROR;
+            }
+
+            return result;
+        }
+
+    public:
+
+        ChunkAssembler(const CMS_ChunkSink* sink) :
+            sink(sink), buffer(), group(), written(0), complete(false) {
+        }
+
+        /**
+         * Writes the body of the next chunk to the sink.
+         */
+        cms_status add(CMS_Message* chunk, int sequence) {
+
+            const cms::Message* message = chunk->message;
+
+            if (chunk->type != CMS_BYTES_MESSAGE ||
+                !message->propertyExists(CMS_GROUP_ID_PROPERTY) ||
+                !message->propertyExists(CMS_GROUP_SEQUENCE_PROPERTY) ||
+                !message->propertyExists(CMS_CHUNK_OFFSET_PROPERTY) ||
+                !message->propertyExists(CMS_CHUNK_TOTAL_PROPERTY) ||
+                !message->propertyExists(CMS_CHUNK_FINAL_PROPERTY)) {
+
+                return CMS_MESSAGE_FORMAT_ERROR;
+            }
+
+            std::string id = message->getStringProperty(CMS_GROUP_ID_PROPERTY);
+            long long total = message->getLongProperty(CMS_CHUNK_TOTAL_PROPERTY);
+
+            if (sequence == 1) {
+                this->group = id;
+            } else if (id != this->group) {
+                return CMS_MESSAGE_FORMAT_ERROR;
+            }
+
+            if (message->getIntProperty(CMS_GROUP_SEQUENCE_PROPERTY) != sequence ||
+                message->getLongProperty(CMS_CHUNK_OFFSET_PROPERTY) != this->written) {
+
+                return CMS_MESSAGE_FORMAT_ERROR;
+            }
+
+            int length = 0;
+            cms_status result = cms_getBytesMessageBodyLength(chunk, &length);
+
+            if (result == CMS_SUCCESS) {
+                result = write(chunk, length);
+            }
+
+            if (result == CMS_SUCCESS) {
+
+                this->written += length;
+                this->complete = message->getBooleanProperty(CMS_CHUNK_FINAL_PROPERTY);
+
+                if ((this->complete && this->written != total) || (!this->complete && this->written >= total)) {
+                    result = CMS_MESSAGE_FORMAT_ERROR;
+                }
+            }
+
+            return result;
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_signalConsumerAvailable(CMS_MessageConsumer* consumer) {
+
+    consumer->available.incrementAndGet();
+
+    Lock lock(&consumer->pollersLock);
+
+    cms_raiseReadyFd(consumer->readyFd);
+
+    std::vector<Mutex*>::const_iterator iter = consumer->pollers.begin();
+    for (; iter != consumer->pollers.end(); ++iter) {
+        Lock pollerLock(*iter);
+        (*iter)->notifyAll();
+    }
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_createDefaultConsumer(CMS_Session* session, CMS_Destination* destination,
@@ -46,6 +407,7 @@ cms_status cms_createDefaultConsumer(CMS_Session* session, CMS_Destination* dest
             result = CMS_ERROR;
         } else {
             wrapper->consumer = session->session->createConsumer(destination->destination);
+            attachConsumer(session, wrapper.get());
             *consumer = wrapper.release();
         }
 
@@ -72,6 +434,7 @@ cms_status cms_createConsumer(CMS_Session* session, CMS_Destination* destination
 
             wrapper->consumer = session->session->createConsumer(
                 destination->destination, sel, noLocal > 0 ? true : false);
+            attachConsumer(session, wrapper.get());
             *consumer = wrapper.release();
         }
 
@@ -109,6 +472,7 @@ cms_status cms_createDurableConsumer(CMS_Session* session,
 
                 wrapper->consumer = session->session->createDurableConsumer(
                     topic, name, sel, noLocal > 0 ? true : false);
+                attachConsumer(session, wrapper.get());
 
                 *consumer = wrapper.release();
             }
@@ -124,6 +488,7 @@ cms_status cms_createDurableConsumer(CMS_Session* session,
 cms_status cms_consumerReceive(CMS_MessageConsumer* consumer, CMS_Message** message) {
 
     cms_status result = CMS_ERROR;
+    long long start = cms_traceReceiveStart(consumer);
 
     if (consumer != NULL && consumer->consumer != NULL && message != NULL) {
 
@@ -134,6 +499,7 @@ cms_status cms_consumerReceive(CMS_MessageConsumer* consumer, CMS_Message** mess
             cms::Message* msg = consumer->consumer->receive();
 
             if(msg != NULL) {
+                consumeAvailable(consumer);
                 wrapper->message = msg;
 
                 if(dynamic_cast<cms::TextMessage*>(msg) != NULL) {
@@ -148,6 +514,7 @@ cms_status cms_consumerReceive(CMS_MessageConsumer* consumer, CMS_Message** mess
                     wrapper->type = CMS_MESSAGE;
                 }
 
+                recordReceive(consumer, wrapper.get(), start);
                 *message = wrapper.release();
 
                 result = CMS_SUCCESS;
@@ -160,6 +527,8 @@ cms_status cms_consumerReceive(CMS_MessageConsumer* consumer, CMS_Message** mess
         CMS_CATCH_EXCEPTION( result )
     }
 
+    cms_traceReceiveDone(consumer, result == CMS_SUCCESS ? *message : NULL, result, start);
+
     return result;
 }
 
@@ -167,6 +536,7 @@ cms_status cms_consumerReceive(CMS_MessageConsumer* consumer, CMS_Message** mess
 cms_status cms_consumerReceiveWithTimeout(CMS_MessageConsumer* consumer, CMS_Message** message, int timeout) {
 
     cms_status result = CMS_ERROR;
+    long long start = cms_traceReceiveStart(consumer);
 
     if (consumer != NULL && consumer->consumer != NULL && message != NULL) {
 
@@ -174,9 +544,11 @@ cms_status cms_consumerReceiveWithTimeout(CMS_MessageConsumer* consumer, CMS_Mes
 
             std::auto_ptr<CMS_Message> wrapper( new CMS_Message );
 
+            int observed = consumer->available.get();
             cms::Message* msg = consumer->consumer->receive(timeout);
 
             if (msg != NULL) {
+                consumeAvailable(consumer);
                 wrapper->message = msg;
 
                 if(dynamic_cast<cms::TextMessage*>(msg) != NULL) {
@@ -191,11 +563,14 @@ cms_status cms_consumerReceiveWithTimeout(CMS_MessageConsumer* consumer, CMS_Mes
                     wrapper->type = CMS_MESSAGE;
                 }
 
+                recordReceive(consumer, wrapper.get(), start);
                 *message = wrapper.release();
 
                 result = CMS_SUCCESS;
 
             } else {
+                resetAvailable(consumer, observed);
+                cms_statisticsAdd(consumer->connectionStatistics, CMS_STAT_RECEIVE_TIMEOUTS, 1);
                 *message = NULL;
                 result = CMS_RECEIVE_TIMEDOUT;
             }
@@ -204,6 +579,8 @@ cms_status cms_consumerReceiveWithTimeout(CMS_MessageConsumer* consumer, CMS_Mes
         CMS_CATCH_EXCEPTION( result )
     }
 
+    cms_traceReceiveDone(consumer, result == CMS_SUCCESS ? *message : NULL, result, start);
+
     return result;
 }
 
@@ -211,6 +588,7 @@ cms_status cms_consumerReceiveWithTimeout(CMS_MessageConsumer* consumer, CMS_Mes
 cms_status cms_consumerReceiveNoWait(CMS_MessageConsumer* consumer, CMS_Message** message) {
 
     cms_status result = CMS_ERROR;
+    long long start = cms_traceReceiveStart(consumer);
 
     if (consumer != NULL && consumer->consumer != NULL && message != NULL) {
 
@@ -218,9 +596,11 @@ cms_status cms_consumerReceiveNoWait(CMS_MessageConsumer* consumer, CMS_Message*
 
             std::auto_ptr<CMS_Message> wrapper( new CMS_Message );
 
-            cms::Message* msg = consumer->consumer->receive();
+            int observed = consumer->available.get();
+            cms::Message* msg = consumer->consumer->receiveNoWait();
 
             if (msg != NULL) {
+                consumeAvailable(consumer);
                 wrapper->message = msg;
 
                 if(dynamic_cast<cms::TextMessage*>(msg) != NULL) {
@@ -235,8 +615,10 @@ cms_status cms_consumerReceiveNoWait(CMS_MessageConsumer* consumer, CMS_Message*
                     wrapper->type = CMS_MESSAGE;
                 }
 
+                recordReceive(consumer, wrapper.get(), start);
                 *message = wrapper.release();
             } else {
+                resetAvailable(consumer, observed);
                 *message = NULL;
             }
 
@@ -246,6 +628,266 @@ cms_status cms_consumerReceiveNoWait(CMS_MessageConsumer* consumer, CMS_Message*
         CMS_CATCH_EXCEPTION( result )
     }
 
+    cms_traceReceiveDone(consumer, result == CMS_SUCCESS ? *message : NULL, result, start);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_consumerReceiveChunked(CMS_MessageConsumer* consumer, const CMS_ChunkSink* sink, int timeout,
+                                      char* groupId, int size, long long* length) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL && consumer->consumer != NULL && sink != NULL) {
+
+        ChunkAssembler assembler(sink);
+
+        try{
+
+            cms::Session::AcknowledgeMode mode = consumer->session->session->getAcknowledgeMode();
+            int sequence = 1;
+
+            do {
+
+                CMS_Message* chunk = NULL;
+
+                result = cms_consumerReceiveWithTimeout(consumer, &chunk, timeout);
+
+                if (result == CMS_SUCCESS) {
+
+                    result = assembler.add(chunk, sequence++);
+
+                    if (result == CMS_SUCCESS &&
+                        (mode == cms::Session::CLIENT_ACKNOWLEDGE || mode == cms::Session::INDIVIDUAL_ACKNOWLEDGE)) {
+
+                        result = cms_acknowledgeMessage(chunk);
+                    }
+
+                    cms_destroyMessage(chunk);
+                }
+
+            } while (result == CMS_SUCCESS && !assembler.complete);
+        }
+        CMS_CATCH_EXCEPTION( result )
+
+        if (groupId != NULL && size > 0) {
+
+            std::size_t pos = 0;
+            for(; pos < assembler.group.size() && pos < (std::size_t)size - 1; ++pos) {
+                groupId[pos] = assembler.group.at(pos);
+            }
+
+            groupId[pos] = '\0';
+        }
+
+        if (length != NULL) {
+            *length = assembler.written;
+        }
+
+        if (sink->complete != NULL) {
+            sink->complete(assembler.group.c_str(), assembler.written, result, sink->userData);
+        }
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_pollConsumers(CMS_MessageConsumer** consumers, int count, int timeout,
+                             int* readyIndices, int* readyCount) {
+
+    if (consumers == NULL || count <= 0 || readyIndices == NULL || readyCount == NULL) {
+        return CMS_ERROR;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (consumers[i] == NULL || consumers[i]->consumer == NULL) {
+            return CMS_ERROR;
+        }
+    }
+
+    cms_status result = CMS_SUCCESS;
+    Mutex monitor;
+
+    *readyCount = 0;
+
+    for (int i = 0; i < count; ++i) {
+        Lock lock(&consumers[i]->pollersLock);
+        consumers[i]->pollers.push_back(&monitor);
+    }
+
+    try{
+
+        long long deadline = System::currentTimeMillis() + timeout;
+
+        // The Consumers signal the monitor only while holding it, so a dispatch that
+        // lands between the scan and the wait can't be missed.
+        Lock lock(&monitor);
+
+        while (true) {
+
+            for (int i = 0; i < count; ++i) {
+                if (consumers[i]->available.get() > 0) {
+                    readyIndices[(*readyCount)++] = i;
+                }
+            }
+
+            if (*readyCount > 0 || timeout == 0) {
+                break;
+            }
+
+            if (timeout < 0) {
+                monitor.wait();
+            } else {
+
+                long long remaining = deadline - System::currentTimeMillis();
+                if (remaining <= 0) {
+                    break;
+                }
+
+                monitor.wait(remaining);
+            }
+        }
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    for (int i = 0; i < count; ++i) {
+        Lock lock(&consumers[i]->pollersLock);
+        std::vector<Mutex*>& pollers = consumers[i]->pollers;
+        std::vector<Mutex*>::iterator iter = std::find(pollers.begin(), pollers.end(), &monitor);
+        if (iter != pollers.end()) {
+            pollers.erase(iter);
+        }
+    }
+
+    if (result == CMS_SUCCESS && *readyCount == 0) {
+        result = CMS_RECEIVE_TIMEDOUT;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getConsumerReadyFd(CMS_MessageConsumer* consumer, int* fd) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL && consumer->consumer != NULL && fd != NULL) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+        try{
+
+            Lock lock(&consumer->pollersLock);
+
+            if (consumer->readyFd == -1) {
+
+                consumer->readyFd = cms_createReadyFd();
+
+                if (consumer->readyFd != -1 && consumer->available.get() > 0) {
+                    cms_raiseReadyFd(consumer->readyFd);
+                }
+            }
+
+            if (consumer->readyFd != -1) {
+                *fd = consumer->readyFd;
+                result = CMS_SUCCESS;
+            }
+        }
+        CMS_CATCH_EXCEPTION( result )
+#else
+        result = CMS_UNSUPPORTEDOP;
+#endif
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getConsumerPendingCount(CMS_MessageConsumer* consumer, int* count) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL && count != NULL) {
+
+        try{
+
+            // The hint stands in for a Consumer that can't count its buffer.
+            int prefetched = consumer->consumer != NULL ? prefetchedCount(consumer->consumer) : -1;
+
+            *count = prefetched >= 0 ? prefetched : consumer->available.get();
+            result = CMS_SUCCESS;
+        }
+        CMS_CATCH_EXCEPTION( result )
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getConsumerStatistics(CMS_MessageConsumer* consumer, CMS_ConsumerStats* stats) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL && stats != NULL) {
+
+        const CMS_EndpointStatistics* statistics = &consumer->statistics;
+
+        memset(stats, 0, sizeof(CMS_ConsumerStats));
+
+        stats->messagesDelivered = cms_endpointStatisticsGet(statistics, CMS_STAT_MESSAGES_RECEIVED);
+        stats->messagesAcknowledged = cms_endpointStatisticsGet(statistics, CMS_STAT_ACKNOWLEDGEMENTS);
+        stats->messagesUnacknowledged = cms_endpointStatisticsGet(statistics, CMS_STAT_UNACKNOWLEDGED);
+        stats->messagesRedelivered = cms_endpointStatisticsGet(statistics, CMS_STAT_REDELIVERED);
+        stats->prefetched = consumer->available.get();
+        cms_histogramAddTo(&statistics->histograms[CMS_STAT_RECEIVE_WAIT], &stats->deliveryWait);
+        stats->compression.messages = cms_endpointStatisticsGet(statistics, CMS_STAT_COMPRESSED_MESSAGES);
+        stats->compression.uncompressedBytes = cms_endpointStatisticsGet(statistics, CMS_STAT_UNCOMPRESSED_BYTES);
+        stats->compression.compressedBytes = cms_endpointStatisticsGet(statistics, CMS_STAT_COMPRESSED_BYTES);
+
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_setConsumerLatencyMeasurement(CMS_MessageConsumer* consumer, int enabled) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL) {
+        consumer->measureLatency = enabled != 0;
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getConsumerLatency(CMS_MessageConsumer* consumer, CMS_ConsumerLatency* latency, int reset) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL && latency != NULL) {
+
+        CMS_EndpointStatistics* statistics = &consumer->statistics;
+
+        memset(latency, 0, sizeof(CMS_ConsumerLatency));
+
+        cms_histogramAddTo(&statistics->histograms[CMS_STAT_END_TO_END_LATENCY], &latency->latency);
+        latency->lastLatency = cms_endpointStatisticsGet(statistics, CMS_STAT_LAST_LATENCY);
+
+        if (reset != 0) {
+            latency->unmeasured = cms_endpointStatisticsTake(statistics, CMS_STAT_UNMEASURED);
+            cms_histogramReset(&statistics->histograms[CMS_STAT_END_TO_END_LATENCY]);
+        } else {
+            latency->unmeasured = cms_endpointStatisticsGet(statistics, CMS_STAT_UNMEASURED);
+        }
+
+        result = CMS_SUCCESS;
+    }
+
     return result;
 }
 
@@ -298,6 +940,32 @@ cms_status cms_getConsumerMessageSelector(CMS_MessageConsumer* consumer, char* d
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_addConsumerCompressionDictionary(CMS_MessageConsumer* consumer, CMS_CompressionDictionary* dictionary) {
+
+    cms_status result = CMS_ERROR;
+
+    if (consumer != NULL && dictionary != NULL) {
+
+        try{
+
+            Lock lock(&consumer->dictionariesLock);
+
+            CMS_CompressionDictionary*& entry = consumer->dictionaries[dictionary->id];
+
+            if (entry != dictionary) {
+                cms_releaseCompressionDictionary(entry);
+                entry = cms_retainCompressionDictionary(dictionary);
+            }
+
+            result = CMS_SUCCESS;
+        }
+        CMS_CATCH_EXCEPTION( result )
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_destroyConsumer(CMS_MessageConsumer* consumer) {
 
@@ -306,7 +974,35 @@ cms_status cms_destroyConsumer(CMS_MessageConsumer* consumer) {
     if (consumer != NULL) {
 
         try{
+
+            if (consumer->session != NULL) {
+                Lock lock(&consumer->session->consumersLock);
+                std::vector<CMS_MessageConsumer*>& consumers = consumer->session->consumers;
+                consumers.erase(std::remove(consumers.begin(), consumers.end(), consumer), consumers.end());
+            }
+
+            if (consumer->consumer != NULL) {
+                consumer->consumer->setMessageAvailableListener(NULL);
+            }
+
+            // Received Messages may outlive the Consumer, they must not reach back into it.
+            {
+                Lock lock(&consumer->receivedLock);
+
+                for (CMS_Message* message = consumer->received; message != NULL; message = message->nextReceived) {
+                    message->consumer = NULL;
+                }
+            }
+
             delete consumer->consumer;
+            delete consumer->availableListener;
+            cms_closeReadyFd(consumer->readyFd);
+
+            std::map<unsigned int, CMS_CompressionDictionary*>::const_iterator iter = consumer->dictionaries.begin();
+            for (; iter != consumer->dictionaries.end(); ++iter) {
+                cms_releaseCompressionDictionary(iter->second);
+            }
+
             delete consumer;
         }
         CMS_CATCH_EXCEPTION( result )
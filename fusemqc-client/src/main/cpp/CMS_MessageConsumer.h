@@ -131,6 +131,250 @@ cms_status cms_consumerReceiveWithTimeout(CMS_MessageConsumer* consumer, CMS_Mes
  */
 cms_status cms_consumerReceiveNoWait(CMS_MessageConsumer* consumer, CMS_Message** message);
 
+/**
+ * Callback type used by a CMS_CHUNK_SINK_CALLBACK sink to take each chunk of a payload, in
+ * order, offset being the position of the chunk in the payload.  The data is only valid
+ * during the call.  A non-zero return abandons the payload.
+ */
+typedef int (*CMS_ChunkWriteCallback)(const unsigned char* data, int length, long long offset, void* userData);
+
+/**
+ * Callback type used to report the end of a payload reassembled by cms_consumerReceiveChunked,
+ * with the group identifier of its chunks, the number of bytes written to the sink and the
+ * status that the call returns.
+ */
+typedef void (*CMS_ChunkCompletionCallback)(const char* groupId, long long length, cms_status status, void* userData);
+
+/**
+ * Describes where cms_consumerReceiveChunked writes the payload it reassembles.
+ */
+typedef struct {
+
+    /** The CMS_CHUNK_SINK_TYPE, which of the fields below the payload is written to. */
+    int type;
+
+    /** The file descriptor that a CMS_CHUNK_SINK_FD sink writes to, at its current position. */
+    int fd;
+
+    /** The memory that a CMS_CHUNK_SINK_MEMORY sink writes to, a mapped file for instance. */
+    unsigned char* buffer;
+    long long capacity;
+
+    /** The callback that a CMS_CHUNK_SINK_CALLBACK sink hands each chunk to. */
+    CMS_ChunkWriteCallback write;
+
+    /** Called once the payload is complete or has failed, can be NULL. */
+    CMS_ChunkCompletionCallback complete;
+
+    /** Passed to the write and complete callbacks. */
+    void* userData;
+
+} CMS_ChunkSink;
+
+/**
+ * Receives the chunks of one payload sent by cms_producerSendFile and writes them to the
+ * sink as they arrive, so the payload is never held in memory as a whole.  The chunks must
+ * arrive in order starting with the first, a chunk that is out of order, belongs to another
+ * group or leaves a gap fails the call with CMS_MESSAGE_FORMAT_ERROR, and a chunk that
+ * doesn't arrive within the timeout fails it with CMS_RECEIVE_TIMEDOUT.  When several
+ * payloads can be in flight on the Destination at once each receiver should create its
+ * Consumer with a selector on the CMS_GROUP_ID_PROPERTY of the payload it wants.
+ *
+ * In a client or individually acknowledged Session each chunk is acknowledged once it has
+ * been written to the sink, so the chunks of a failed payload are not redelivered.  The
+ * chunks are destroyed once written.
+ *
+ * @param consumer
+ *      The MessageConsumer that will be used to receive the chunks.
+ * @param sink
+ *      Where the payload is written.
+ * @param timeout
+ *      The time in milliseconds to wait for each chunk to arrive.
+ * @param groupId
+ *      The address of a buffer where the group identifier of the chunks is written, can be NULL.
+ * @param size
+ *      The size of the groupId buffer.
+ * @param length
+ *      The address where the number of bytes written to the sink is stored, can be NULL.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_consumerReceiveChunked(CMS_MessageConsumer* consumer, const CMS_ChunkSink* sink, int timeout,
+                                      char* groupId, int size, long long* length);
+
+/**
+ * Waits until at least one of the given Consumers has a Message available in its prefetch
+ * buffer, allowing a single thread to service many Consumers without polling each of them
+ * in turn.  The indices of the ready Consumers within the given array are written to the
+ * readyIndices array which must be able to hold count entries.  Messages are not removed
+ * from the Consumers, the caller drains each ready Consumer with cms_consumerReceiveNoWait.
+ * A Consumer can occasionally be reported ready when its Messages have since expired, in
+ * that case the receive simply finds no Message.
+ *
+ * @param consumers
+ *      The array of MessageConsumers to wait on.
+ * @param count
+ *      The number of MessageConsumers in the given array.
+ * @param timeout
+ *      The time in milliseconds to wait for a Message, zero returns immediately and a
+ *      negative value waits indefinitely.
+ * @param readyIndices
+ *      The array where the indices of the Consumers that have Messages are stored.
+ * @param readyCount
+ *      The address where the number of ready Consumers is written.
+ *
+ * @return result code indicating the success or failure of the operation, if no Consumer
+ *         became ready before the timeout elapsed CMS_RECEIVE_TIMEDOUT is returned.
+ */
+cms_status cms_pollConsumers(CMS_MessageConsumer** consumers, int count, int timeout,
+                             int* readyIndices, int* readyCount);
+
+/**
+ * Gets an event descriptor that becomes readable when Messages are dispatched to the
+ * Consumer, which allows the Consumer to be serviced from an application's epoll or select
+ * based event loop alongside its other descriptors.  When the descriptor is readable the
+ * application drains the Consumer with cms_consumerReceiveNoWait, once a receive finds no
+ * Message the descriptor is reset until the next dispatch.  The application must not read
+ * from or close the descriptor, it is closed when the Consumer is destroyed.
+ *
+ * This method returns CMS_UNSUPPORTEDOP on platforms without event descriptors.
+ *
+ * @param consumer
+ *      The Consumer whose descriptor is requested.
+ * @param fd
+ *      The address where the descriptor is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getConsumerReadyFd(CMS_MessageConsumer* consumer, int* fd);
+
+/**
+ * Gets the number of Messages waiting in the Consumer's prefetch buffer, those that have
+ * been dispatched to the client but not yet received.  The count is read from the client's
+ * buffer so it doesn't involve the broker and it can be read from any thread.
+ *
+ * @param consumer
+ *      The Consumer whose pending Messages are to be counted.
+ * @param count
+ *      The address where the number of pending Messages is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getConsumerPendingCount(CMS_MessageConsumer* consumer, int* count);
+
+/**
+ * A snapshot of the runtime statistics of a single Consumer.  Latencies are measured
+ * in nanoseconds.
+ */
+typedef struct {
+
+    /** Messages returned from the receive calls of the Consumer. */
+    long long messagesDelivered;
+
+    /**
+     * Delivered Messages that have been acknowledged, automatically on delivery, by
+     * cms_acknowledgeMessage or by the commit of the Session's transaction.
+     */
+    long long messagesAcknowledged;
+
+    /** Delivered Messages whose acknowledgement or commit is still outstanding. */
+    long long messagesUnacknowledged;
+
+    /** Delivered Messages that the broker marked as redelivered. */
+    long long messagesRedelivered;
+
+    /** An estimate of the number of Messages waiting in the Consumer's prefetch buffer. */
+    long long prefetched;
+
+    /** The time each receive call that returned a Message spent waiting for it. */
+    CMS_LatencyHistogram deliveryWait;
+
+    /** Delivered Messages whose bodies arrived compressed. */
+    CMS_CompressionStats compression;
+
+} CMS_ConsumerStats;
+
+/**
+ * Takes a snapshot of the runtime statistics of the given Consumer.
+ *
+ * @param consumer
+ *      The Consumer whose statistics are requested.
+ * @param stats
+ *      The address of the structure that the statistics are written to.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getConsumerStatistics(CMS_MessageConsumer* consumer, CMS_ConsumerStats* stats);
+
+/**
+ * The end to end latency of the Messages delivered to a Consumer, the time from their send
+ * to their receipt in nanoseconds.
+ */
+typedef struct {
+
+    /** The latency of each Message measured, the max is the largest lag seen. */
+    CMS_LatencyHistogram latency;
+
+    /** The latency of the most recent Message measured, negative when the clocks disagree. */
+    long long lastLatency;
+
+    /** Messages delivered that carried neither a send time stamp nor a CMSTimestamp. */
+    long long unmeasured;
+
+} CMS_ConsumerLatency;
+
+/**
+ * Sets whether the Consumer measures the end to end latency of the Messages it delivers.
+ * The latency is taken from the nanosecond CMS_SEND_TIME_PROPERTY when the Producer set it
+ * and from the millisecond CMSTimestamp otherwise, against the local wall clock, so it is
+ * only as accurate as the synchronization of the two hosts' clocks.  A Consumer is bound to
+ * one Destination so its measurements are those of that Destination.  A value of zero
+ * disables the measurement, which is the default, otherwise its enabled.
+ *
+ * @param consumer
+ *      The Consumer to use for this operation.
+ * @param enabled
+ *      The new latency measurement setting for the given Consumer.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_setConsumerLatencyMeasurement(CMS_MessageConsumer* consumer, int enabled);
+
+/**
+ * Gets the end to end latency measured by the given Consumer, optionally starting a new
+ * measurement period so that the histogram's max gives the largest lag of each period.
+ *
+ * @param consumer
+ *      The Consumer whose measurements are requested.
+ * @param latency
+ *      The address of the structure that the measurements are written to.
+ * @param reset
+ *      Non-zero to clear the measurements once they have been read.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getConsumerLatency(CMS_MessageConsumer* consumer, CMS_ConsumerLatency* latency, int reset);
+
+/**
+ * Gives the Consumer a dictionary that the Messages it receives may have been compressed
+ * against, those Messages name the dictionary by its identifier and so a Consumer can hold
+ * the dictionaries of several Producers, or the old and new dictionary while Producers move
+ * to a new one.  A dictionary with the same identifier as one already held replaces it.
+ * The Consumer keeps its own reference to the dictionary.  The body of a Message that was
+ * compressed against a dictionary the Consumer doesn't hold fails to decompress with
+ * CMS_UNSUPPORTEDOP, as does that of such a Message when browsed.  A dictionary can be added
+ * while other threads receive from the Consumer, a Message received after this returns can
+ * be decompressed with it.
+ *
+ * @param consumer
+ *      The Consumer to use for this operation.
+ * @param dictionary
+ *      The dictionary to add.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_addConsumerCompressionDictionary(CMS_MessageConsumer* consumer, CMS_CompressionDictionary* dictionary);
+
 /**
  * Closes the MessageConsumer, interrupting any currently blocked receive calls.
  *
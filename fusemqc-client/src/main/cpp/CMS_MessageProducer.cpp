@@ -16,18 +16,828 @@
  */
 
 #include <CMS_MessageProducer.h>
+#include <CMS_Destination.h>
 
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Statistics.h>
+#include <private/CMS_Trace.h>
+#include <private/CMS_Compression.h>
+#include <private/CMS_SharedBody.h>
 
 #include <cms/Destination.h>
+#include <cms/Queue.h>
+#include <cms/Topic.h>
+#include <cms/TemporaryQueue.h>
+#include <cms/TemporaryTopic.h>
+#include <cms/AsyncCallback.h>
+#include <cms/DeliveryMode.h>
+
+#include <activemq/core/ActiveMQConnection.h>
+#include <activemq/core/ActiveMQProducer.h>
+
+#include <loopback/LoopbackConnection.h>
+#include <loopback/LoopbackProducer.h>
+
+#include <decaf/lang/System.h>
+#include <decaf/util/UUID.h>
+#include <decaf/util/concurrent/Lock.h>
+#include <decaf/util/concurrent/Mutex.h>
+#include <decaf/util/concurrent/atomic/AtomicInteger.h>
+#include <decaf/util/concurrent/atomic/AtomicBoolean.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
 
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <vector>
+
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+using namespace decaf::util::concurrent::atomic;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    /**
+     * Counts the outcome of a send in the statistics of the Producer and its Connection.
+     */
+    void recordSend(CMS_MessageProducer* producer, int size, cms_status status, long long start) {
+
+        CMS_ConnectionStatistics* statistics = producer->connectionStatistics;
+
+        if (status == CMS_SUCCESS) {
+
+            long long latency = cms_statisticsTime() - start;
+
+            cms_statisticsAdd(statistics, CMS_STAT_MESSAGES_SENT, 1);
+            cms_statisticsAdd(statistics, CMS_STAT_BYTES_SENT, size);
+            cms_statisticsRecord(statistics, CMS_STAT_SEND_LATENCY, latency);
+
+            cms_endpointStatisticsAdd(&producer->statistics, CMS_STAT_MESSAGES_SENT, 1);
+            cms_endpointStatisticsAdd(&producer->statistics, CMS_STAT_BYTES_SENT, size);
+            cms_endpointStatisticsRecord(&producer->statistics, CMS_STAT_SEND_LATENCY, latency);
+        } else {
+            cms_statisticsAdd(statistics, CMS_STAT_SEND_ERRORS, 1);
+            cms_endpointStatisticsAdd(&producer->statistics, CMS_STAT_SEND_ERRORS, 1);
+        }
+    }
+
+    /**
+     * Adapts the C completion callback to the CMS AsyncCallback interface.  The instance
+     * is shared by the sending thread and the transport thread that completes the send so
+     * it holds one reference for each and deletes itself once both have let go.  The user
+     * callback fires at most once, whichever side claims the completion first, and the
+     * Message is counted as in flight on the Producer until then, and is counted in the
+     * Connection's statistics once its outcome is known.  The in flight count is only
+     * given back once the user callback has returned, cms_destroyProducer waits for it so
+     * that no callback can still be using the Producer once it is deleted.
+     */
+    class SendCompletionCallback : public cms::AsyncCallback {
+    private:
+
+        CMS_MessageProducer* producer;
+        CMS_SendCompletionCallback callback;
+        void* userData;
+        int size;
+        long long start;
+
+        AtomicInteger references;
+        AtomicBoolean completed;
+
+    public:
+
+        SendCompletionCallback(CMS_MessageProducer* producer, CMS_SendCompletionCallback callback, void* userData,
+                               int size, long long start) :
+            cms::AsyncCallback(), producer(producer), callback(callback), userData(userData), size(size),
+            start(start), references(2), completed(false) {
+
+            this->producer->inFlightCount.incrementAndGet();
+            this->producer->inFlightBytes.addAndGet(size);
+        }
+
+        virtual ~SendCompletionCallback() {}
+
+        virtual void onSuccess() {
+            complete(CMS_SUCCESS);
+        }
+
+        virtual void onException(const cms::CMSException& ex) {
+            complete(cms_statusFromException(ex));
+        }
+
+        /**
+         * Called by the sending thread when the send threw, returns true if the user
+         * callback had not yet fired and now never will.
+         */
+        bool cancel() {
+
+            if (this->completed.compareAndSet(false, true)) {
+                settle(CMS_ERROR);
+                finish();
+                return true;
+            }
+
+            return false;
+        }
+
+        void release() {
+            if (this->references.decrementAndGet() == 0) {
+                delete this;
+            }
+        }
+
+    private:
+
+        void complete(cms_status status) {
+
+            if (this->completed.compareAndSet(false, true)) {
+
+                settle(status);
+
+                if (this->callback != NULL) {
+                    this->callback(this->producer, status, this->userData);
+                }
+
+                finish();
+            }
+
+            release();
+        }
+
+        /**
+         * Counts the outcome and gives the Message's bytes back to the window.
+         */
+        void settle(cms_status status) {
+
+            recordSend(this->producer, this->size, status, this->start);
+
+            Lock lock(&this->producer->windowLock);
+            this->producer->inFlightBytes.addAndGet(-this->size);
+            this->producer->windowLock.notifyAll();
+        }
+
+        /**
+         * The last use of the Producer, once the count drops it may be deleted.
+         */
+        void finish() {
+
+            Lock lock(&this->producer->windowLock);
+            this->producer->inFlightCount.decrementAndGet();
+            this->producer->windowLock.notifyAll();
+        }
+
+    };
+
+    /**
+     * Waits for the broker's receipt of a send that was handed to the transport with a
+     * callback.  As with SendCompletionCallback the sending thread and the transport each
+     * hold a reference, so the sender can stop waiting before the receipt arrives.
+     */
+    class SendReceipt : public cms::AsyncCallback {
+    private:
+
+        Mutex mutex;
+        bool done;
+        cms_status status;
+
+        AtomicInteger references;
+        AtomicBoolean completed;
+
+    public:
+
+        SendReceipt() : cms::AsyncCallback(), mutex(), done(false), status(CMS_ERROR), references(2), completed(false) {
+        }
+
+        virtual ~SendReceipt() {}
+
+        virtual void onSuccess() {
+            complete(CMS_SUCCESS);
+        }
+
+        virtual void onException(const cms::CMSException& ex) {
+            complete(cms_statusFromException(ex));
+        }
+
+        /**
+         * Called by the sending thread when the send threw, returns true if the receipt
+         * had not yet arrived and now never will.
+         */
+        bool cancel() {
+            return this->completed.compareAndSet(false, true);
+        }
+
+        /**
+         * Waits for the receipt, a timeout of zero or less waits for as long as it takes.
+         * Returns false if the time out elapsed first.
+         */
+        bool await(long long timeout) {
+
+            Lock lock(&this->mutex);
+
+            long long deadline = System::nanoTime() + timeout * 1000000;
+
+            while (!this->done) {
+
+                if (timeout <= 0) {
+                    this->mutex.wait();
+                    continue;
+                }
+
+                long long remaining = deadline - System::nanoTime();
+                if (remaining <= 0) {
+                    return false;
+                }
+
+                this->mutex.wait((remaining + 999999) / 1000000);
+            }
+
+            return true;
+        }
+
+        cms_status getStatus() {
+            Lock lock(&this->mutex);
+            return this->status;
+        }
+
+        void release() {
+            if (this->references.decrementAndGet() == 0) {
+                delete this;
+            }
+        }
+
+    private:
+
+        void complete(cms_status status) {
+
+            if (this->completed.compareAndSet(false, true)) {
+                Lock lock(&this->mutex);
+                this->status = status;
+                this->done = true;
+                this->mutex.notifyAll();
+            }
+
+            release();
+        }
+    };
+
+    /**
+     * Gets the send timeout of the CMS Producer, -1 when the Producer has none.
+     */
+    long long getSendTimeout(cms::MessageProducer* producer) {
+
+        activemq::core::ActiveMQProducer* amqProducer = dynamic_cast<activemq::core::ActiveMQProducer*>(producer);
+
+        if (amqProducer != NULL) {
+            return amqProducer->getSendTimeout();
+        }
+
+        loopback::LoopbackProducer* loopProducer = dynamic_cast<loopback::LoopbackProducer*>(producer);
+
+        if (loopProducer != NULL) {
+            return loopProducer->getSendTimeout();
+        }
+
+        return -1;
+    }
+
+    void setSendTimeout(cms::MessageProducer* producer, long long timeout) {
+
+        activemq::core::ActiveMQProducer* amqProducer = dynamic_cast<activemq::core::ActiveMQProducer*>(producer);
+
+        if (amqProducer != NULL) {
+            amqProducer->setSendTimeout(timeout);
+            return;
+        }
+
+        loopback::LoopbackProducer* loopProducer = dynamic_cast<loopback::LoopbackProducer*>(producer);
+
+        if (loopProducer != NULL) {
+            loopProducer->setSendTimeout(timeout);
+        }
+    }
+
+    /**
+     * Applies a send timeout to the CMS Producer for as long as the guard is in scope and
+     * then restores the one it had before.
+     */
+    class SendTimeoutGuard {
+    private:
+
+        cms::MessageProducer* producer;
+        long long saved;
+
+        SendTimeoutGuard(const SendTimeoutGuard&);
+        SendTimeoutGuard& operator= (const SendTimeoutGuard&);
+
+    public:
+
+        SendTimeoutGuard(cms::MessageProducer* producer, long long timeout) :
+            producer(producer), saved(getSendTimeout(producer)) {
+
+            setSendTimeout(this->producer, timeout);
+        }
+
+        ~SendTimeoutGuard() {
+            try{
+                setSendTimeout(this->producer, this->saved);
+            } catch(...) {
+            }
+        }
+    };
+
+    /**
+     * Stamps the Message with the current time when the Producer is configured to.
+     */
+    void stampSendTime(CMS_MessageProducer* producer, CMS_Message* message) {
+
+        if (producer->stampSendTime) {
+            message->message->setLongProperty(CMS_SEND_TIME_PROPERTY, cms_statisticsWallTime());
+        }
+    }
+
+    /**
+     * Where and how a Message is sent, the CMS Producer's own Destination and its default
+     * settings unless they are given.
+     */
+    class SendTarget {
+    private:
+
+        const cms::Destination* destination;
+        bool hasDestination;
+        bool hasSettings;
+        int deliveryMode;
+        int priority;
+        long long timeToLive;
+
+    public:
+
+        SendTarget() : destination(NULL), hasDestination(false), hasSettings(false),
+                       deliveryMode(0), priority(0), timeToLive(0) {
+        }
+
+        SendTarget& to(const cms::Destination* destination) {
+            this->destination = destination;
+            this->hasDestination = true;
+            return *this;
+        }
+
+        SendTarget& with(int deliveryMode, int priority, long long timeToLive) {
+            this->deliveryMode = deliveryMode;
+            this->priority = priority;
+            this->timeToLive = timeToLive;
+            this->hasSettings = true;
+            return *this;
+        }
+
+        int getDeliveryMode(cms::MessageProducer* producer) const {
+            return this->hasSettings ? this->deliveryMode : producer->getDeliveryMode();
+        }
+
+        void send(cms::MessageProducer* producer, cms::Message* message, cms::AsyncCallback* onComplete) const {
+
+            if (this->hasDestination && this->hasSettings) {
+                producer->send(this->destination, message, this->deliveryMode, this->priority,
+                               this->timeToLive, onComplete);
+            } else if (this->hasDestination) {
+                producer->send(this->destination, message, onComplete);
+            } else if (this->hasSettings) {
+                producer->send(message, this->deliveryMode, this->priority, this->timeToLive, onComplete);
+            } else {
+                producer->send(message, onComplete);
+            }
+        }
+    };
+
+    /**
+     * The Message that is handed to the CMS Producer for a send, the caller's own Message
+     * or a copy of it when its body is compressed on the way out or was received compressed.
+     * A Message that shares its body sends the shared Message, which is lent to it until the
+     * send has been handed to the transport, or until the copy is made when one is needed.
+     */
+    class OutgoingMessage {
+    private:
+
+        CMS_MessageProducer* producer;
+        CMS_Message* message;
+        std::auto_ptr<cms::Message> copy;
+
+        /** Wraps the shared Message while it is lent, its Message is NULL otherwise. */
+        CMS_Message lent;
+
+        /** The size of the lent Message once it has been given back, -1 until then. */
+        int lentSize;
+
+        /** Whether the send went out against the window, its outcome is counted when it completes. */
+        bool windowed;
+
+        OutgoingMessage(const OutgoingMessage&);
+        OutgoingMessage& operator= (const OutgoingMessage&);
+
+    public:
+
+        OutgoingMessage(CMS_MessageProducer* producer, CMS_Message* message) :
+            producer(producer), message(message), copy(), lent(), lentSize(-1), windowed(false) {
+        }
+
+        ~OutgoingMessage() {
+            giveBack();
+        }
+
+        /**
+         * Stamps the caller's Message and creates the copy if one is needed, returns the
+         * Message to send.
+         */
+        cms::Message* prepare() {
+
+            stampSendTime(this->producer, this->message);
+
+            CMS_Message* source = this->message;
+
+            if (cms_isSharingBody(this->message)) {
+
+                this->lent.message = cms_lendSharedBody(this->message);
+                this->lent.type = this->message->type;
+
+                source = &this->lent;
+            }
+
+            this->copy.reset(cms_createSendCopy(this->producer->session->session, source,
+                                                this->producer->compressionCodec,
+                                                this->producer->compressionThreshold,
+                                                this->producer->dictionary,
+                                                &this->producer->statistics));
+
+            // The copy has a body of its own, the others sharing the body needn't wait.
+            if (this->copy.get() != NULL) {
+                giveBack();
+            }
+
+            return get();
+        }
+
+        bool isLent() const {
+            return this->lent.message != NULL;
+        }
+
+        /**
+         * Returns the shared Message once the send no longer needs it, its headers must
+         * have been copied to the caller's Message by then.
+         */
+        void giveBack() {
+
+            if (this->lent.message != NULL) {
+
+                if (this->copy.get() == NULL) {
+                    this->lentSize = cms_statisticsMessageSize(this->lent.message);
+                }
+
+                this->lent.message = NULL;
+                cms_returnSharedBody(this->message);
+            }
+        }
+
+        cms::Message* get() const {
+
+            if (this->copy.get() != NULL) {
+                return this->copy.get();
+            }
+
+            return this->lent.message != NULL ? this->lent.message : this->message->message;
+        }
+
+        /**
+         * Called once the send has returned, the headers assigned to a copy or to the lent
+         * Message are copied to the caller's Message.
+         */
+        void sent() {
+            if (this->copy.get() != NULL || this->lent.message != NULL) {
+                cms_copySentHeaders(get(), this->message->message);
+            }
+        }
+
+        int size() const {
+            return this->lentSize >= 0 ? this->lentSize : cms_statisticsMessageSize(get());
+        }
+
+        void setWindowed() {
+            this->windowed = true;
+        }
+
+        bool isWindowed() const {
+            return this->windowed;
+        }
+    };
+
+    /**
+     * Counts a synchronous send in the statistics and reports it to the trace hooks, sends
+     * with invalid arguments are only traced as are those that went out against the window,
+     * which are counted when they complete.
+     */
+    void completeSend(CMS_MessageProducer* producer, CMS_Message* message, const OutgoingMessage& outgoing,
+                      cms_status status, long long start) {
+
+        if (producer != NULL && producer->producer != NULL && message != NULL && !outgoing.isWindowed()) {
+            recordSend(producer, status == CMS_SUCCESS ? outgoing.size() : 0, status, start);
+        }
+
+        cms_traceSendDone(producer, message, status, start);
+    }
+
+    /**
+     * Hands the Message to the transport without waiting for the broker's receipt, the
+     * callback can be NULL when the caller only needs the in flight accounting.
+     */
+    cms_status sendAsync(CMS_MessageProducer* producer, OutgoingMessage& outgoing, const SendTarget& target,
+                         int size, long long start, CMS_SendCompletionCallback callback, void* userData) {
+
+        cms_status result = CMS_SUCCESS;
+
+        SendCompletionCallback* onComplete = new SendCompletionCallback(producer, callback, userData, size, start);
+
+        try{
+            target.send(producer->producer, outgoing.get(), onComplete);
+            outgoing.sent();
+        }
+        CMS_CATCH_EXCEPTION( result )
+
+        // A send that failed after the transport already reported the failure through
+        // the callback has delivered its outcome, so it is not reported a second time.
+        // Otherwise the transport dropped the callback as the send threw and will never
+        // complete it, so its reference is released here.
+        if (result != CMS_SUCCESS) {
+            if (onComplete->cancel()) {
+                onComplete->release();
+            } else {
+                result = CMS_SUCCESS;
+            }
+        }
+
+        onComplete->release();
+
+        return result;
+    }
+
+    /**
+     * Sends a Message that borrows a shared body and waits for the broker's receipt.  The
+     * shared body is only held while the send is handed to the transport, the receipt is
+     * waited for once it has been given back so that the others sharing the body can be
+     * sent meanwhile.  Returns CMS_SEND_TIMEDOUT when a timeout greater than zero elapses
+     * before the receipt arrives.
+     */
+    cms_status sendBorrowed(CMS_MessageProducer* producer, OutgoingMessage& outgoing, const SendTarget& target,
+                            long long timeout) {
+
+        cms_status result = CMS_SUCCESS;
+
+        SendReceipt* receipt = new SendReceipt();
+
+        try{
+            target.send(producer->producer, outgoing.get(), receipt);
+            outgoing.sent();
+        }
+        CMS_CATCH_EXCEPTION( result )
+
+        outgoing.giveBack();
+
+        if (result != CMS_SUCCESS) {
+
+            // As for sendAsync, a receipt that already arrived gives the outcome.
+            if (receipt->cancel()) {
+                receipt->release();
+            } else {
+                result = receipt->getStatus();
+            }
+
+        } else if (receipt->await(timeout)) {
+            result = receipt->getStatus();
+        } else {
+            result = CMS_SEND_TIMEDOUT;
+        }
+
+        receipt->release();
+
+        return result;
+    }
+
+    /**
+     * Tells whether the CMS Producer would hand a send to the transport without waiting
+     * for the broker, the same test the ActiveMQ session applies.  Those are the sends that
+     * the ActiveMQ Producer charges to its own window.
+     */
+    bool isAsyncSend(CMS_MessageProducer* producer, const SendTarget& target) {
+
+        if (producer->alwaysSyncSend || getSendTimeout(producer->producer) > 0) {
+            return false;
+        }
+
+        return target.getDeliveryMode(producer->producer) == cms::DeliveryMode::NON_PERSISTENT ||
+               producer->persistentSendsAsync;
+    }
+
+    /**
+     * Waits until the window has room for a Message of the given size, a Message larger
+     * than the whole window is let through once nothing else is in flight.
+     */
+    void awaitCredit(CMS_MessageProducer* producer, int size) {
+
+        Lock lock(&producer->windowLock);
+
+        while (producer->inFlightCount.get() > 0 &&
+               producer->inFlightBytes.get() + size > producer->windowSize) {
+
+            producer->windowLock.wait();
+        }
+    }
+
+    /**
+     * Sends the prepared Message for one of the blocking send calls.  When the Producer
+     * has a window a send that would go out without waiting for the broker is charged to
+     * this Producer's window, waiting for credit first, and carries a completion callback
+     * so that the ActiveMQ Producer never charges its own window.  Every send is then
+     * counted against the credit that cms_producerTrySend checks, and cms_producerTrySend
+     * can't be held up by credit that only the ActiveMQ Producer knows about.  A Message that
+     * borrows a shared body waits for its receipt once the body has been given back.
+     */
+    cms_status transmit(CMS_MessageProducer* producer, OutgoingMessage& outgoing, const SendTarget& target,
+                        long long start) {
+
+        if (producer->windowSize > 0 && isAsyncSend(producer, target)) {
+
+            int size = outgoing.size();
+
+            awaitCredit(producer, size);
+            outgoing.setWindowed();
+
+            return sendAsync(producer, outgoing, target, size, start, NULL, NULL);
+        }
+
+        if (outgoing.isLent() && !isAsyncSend(producer, target)) {
+            return sendBorrowed(producer, outgoing, target, getSendTimeout(producer->producer));
+        }
+
+        target.send(producer->producer, outgoing.get(), NULL);
+        outgoing.sent();
+
+        return CMS_SUCCESS;
+    }
+
+    /**
+     * Gets the name of a Destination qualified with its type, the form a member of an
+     * ActiveMQ composite Destination takes so that Queues and Topics can be mixed.
+     */
+    std::string qualifiedName(const CMS_Destination* destination) {
+
+        const cms::Destination* member = destination->destination;
+
+        // The temporary Destinations derive from cms::Destination, not from cms::Queue or cms::Topic.
+        switch(member->getDestinationType()) {
+            case cms::Destination::TOPIC: {
+                const cms::Topic* topic = dynamic_cast<const cms::Topic*>(member);
+                if (topic != NULL) {
+                    return "topic://" + topic->getTopicName();
+                }
+                break;
+            }
+            case cms::Destination::TEMPORARY_TOPIC: {
+                const cms::TemporaryTopic* topic = dynamic_cast<const cms::TemporaryTopic*>(member);
+                if (topic != NULL) {
+                    return "temp-topic://" + topic->getTopicName();
+                }
+                break;
+            }
+            case cms::Destination::TEMPORARY_QUEUE: {
+                const cms::TemporaryQueue* queue = dynamic_cast<const cms::TemporaryQueue*>(member);
+                if (queue != NULL) {
+                    return "temp-queue://" + queue->getQueueName();
+                }
+                break;
+            }
+            case cms::Destination::QUEUE: {
+                const cms::Queue* queue = dynamic_cast<const cms::Queue*>(member);
+                if (queue != NULL) {
+                    return "queue://" + queue->getQueueName();
+                }
+                break;
+            }
+        }
+
+        throw cms::CMSException("Cannot send to a Destination of an unknown type");
+    }
+
+    /**
+     * Creates the composite Destination that addresses every one of the given Destinations,
+     * the broker delivers a copy of a Message sent to it to each member.
+     */
+    cms::Destination* createComposite(CMS_Session* session, CMS_Destination** destinations, int count) {
+
+        std::string name;
+
+        for (int i = 0; i < count; ++i) {
+
+            if (destinations[i] == NULL || destinations[i]->destination == NULL) {
+                throw cms::CMSException("Cannot send to a NULL Destination");
+            }
+
+            if (i > 0) {
+                name.append(",");
+            }
+
+            name.append(qualifiedName(destinations[i]));
+        }
+
+        return session->session->createQueue(name);
+    }
+
+    /**
+     * A window of a file that is mapped into memory, or read into a buffer when the file
+     * can't be mapped, for as long as the chunk is in scope.
+     */
+    class FileChunk {
+    private:
+
+        void* mapping;
+        std::size_t mappedLength;
+        const unsigned char* bytes;
+        std::vector<unsigned char> buffer;
+
+    private:
+
+        FileChunk(const FileChunk&);
+        FileChunk& operator=(const FileChunk&);
+
+    public:
+
+        FileChunk(int fd, off_t offset, std::size_t length) :
+            mapping(NULL), mappedLength(0), bytes(NULL), buffer() {
+
+            if (length == 0) {
+                return;
+            }
+
+#ifdef HAVE_SYS_MMAN_H
+            // The mapping has to start on a page boundary.
+            off_t aligned = offset - offset % (off_t) sysconf(_SC_PAGESIZE);
+            std::size_t skipped = (std::size_t) (offset - aligned);
+            void* region = mmap(NULL, length + skipped, PROT_READ, MAP_SHARED, fd, aligned);
+
+            if (region != MAP_FAILED) {
+                this->mapping = region;
+                this->mappedLength = length + skipped;
+                this->bytes = (const unsigned char*) region + skipped;
+                return;
+            }
+#endif
+
+            this->buffer.resize(length);
+
+            std::size_t done = 0;
+            while (done < length) {
+
+                ssize_t count = pread(fd, &this->buffer[done], length - done, offset + (off_t) done);
+
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                } else if (count <= 0) {
+                    throw cms::CMSException("Failed to read the file being sent");
+                }
+
+                done += (std::size_t) count;
+            }
+
+            this->bytes = &this->buffer[0];
+        }
+
+        ~FileChunk() {
+#ifdef HAVE_SYS_MMAN_H
+            if (this->mapping != NULL) {
+                munmap(this->mapping, this->mappedLength);
+            }
+#endif
+        }
+
+        const unsigned char* data() const {
+            return this->bytes;
+        }
+    };
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_createProducer(CMS_Session* session, CMS_Destination* destination, CMS_MessageProducer** producer) {
@@ -46,6 +856,31 @@ cms_status cms_createProducer(CMS_Session* session, CMS_Destination* destination
                 wrapper->producer = session->session->createProducer(NULL);
             }
 
+            wrapper->session = session;
+            wrapper->windowSize = 0;
+            wrapper->alwaysSyncSend = false;
+            wrapper->persistentSendsAsync = session->session->isTransacted();
+            wrapper->stampSendTime = false;
+            wrapper->compressionCodec = CMS_COMPRESSION_NONE;
+            wrapper->compressionThreshold = -1;
+            wrapper->dictionary = NULL;
+            cms_clearEndpointStatistics(&wrapper->statistics);
+            wrapper->connectionStatistics = session->connection->statistics;
+
+            activemq::core::ActiveMQConnection* amqConnection =
+                dynamic_cast<activemq::core::ActiveMQConnection*>(session->connection->connection);
+
+            loopback::LoopbackConnection* loopConnection =
+                dynamic_cast<loopback::LoopbackConnection*>(session->connection->connection);
+
+            if (amqConnection != NULL) {
+                wrapper->windowSize = (int) amqConnection->getProducerWindowSize();
+                wrapper->alwaysSyncSend = amqConnection->isAlwaysSyncSend();
+                wrapper->persistentSendsAsync = wrapper->persistentSendsAsync || amqConnection->isUseAsyncSend();
+            } else if (loopConnection != NULL) {
+                wrapper->windowSize = (int) loopConnection->getProducerWindowSize();
+            }
+
             *producer = wrapper.release();
         }
 
@@ -60,18 +895,23 @@ cms_status cms_producerSend(CMS_MessageProducer* producer, CMS_Message* message,
                             int deliveryMode, int priority, int timeToLive) {
 
     cms_status result = CMS_SUCCESS;
+    long long start = cms_traceSendStart(producer, message);
+    OutgoingMessage outgoing(producer, message);
 
     try{
 
         if (producer == NULL || producer->producer == NULL || message == NULL) {
             result = CMS_ERROR;
         } else {
-            producer->producer->send(message->message, deliveryMode, priority, timeToLive);
+            outgoing.prepare();
+            result = transmit(producer, outgoing, SendTarget().with(deliveryMode, priority, timeToLive), start);
         }
 
     }
     CMS_CATCH_EXCEPTION( result )
 
+    completeSend(producer, message, outgoing, result, start);
+
     return result;
 }
 
@@ -80,6 +920,8 @@ cms_status cms_producerSendToDestination(CMS_MessageProducer* producer, CMS_Mess
                                           int deliveryMode, int priority, int timeToLive) {
 
     cms_status result = CMS_SUCCESS;
+    long long start = cms_traceSendStart(producer, message);
+    OutgoingMessage outgoing(producer, message);
 
     try{
 
@@ -87,12 +929,72 @@ cms_status cms_producerSendToDestination(CMS_MessageProducer* producer, CMS_Mess
             result = CMS_ERROR;
         } else {
             cms::Destination* dest = destination->destination == NULL ? NULL : destination->destination;
-            producer->producer->send(dest, message->message, deliveryMode, priority, timeToLive);
+            outgoing.prepare();
+            result = transmit(producer, outgoing, SendTarget().to(dest).with(deliveryMode, priority, timeToLive), start);
         }
 
     }
     CMS_CATCH_EXCEPTION( result )
 
+    completeSend(producer, message, outgoing, result, start);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_producerSendToDestinations(CMS_MessageProducer* producer, CMS_Message* message,
+                                          CMS_Destination** destinations, int count,
+                                          int deliveryMode, int priority, int timeToLive) {
+
+    if (destinations != NULL && count == 1) {
+        return cms_producerSendToDestination(producer, message, destinations[0], deliveryMode, priority, timeToLive);
+    }
+
+    cms_status result = CMS_SUCCESS;
+    long long start = cms_traceSendStart(producer, message);
+    OutgoingMessage outgoing(producer, message);
+
+    try{
+
+        if (producer == NULL || producer->producer == NULL || message == NULL || destinations == NULL || count <= 0) {
+            result = CMS_ERROR;
+        } else {
+            std::auto_ptr<cms::Destination> composite(createComposite(producer->session, destinations, count));
+            outgoing.prepare();
+            result = transmit(producer, outgoing,
+                              SendTarget().to(composite.get()).with(deliveryMode, priority, timeToLive), start);
+        }
+
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    completeSend(producer, message, outgoing, result, start);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_producerSendToName(CMS_MessageProducer* producer, const char* name, CMS_Message* message) {
+
+    cms_status result = CMS_SUCCESS;
+    long long start = cms_traceSendStart(producer, message);
+    OutgoingMessage outgoing(producer, message);
+    CMS_Destination* destination = NULL;
+
+    try{
+
+        if (producer == NULL || producer->producer == NULL || message == NULL || name == NULL) {
+            result = CMS_ERROR;
+        } else if ((result = cms_getDestinationByName(producer->session, name, &destination)) == CMS_SUCCESS) {
+            outgoing.prepare();
+            result = transmit(producer, outgoing, SendTarget().to(destination->destination), start);
+        }
+
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    completeSend(producer, message, outgoing, result, start);
+
     return result;
 }
 
@@ -100,18 +1002,23 @@ cms_status cms_producerSendToDestination(CMS_MessageProducer* producer, CMS_Mess
 cms_status cms_producerSendWithDefaults(CMS_MessageProducer* producer, CMS_Message* message) {
 
     cms_status result = CMS_SUCCESS;
+    long long start = cms_traceSendStart(producer, message);
+    OutgoingMessage outgoing(producer, message);
 
     try{
 
-        if (producer == NULL || message == NULL) {
+        if (producer == NULL || producer->producer == NULL || message == NULL) {
             result = CMS_ERROR;
         } else {
-            producer->producer->send(message->message);
+            outgoing.prepare();
+            result = transmit(producer, outgoing, SendTarget(), start);
         }
 
     }
     CMS_CATCH_EXCEPTION( result )
 
+    completeSend(producer, message, outgoing, result, start);
+
     return result;
 }
 
@@ -119,18 +1026,232 @@ cms_status cms_producerSendWithDefaults(CMS_MessageProducer* producer, CMS_Messa
 cms_status cms_producerSendWithTimeOut(CMS_MessageProducer* producer, CMS_Message* message, long long timeOut) {
 
     cms_status result = CMS_SUCCESS;
+    long long sendStart = cms_traceSendStart(producer, message);
+    OutgoingMessage outgoing(producer, message);
 
     try{
 
-        if (producer == NULL || message == NULL) {
+        if (producer == NULL || producer->producer == NULL || message == NULL) {
             result = CMS_ERROR;
         } else {
-            producer->producer->send(message->message, producer->producer->getDeliveryMode(), producer->producer->getPriority(), timeOut);
+
+            long long sendTimeout = getSendTimeout(producer->producer);
+
+            outgoing.prepare();
+
+            if (sendTimeout < 0 || timeOut <= 0) {
+                result = transmit(producer, outgoing, SendTarget(), sendStart);
+            } else if (outgoing.isLent()) {
+                result = sendBorrowed(producer, outgoing, SendTarget(), timeOut);
+            } else {
+
+                // With a send timeout the CMS Producer sends synchronously and bounds the
+                // wait for the broker's receipt, such a send is never charged to a window.
+                SendTimeoutGuard guard(producer->producer, timeOut);
+                long long started = System::nanoTime();
+
+                try{
+                    producer->producer->send(outgoing.get());
+                    outgoing.sent();
+                } catch(cms::CMSException& ex) {
+
+                    // The transports don't report a missing receipt with an exception of
+                    // its own type, a send that failed once the time out had elapsed is
+                    // taken to have timed out.
+                    long long elapsed = (System::nanoTime() - started + 999999) / 1000000;
+
+                    if (elapsed < timeOut) {
+                        throw;
+                    }
+
+                    result = CMS_SEND_TIMEDOUT;
+                }
+            }
         }
 
     }
     CMS_CATCH_EXCEPTION( result )
 
+    completeSend(producer, message, outgoing, result, sendStart);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_producerSendAsync(CMS_MessageProducer* producer, CMS_Message* message,
+                                 CMS_SendCompletionCallback callback, void* userData) {
+
+    cms_status result = CMS_ERROR;
+    long long start = cms_traceSendStart(producer, message);
+
+    if (producer != NULL && producer->producer != NULL && message != NULL && callback != NULL) {
+
+        OutgoingMessage outgoing(producer, message);
+        result = CMS_SUCCESS;
+
+        try{
+            outgoing.prepare();
+        }
+        CMS_CATCH_EXCEPTION( result )
+
+        if (result == CMS_SUCCESS) {
+            result = sendAsync(producer, outgoing, SendTarget(), outgoing.size(), start, callback, userData);
+        }
+    }
+
+    cms_traceSendDone(producer, message, result, start);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_producerTrySend(CMS_MessageProducer* producer, CMS_Message* message) {
+
+    cms_status result = CMS_ERROR;
+    long long start = cms_traceSendStart(producer, message);
+
+    if (producer != NULL && producer->producer != NULL && message != NULL) {
+
+        OutgoingMessage outgoing(producer, message);
+        result = CMS_SUCCESS;
+
+        // The window is charged for the Message as it goes out, compressed or not.
+        try{
+            outgoing.prepare();
+        }
+        CMS_CATCH_EXCEPTION( result )
+
+        if (result == CMS_SUCCESS) {
+
+            int size = outgoing.size();
+
+            // A single Message larger than the whole window is let through once nothing
+            // else is in flight, otherwise it could never be sent.
+            if (producer->windowSize > 0 && producer->inFlightCount.get() > 0 &&
+                producer->inFlightBytes.get() + size > producer->windowSize) {
+
+                result = CMS_WOULD_BLOCK;
+            } else {
+                result = sendAsync(producer, outgoing, SendTarget(), size, start, NULL, NULL);
+            }
+        }
+    }
+
+    cms_traceSendDone(producer, message, result, start);
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_producerSendFile(CMS_MessageProducer* producer, int fd, off_t offset, size_t length,
+                                size_t chunkSize, char* groupId, int size) {
+
+    cms_status result = CMS_ERROR;
+
+    if (producer != NULL && producer->producer != NULL && fd >= 0 && offset >= 0 &&
+        chunkSize > 0 && chunkSize <= (size_t) INT_MAX) {
+
+        try{
+
+            struct stat status;
+
+            // Mapping past the end of a regular file faults on access rather than failing.
+            if (fstat(fd, &status) != 0 ||
+                (S_ISREG(status.st_mode) && (off_t) length > status.st_size - offset)) {
+
+                return CMS_ERROR;
+            }
+
+            std::string group = decaf::util::UUID::randomUUID().toString();
+
+            if (groupId != NULL && size > 0) {
+
+                std::size_t pos = 0;
+                for(; pos < group.size() && pos < (std::size_t)size - 1; ++pos) {
+                    groupId[pos] = group.at(pos);
+                }
+
+                groupId[pos] = '\0';
+            }
+
+            std::size_t sent = 0;
+            int sequence = 1;
+
+            do {
+
+                std::size_t count = std::min(chunkSize, length - sent);
+                FileChunk chunk(fd, offset + (off_t) sent, count);
+
+                // An empty chunk has no bytes to point at, it gets an empty body instead.
+                CMS_Message message;
+                std::auto_ptr<cms::Message> bytesMessage(count == 0 ?
+                    producer->session->session->createBytesMessage() :
+                    producer->session->session->createBytesMessage(chunk.data(), (int) count));
+
+                bytesMessage->setStringProperty(CMS_GROUP_ID_PROPERTY, group);
+                bytesMessage->setIntProperty(CMS_GROUP_SEQUENCE_PROPERTY, sequence++);
+                bytesMessage->setLongProperty(CMS_CHUNK_OFFSET_PROPERTY, (long long) sent);
+                bytesMessage->setLongProperty(CMS_CHUNK_TOTAL_PROPERTY, (long long) length);
+                bytesMessage->setBooleanProperty(CMS_CHUNK_FINAL_PROPERTY, sent + count == length);
+
+                message.message = bytesMessage.get();
+                message.type = CMS_BYTES_MESSAGE;
+
+                result = cms_producerSendWithDefaults(producer, &message);
+                sent += count;
+
+            } while (result == CMS_SUCCESS && sent < length);
+        }
+        CMS_CATCH_EXCEPTION( result )
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getProducerAvailableCredit(CMS_MessageProducer* producer, long long* credit) {
+
+    cms_status result = CMS_ERROR;
+
+    if (producer != NULL && credit != NULL) {
+
+        if (producer->windowSize > 0) {
+            long long available = (long long) producer->windowSize - producer->inFlightBytes.get();
+            *credit = available > 0 ? available : 0;
+        } else {
+            *credit = -1;
+        }
+
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getProducerStatistics(CMS_MessageProducer* producer, CMS_ProducerStats* stats) {
+
+    cms_status result = CMS_ERROR;
+
+    if (producer != NULL && stats != NULL) {
+
+        const CMS_EndpointStatistics* statistics = &producer->statistics;
+
+        memset(stats, 0, sizeof(CMS_ProducerStats));
+
+        stats->messagesSent = cms_endpointStatisticsGet(statistics, CMS_STAT_MESSAGES_SENT);
+        stats->bytesSent = cms_endpointStatisticsGet(statistics, CMS_STAT_BYTES_SENT);
+        stats->sendErrors = cms_endpointStatisticsGet(statistics, CMS_STAT_SEND_ERRORS);
+        stats->inFlightCount = producer->inFlightCount.get();
+        stats->inFlightBytes = producer->inFlightBytes.get();
+        cms_histogramAddTo(&statistics->histograms[CMS_STAT_SEND_LATENCY], &stats->sendLatency);
+        stats->compression.messages = cms_endpointStatisticsGet(statistics, CMS_STAT_COMPRESSED_MESSAGES);
+        stats->compression.uncompressedBytes = cms_endpointStatisticsGet(statistics, CMS_STAT_UNCOMPRESSED_BYTES);
+        stats->compression.compressedBytes = cms_endpointStatisticsGet(statistics, CMS_STAT_COMPRESSED_BYTES);
+
+        result = CMS_SUCCESS;
+    }
+
     return result;
 }
 
@@ -246,6 +1367,83 @@ cms_status cms_getProducerDisableMessageTimeStamp(CMS_MessageProducer* producer,
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_setProducerSendTimeStamp(CMS_MessageProducer* producer, int enabled) {
+
+    cms_status result = CMS_ERROR;
+
+    if(producer != NULL) {
+        producer->stampSendTime = enabled != 0;
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getProducerSendTimeStamp(CMS_MessageProducer* producer, int* enabled) {
+
+    cms_status result = CMS_ERROR;
+
+    if(producer != NULL && enabled != NULL) {
+        *enabled = producer->stampSendTime ? 1 : 0;
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_setProducerCompression(CMS_MessageProducer* producer, int codec, int threshold) {
+
+    cms_status result = CMS_ERROR;
+
+    if(producer != NULL) {
+
+        if (codec == CMS_COMPRESSION_NONE || threshold < 0) {
+            producer->compressionCodec = CMS_COMPRESSION_NONE;
+            producer->compressionThreshold = -1;
+            result = CMS_SUCCESS;
+        } else if (!cms_isCompressionSupported(codec)) {
+            result = CMS_UNSUPPORTEDOP;
+        } else {
+            producer->compressionCodec = codec;
+            producer->compressionThreshold = threshold;
+            result = CMS_SUCCESS;
+        }
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getProducerCompression(CMS_MessageProducer* producer, int* codec, int* threshold) {
+
+    cms_status result = CMS_ERROR;
+
+    if(producer != NULL && codec != NULL && threshold != NULL) {
+        *codec = producer->compressionCodec;
+        *threshold = producer->compressionThreshold;
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_setProducerCompressionDictionary(CMS_MessageProducer* producer, CMS_CompressionDictionary* dictionary) {
+
+    cms_status result = CMS_ERROR;
+
+    if(producer != NULL) {
+        cms_releaseCompressionDictionary(producer->dictionary);
+        producer->dictionary = cms_retainCompressionDictionary(dictionary);
+        result = CMS_SUCCESS;
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_setProducerPriority(CMS_MessageProducer* producer, int priority) {
 
@@ -318,6 +1516,20 @@ cms_status cms_destroyProducer(CMS_MessageProducer* producer) {
     if(producer != NULL) {
 
         try{
+
+            // Closing stops new sends, those still in flight complete on the transport
+            // thread and use the Producer until they do.
+            producer->producer->close();
+
+            {
+                Lock lock(&producer->windowLock);
+
+                while (producer->inFlightCount.get() > 0) {
+                    producer->windowLock.wait();
+                }
+            }
+
+            cms_releaseCompressionDictionary(producer->dictionary);
             delete producer->producer;
             delete producer;
         }
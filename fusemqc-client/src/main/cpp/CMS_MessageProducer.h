@@ -17,6 +17,9 @@
 
 #include <cms.h>
 
+#include <stddef.h>
+#include <sys/types.h>
+
 #ifndef _CMS_MESSAGEPRODUCER_WRAPPER_H_
 #define _CMS_MESSAGEPRODUCER_WRAPPER_H_
 
@@ -84,6 +87,58 @@ cms_status cms_producerSend(CMS_MessageProducer* producer, CMS_Message* message,
 cms_status cms_producerSendToDestination(CMS_MessageProducer* producer, CMS_Message* message, CMS_Destination* destination,
                                           int deliveryMode, int priority, int timeToLive);
 
+/**
+ * Given a Message Producer that was created with a NULL Destination, send the given Message
+ * to the Destination with the given name, such as "queue://orders.eu" or "topic://prices".
+ * The Destination is taken from the cache of the Producer's Session as described for
+ * cms_getDestinationByName, so routing each Message by name creates no Destination once a
+ * name has been seen.  The cache keeps every name it has seen until the Session is destroyed,
+ * so the names should come from a bounded set.  This method uses the currently set values
+ * for priority, persistence, and message time to live.
+ *
+ * @param producer
+ *      The Message Producer to use for this send operation.
+ * @param name
+ *      The name of the Destination with its queue:// or topic:// prefix.
+ * @param message
+ *      The Message to send via the given Message Producer.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_producerSendToName(CMS_MessageProducer* producer, const char* name, CMS_Message* message);
+
+/**
+ * Given a Message Producer that was created with a NULL Destination, send the given Message
+ * to every one of the given Destinations in a single send.  The Message is marshaled once
+ * and sent to an ActiveMQ composite Destination that names all of the Destinations, the
+ * broker delivers a copy to each of them and acknowledges the send once, so a fan out costs
+ * one round trip however many Destinations it reaches.  Queues, Topics and Temporary
+ * Destinations can be mixed, the broker must allow composite Destinations to be used.
+ *
+ * One result is returned for all of the Destinations, once the send has returned the
+ * CMSDestination of the Message is the composite Destination.
+ *
+ * @param producer
+ *      The Message Producer to use for this send operation.
+ * @param message
+ *      The Message to send via the given Message Producer.
+ * @param destinations
+ *      The Destinations where the Message is to be sent.
+ * @param count
+ *      The number of Destinations in the destinations array.
+ * @param deliveryMode
+ * 		The deliveryMode to use when sending this Message.
+ * @param priority
+ * 		The priority value to use for this Message.
+ * @param timeToLive
+ *      The time in milliseconds that this Message is allowed to remain active.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_producerSendToDestinations(CMS_MessageProducer* producer, CMS_Message* message,
+                                          CMS_Destination** destinations, int count,
+                                          int deliveryMode, int priority, int timeToLive);
+
 /**
  * Given a Message Producer, send the given Message using that Producer.  This method
  * uses the currently set values for priority, persistence, and message time to live.
@@ -98,20 +153,176 @@ cms_status cms_producerSendToDestination(CMS_MessageProducer* producer, CMS_Mess
 cms_status cms_producerSendWithDefaults(CMS_MessageProducer* producer, CMS_Message* message);
 
 /**
- * Given a Message Producer, send the given Message using that Producer.  Assign the sent
- * message the time to live value specified and uses the currently set values for priority,
- * and message persistence.
+ * Given a Message Producer, send the given Message using that Producer waiting no longer
+ * than the given time out for the send to complete.  This method uses the currently set
+ * values for priority, persistence, and message time to live.  The Message is sent
+ * synchronously whatever its persistence and the time out bounds the wait for the broker's
+ * receipt, if the send fails once the time out has elapsed CMS_SEND_TIMEDOUT is returned and
+ * the Message may or may not have been delivered.  Such a send is not charged to the producer
+ * window so it never waits for window credit.  A time out of zero or less sends the Message
+ * as cms_producerSendWithDefaults does, without a bound.
  *
  * @param producer
  *      The Message Producer to use for this send operation.
  * @param message
  *      The Message to send via the given Message Producer.
- * @param timeToLive
- *      The time in milliseconds to live for the message.
+ * @param timeOut
+ *      The time in milliseconds to wait for the send to complete.
  *
  * @return result code indicating the success or failure of the operation.
  */
-cms_status cms_producerSendWithTimeOut(CMS_MessageProducer* producer, CMS_Message* message, long long timeToLive);
+cms_status cms_producerSendWithTimeOut(CMS_MessageProducer* producer, CMS_Message* message, long long timeOut);
+
+/**
+ * Callback type used to report the outcome of a send started with cms_producerSendAsync.
+ * The status is CMS_SUCCESS once the broker has acknowledged the Message, otherwise it
+ * holds the error code that describes why the broker rejected it.  The callback runs on
+ * the library's transport thread and so it must not block or send Messages itself.
+ */
+typedef void (*CMS_SendCompletionCallback)(CMS_MessageProducer* producer, cms_status status, void* userData);
+
+/**
+ * Given a Message Producer, send the given Message using that Producer without waiting
+ * for the broker to acknowledge it.  This method uses the currently set values for priority,
+ * persistence, and message time to live.  The callback is invoked exactly once when the
+ * broker acknowledges or rejects the Message, which allows persistent Messages to be
+ * pipelined instead of paying a network round trip for each.  If this method returns an
+ * error status the callback will not be invoked for this Message.
+ *
+ * The Message can be destroyed as soon as this method returns.  The callback receives the
+ * Producer, so cms_destroyProducer waits for the callbacks of every outstanding send to
+ * return before the Producer is deleted, a callback must not destroy its own Producer.
+ *
+ * @param producer
+ *      The Message Producer to use for this send operation.
+ * @param message
+ *      The Message to send via the given Message Producer.
+ * @param callback
+ *      The callback that is invoked once the outcome of the send is known.
+ * @param userData
+ *      Opaque pointer that is passed unchanged to the callback.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_producerSendAsync(CMS_MessageProducer* producer, CMS_Message* message,
+                                 CMS_SendCompletionCallback callback, void* userData);
+
+/**
+ * Given a Message Producer, attempt to send the given Message using that Producer without
+ * ever blocking the caller.  This method uses the currently set values for priority,
+ * persistence, and message time to live.  When sending the Message would exceed the
+ * Producer's window, either because the window is full or because the broker has stopped
+ * acknowledging Messages while enforcing its memory limits, CMS_WOULD_BLOCK is returned
+ * immediately and nothing is sent.  Otherwise the Message is sent asynchronously and its
+ * bytes count against the window until the broker acknowledges it.
+ *
+ * The window size is the Connection's producer window, configured with the broker URI
+ * option connection.producerWindowSize which loop:// URIs accept as well.  When no window
+ * is configured this method never returns CMS_WOULD_BLOCK.  Messages that the other send
+ * methods hand to the transport without waiting for the broker, such as non persistent
+ * Messages, count against the same window and those methods wait for credit instead.
+ *
+ * The Producer remains in use until the broker acknowledges the Message, so
+ * cms_destroyProducer waits for every Message sent by this method to be acknowledged or
+ * rejected before the Producer is deleted.
+ *
+ * @param producer
+ *      The Message Producer to use for this send operation.
+ * @param message
+ *      The Message to send via the given Message Producer.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_producerTrySend(CMS_MessageProducer* producer, CMS_Message* message);
+
+/**
+ * Sends length bytes of a file, starting at offset, as a group of chunked BytesMessages of
+ * at most chunkSize bytes each, see CMS_GROUP_ID_PROPERTY for the properties the chunks
+ * carry.  The file is mapped into memory one chunk at a time, or read a chunk at a time
+ * when it can't be mapped, so the memory used is bounded by the chunk size whatever the
+ * size of the file.  The chunks are sent one after the other with the Producer's default
+ * settings and are counted, traced and compressed as any other Message.  A payload of
+ * length zero is sent as a single empty final chunk.
+ *
+ * The file must not be truncated while it is sent.  When a send fails part way the chunks
+ * already sent remain sent, a Consumer sees a group that never completes.  Within a
+ * transacted Session the chunks are part of the current transaction.
+ *
+ * @param producer
+ *      The Message Producer to use for this send operation.
+ * @param fd
+ *      The open file descriptor of the file, its file offset is left as it is.
+ * @param offset
+ *      The position in the file of the first byte to send.
+ * @param length
+ *      The number of bytes to send.
+ * @param chunkSize
+ *      The largest number of bytes that is sent in one Message.
+ * @param groupId
+ *      The address of a buffer where the generated group identifier is written, can be NULL.
+ * @param size
+ *      The size of the groupId buffer.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_producerSendFile(CMS_MessageProducer* producer, int fd, off_t offset, size_t length,
+                                size_t chunkSize, char* groupId, int size);
+
+/**
+ * Gets the number of bytes that can still be sent by cms_producerTrySend before it would
+ * block, this is the Producer's window size less the bytes of all asynchronously sent
+ * Messages that the broker has yet to acknowledge.  When the Producer has no window
+ * configured the credit is reported as -1.
+ *
+ * @param producer
+ *      The Message Producer to use for this operation.
+ * @param credit
+ *      The address where the available credit in bytes is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getProducerAvailableCredit(CMS_MessageProducer* producer, long long* credit);
+
+/**
+ * A snapshot of the runtime statistics of a single Producer.  Latencies are measured
+ * in nanoseconds.
+ */
+typedef struct {
+
+    /** Messages sent successfully, asynchronous sends are counted once the broker acknowledges them. */
+    long long messagesSent;
+
+    /** The total encoded size of the Messages that were sent. */
+    long long bytesSent;
+
+    /** Sends that failed, timed out or were cancelled. */
+    long long sendErrors;
+
+    /** Messages sent asynchronously that the broker has yet to acknowledge. */
+    long long inFlightCount;
+
+    /** The total encoded size of the Messages that are in flight. */
+    long long inFlightBytes;
+
+    /** The time taken by each successful send call, or to completion for asynchronous sends. */
+    CMS_LatencyHistogram sendLatency;
+
+    /** The Messages whose bodies were compressed by cms_setProducerCompression. */
+    CMS_CompressionStats compression;
+
+} CMS_ProducerStats;
+
+/**
+ * Takes a snapshot of the runtime statistics of the given Producer.
+ *
+ * @param producer
+ *      The Producer whose statistics are requested.
+ * @param stats
+ *      The address of the structure that the statistics are written to.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getProducerStatistics(CMS_MessageProducer* producer, CMS_ProducerStats* stats);
 
 /**
  * Sets the delivery mode used by the given producer.
@@ -189,6 +400,86 @@ cms_status cms_setProducerDisableMessageTimeStamp(CMS_MessageProducer* producer,
  */
 cms_status cms_getProducerDisableMessageTimeStamp(CMS_MessageProducer* producer, int* enabled);
 
+/**
+ * Sets whether the Producer stamps every Message it sends with the time it was sent, in
+ * nanoseconds since the epoch, in the CMS_SEND_TIME_PROPERTY property.  Consumers that
+ * measure the end to end latency of their Messages use this in place of the millisecond
+ * CMSTimestamp.  The property is set on the caller's Message.  A value of zero disables
+ * the stamp, which is the default, otherwise its enabled.
+ *
+ * @param producer
+ *      The Message Producer to use for this operation.
+ * @param enabled
+ *      The new send time stamp setting for the given MessageProducer.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_setProducerSendTimeStamp(CMS_MessageProducer* producer, int enabled);
+
+/**
+ * Gets whether the Producer stamps every Message it sends with the time it was sent.
+ *
+ * @param producer
+ *      The Message Producer to use for this operation.
+ * @param enabled
+ *      The address where the send time stamp setting is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getProducerSendTimeStamp(CMS_MessageProducer* producer, int* enabled);
+
+/**
+ * Sets whether the Producer compresses the bodies of the TextMessages and BytesMessages it
+ * sends.  A body of at least threshold bytes is compressed with the codec and sent in a
+ * BytesMessage marked with the CMS_COMPRESSION_PROPERTY, unless compression fails to make
+ * it smaller.  Consumers created by this library restore the original Message, including
+ * its type, and decompress its body the first time it is accessed.  The caller's Message
+ * is left as it is apart from the headers assigned by the send.  Compression is disabled
+ * by default, CMS_COMPRESSION_NONE or a negative threshold disables it.
+ *
+ * @param producer
+ *      The Message Producer to use for this operation.
+ * @param codec
+ *      The CMS_COMPRESSION_CODEC to compress with.
+ * @param threshold
+ *      The length in bytes from which bodies are compressed.
+ *
+ * @return result code indicating the success or failure of the operation, CMS_UNSUPPORTEDOP
+ *         if the library was built without the codec.
+ */
+cms_status cms_setProducerCompression(CMS_MessageProducer* producer, int codec, int threshold);
+
+/**
+ * Gets the codec and threshold that the Producer compresses Message bodies with.
+ *
+ * @param producer
+ *      The Message Producer to use for this operation.
+ * @param codec
+ *      The address where the CMS_COMPRESSION_CODEC is to be written.
+ * @param threshold
+ *      The address where the threshold is to be written, -1 when compression is disabled.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getProducerCompression(CMS_MessageProducer* producer, int* codec, int* threshold);
+
+/**
+ * Sets the dictionary that the Producer compresses Message bodies against, which makes
+ * bodies of only a few hundred bytes worth compressing.  Each compressed Message carries
+ * the identifier of the dictionary in its CMS_COMPRESSION_DICTIONARY_PROPERTY and can only
+ * be decompressed by Consumers that were given the same dictionary.  The Producer keeps
+ * its own reference to the dictionary.  Compression itself is still enabled with
+ * cms_setProducerCompression.
+ *
+ * @param producer
+ *      The Message Producer to use for this operation.
+ * @param dictionary
+ *      The dictionary to compress against, NULL to compress without one.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_setProducerCompressionDictionary(CMS_MessageProducer* producer, CMS_CompressionDictionary* dictionary);
+
 /**
  * Sets the value of the Producer's Message Priority setting.
  *
@@ -248,7 +539,9 @@ cms_status cms_getProducerTimeToLive(CMS_MessageProducer* producer, int* timeToL
 cms_status cms_closeProducer(CMS_MessageProducer* producer);
 
 /**
- * Destroys the given Producer instance.
+ * Destroys the given Producer instance.  The Producer is closed first and then this method
+ * waits for every Message it sent asynchronously to be acknowledged or rejected by the broker,
+ * and for their completion callbacks to return, before the Producer is deleted.
  *
  * @param producer
  *      The Producer that is to be destroyed.
@@ -20,6 +20,7 @@
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Compression.h>
 
 #include <cms/Destination.h>
 
@@ -118,6 +119,8 @@ cms_status cms_browserGetNextMessages(CMS_QueueBrowser* browser, CMS_Message** m
                     wrapper->type = CMS_MESSAGE;
                 }
 
+                cms_inspectReceivedMessage(wrapper.get(), NULL);
+
                 *message = wrapper.release();
 
                 result = CMS_SUCCESS;
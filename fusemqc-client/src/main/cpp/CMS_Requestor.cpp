@@ -0,0 +1,453 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CMS_Requestor.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+
+#include <Config.h>
+#include <private/CMS_Types.h>
+#include <private/CMS_Utils.h>
+#include <private/CMS_Compression.h>
+
+#include <cms/Message.h>
+#include <cms/TextMessage.h>
+#include <cms/BytesMessage.h>
+#include <cms/StreamMessage.h>
+#include <cms/MapMessage.h>
+#include <cms/MessageListener.h>
+#include <cms/TemporaryQueue.h>
+
+#include <decaf/lang/System.h>
+#include <decaf/util/UUID.h>
+#include <decaf/util/concurrent/Lock.h>
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+/**
+ * A request awaiting its reply.  A thread waiting in cms_request waits on the monitor for
+ * the reply to be set, an asynchronous request is deleted once its callback has run.
+ */
+struct CMS_PendingRequest {
+
+    CMS_ReplyCallback callback;
+    void* userData;
+
+    CMS_Message* reply;
+    cms_status status;
+    bool done;
+    Mutex monitor;
+
+    CMS_PendingRequest(CMS_ReplyCallback callback, void* userData) :
+        callback(callback), userData(userData), reply(NULL), status(CMS_SUCCESS), done(false), monitor() {
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    CMS_RequestStripe& stripeOf(CMS_Requestor* requestor, int sequence) {
+        return requestor->stripes[(unsigned int) sequence % CMS_REQUEST_STRIPES];
+    }
+
+    /**
+     * Takes the request with the given sequence number out of the pending requests, returns
+     * NULL when a reply or the Requestor's destruction has already taken it.
+     */
+    CMS_PendingRequest* claim(CMS_Requestor* requestor, int sequence) {
+
+        CMS_RequestStripe& stripe = stripeOf(requestor, sequence);
+
+        Lock lock(&stripe.lock);
+
+        std::map<int, CMS_PendingRequest*>::iterator iter = stripe.requests.find(sequence);
+        if (iter == stripe.requests.end()) {
+            return NULL;
+        }
+
+        CMS_PendingRequest* pending = iter->second;
+        stripe.requests.erase(iter);
+
+        return pending;
+    }
+
+    /**
+     * Completes a request that was claimed, the callback of an asynchronous request is
+     * invoked and the thread waiting on any other is woken.
+     */
+    void complete(CMS_Requestor* requestor, CMS_PendingRequest* pending, CMS_Message* reply, cms_status status) {
+
+        if (pending->callback != NULL) {
+            pending->callback(requestor, reply, status, pending->userData);
+            delete pending;
+            return;
+        }
+
+        Lock lock(&pending->monitor);
+
+        pending->reply = reply;
+        pending->status = status;
+        pending->done = true;
+        pending->monitor.notifyAll();
+    }
+
+    CMS_Message* wrapReply(CMS_Requestor* requestor, const cms::Message* message) {
+
+        std::auto_ptr<CMS_Message> wrapper( new CMS_Message );
+
+        // The dispatched Message is only lent to the listener.
+        wrapper->message = message->clone();
+
+        if(dynamic_cast<const cms::TextMessage*>(message) != NULL) {
+            wrapper->type = CMS_TEXT_MESSAGE;
+        } else if(dynamic_cast<const cms::BytesMessage*>(message) != NULL) {
+            wrapper->type = CMS_BYTES_MESSAGE;
+        } else if(dynamic_cast<const cms::MapMessage*>(message) != NULL) {
+            wrapper->type = CMS_MAP_MESSAGE;
+        } else if(dynamic_cast<const cms::StreamMessage*>(message) != NULL) {
+            wrapper->type = CMS_STREAM_MESSAAGE;
+        } else {
+            wrapper->type = CMS_MESSAGE;
+        }
+
+        cms_inspectReceivedMessage(wrapper.get(), requestor->consumer);
+
+        return wrapper.release();
+    }
+
+    /**
+     * Receives the replies on the Session's dispatch thread and hands each to the request
+     * whose correlation ID it carries, replies to requests that gave up are discarded.
+     */
+    class ReplyListener : public cms::MessageListener {
+    private:
+
+        CMS_Requestor* requestor;
+
+    public:
+
+        ReplyListener(CMS_Requestor* requestor) : cms::MessageListener(), requestor(requestor) {
+        }
+
+        virtual ~ReplyListener() {}
+
+        virtual void onMessage(const cms::Message* message) {
+
+            try{
+
+                std::string id = message->getCMSCorrelationID();
+                const std::string& prefix = this->requestor->correlationPrefix;
+
+                if (id.size() <= prefix.size() || id.compare(0, prefix.size(), prefix) != 0) {
+                    return;
+                }
+
+                CMS_PendingRequest* pending = claim(this->requestor, atoi(id.c_str() + prefix.size()));
+                if (pending == NULL) {
+                    return;
+                }
+
+                cms_status status = CMS_SUCCESS;
+                CMS_Message* reply = NULL;
+
+                try{
+                    reply = wrapReply(this->requestor, message);
+                }
+                CMS_CATCH_EXCEPTION( status )
+
+                complete(this->requestor, pending, reply, status);
+
+            } catch(...) {
+                // Nothing may escape to the dispatch thread.
+            }
+        }
+    };
+
+    /**
+     * Gives the request its correlation ID and Reply To Destination, records it as pending
+     * and sends it.  The request is pending before it is sent so that no reply can beat it.
+     * It never expires, a time to live would depend on the broker's clock agreeing with ours.
+     */
+    cms_status sendRequest(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                           CMS_PendingRequest* pending, int* sequence) {
+
+        *sequence = requestor->sequence.incrementAndGet();
+
+        std::ostringstream id;
+        id << requestor->correlationPrefix << *sequence;
+
+        cms_status result = cms_setCMSMessageCorrelationID(request, id.str().c_str());
+
+        if (result == CMS_SUCCESS) {
+            result = cms_setCMSMessageReplyTo(request, requestor->replyTo);
+        }
+
+        if (result != CMS_SUCCESS) {
+            return result;
+        }
+
+        {
+            CMS_RequestStripe& stripe = stripeOf(requestor, *sequence);
+            Lock lock(&stripe.lock);
+            stripe.requests[*sequence] = pending;
+        }
+
+        {
+            Lock lock(&requestor->sendLock);
+            result = cms_producerSendToDestination(requestor->producer, request, destination,
+                                                   CMS_MSG_NON_PERSISTENT, 4, 0);
+        }
+
+        // A reply that arrived even though the send failed has completed the request.
+        if (result != CMS_SUCCESS && claim(requestor, *sequence) == NULL) {
+            result = CMS_SUCCESS;
+        }
+
+        return result;
+    }
+
+    /**
+     * Sends a request and waits for its reply, a negative timeout waits forever.
+     */
+    cms_status requestAndWait(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                              CMS_Message** reply, int timeout) {
+
+        CMS_PendingRequest pending(NULL, NULL);
+        int sequence = 0;
+
+        cms_status result = sendRequest(requestor, destination, request, &pending, &sequence);
+        if (result != CMS_SUCCESS) {
+            return result;
+        }
+
+        long long deadline = System::currentTimeMillis() + timeout;
+
+        Lock lock(&pending.monitor);
+
+        while (!pending.done) {
+
+            if (timeout < 0) {
+                pending.monitor.wait();
+                continue;
+            }
+
+            long long remaining = deadline - System::currentTimeMillis();
+
+            if (remaining > 0) {
+                pending.monitor.wait(remaining);
+            } else if (claim(requestor, sequence) != NULL) {
+                return CMS_RECEIVE_TIMEDOUT;
+            } else {
+                // A reply has claimed the request and is being handed over.
+                pending.monitor.wait();
+            }
+        }
+
+        *reply = pending.reply;
+
+        return pending.status;
+    }
+
+    void destroyParts(CMS_Requestor* requestor) {
+
+        cms_destroyConsumer(requestor->consumer);
+        cms_destroyProducer(requestor->producer);
+
+        // The broker keeps a Temporary Queue until it is deleted or its Connection closes.
+        if (requestor->replyTo != NULL) {
+
+            cms::TemporaryQueue* queue = dynamic_cast<cms::TemporaryQueue*>(requestor->replyTo->destination);
+
+            try{
+                if (queue != NULL) {
+                    queue->destroy();
+                }
+            } catch(cms::CMSException&) {
+            }
+        }
+
+        cms_destroyDestination(requestor->replyTo);
+        cms_destroySession(requestor->session);
+
+        delete requestor->listener;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_createRequestor(CMS_Connection* connection, CMS_Requestor** requestor) {
+
+    if (connection == NULL || requestor == NULL) {
+        return CMS_ERROR;
+    }
+
+    cms_status result = CMS_SUCCESS;
+    std::auto_ptr<CMS_Requestor> wrapper( new CMS_Requestor );
+
+    wrapper->session = NULL;
+    wrapper->replyTo = NULL;
+    wrapper->producer = NULL;
+    wrapper->consumer = NULL;
+    wrapper->listener = NULL;
+
+    try{
+
+        wrapper->correlationPrefix = decaf::util::UUID::randomUUID().toString() + ":";
+
+        result = cms_createSession(connection, &wrapper->session, CMS_AUTO_ACKNOWLEDGE);
+
+        if (result == CMS_SUCCESS) {
+            result = cms_createTemporaryDestination(wrapper->session, CMS_TEMPORARY_QUEUE, &wrapper->replyTo);
+        }
+
+        if (result == CMS_SUCCESS) {
+            result = cms_createProducer(wrapper->session, NULL, &wrapper->producer);
+        }
+
+        if (result == CMS_SUCCESS) {
+            result = cms_createDefaultConsumer(wrapper->session, wrapper->replyTo, &wrapper->consumer);
+        }
+
+        if (result == CMS_SUCCESS) {
+            wrapper->listener = new ReplyListener(wrapper.get());
+            wrapper->consumer->consumer->setMessageListener(wrapper->listener);
+            *requestor = wrapper.release();
+        }
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    if (result != CMS_SUCCESS) {
+        destroyParts(wrapper.get());
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_request(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                       CMS_Message** reply) {
+
+    if (requestor == NULL || destination == NULL || request == NULL || reply == NULL) {
+        return CMS_ERROR;
+    }
+
+    cms_status result = CMS_SUCCESS;
+
+    *reply = NULL;
+
+    try{
+        result = requestAndWait(requestor, destination, request, reply, -1);
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_requestWithTimeout(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                                  CMS_Message** reply, int timeout) {
+
+    if (requestor == NULL || destination == NULL || request == NULL || reply == NULL || timeout <= 0) {
+        return CMS_ERROR;
+    }
+
+    cms_status result = CMS_SUCCESS;
+
+    *reply = NULL;
+
+    try{
+        result = requestAndWait(requestor, destination, request, reply, timeout);
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_requestAsync(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                            CMS_ReplyCallback callback, void* userData) {
+
+    if (requestor == NULL || destination == NULL || request == NULL || callback == NULL) {
+        return CMS_ERROR;
+    }
+
+    cms_status result = CMS_SUCCESS;
+
+    try{
+
+        std::auto_ptr<CMS_PendingRequest> pending( new CMS_PendingRequest(callback, userData) );
+        int sequence = 0;
+
+        result = sendRequest(requestor, destination, request, pending.get(), &sequence);
+
+        // Once sent the request belongs to whichever of its reply or the destruction
+        // of the Requestor completes it.
+        if (result == CMS_SUCCESS) {
+            pending.release();
+        }
+    }
+    CMS_CATCH_EXCEPTION( result )
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_destroyRequestor(CMS_Requestor* requestor) {
+
+    cms_status result = CMS_SUCCESS;
+
+    if (requestor != NULL) {
+
+        // Once the Session is closed no more replies are dispatched.
+        try{
+            requestor->session->session->close();
+        }
+        CMS_CATCH_EXCEPTION( result )
+
+        for (int i = 0; i < CMS_REQUEST_STRIPES; ++i) {
+
+            std::map<int, CMS_PendingRequest*> requests;
+
+            {
+                Lock lock(&requestor->stripes[i].lock);
+                requests.swap(requestor->stripes[i].requests);
+            }
+
+            std::map<int, CMS_PendingRequest*>::const_iterator iter = requests.begin();
+            for (; iter != requests.end(); ++iter) {
+                complete(requestor, iter->second, NULL, CMS_ILLEGAL_STATE);
+            }
+        }
+
+        destroyParts(requestor);
+        delete requestor;
+    }
+
+    return result;
+}
@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cms.h>
+
+#ifndef _CMS_REQUESTOR_WRAPPER_H_
+#define _CMS_REQUESTOR_WRAPPER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A Requestor makes requests and waits for their replies over one Temporary Queue that it
+ * creates for itself, rather than a Temporary Queue and Consumer per request.  Each request
+ * is given the Requestor's Queue as its Reply To Destination and a correlation ID of its
+ * own, the replier must copy that correlation ID onto its reply.  Replies are received in
+ * the background and handed to the request they answer, so any number of threads can make
+ * requests through the same Requestor at once and thousands of them can be outstanding.
+ *
+ * The Requestor has a Session of its own on the given Connection, replies only arrive once
+ * the Connection has been started.
+ */
+
+/**
+ * Callback type used to deliver the reply to a request made with cms_requestAsync.  The
+ * status is CMS_SUCCESS with the reply, which the callback then owns and must destroy, or
+ * an error code with a NULL reply when the Requestor was destroyed before the reply came.
+ * The callback runs on the Requestor's dispatch thread and so it must not block or make
+ * blocking requests itself.
+ */
+typedef void (*CMS_ReplyCallback)(CMS_Requestor* requestor, CMS_Message* reply, cms_status status, void* userData);
+
+/**
+ * Creates a Requestor on the given Connection along with its Session, reply Queue and the
+ * Consumer of its replies.
+ *
+ * @param connection
+ *      The Connection that requests are made over.
+ * @param requestor
+ *      The memory location where the newly allocated Requestor instance is to be stored.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_createRequestor(CMS_Connection* connection, CMS_Requestor** requestor);
+
+/**
+ * Sends a request to the given Destination and waits for its reply.  The request's Reply
+ * To Destination and correlation ID are set by this method, the request can be destroyed
+ * as soon as it returns.  Requests are sent non persistent and never expire.
+ *
+ * @param requestor
+ *      The Requestor to use for this request.
+ * @param destination
+ *      The Destination where the request is to be sent.
+ * @param request
+ *      The request Message.
+ * @param reply
+ *      The memory location where the reply is to be stored, the caller owns it.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_request(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                       CMS_Message** reply);
+
+/**
+ * Sends a request to the given Destination and waits no longer than the given time out for
+ * its reply, CMS_RECEIVE_TIMEDOUT is returned if none arrives in time and a reply that comes
+ * later is discarded.  Like every request it is sent without a time to live, which would
+ * rely on the clocks of the client and the broker agreeing, so a request that times out
+ * may still be consumed and answered.
+ *
+ * @param requestor
+ *      The Requestor to use for this request.
+ * @param destination
+ *      The Destination where the request is to be sent.
+ * @param request
+ *      The request Message.
+ * @param reply
+ *      The memory location where the reply is to be stored, the caller owns it.
+ * @param timeout
+ *      The time in milliseconds to wait for the reply, which must be greater than zero,
+ *      cms_request waits forever.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_requestWithTimeout(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                                  CMS_Message** reply, int timeout);
+
+/**
+ * Sends a request to the given Destination and returns without waiting, the callback is
+ * invoked exactly once with the reply or, if the Requestor is destroyed first, with an
+ * error.  If this method returns an error status the callback will not be invoked.
+ *
+ * @param requestor
+ *      The Requestor to use for this request.
+ * @param destination
+ *      The Destination where the request is to be sent.
+ * @param request
+ *      The request Message.
+ * @param callback
+ *      The callback that is invoked with the reply.
+ * @param userData
+ *      Opaque pointer that is passed unchanged to the callback.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_requestAsync(CMS_Requestor* requestor, CMS_Destination* destination, CMS_Message* request,
+                            CMS_ReplyCallback callback, void* userData);
+
+/**
+ * Destroys the Requestor and its Session.  The callbacks of asynchronous requests that are
+ * still awaiting a reply are invoked with CMS_ILLEGAL_STATE before this method returns, no
+ * thread may be waiting in cms_request or cms_requestWithTimeout.
+ *
+ * @param requestor
+ *      The Requestor to destroy.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_destroyRequestor(CMS_Requestor* requestor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CMS_REQUESTOR_WRAPPER_H_ */
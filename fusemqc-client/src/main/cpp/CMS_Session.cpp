@@ -16,16 +16,55 @@
  */
 
 #include <CMS_Session.h>
+#include <CMS_MessageConsumer.h>
 
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Readiness.h>
+#include <private/CMS_Statistics.h>
+#include <private/CMS_Trace.h>
+
+#include <decaf/util/concurrent/Lock.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
 
+#include <map>
 #include <memory>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    /**
+     * A rollback or recover puts the delivered Messages that weren't acknowledged back
+     * into the prefetch buffers without a new dispatch, so they are counted back into the
+     * Consumers' pending counts and the Consumers are signalled here instead.
+     */
+    void returnDeliveredMessages(CMS_Session* session) {
+
+        decaf::util::concurrent::Lock lock(&session->consumersLock);
+
+        std::vector<CMS_MessageConsumer*>::const_iterator iter = session->consumers.begin();
+        for (; iter != session->consumers.end(); ++iter) {
+
+            long long returned = cms_endpointStatisticsTake(&(*iter)->statistics, CMS_STAT_UNACKNOWLEDGED);
+
+            if (returned <= 0) {
+                continue;
+            }
+
+            // The signal counts one of them.
+            if (returned > 1) {
+                (*iter)->available.addAndGet((int) (returned - 1));
+            }
+
+            cms_signalConsumerAvailable(*iter);
+        }
+    }
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_createDefaultSession(CMS_Connection* connection, CMS_Session** session) {
@@ -39,6 +78,7 @@ cms_status cms_createDefaultSession(CMS_Connection* connection, CMS_Session** se
             result = CMS_ERROR;
         } else {
             wrapper->session = connection->connection->createSession();
+            wrapper->connection = connection;
             *session = wrapper.release();
         }
 
@@ -81,6 +121,7 @@ cms_status cms_createSession(CMS_Connection* connection, CMS_Session** session,
                     return CMS_UNKNOWN_ACKTYPE;
             }
             wrapper->session = connection->connection->createSession(cmsAckType);
+            wrapper->connection = connection;
             *session = wrapper.release();
         }
 
@@ -98,6 +139,23 @@ cms_status cms_destroySession(CMS_Session* session) {
     if(session != NULL) {
 
         try{
+
+            // Consumers may outlive the Session wrapper, they must not reach back into it.
+            {
+                decaf::util::concurrent::Lock lock(&session->consumersLock);
+
+                std::vector<CMS_MessageConsumer*>::const_iterator iter = session->consumers.begin();
+                for (; iter != session->consumers.end(); ++iter) {
+                    (*iter)->session = NULL;
+                }
+            }
+
+            std::map<std::string, CMS_Destination*>::const_iterator dest = session->destinations.begin();
+            for (; dest != session->destinations.end(); ++dest) {
+                delete dest->second->destination;
+                delete dest->second;
+            }
+
             delete session->session;
             delete session;
         }
@@ -127,15 +185,20 @@ cms_status cms_closeSession(CMS_Session* session) {
 cms_status cms_commitSession(CMS_Session* session) {
 
     cms_status result = CMS_SUCCESS;
+    long long start = cms_traceCommitStart(session);
 
     if(session != NULL) {
 
         try{
             session->session->commit();
+            cms_statisticsAdd(session->connection->statistics, CMS_STAT_COMMITS, 1);
+            cms_statisticsAcknowledged(session, NULL);
         }
         CMS_CATCH_EXCEPTION( result )
     }
 
+    cms_traceCommitDone(session, result, start);
+
     return result;
 }
 
@@ -143,16 +206,21 @@ cms_status cms_commitSession(CMS_Session* session) {
 cms_status cms_rollbackSession(CMS_Session* session) {
 
     cms_status result = CMS_SUCCESS;
+    long long start = cms_traceRollbackStart(session);
 
     if(session != NULL) {
 
         try{
             session->session->rollback();
+            cms_statisticsAdd(session->connection->statistics, CMS_STAT_ROLLBACKS, 1);
+            returnDeliveredMessages(session);
         } catch(...) {
             result = CMS_ERROR;
         }
     }
 
+    cms_traceRollbackDone(session, result, start);
+
     return result;
 }
 
@@ -165,6 +233,7 @@ cms_status cms_recoverSession(CMS_Session* session) {
 
         try{
             session->session->recover();
+            returnDeliveredMessages(session);
         }
         CMS_CATCH_EXCEPTION( result )
     }
@@ -204,6 +273,33 @@ cms_status cms_isSessionTransacted(CMS_Session* session, int* transacted) {
     return result;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getSessionPendingCount(CMS_Session* session, int* count) {
+
+    cms_status result = CMS_ERROR;
+
+    if (session != NULL && count != NULL) {
+
+        int pending = 0;
+        result = CMS_SUCCESS;
+
+        decaf::util::concurrent::Lock lock(&session->consumersLock);
+
+        std::vector<CMS_MessageConsumer*>::const_iterator iter = session->consumers.begin();
+        for (; iter != session->consumers.end() && result == CMS_SUCCESS; ++iter) {
+
+            int consumerPending = 0;
+
+            result = cms_getConsumerPendingCount(*iter, &consumerPending);
+            pending += consumerPending;
+        }
+
+        *count = pending;
+    }
+
+    return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 cms_status cms_unsubscribeSessionDurableConsumer(CMS_Session* session, const char* subscription) {
 
@@ -132,6 +132,20 @@ cms_status cms_getSessionAcknowledgeMode(CMS_Session* session, int* mode);
  */
 cms_status cms_isSessionTransacted(CMS_Session* session, int* transacted);
 
+/**
+ * Gets the number of Messages waiting in the prefetch buffers of all the Consumers of the
+ * given Session, see cms_getConsumerPendingCount.  It can be called while other threads
+ * create or destroy Consumers of the Session.
+ *
+ * @param session
+ *      The session that is the target for this operation.
+ * @param count
+ *      The address where the number of pending Messages is to be written.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getSessionPendingCount(CMS_Session* session, int* count);
+
 /**
  * Remove the given durable subscription from the Broker's registered durable
  * subscribers.
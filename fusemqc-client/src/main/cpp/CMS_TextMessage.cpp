@@ -21,6 +21,8 @@
 #include <Config.h>
 #include <private/CMS_Types.h>
 #include <private/CMS_Utils.h>
+#include <private/CMS_Compression.h>
+#include <private/CMS_SharedBody.h>
 
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
@@ -48,8 +50,14 @@ cms_status cms_getMessageText(CMS_Message* message, char* dest, int size) {
         try{
 
             cms::TextMessage* txtMessage = dynamic_cast<cms::TextMessage*>( message->message );
+            std::string msgText;
 
-            std::string msgText = txtMessage->getText();
+            // A TextMessage that was received compressed holds its text as a BytesMessage body.
+            if(cms_isSharingBody( message )) {
+                msgText = cms_getSharedText( message );
+            } else {
+                msgText = txtMessage != NULL ? txtMessage->getText() : cms_getDecompressedText( message );
+            }
 
             if(!msgText.empty()) {
 
@@ -85,9 +93,14 @@ cms_status cms_setMessageText(CMS_Message* message, const char* value) {
 
         try{
 
+            cms_discardSharedBody( message );
+
             cms::TextMessage* txtMessage = dynamic_cast<cms::TextMessage*>( message->message );
 
-            if(strlen(value) > 0) {
+            if(txtMessage == NULL) {
+                cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>( message->message );
+                bytesMessage->setBodyBytes( (const unsigned char*) value, (int) strlen(value) );
+            } else if(strlen(value) > 0) {
                 txtMessage->setText(value);
             } else {
                 txtMessage->setText("");
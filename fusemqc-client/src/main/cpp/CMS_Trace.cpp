@@ -0,0 +1,44 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <CMS_Trace.h>
+
+#include <Config.h>
+#include <private/CMS_Trace.h>
+
+////////////////////////////////////////////////////////////////////////////////
+const CMS_TraceHooks* cms_traceHooks = NULL;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    // The installed hooks are copied here so the caller's structure can go away.
+    CMS_TraceHooks installedHooks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_setTraceHooks(const CMS_TraceHooks* hooks) {
+
+    cms_traceHooks = NULL;
+
+    if (hooks != NULL) {
+        installedHooks = *hooks;
+        cms_traceHooks = &installedHooks;
+    }
+
+    return CMS_SUCCESS;
+}
@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cms.h>
+
+#ifndef _CMS_TRACE_WRAPPER_H_
+#define _CMS_TRACE_WRAPPER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Callbacks that are invoked around the sends, receives, acknowledgements, commits and
+ * rollbacks made through the library, for example to feed a tracing or profiling system.
+ * Every callback is optional and is left NULL when not wanted.  The "before" callbacks
+ * are passed the monotonic time in nanoseconds at which the operation started, the
+ * "after" callbacks are passed the same start time along with the time the operation
+ * finished and the status it returns.
+ *
+ * The callbacks run on the thread making the call, except for the completion of
+ * asynchronous sends which is not traced, and must not call back into the library.
+ *
+ * On platforms with systemtap style static probes the same points are also exposed as
+ * USDT probes of the activemq_c provider (send__start, send__done, receive__start,
+ * receive__done, ack__start, ack__done, commit__start, commit__done, rollback__start,
+ * rollback__done and body__copy) which cost nothing until a tracer such as bpftrace
+ * attaches to them.
+ */
+typedef struct {
+
+    void (*beforeSend)(CMS_MessageProducer* producer, CMS_Message* message, long long start, void* userData);
+    void (*afterSend)(CMS_MessageProducer* producer, CMS_Message* message, cms_status status,
+                      long long start, long long end, void* userData);
+
+    void (*beforeReceive)(CMS_MessageConsumer* consumer, long long start, void* userData);
+
+    /** The Message is NULL when the receive returned without one. */
+    void (*afterReceive)(CMS_MessageConsumer* consumer, CMS_Message* message, cms_status status,
+                         long long start, long long end, void* userData);
+
+    void (*beforeAcknowledge)(CMS_Message* message, long long start, void* userData);
+    void (*afterAcknowledge)(CMS_Message* message, cms_status status, long long start, long long end, void* userData);
+
+    void (*beforeCommit)(CMS_Session* session, long long start, void* userData);
+    void (*afterCommit)(CMS_Session* session, cms_status status, long long start, long long end, void* userData);
+
+    void (*beforeRollback)(CMS_Session* session, long long start, void* userData);
+    void (*afterRollback)(CMS_Session* session, cms_status status, long long start, long long end, void* userData);
+
+    /**
+     * A body shared through cms_cloneMessageShallow was copied, because one of the Messages
+     * sharing it was cloned in full or is about to read or write its body at a position.
+     */
+    void (*bodyCopied)(CMS_Message* message, void* userData);
+
+    /** Passed unchanged to every callback. */
+    void* userData;
+
+} CMS_TraceHooks;
+
+/**
+ * Installs the given trace hooks for every Connection in the process, replacing any that
+ * were installed before.  The hooks are copied so the structure need not outlive the call.
+ * Hooks should be installed or removed before the library is in use, they must not be
+ * changed while other threads may be sending or receiving.
+ *
+ * @param hooks
+ *      The hooks to install, or NULL to remove the installed hooks.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_setTraceHooks(const CMS_TraceHooks* hooks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CMS_TRACE_WRAPPER_H_ */
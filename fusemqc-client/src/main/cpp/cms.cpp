@@ -17,8 +17,12 @@
 
 #include <cms.h>
 
+#include <private/CMS_Statistics.h>
+
 #include <activemq/library/ActiveMQCPP.h>
 
+#include <math.h>
+
 ////////////////////////////////////////////////////////////////////////////////
 void cms_initialize() {
     activemq::library::ActiveMQCPP::initializeLibrary();
@@ -28,3 +32,52 @@ void cms_initialize() {
 void cms_terminate() {
     activemq::library::ActiveMQCPP::shutdownLibrary();
 }
+
+////////////////////////////////////////////////////////////////////////////////
+long long cms_getLatencyHistogramBucketLowerBound(int bucket) {
+
+    if (bucket < 0 || bucket >= CMS_LATENCY_HISTOGRAM_BUCKETS) {
+        return -1;
+    }
+
+    return cms_histogramBucketLowerBound(bucket);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms_status cms_getLatencyHistogramPercentile(const CMS_LatencyHistogram* histogram, double percentile, long long* value) {
+
+    if (histogram == NULL || value == NULL || percentile < 0 || percentile > 100) {
+        return CMS_ERROR;
+    }
+
+    *value = 0;
+
+    if (histogram->count <= 0) {
+        return CMS_SUCCESS;
+    }
+
+    long long target = (long long) ceil(percentile / 100.0 * (double) histogram->count);
+    if (target < 1) {
+        target = 1;
+    }
+
+    long long seen = 0;
+
+    for (int bucket = 0; bucket < CMS_LATENCY_HISTOGRAM_BUCKETS; ++bucket) {
+
+        seen += histogram->counts[bucket];
+
+        if (seen >= target) {
+
+            long long highest = histogram->max;
+            if (bucket + 1 < CMS_LATENCY_HISTOGRAM_BUCKETS) {
+                highest = cms_histogramBucketLowerBound(bucket + 1) - 1;
+            }
+
+            *value = highest < histogram->max ? highest : histogram->max;
+            break;
+        }
+    }
+
+    return CMS_SUCCESS;
+}
@@ -51,6 +51,12 @@ typedef struct CMS_Message CMS_Message;
 /** The Opaque Destination Structure */
 typedef struct CMS_Destination CMS_Destination;
 
+/** The Opaque Compression Dictionary Structure */
+typedef struct CMS_CompressionDictionary CMS_CompressionDictionary;
+
+/** The Opaque Requestor Structure */
+typedef struct CMS_Requestor CMS_Requestor;
+
 /**
  * This section defines types used by the C client code to interact with the
  * C++ library via the Wrapper functions.
@@ -88,6 +94,19 @@ typedef enum {
     CMS_MSG_NON_PERSISTENT = 1
 } CMS_DELIVERY_MODE;
 
+/** Enum that defines the codecs a Producer can compress Message bodies with. */
+typedef enum {
+    CMS_COMPRESSION_NONE,
+    CMS_COMPRESSION_ZLIB
+} CMS_COMPRESSION_CODEC;
+
+/** Enum that defines where cms_consumerReceiveChunked writes the payload it reassembles. */
+typedef enum {
+    CMS_CHUNK_SINK_FD,
+    CMS_CHUNK_SINK_MEMORY,
+    CMS_CHUNK_SINK_CALLBACK
+} CMS_CHUNK_SINK_TYPE;
+
 /** Result code returned from wrapper functions to indicate success or failure. */
 typedef int cms_status;
 
@@ -112,6 +131,85 @@ typedef int cms_status;
 #define CMS_UNKNOWN_ACKTYPE         13
 #define CMS_INCOMPLETE_READ         14
 #define CMS_RECEIVE_TIMEDOUT        15
+#define CMS_SEND_TIMEDOUT           16
+#define CMS_WOULD_BLOCK             17
+
+/** The number of buckets in a CMS_LatencyHistogram. */
+#define CMS_LATENCY_HISTOGRAM_BUCKETS 128
+
+/**
+ * A log-linear histogram of latencies in nanoseconds, as reported in the statistics
+ * snapshots.  Values below four each have a bucket of their own, above that every power
+ * of two is split into four equal buckets so a bucket is never wider than a quarter of
+ * its lower bound.  The last bucket also holds everything from 7.5 seconds up.
+ */
+typedef struct {
+    long long counts[CMS_LATENCY_HISTOGRAM_BUCKETS];
+
+    /** The number of values recorded. */
+    long long count;
+
+    /** The sum of the values recorded, divide by count for the mean. */
+    long long total;
+
+    /** The largest value recorded. */
+    long long max;
+} CMS_LatencyHistogram;
+
+/**
+ * The Message property holding the time, in nanoseconds since the epoch, at which a
+ * Producer with send time stamps enabled sent the Message.
+ */
+#define CMS_SEND_TIME_PROPERTY "AMQC_SendTime"
+
+/**
+ * The Message property that marks a body compressed by the sending Producer, it holds
+ * the name of the codec, "zlib" for CMS_COMPRESSION_ZLIB.  Compressed Messages always
+ * travel as BytesMessages, CMS_COMPRESSED_SIZE_PROPERTY holds the length of the body
+ * before compression and CMS_COMPRESSED_TEXT_PROPERTY is set when the body is the text
+ * of a TextMessage.  Consumers of this library decompress such bodies transparently.
+ */
+#define CMS_COMPRESSION_PROPERTY "AMQC_Compression"
+#define CMS_COMPRESSED_SIZE_PROPERTY "AMQC_UncompressedSize"
+#define CMS_COMPRESSED_TEXT_PROPERTY "AMQC_CompressedText"
+
+/**
+ * The Message property that identifies the CMS_CompressionDictionary a body was compressed
+ * against, it holds the dictionary's identifier as a long.
+ */
+#define CMS_COMPRESSION_DICTIONARY_PROPERTY "AMQC_CompressionDictionary"
+
+/**
+ * The Message properties of the chunks that a large payload is sent in by
+ * cms_producerSendFile.  The chunks of one payload share a CMS_GROUP_ID_PROPERTY and are
+ * numbered from 1 in their CMS_GROUP_SEQUENCE_PROPERTY, the standard JMSXGroupID and
+ * JMSXGroupSeq, so the broker hands them all to the same Consumer in order.  Each chunk is
+ * a BytesMessage whose CMS_CHUNK_OFFSET_PROPERTY holds its position in the payload and
+ * whose CMS_CHUNK_TOTAL_PROPERTY holds the length of the whole payload, both as longs, and
+ * the last chunk has CMS_CHUNK_FINAL_PROPERTY set to true.
+ */
+#define CMS_GROUP_ID_PROPERTY "JMSXGroupID"
+#define CMS_GROUP_SEQUENCE_PROPERTY "JMSXGroupSeq"
+#define CMS_CHUNK_OFFSET_PROPERTY "AMQC_ChunkOffset"
+#define CMS_CHUNK_TOTAL_PROPERTY "AMQC_ChunkTotal"
+#define CMS_CHUNK_FINAL_PROPERTY "AMQC_ChunkFinal"
+
+/**
+ * Counts of the Message bodies compressed by a Producer or received compressed by a
+ * Consumer, the compression ratio is uncompressedBytes / compressedBytes.
+ */
+typedef struct {
+
+    /** Messages whose body was compressed. */
+    long long messages;
+
+    /** The total length of their bodies before compression. */
+    long long uncompressedBytes;
+
+    /** The total length of their bodies after compression. */
+    long long compressedBytes;
+
+} CMS_CompressionStats;
 
 /**
  * C Functions used to initialize and shutdown the ActiveMQ-C library.
@@ -132,6 +230,33 @@ void cms_initialize();
  */
 void cms_terminate();
 
+/**
+ * Gets the smallest latency that is counted in the given bucket of a CMS_LatencyHistogram,
+ * the bucket holds every value from there up to the lower bound of the next bucket.
+ *
+ * @param bucket
+ *      The index of the bucket, from 0 to CMS_LATENCY_HISTOGRAM_BUCKETS - 1.
+ *
+ * @returns the lower bound in nanoseconds or -1 if the bucket index is out of range.
+ */
+long long cms_getLatencyHistogramBucketLowerBound(int bucket);
+
+/**
+ * Estimates the latency at or below which the given percentage of the values in the
+ * histogram fall.  The estimate is the highest value of the bucket the percentile falls
+ * into, limited to the largest value recorded.
+ *
+ * @param histogram
+ *      The histogram to examine.
+ * @param percentile
+ *      The percentile to estimate, from 0 to 100.
+ * @param value
+ *      The address where the latency in nanoseconds is written, zero for an empty histogram.
+ *
+ * @return result code indicating the success or failure of the operation.
+ */
+cms_status cms_getLatencyHistogramPercentile(const CMS_LatencyHistogram* histogram, double percentile, long long* value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,673 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackBroker.h>
+#include <loopback/LoopbackConnection.h>
+#include <loopback/LoopbackConsumer.h>
+#include <loopback/LoopbackSelector.h>
+
+#include <activemq/commands/Message.h>
+#include <activemq/commands/ActiveMQQueue.h>
+#include <activemq/commands/ActiveMQTopic.h>
+#include <activemq/commands/ActiveMQTempQueue.h>
+#include <activemq/commands/ActiveMQTempTopic.h>
+
+#include <cms/Queue.h>
+#include <cms/Topic.h>
+#include <cms/TemporaryQueue.h>
+#include <cms/TemporaryTopic.h>
+#include <cms/IllegalStateException.h>
+#include <cms/InvalidClientIdException.h>
+#include <cms/InvalidDestinationException.h>
+#include <cms/ExceptionListener.h>
+
+#include <decaf/lang/System.h>
+#include <decaf/util/concurrent/Lock.h>
+
+#include <algorithm>
+#include <memory>
+
+using namespace loopback;
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    void markRedelivered(cms::Message* message) {
+
+        message->setCMSRedelivered(true);
+
+        activemq::commands::Message* command = dynamic_cast<activemq::commands::Message*>(message);
+        if (command != NULL) {
+            command->setRedeliveryCounter(command->getRedeliveryCounter() + 1);
+        }
+    }
+
+    void removeConsumer(std::vector<LoopbackConsumer*>& consumers, LoopbackConsumer* consumer) {
+        consumers.erase(std::remove(consumers.begin(), consumers.end(), consumer), consumers.end());
+    }
+
+    bool removePrefix(std::string& name, const std::string& prefix) {
+
+        if (name.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+
+        name.erase(0, prefix.size());
+        return true;
+    }
+
+    /**
+     * Creates the Destination named by a member of a composite Destination, as the ActiveMQ
+     * broker does a member without a type prefix has the type of the composite.
+     */
+    cms::Destination* createMember(std::string name, const cms::Destination* composite) {
+
+        using namespace activemq::commands;
+
+        if (removePrefix(name, "queue://")) {
+            return new ActiveMQQueue(name);
+        } else if (removePrefix(name, "topic://")) {
+            return new ActiveMQTopic(name);
+        } else if (removePrefix(name, "temp-queue://")) {
+            return new ActiveMQTempQueue(name);
+        } else if (removePrefix(name, "temp-topic://")) {
+            return new ActiveMQTempTopic(name);
+        }
+
+        switch (composite->getDestinationType()) {
+            case cms::Destination::TOPIC:
+                return new ActiveMQTopic(name);
+            case cms::Destination::TEMPORARY_QUEUE:
+                return new ActiveMQTempQueue(name);
+            case cms::Destination::TEMPORARY_TOPIC:
+                return new ActiveMQTempTopic(name);
+            default:
+                return new ActiveMQQueue(name);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackStore::LoopbackStore(const std::string& name) :
+    name(name), pending(), consumers(), nextConsumer(0), selector(NULL), noLocal(false), owner(0) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackStore::~LoopbackStore() {
+
+    std::deque<Envelope>::iterator iter = this->pending.begin();
+    for (; iter != this->pending.end(); ++iter) {
+        delete iter->message;
+    }
+
+    delete this->selector;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackStore::accepts(const Envelope& envelope) const {
+
+    if (this->noLocal && envelope.origin == this->owner) {
+        return false;
+    }
+
+    return this->selector == NULL || this->selector->matches(envelope.message);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackBroker::LoopbackBroker(const std::string& name) :
+    name(name), mutex(), queues(), topics(), durables(), stores(), clientIds(), connections(),
+    nextId(0), receiptMutex(), receiptsWithheld(false), heldReceipts() {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackBroker::~LoopbackBroker() {
+
+    std::set<LoopbackStore*>::iterator iter = this->stores.begin();
+    for (; iter != this->stores.end(); ++iter) {
+        delete *iter;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackBroker* LoopbackBroker::getInstance(const std::string& name) {
+
+    // Leaked deliberately, the brokers must survive until every Connection is gone.
+    static Mutex* registryLock = new Mutex();
+    static std::map<std::string, LoopbackBroker*>* registry = new std::map<std::string, LoopbackBroker*>();
+
+    Lock lock(registryLock);
+
+    LoopbackBroker*& broker = (*registry)[name];
+    if (broker == NULL) {
+        broker = new LoopbackBroker(name);
+    }
+
+    return broker;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string LoopbackBroker::getDestinationName(const cms::Destination* destination) {
+
+    // The temporary Destinations derive from cms::Destination, not from cms::Queue or cms::Topic.
+    switch (destination->getDestinationType()) {
+        case cms::Destination::QUEUE: {
+            const cms::Queue* queue = dynamic_cast<const cms::Queue*>(destination);
+            if (queue != NULL) {
+                return queue->getQueueName();
+            }
+            break;
+        }
+        case cms::Destination::TEMPORARY_QUEUE: {
+            const cms::TemporaryQueue* queue = dynamic_cast<const cms::TemporaryQueue*>(destination);
+            if (queue != NULL) {
+                return queue->getQueueName();
+            }
+            break;
+        }
+        case cms::Destination::TOPIC: {
+            const cms::Topic* topic = dynamic_cast<const cms::Topic*>(destination);
+            if (topic != NULL) {
+                return topic->getTopicName();
+            }
+            break;
+        }
+        case cms::Destination::TEMPORARY_TOPIC: {
+            const cms::TemporaryTopic* topic = dynamic_cast<const cms::TemporaryTopic*>(destination);
+            if (topic != NULL) {
+                return topic->getTopicName();
+            }
+            break;
+        }
+    }
+
+    throw cms::InvalidDestinationException("Unsupported destination type");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackBroker::isQueue(const cms::Destination* destination) {
+    return destination->getDestinationType() == cms::Destination::QUEUE ||
+           destination->getDestinationType() == cms::Destination::TEMPORARY_QUEUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long LoopbackBroker::generateId() {
+
+    Lock lock(&this->mutex);
+    return ++this->nextId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::addClientId(const std::string& clientId) {
+
+    Lock lock(&this->mutex);
+
+    if (!this->clientIds.insert(clientId).second) {
+        throw cms::InvalidClientIdException("Client id " + clientId + " is already in use");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::removeClientId(const std::string& clientId) {
+
+    Lock lock(&this->mutex);
+    this->clientIds.erase(clientId);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::addConnection(LoopbackConnection* connection) {
+
+    Lock lock(&this->mutex);
+    this->connections.insert(connection);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::removeConnection(LoopbackConnection* connection) {
+
+    Lock lock(&this->mutex);
+    this->connections.erase(connection);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::fail(const cms::CMSException& error) {
+
+    // Holding the broker lock keeps a Connection from being closed under the listener.
+    Lock lock(&this->mutex);
+
+    std::set<LoopbackConnection*>::const_iterator iter = this->connections.begin();
+    for (; iter != this->connections.end(); ++iter) {
+
+        cms::ExceptionListener* listener = (*iter)->getExceptionListener();
+        if (listener != NULL) {
+            listener->onException(error);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::addConsumer(LoopbackConsumer* consumer) {
+
+    Lock lock(&this->mutex);
+
+    const std::string& key = consumer->getSubscriptionKey();
+
+    if (!key.empty()) {
+
+        std::map<std::string, LoopbackStore*>::iterator iter = this->durables.find(key);
+        LoopbackStore* store = iter == this->durables.end() ? NULL : iter->second;
+
+        if (store != NULL && !store->consumers.empty()) {
+            throw cms::IllegalStateException("Durable subscription " + key + " already has an active consumer");
+        }
+
+        // Subscribing with a different topic or selector replaces the subscription.
+        if (store != NULL && (store->name != consumer->getDestinationName() ||
+                              store->selector->getText() != consumer->getMessageSelector() ||
+                              store->noLocal != consumer->isNoLocal())) {
+
+            this->stores.erase(store);
+            this->durables.erase(iter);
+            delete store;
+            store = NULL;
+        }
+
+        if (store == NULL) {
+
+            std::auto_ptr<LoopbackStore> created(new LoopbackStore(consumer->getDestinationName()));
+            created->selector = new LoopbackSelector(consumer->getMessageSelector());
+            created->noLocal = consumer->isNoLocal();
+
+            store = created.release();
+            this->durables[key] = store;
+            this->stores.insert(store);
+        }
+
+        store->owner = consumer->getConnectionId();
+        store->consumers.push_back(consumer);
+        dispatchPending(store);
+
+    } else if (consumer->isQueue()) {
+
+        LoopbackStore* store = getQueue(consumer->getDestinationName());
+        store->consumers.push_back(consumer);
+        dispatchPending(store);
+
+    } else {
+        this->topics[consumer->getDestinationName()].push_back(consumer);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::removeConsumer(LoopbackConsumer* consumer) {
+
+    Lock lock(&this->mutex);
+
+    std::vector<Envelope> unconsumed;
+    consumer->detach(unconsumed);
+
+    const std::string& key = consumer->getSubscriptionKey();
+
+    if (!key.empty()) {
+
+        std::map<std::string, LoopbackStore*>::iterator iter = this->durables.find(key);
+        if (iter != this->durables.end()) {
+            ::removeConsumer(iter->second->consumers, consumer);
+        }
+
+    } else if (consumer->isQueue()) {
+
+        std::map<std::string, LoopbackStore*>::iterator iter = this->queues.find(consumer->getDestinationName());
+        if (iter != this->queues.end()) {
+            ::removeConsumer(iter->second->consumers, consumer);
+        }
+
+    } else {
+
+        std::map<std::string, std::vector<LoopbackConsumer*> >::iterator iter =
+            this->topics.find(consumer->getDestinationName());
+
+        if (iter != this->topics.end()) {
+            ::removeConsumer(iter->second, consumer);
+            if (iter->second.empty()) {
+                this->topics.erase(iter);
+            }
+        }
+    }
+
+    restore(unconsumed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::unsubscribe(const std::string& key) {
+
+    Lock lock(&this->mutex);
+
+    std::map<std::string, LoopbackStore*>::iterator iter = this->durables.find(key);
+
+    if (iter == this->durables.end()) {
+        throw cms::InvalidDestinationException("No durable subscription exists for " + key);
+    }
+
+    if (!iter->second->consumers.empty()) {
+        throw cms::IllegalStateException("Durable subscription " + key + " has an active consumer");
+    }
+
+    this->stores.erase(iter->second);
+    delete iter->second;
+    this->durables.erase(iter);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::send(const Envelope& envelope) {
+
+    std::auto_ptr<cms::Message> message(envelope.message);
+
+    const cms::Destination* destination = message->getCMSDestination();
+    if (destination == NULL) {
+        throw cms::InvalidDestinationException("Message has no destination");
+    }
+
+    std::string name = getDestinationName(destination);
+
+    Lock lock(&this->mutex);
+
+    if (name.find(',') == std::string::npos) {
+        route(name, isQueue(destination), Envelope(message.release(), envelope.origin));
+        return;
+    }
+
+    // Each member of a composite Destination gets a copy addressed to the member itself.
+    std::string::size_type start = 0;
+
+    while (start <= name.size()) {
+
+        std::string::size_type end = name.find(',', start);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+
+        if (end > start) {
+
+            std::auto_ptr<cms::Destination> member(createMember(name.substr(start, end - start), destination));
+            std::auto_ptr<cms::Message> copy(message->clone());
+
+            copy->setCMSDestination(member.get());
+            route(getDestinationName(member.get()), isQueue(member.get()), Envelope(copy.release(), envelope.origin));
+        }
+
+        start = end + 1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::route(const std::string& name, bool queue, const Envelope& envelope) {
+
+    std::auto_ptr<cms::Message> message(envelope.message);
+
+    if (queue) {
+        dispatch(getQueue(name), Envelope(message.release(), envelope.origin));
+        return;
+    }
+
+    // Every subscriber gets its own copy, the original is discarded once routed.
+    std::map<std::string, std::vector<LoopbackConsumer*> >::iterator topic = this->topics.find(name);
+    if (topic != this->topics.end()) {
+
+        std::vector<LoopbackConsumer*>::iterator iter = topic->second.begin();
+        for (; iter != topic->second.end(); ++iter) {
+            if ((*iter)->matches(envelope)) {
+                (*iter)->enqueue(Envelope(message->clone(), envelope.origin));
+            }
+        }
+    }
+
+    std::map<std::string, LoopbackStore*>::iterator durable = this->durables.begin();
+    for (; durable != this->durables.end(); ++durable) {
+        if (durable->second->name == name && durable->second->accepts(envelope)) {
+            dispatch(durable->second, Envelope(message->clone(), envelope.origin));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::redeliver(const std::vector<Delivery>& deliveries) {
+
+    Lock lock(&this->mutex);
+
+    std::vector<LoopbackConsumer*> consumers;
+    std::map<LoopbackConsumer*, std::vector<Envelope> > grouped;
+    std::vector<Envelope> orphans;
+
+    std::vector<Delivery>::const_iterator iter = deliveries.begin();
+    for (; iter != deliveries.end(); ++iter) {
+
+        markRedelivered(iter->envelope.message);
+
+        if (iter->consumer != NULL && !iter->consumer->isClosed()) {
+
+            std::vector<Envelope>& envelopes = grouped[iter->consumer];
+            if (envelopes.empty()) {
+                consumers.push_back(iter->consumer);
+            }
+            envelopes.push_back(iter->envelope);
+
+        } else {
+            orphans.push_back(iter->envelope);
+        }
+    }
+
+    std::vector<LoopbackConsumer*>::const_iterator consumer = consumers.begin();
+    for (; consumer != consumers.end(); ++consumer) {
+        (*consumer)->requeue(grouped[*consumer]);
+    }
+
+    restore(orphans);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::browse(const std::string& queue, const LoopbackSelector* selector,
+                            std::vector<cms::Message*>& messages) {
+
+    Lock lock(&this->mutex);
+
+    std::map<std::string, LoopbackStore*>::const_iterator iter = this->queues.find(queue);
+    if (iter == this->queues.end()) {
+        return;
+    }
+
+    const LoopbackStore* store = iter->second;
+
+    std::vector<LoopbackConsumer*>::const_iterator consumer = store->consumers.begin();
+    for (; consumer != store->consumers.end(); ++consumer) {
+        (*consumer)->snapshot(messages, selector);
+    }
+
+    std::deque<Envelope>::const_iterator envelope = store->pending.begin();
+    for (; envelope != store->pending.end(); ++envelope) {
+        if (selector == NULL || selector->matches(envelope->message)) {
+            messages.push_back(envelope->message->clone());
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::destroyDestination(const std::string& name, bool queue) {
+
+    Lock lock(&this->mutex);
+
+    if (queue) {
+
+        std::map<std::string, LoopbackStore*>::iterator iter = this->queues.find(name);
+        if (iter != this->queues.end()) {
+
+            if (!iter->second->consumers.empty()) {
+                throw cms::IllegalStateException("Destination " + name + " still has active consumers");
+            }
+
+            this->stores.erase(iter->second);
+            delete iter->second;
+            this->queues.erase(iter);
+        }
+
+    } else if (this->topics.find(name) != this->topics.end()) {
+        throw cms::IllegalStateException("Destination " + name + " still has active consumers");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::setReceiptsWithheld(bool withheld) {
+
+    std::vector<cms::AsyncCallback*> released;
+
+    {
+        Lock lock(&this->receiptMutex);
+
+        this->receiptsWithheld = withheld;
+
+        if (!withheld) {
+            released.swap(this->heldReceipts);
+            this->receiptMutex.notifyAll();
+        }
+    }
+
+    for (std::size_t i = 0; i < released.size(); ++i) {
+        released[i]->onSuccess();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::receipt(cms::AsyncCallback* onComplete) {
+
+    {
+        Lock lock(&this->receiptMutex);
+
+        if (this->receiptsWithheld) {
+            this->heldReceipts.push_back(onComplete);
+            return;
+        }
+    }
+
+    onComplete->onSuccess();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackBroker::awaitReceipt(long long timeout) {
+
+    Lock lock(&this->receiptMutex);
+
+    long long deadline = System::nanoTime() + timeout * 1000000;
+
+    while (this->receiptsWithheld) {
+
+        if (timeout <= 0) {
+            this->receiptMutex.wait();
+            continue;
+        }
+
+        // The full timeout is waited out, the remaining time is rounded up.
+        long long remaining = deadline - System::nanoTime();
+        if (remaining <= 0) {
+            return false;
+        }
+
+        this->receiptMutex.wait((remaining + 999999) / 1000000);
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackStore* LoopbackBroker::getQueue(const std::string& name) {
+
+    LoopbackStore*& store = this->queues[name];
+
+    if (store == NULL) {
+        store = new LoopbackStore(name);
+        this->stores.insert(store);
+    }
+
+    return store;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::dispatch(LoopbackStore* store, Envelope envelope) {
+
+    envelope.store = store;
+
+    // Round robin over the Consumers whose selector accepts the Message.
+    std::size_t count = store->consumers.size();
+    for (std::size_t i = 0; i < count; ++i) {
+
+        std::size_t index = (store->nextConsumer + i) % count;
+        LoopbackConsumer* consumer = store->consumers[index];
+
+        if (consumer->matches(envelope)) {
+            store->nextConsumer = index + 1;
+            consumer->enqueue(envelope);
+            return;
+        }
+    }
+
+    store->pending.push_back(envelope);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::dispatchPending(LoopbackStore* store) {
+
+    if (store->consumers.empty() || store->pending.empty()) {
+        return;
+    }
+
+    std::deque<Envelope> pending;
+    pending.swap(store->pending);
+
+    std::deque<Envelope>::iterator iter = pending.begin();
+    for (; iter != pending.end(); ++iter) {
+        dispatch(store, *iter);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackBroker::restore(std::vector<Envelope>& envelopes) {
+
+    std::vector<LoopbackStore*> touched;
+
+    // Walk backwards so the Messages end up at the front in their original order.
+    std::vector<Envelope>::reverse_iterator iter = envelopes.rbegin();
+    for (; iter != envelopes.rend(); ++iter) {
+
+        if (iter->store != NULL && this->stores.find(iter->store) != this->stores.end()) {
+
+            iter->store->pending.push_front(*iter);
+
+            if (std::find(touched.begin(), touched.end(), iter->store) == touched.end()) {
+                touched.push_back(iter->store);
+            }
+
+        } else {
+            delete iter->message;
+        }
+    }
+
+    std::vector<LoopbackStore*>::iterator store = touched.begin();
+    for (; store != touched.end(); ++store) {
+        dispatchPending(*store);
+    }
+
+    envelopes.clear();
+}
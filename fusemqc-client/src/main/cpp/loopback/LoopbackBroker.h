@@ -0,0 +1,279 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKBROKER_H_
+#define _LOOPBACK_LOOPBACKBROKER_H_
+
+#include <cms/Message.h>
+#include <cms/Destination.h>
+#include <cms/AsyncCallback.h>
+#include <cms/CMSException.h>
+
+#include <decaf/util/concurrent/Mutex.h>
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <map>
+#include <set>
+
+namespace loopback {
+
+    class LoopbackConnection;
+    class LoopbackConsumer;
+    class LoopbackSelector;
+    class LoopbackStore;
+
+    /**
+     * A Message held by the broker along with the details needed to route it.
+     */
+    struct Envelope {
+
+        /** The Message, owned by whoever currently holds the Envelope. */
+        cms::Message* message;
+
+        /** Id of the Connection that sent the Message, used for noLocal Consumers. */
+        long long origin;
+
+        /** The Queue or durable subscription the Message belongs to, NULL for Topics. */
+        LoopbackStore* store;
+
+        Envelope() : message(NULL), origin(0), store(NULL) {}
+        Envelope(cms::Message* message, long long origin) : message(message), origin(origin), store(NULL) {}
+    };
+
+    /**
+     * A Message that was handed to a client and can still be redelivered.
+     */
+    struct Delivery {
+
+        long long id;
+
+        /** The Consumer that received the Message, NULL once it is closed. */
+        LoopbackConsumer* consumer;
+
+        Envelope envelope;
+
+        Delivery(long long id, LoopbackConsumer* consumer, const Envelope& envelope) :
+            id(id), consumer(consumer), envelope(envelope) {}
+    };
+
+    /**
+     * Messages waiting on a Queue or a durable subscription for a Consumer to take them.
+     */
+    class LoopbackStore {
+    public:
+
+        std::string name;
+        std::deque<Envelope> pending;
+        std::vector<LoopbackConsumer*> consumers;
+        std::size_t nextConsumer;
+
+        /** Durable subscriptions only, the subscription selector and noLocal setting. */
+        LoopbackSelector* selector;
+        bool noLocal;
+        long long owner;
+
+    private:
+
+        LoopbackStore(const LoopbackStore&);
+        LoopbackStore& operator=(const LoopbackStore&);
+
+    public:
+
+        LoopbackStore(const std::string& name);
+        ~LoopbackStore();
+
+        /**
+         * @returns true if a durable subscription accepts the given Message.
+         */
+        bool accepts(const Envelope& envelope) const;
+
+    };
+
+    /**
+     * An in-process stand in for an ActiveMQ broker used with loop:// URIs.  Queues and
+     * Topics live in memory for the life of the process, every Connection created with the
+     * same loop://name URI shares the same broker instance.  All routing happens under one
+     * broker lock, Consumers buffer the Messages dispatched to them so receive calls only
+     * contend on the Consumer itself.
+     */
+    class LoopbackBroker {
+    private:
+
+        std::string name;
+        decaf::util::concurrent::Mutex mutex;
+
+        std::map<std::string, LoopbackStore*> queues;
+        std::map<std::string, std::vector<LoopbackConsumer*> > topics;
+        std::map<std::string, LoopbackStore*> durables;
+        std::set<LoopbackStore*> stores;
+        std::set<std::string> clientIds;
+        std::set<LoopbackConnection*> connections;
+
+        long long nextId;
+
+        decaf::util::concurrent::Mutex receiptMutex;
+        bool receiptsWithheld;
+        std::vector<cms::AsyncCallback*> heldReceipts;
+
+    private:
+
+        LoopbackBroker(const std::string& name);
+        ~LoopbackBroker();
+
+        LoopbackBroker(const LoopbackBroker&);
+        LoopbackBroker& operator=(const LoopbackBroker&);
+
+    public:
+
+        /**
+         * Gets the broker with the given name, creating it on first use.  Brokers are
+         * never destroyed so that Queues outlive the Connections that use them.
+         */
+        static LoopbackBroker* getInstance(const std::string& name);
+
+        /**
+         * @returns the name of the given Queue or Topic.
+         */
+        static std::string getDestinationName(const cms::Destination* destination);
+
+        /**
+         * @returns true if the given Destination is a Queue or Temporary Queue.
+         */
+        static bool isQueue(const cms::Destination* destination);
+
+        const std::string& getName() const {
+            return this->name;
+        }
+
+        /**
+         * @returns a new id that is unique within this broker.
+         */
+        long long generateId();
+
+        /**
+         * Claims the given client id for a Connection.
+         *
+         * @throws InvalidClientIdException if the id is already in use.
+         */
+        void addClientId(const std::string& clientId);
+
+        void removeClientId(const std::string& clientId);
+
+        /**
+         * Registers an open Connection so that it hears of broker failures.
+         */
+        void addConnection(LoopbackConnection* connection);
+
+        void removeConnection(LoopbackConnection* connection);
+
+        /**
+         * Reports the given error to the ExceptionListener of every open Connection, as an
+         * ActiveMQ Connection does when its transport fails.  Meant for tests of the
+         * asynchronous error handling, the Connections themselves remain usable.
+         */
+        void fail(const cms::CMSException& error);
+
+        /**
+         * Registers a Consumer and dispatches any Messages already waiting for it.
+         */
+        void addConsumer(LoopbackConsumer* consumer);
+
+        /**
+         * Unregisters a Consumer, Messages it had buffered but not delivered are returned
+         * to their Queue or durable subscription.
+         */
+        void removeConsumer(LoopbackConsumer* consumer);
+
+        /**
+         * Removes the durable subscription with the given key.
+         *
+         * @throws InvalidDestinationException if there is no such subscription.
+         * @throws IllegalStateException if the subscription has an active Consumer.
+         */
+        void unsubscribe(const std::string& key);
+
+        /**
+         * Routes a Message to the Destination set in its CMSDestination header, ownership
+         * of the Message passes to the broker.  A composite Destination, whose name lists
+         * several Destinations separated by commas, routes a copy to each of them.
+         */
+        void send(const Envelope& envelope);
+
+        /**
+         * Returns Messages that a client received but did not acknowledge to the Consumers
+         * that received them, or to their Queue if the Consumer has been closed.  The
+         * Messages are flagged as redelivered and ownership passes to the broker.
+         */
+        void redeliver(const std::vector<Delivery>& deliveries);
+
+        /**
+         * Copies the Messages currently held for the given Queue that match the selector.
+         */
+        void browse(const std::string& queue, const LoopbackSelector* selector,
+                    std::vector<cms::Message*>& messages);
+
+        /**
+         * Discards a Temporary Destination and any Messages held for it.
+         */
+        void destroyDestination(const std::string& name, bool queue);
+
+        /**
+         * Withholds the receipts of sends while set, as an ActiveMQ broker enforcing its
+         * memory limits holds back its producer acknowledgements.  Clearing it completes
+         * every send that was waiting for its receipt.  Meant for tests of producer flow
+         * control, the receipts must be released before the Producers are closed.
+         */
+        void setReceiptsWithheld(bool withheld);
+
+        /**
+         * Completes an asynchronous send, at once or when the receipts are released.
+         */
+        void receipt(cms::AsyncCallback* onComplete);
+
+        /**
+         * Waits for the receipt of a synchronous send while receipts are withheld.
+         *
+         * @param timeout
+         *      The time in milliseconds to wait, zero or less waits until the release.
+         *
+         * @returns false if the time out elapsed before the receipts were released.
+         */
+        bool awaitReceipt(long long timeout);
+
+    private:
+
+        LoopbackStore* getQueue(const std::string& name);
+
+        /**
+         * Routes a Message to the named Queue or Topic with the broker lock held, ownership
+         * of the Message passes to the broker.
+         */
+        void route(const std::string& name, bool queue, const Envelope& envelope);
+
+        void dispatch(LoopbackStore* store, Envelope envelope);
+
+        void dispatchPending(LoopbackStore* store);
+
+        void restore(std::vector<Envelope>& envelopes);
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKBROKER_H_ */
@@ -0,0 +1,225 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackConnection.h>
+#include <loopback/LoopbackSession.h>
+
+#include <cms/CMSException.h>
+#include <cms/IllegalStateException.h>
+#include <cms/InvalidClientIdException.h>
+
+#include <decaf/util/concurrent/Lock.h>
+
+#include <algorithm>
+#include <sstream>
+
+using namespace loopback;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackConnection::LoopbackConnection(LoopbackBroker* broker, const std::string& clientId) :
+    cms::Connection(), broker(broker), id(broker->generateId()), mutex(), clientId(clientId),
+    clientIdFixed(!clientId.empty()), sessions(), temporaries(), nextTemporaryId(0), closed(false),
+    started(false), exceptionListener(NULL), transformer(NULL), metaData(), producerWindowSize(0) {
+
+    if (this->clientId.empty()) {
+        std::ostringstream generated;
+        generated << "ID:loopback-" << broker->getName() << "-" << this->id;
+        this->clientId = generated.str();
+    }
+
+    this->broker->addClientId(this->clientId);
+    this->broker->addConnection(this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackConnection::~LoopbackConnection() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::close() {
+
+    std::vector<LoopbackSession*> sessions;
+    std::vector< std::pair<std::string, bool> > temporaries;
+
+    {
+        Lock lock(&this->mutex);
+
+        if (this->closed) {
+            return;
+        }
+
+        this->closed = true;
+        sessions = this->sessions;
+        temporaries.swap(this->temporaries);
+    }
+
+    this->started.set(false);
+
+    std::vector<LoopbackSession*>::iterator session = sessions.begin();
+    for (; session != sessions.end(); ++session) {
+        (*session)->close();
+    }
+
+    std::vector< std::pair<std::string, bool> >::iterator temporary = temporaries.begin();
+    for (; temporary != temporaries.end(); ++temporary) {
+        try {
+            this->broker->destroyDestination(temporary->first, temporary->second);
+        } catch (cms::CMSException&) {
+            // Another Connection is still consuming from it, the broker keeps it.
+        }
+    }
+
+    this->broker->removeConnection(this);
+    this->broker->removeClientId(this->clientId);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::start() {
+
+    std::vector<LoopbackSession*> sessions;
+
+    {
+        Lock lock(&this->mutex);
+        checkClosed();
+
+        this->clientIdFixed = true;
+        this->started.set(true);
+        sessions = this->sessions;
+    }
+
+    std::vector<LoopbackSession*>::iterator iter = sessions.begin();
+    for (; iter != sessions.end(); ++iter) {
+        (*iter)->start();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::stop() {
+
+    Lock lock(&this->mutex);
+    checkClosed();
+
+    this->started.set(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const cms::ConnectionMetaData* LoopbackConnection::getMetaData() const {
+    checkClosed();
+    return &this->metaData;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Session* LoopbackConnection::createSession() {
+    return createSession(cms::Session::AUTO_ACKNOWLEDGE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Session* LoopbackConnection::createSession(cms::Session::AcknowledgeMode ackMode) {
+
+    Lock lock(&this->mutex);
+    checkClosed();
+
+    std::auto_ptr<LoopbackSession> session(new LoopbackSession(this, ackMode));
+
+    this->clientIdFixed = true;
+    this->sessions.push_back(session.get());
+
+    return session.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string LoopbackConnection::getClientID() const {
+
+    Lock lock(&this->mutex);
+    return this->clientId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::setClientID(const std::string& clientID) {
+
+    Lock lock(&this->mutex);
+    checkClosed();
+
+    if (this->clientIdFixed) {
+        throw cms::IllegalStateException("Client id cannot be changed once the Connection is in use");
+    }
+
+    if (clientID.empty()) {
+        throw cms::InvalidClientIdException("Client id cannot be empty");
+    }
+
+    this->broker->addClientId(clientID);
+    this->broker->removeClientId(this->clientId);
+
+    this->clientId = clientID;
+    this->clientIdFixed = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::ExceptionListener* LoopbackConnection::getExceptionListener() const {
+    return this->exceptionListener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::setExceptionListener(cms::ExceptionListener* listener) {
+    this->exceptionListener = listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::setMessageTransformer(cms::MessageTransformer* transformer) {
+    this->transformer = transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageTransformer* LoopbackConnection::getMessageTransformer() const {
+    return this->transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string LoopbackConnection::createTemporaryName(bool queue) {
+
+    Lock lock(&this->mutex);
+    checkClosed();
+
+    std::ostringstream name;
+    name << "ID:loopback-" << this->broker->getName() << "-" << this->id
+         << (queue ? ":queue:" : ":topic:") << ++this->nextTemporaryId;
+
+    this->temporaries.push_back(std::make_pair(name.str(), queue));
+
+    return name.str();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::removeSession(LoopbackSession* session) {
+
+    Lock lock(&this->mutex);
+    this->sessions.erase(std::remove(this->sessions.begin(), this->sessions.end(), session), this->sessions.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnection::checkClosed() const {
+
+    if (this->closed) {
+        throw cms::IllegalStateException("Connection is closed");
+    }
+}
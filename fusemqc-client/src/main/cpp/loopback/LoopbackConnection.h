@@ -0,0 +1,145 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKCONNECTION_H_
+#define _LOOPBACK_LOOPBACKCONNECTION_H_
+
+#include <cms/Connection.h>
+
+#include <activemq/core/ActiveMQConnectionMetaData.h>
+
+#include <decaf/util/concurrent/Mutex.h>
+#include <decaf/util/concurrent/atomic/AtomicBoolean.h>
+
+#include <loopback/LoopbackBroker.h>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace loopback {
+
+    class LoopbackSession;
+
+    /**
+     * Connection to an in-process loopback broker.
+     */
+    class LoopbackConnection : public cms::Connection {
+    private:
+
+        LoopbackBroker* broker;
+        long long id;
+
+        mutable decaf::util::concurrent::Mutex mutex;
+        std::string clientId;
+        bool clientIdFixed;
+        std::vector<LoopbackSession*> sessions;
+        std::vector< std::pair<std::string, bool> > temporaries;
+        long long nextTemporaryId;
+        bool closed;
+
+        decaf::util::concurrent::atomic::AtomicBoolean started;
+
+        cms::ExceptionListener* exceptionListener;
+        cms::MessageTransformer* transformer;
+        activemq::core::ActiveMQConnectionMetaData metaData;
+        unsigned int producerWindowSize;
+
+    private:
+
+        LoopbackConnection(const LoopbackConnection&);
+        LoopbackConnection& operator=(const LoopbackConnection&);
+
+    public:
+
+        /**
+         * Creates a Connection to the given broker.
+         *
+         * @param clientId
+         *      The client id to claim, when empty a unique id is generated.
+         *
+         * @throws InvalidClientIdException if the client id is already in use.
+         */
+        LoopbackConnection(LoopbackBroker* broker, const std::string& clientId);
+
+        virtual ~LoopbackConnection();
+
+    public:  // cms::Connection
+
+        virtual void close();
+        virtual void start();
+        virtual void stop();
+
+        virtual const cms::ConnectionMetaData* getMetaData() const;
+
+        virtual cms::Session* createSession();
+        virtual cms::Session* createSession(cms::Session::AcknowledgeMode ackMode);
+
+        virtual std::string getClientID() const;
+        virtual void setClientID(const std::string& clientID);
+
+        virtual cms::ExceptionListener* getExceptionListener() const;
+        virtual void setExceptionListener(cms::ExceptionListener* listener);
+
+        virtual void setMessageTransformer(cms::MessageTransformer* transformer);
+        virtual cms::MessageTransformer* getMessageTransformer() const;
+
+    public:
+
+        /**
+         * The producer window in bytes, as on ActiveMQConnection, zero for none.  The broker
+         * ignores it, the wrapper's non-blocking sends are the only ones that honour it.
+         */
+        unsigned int getProducerWindowSize() const {
+            return this->producerWindowSize;
+        }
+
+        void setProducerWindowSize(unsigned int windowSize) {
+            this->producerWindowSize = windowSize;
+        }
+
+    public:  // Session facing
+
+        LoopbackBroker* getBroker() const {
+            return this->broker;
+        }
+
+        long long getId() const {
+            return this->id;
+        }
+
+        bool isStarted() const {
+            return this->started.get();
+        }
+
+        /**
+         * Creates a unique name for a Temporary Destination, the Destination is destroyed
+         * when this Connection closes.
+         */
+        std::string createTemporaryName(bool queue);
+
+        void removeSession(LoopbackSession* session);
+
+    private:
+
+        void checkClosed() const;
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKCONNECTION_H_ */
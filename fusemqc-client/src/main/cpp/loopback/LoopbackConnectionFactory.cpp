@@ -0,0 +1,134 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackConnectionFactory.h>
+#include <loopback/LoopbackConnection.h>
+#include <loopback/LoopbackBroker.h>
+
+#include <Config.h>
+
+#include <memory>
+#include <sstream>
+
+using namespace loopback;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const std::string LOOPBACK_SCHEME = "loop://";
+    const std::string DEFAULT_BROKER_NAME = "localhost";
+    const std::string PRODUCER_WINDOW_OPTION = "connection.producerWindowSize";
+
+    /**
+     * Gets the value of an option from the query of a URI, empty when it isn't there.
+     */
+    std::string findOption(const std::string& query, const std::string& option) {
+
+        std::string::size_type start = 0;
+
+        while (start < query.size()) {
+
+            std::string::size_type end = query.find('&', start);
+            if (end == std::string::npos) {
+                end = query.size();
+            }
+
+            std::string pair = query.substr(start, end - start);
+            if (pair.compare(0, option.size() + 1, option + "=") == 0) {
+                return pair.substr(option.size() + 1);
+            }
+
+            start = end + 1;
+        }
+
+        return "";
+    }
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackConnectionFactory::LoopbackConnectionFactory(const std::string& uri) :
+    cms::ConnectionFactory(), brokerName(), producerWindowSize(0), exceptionListener(NULL), transformer(NULL) {
+
+    std::string name = isLoopbackURI(uri) ? uri.substr(LOOPBACK_SCHEME.length()) : "";
+    std::string::size_type query = name.find('?');
+
+    if (query != std::string::npos) {
+        std::istringstream window(findOption(name.substr(query + 1), PRODUCER_WINDOW_OPTION));
+        window >> this->producerWindowSize;
+    }
+
+    // Other options have no meaning to the loopback broker.
+    name = name.substr(0, name.find_first_of("/?"));
+
+    this->brokerName = name.empty() ? DEFAULT_BROKER_NAME : name;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackConnectionFactory::~LoopbackConnectionFactory() {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackConnectionFactory::isLoopbackURI(const std::string& uri) {
+    return uri.compare(0, LOOPBACK_SCHEME.length(), LOOPBACK_SCHEME) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Connection* LoopbackConnectionFactory::createConnection() {
+    return createConnection("", "", "");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Connection* LoopbackConnectionFactory::createConnection(const std::string& username,
+                                                             const std::string& password) {
+    return createConnection(username, password, "");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Connection* LoopbackConnectionFactory::createConnection(const std::string& username AMQC_UNUSED,
+                                                             const std::string& password AMQC_UNUSED,
+                                                             const std::string& clientId) {
+
+    std::auto_ptr<LoopbackConnection> connection(
+        new LoopbackConnection(LoopbackBroker::getInstance(this->brokerName), clientId));
+
+    connection->setExceptionListener(this->exceptionListener);
+    connection->setProducerWindowSize(this->producerWindowSize);
+    connection->setMessageTransformer(this->transformer);
+
+    return connection.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnectionFactory::setExceptionListener(cms::ExceptionListener* listener) {
+    this->exceptionListener = listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::ExceptionListener* LoopbackConnectionFactory::getExceptionListener() const {
+    return this->exceptionListener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConnectionFactory::setMessageTransformer(cms::MessageTransformer* transformer) {
+    this->transformer = transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageTransformer* LoopbackConnectionFactory::getMessageTransformer() const {
+    return this->transformer;
+}
@@ -0,0 +1,75 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKCONNECTIONFACTORY_H_
+#define _LOOPBACK_LOOPBACKCONNECTIONFACTORY_H_
+
+#include <cms/ConnectionFactory.h>
+
+#include <string>
+
+namespace loopback {
+
+    /**
+     * ConnectionFactory for the in-process loopback broker.  The broker URI takes the form
+     * loop://name where the optional name selects which in-process broker to connect to,
+     * Connections created from factories with the same name share Queues and Topics.
+     * Username and password are accepted and ignored.  Of the URI options only
+     * connection.producerWindowSize is understood, the others are ignored.
+     */
+    class LoopbackConnectionFactory : public cms::ConnectionFactory {
+    private:
+
+        std::string brokerName;
+        unsigned int producerWindowSize;
+        cms::ExceptionListener* exceptionListener;
+        cms::MessageTransformer* transformer;
+
+    private:
+
+        LoopbackConnectionFactory(const LoopbackConnectionFactory&);
+        LoopbackConnectionFactory& operator=(const LoopbackConnectionFactory&);
+
+    public:
+
+        LoopbackConnectionFactory(const std::string& uri);
+
+        virtual ~LoopbackConnectionFactory();
+
+        /**
+         * @returns true if the given broker URI selects the loopback broker.
+         */
+        static bool isLoopbackURI(const std::string& uri);
+
+    public:  // cms::ConnectionFactory
+
+        virtual cms::Connection* createConnection();
+        virtual cms::Connection* createConnection(const std::string& username, const std::string& password);
+        virtual cms::Connection* createConnection(const std::string& username, const std::string& password,
+                                                  const std::string& clientId);
+
+        virtual void setExceptionListener(cms::ExceptionListener* listener);
+        virtual cms::ExceptionListener* getExceptionListener() const;
+
+        virtual void setMessageTransformer(cms::MessageTransformer* transformer);
+        virtual cms::MessageTransformer* getMessageTransformer() const;
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKCONNECTIONFACTORY_H_ */
@@ -0,0 +1,385 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackConsumer.h>
+#include <loopback/LoopbackSession.h>
+
+#include <cms/MessageListener.h>
+#include <cms/MessageAvailableListener.h>
+#include <cms/MessageTransformer.h>
+#include <cms/IllegalStateException.h>
+
+#include <decaf/lang/System.h>
+#include <decaf/util/concurrent/Lock.h>
+
+using namespace loopback;
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackConsumer::LoopbackConsumer(LoopbackSession* session, const cms::Destination* destination,
+                                   const std::string& selector, bool noLocal, const std::string& subscriptionKey) :
+    cms::MessageConsumer(), session(session), broker(session->getBroker()),
+    destination(destination->clone()), destinationName(LoopbackBroker::getDestinationName(destination)),
+    queue(LoopbackBroker::isQueue(destination)), selector(new LoopbackSelector(selector)), noLocal(noLocal),
+    subscriptionKey(subscriptionKey), connectionId(session->getConnectionId()), mutex(), buffer(),
+    closed(false), stopped(false), listener(NULL), availableListener(NULL),
+    transformer(session->getMessageTransformer()) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackConsumer::~LoopbackConsumer() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::close() {
+
+    LoopbackSession* session = NULL;
+
+    {
+        Lock lock(&this->mutex);
+
+        if (this->session == NULL) {
+            return;
+        }
+
+        session = this->session;
+    }
+
+    this->broker->removeConsumer(this);
+    session->removeConsumer(this);
+
+    Lock lock(&this->mutex);
+    this->session = NULL;
+    this->listener = NULL;
+    this->availableListener = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::start() {
+
+    {
+        Lock lock(&this->mutex);
+        checkClosed();
+        this->stopped = false;
+    }
+
+    wakeup();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::stop() {
+
+    Lock lock(&this->mutex);
+    checkClosed();
+    this->stopped = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackConsumer::receive() {
+    return dequeue(-1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackConsumer::receive(int millisecs) {
+    return dequeue(millisecs <= 0 ? -1 : millisecs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackConsumer::receiveNoWait() {
+    return dequeue(0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::setMessageListener(cms::MessageListener* listener) {
+
+    LoopbackSession* session = NULL;
+
+    {
+        Lock lock(&this->mutex);
+        checkClosed();
+        this->listener = listener;
+        session = this->session;
+    }
+
+    if (listener != NULL) {
+        session->startDispatcher();
+        session->wakeup();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageListener* LoopbackConsumer::getMessageListener() const {
+
+    Lock lock(&this->mutex);
+    return this->listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::setMessageAvailableListener(cms::MessageAvailableListener* listener) {
+
+    Lock lock(&this->mutex);
+    this->availableListener = listener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageAvailableListener* LoopbackConsumer::getMessageAvailableListener() const {
+
+    Lock lock(&this->mutex);
+    return this->availableListener;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string LoopbackConsumer::getMessageSelector() const {
+    return this->selector->getText();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::setMessageTransformer(cms::MessageTransformer* transformer) {
+    this->transformer = transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageTransformer* LoopbackConsumer::getMessageTransformer() const {
+    return this->transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int LoopbackConsumer::getMessageAvailableCount() const {
+
+    Lock lock(&this->mutex);
+    return (int) this->buffer.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackConsumer::isClosed() const {
+
+    Lock lock(&this->mutex);
+    return this->closed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackConsumer::matches(const Envelope& envelope) const {
+
+    if (this->noLocal && !this->queue && envelope.origin == this->connectionId) {
+        return false;
+    }
+
+    return this->selector->matches(envelope.message);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::enqueue(const Envelope& envelope) {
+
+    cms::MessageAvailableListener* availableListener = NULL;
+    LoopbackSession* session = NULL;
+
+    {
+        Lock lock(&this->mutex);
+
+        this->buffer.push_back(envelope);
+        this->mutex.notifyAll();
+
+        availableListener = this->availableListener;
+        session = this->listener != NULL ? this->session : NULL;
+    }
+
+    if (availableListener != NULL) {
+        availableListener->onMessageAvailable(this);
+    }
+
+    if (session != NULL) {
+        session->wakeup();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::requeue(const std::vector<Envelope>& envelopes) {
+
+    Lock lock(&this->mutex);
+
+    this->buffer.insert(this->buffer.begin(), envelopes.begin(), envelopes.end());
+    this->mutex.notifyAll();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::detach(std::vector<Envelope>& unconsumed) {
+
+    Lock lock(&this->mutex);
+
+    this->closed = true;
+    unconsumed.insert(unconsumed.end(), this->buffer.begin(), this->buffer.end());
+    this->buffer.clear();
+    this->mutex.notifyAll();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::snapshot(std::vector<cms::Message*>& messages, const LoopbackSelector* selector) const {
+
+    Lock lock(&this->mutex);
+
+    std::deque<Envelope>::const_iterator iter = this->buffer.begin();
+    for (; iter != this->buffer.end(); ++iter) {
+        if (selector == NULL || selector->matches(iter->message)) {
+            messages.push_back(iter->message->clone());
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::wakeup() {
+
+    LoopbackSession* session = NULL;
+
+    {
+        Lock lock(&this->mutex);
+        this->mutex.notifyAll();
+        session = this->listener != NULL ? this->session : NULL;
+    }
+
+    if (session != NULL) {
+        session->wakeup();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackConsumer::dispatch() {
+
+    Envelope envelope;
+    cms::MessageListener* listener = NULL;
+    LoopbackSession* session = NULL;
+
+    {
+        Lock lock(&this->mutex);
+
+        if (this->closed || this->listener == NULL || this->stopped || !this->session->isStarted()) {
+            return false;
+        }
+
+        if (!takeNext(envelope)) {
+            return false;
+        }
+
+        listener = this->listener;
+        session = this->session;
+    }
+
+    std::auto_ptr<cms::Message> message(transform(session->deliver(this, envelope)));
+    listener->onMessage(message.get());
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackConsumer::dequeue(int timeout) {
+
+    Envelope envelope;
+    LoopbackSession* session = NULL;
+
+    {
+        Lock lock(&this->mutex);
+
+        checkClosed();
+
+        if (this->listener != NULL) {
+            throw cms::IllegalStateException("Cannot receive synchronously while a MessageListener is set");
+        }
+
+        long long deadline = timeout > 0 ? System::currentTimeMillis() + timeout : 0;
+
+        while (true) {
+
+            if (this->closed) {
+                return NULL;
+            }
+
+            if (!this->stopped && this->session->isStarted() && takeNext(envelope)) {
+                break;
+            }
+
+            if (timeout == 0) {
+                return NULL;
+            } else if (timeout < 0) {
+                this->mutex.wait();
+            } else {
+
+                long long remaining = deadline - System::currentTimeMillis();
+                if (remaining <= 0) {
+                    return NULL;
+                }
+
+                this->mutex.wait(remaining);
+            }
+        }
+
+        session = this->session;
+    }
+
+    return transform(session->deliver(this, envelope));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackConsumer::takeNext(Envelope& envelope) {
+
+    long long now = System::currentTimeMillis();
+
+    while (!this->buffer.empty()) {
+
+        envelope = this->buffer.front();
+        this->buffer.pop_front();
+
+        long long expiration = envelope.message->getCMSExpiration();
+        if (expiration == 0 || expiration > now) {
+            return true;
+        }
+
+        delete envelope.message;
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackConsumer::transform(cms::Message* message) {
+
+    if (this->transformer == NULL) {
+        return message;
+    }
+
+    cms::Message* transformed = NULL;
+
+    if (this->transformer->consumerTransform(this->session, this, message, &transformed) &&
+        transformed != NULL && transformed != message) {
+
+        delete message;
+        return transformed;
+    }
+
+    return message;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackConsumer::checkClosed() const {
+
+    if (this->closed) {
+        throw cms::IllegalStateException("Consumer is closed");
+    }
+}
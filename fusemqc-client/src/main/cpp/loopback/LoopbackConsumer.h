@@ -0,0 +1,188 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKCONSUMER_H_
+#define _LOOPBACK_LOOPBACKCONSUMER_H_
+
+#include <cms/MessageConsumer.h>
+#include <cms/Destination.h>
+
+#include <decaf/util/concurrent/Mutex.h>
+
+#include <loopback/LoopbackBroker.h>
+#include <loopback/LoopbackSelector.h>
+
+#include <memory>
+#include <deque>
+#include <vector>
+
+namespace loopback {
+
+    class LoopbackSession;
+
+    /**
+     * MessageConsumer of the loopback broker.  The broker pushes every Message that matches
+     * the Consumer into its buffer, there is no prefetch limit.
+     */
+    class LoopbackConsumer : public cms::MessageConsumer {
+    private:
+
+        LoopbackSession* session;
+        LoopbackBroker* broker;
+
+        std::auto_ptr<cms::Destination> destination;
+        std::string destinationName;
+        bool queue;
+        std::auto_ptr<LoopbackSelector> selector;
+        bool noLocal;
+        std::string subscriptionKey;
+        long long connectionId;
+
+        mutable decaf::util::concurrent::Mutex mutex;
+        std::deque<Envelope> buffer;
+        bool closed;
+        bool stopped;
+
+        cms::MessageListener* listener;
+        cms::MessageAvailableListener* availableListener;
+        cms::MessageTransformer* transformer;
+
+    private:
+
+        LoopbackConsumer(const LoopbackConsumer&);
+        LoopbackConsumer& operator=(const LoopbackConsumer&);
+
+    public:
+
+        /**
+         * Creates a Consumer, the Session registers it with the broker once constructed.
+         *
+         * @param subscriptionKey
+         *      The key of the durable subscription, empty for non-durable Consumers.
+         *
+         * @throws InvalidSelectorException if the selector can't be parsed.
+         */
+        LoopbackConsumer(LoopbackSession* session, const cms::Destination* destination,
+                         const std::string& selector, bool noLocal, const std::string& subscriptionKey);
+
+        virtual ~LoopbackConsumer();
+
+    public:  // cms::MessageConsumer
+
+        virtual void close();
+        virtual void start();
+        virtual void stop();
+
+        virtual cms::Message* receive();
+        virtual cms::Message* receive(int millisecs);
+        virtual cms::Message* receiveNoWait();
+
+        virtual void setMessageListener(cms::MessageListener* listener);
+        virtual cms::MessageListener* getMessageListener() const;
+
+        virtual void setMessageAvailableListener(cms::MessageAvailableListener* listener);
+        virtual cms::MessageAvailableListener* getMessageAvailableListener() const;
+
+        virtual std::string getMessageSelector() const;
+
+        virtual void setMessageTransformer(cms::MessageTransformer* transformer);
+        virtual cms::MessageTransformer* getMessageTransformer() const;
+
+    public:
+
+        /**
+         * @returns the number of Messages waiting in the buffer, as the method of the same
+         *          name on ActiveMQConsumer does.
+         */
+        int getMessageAvailableCount() const;
+
+    public:  // Broker and Session facing, the broker calls these with its lock held.
+
+        const std::string& getDestinationName() const {
+            return this->destinationName;
+        }
+
+        bool isQueue() const {
+            return this->queue;
+        }
+
+        bool isNoLocal() const {
+            return this->noLocal;
+        }
+
+        const std::string& getSubscriptionKey() const {
+            return this->subscriptionKey;
+        }
+
+        long long getConnectionId() const {
+            return this->connectionId;
+        }
+
+        bool isClosed() const;
+
+        /**
+         * @returns true if the given Message should be dispatched to this Consumer.
+         */
+        bool matches(const Envelope& envelope) const;
+
+        /**
+         * Adds a Message to the end of the buffer.
+         */
+        void enqueue(const Envelope& envelope);
+
+        /**
+         * Puts redelivered Messages back at the front of the buffer in their original order.
+         */
+        void requeue(const std::vector<Envelope>& envelopes);
+
+        /**
+         * Marks the Consumer closed and hands back the Messages it had not yet delivered.
+         */
+        void detach(std::vector<Envelope>& unconsumed);
+
+        /**
+         * Copies the buffered Messages that match the given selector.
+         */
+        void snapshot(std::vector<cms::Message*>& messages, const LoopbackSelector* selector) const;
+
+        /**
+         * Wakes any thread blocked in receive, called when the Connection starts.
+         */
+        void wakeup();
+
+        /**
+         * Delivers the next buffered Message to the MessageListener.
+         *
+         * @returns true if a Message was delivered.
+         */
+        bool dispatch();
+
+    private:
+
+        cms::Message* dequeue(int timeout);
+
+        bool takeNext(Envelope& envelope);
+
+        cms::Message* transform(cms::Message* message);
+
+        void checkClosed() const;
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKCONSUMER_H_ */
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackProducer.h>
+#include <loopback/LoopbackSession.h>
+
+#include <cms/Message.h>
+#include <cms/AsyncCallback.h>
+#include <cms/MessageTransformer.h>
+#include <cms/IllegalStateException.h>
+#include <cms/InvalidDestinationException.h>
+#include <cms/UnsupportedOperationException.h>
+
+#include <decaf/lang/System.h>
+
+#include <sstream>
+
+using namespace loopback;
+using namespace decaf::lang;
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackProducer::LoopbackProducer(LoopbackSession* session, const cms::Destination* destination) :
+    cms::MessageProducer(), session(session), destination(destination != NULL ? destination->clone() : NULL),
+    id(session->getBroker()->generateId()), sequence(0), connectionId(session->getConnectionId()), closed(false),
+    deliveryMode(cms::Message::DEFAULT_DELIVERY_MODE), priority(cms::Message::DEFAULT_MSG_PRIORITY),
+    timeToLive(cms::Message::DEFAULT_TIME_TO_LIVE), disableMessageId(false), disableTimeStamp(false),
+    sendTimeout(0), transformer(session->getMessageTransformer()) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackProducer::~LoopbackProducer() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::close() {
+
+    if (this->closed) {
+        return;
+    }
+
+    this->closed = true;
+    this->session->removeProducer(this);
+    this->session = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(cms::Message* message) {
+    send(message, this->deliveryMode, this->priority, this->timeToLive, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(cms::Message* message, cms::AsyncCallback* onComplete) {
+    send(message, this->deliveryMode, this->priority, this->timeToLive, onComplete);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(cms::Message* message, int deliveryMode, int priority, long long timeToLive) {
+    send(message, deliveryMode, priority, timeToLive, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(cms::Message* message, int deliveryMode, int priority, long long timeToLive,
+                            cms::AsyncCallback* onComplete) {
+
+    checkClosed();
+
+    if (this->destination.get() == NULL) {
+        throw cms::UnsupportedOperationException("A destination must be specified.");
+    }
+
+    doSend(this->destination.get(), message, deliveryMode, priority, timeToLive, onComplete);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(const cms::Destination* destination, cms::Message* message) {
+    send(destination, message, this->deliveryMode, this->priority, this->timeToLive, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(const cms::Destination* destination, cms::Message* message,
+                            cms::AsyncCallback* onComplete) {
+    send(destination, message, this->deliveryMode, this->priority, this->timeToLive, onComplete);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(const cms::Destination* destination, cms::Message* message,
+                            int deliveryMode, int priority, long long timeToLive) {
+    send(destination, message, deliveryMode, priority, timeToLive, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::send(const cms::Destination* destination, cms::Message* message,
+                            int deliveryMode, int priority, long long timeToLive, cms::AsyncCallback* onComplete) {
+
+    checkClosed();
+    doSend(checkDestination(destination), message, deliveryMode, priority, timeToLive, onComplete);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::setDeliveryMode(int mode) {
+    this->deliveryMode = mode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int LoopbackProducer::getDeliveryMode() const {
+    return this->deliveryMode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::setDisableMessageID(bool value) {
+    this->disableMessageId = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackProducer::getDisableMessageID() const {
+    return this->disableMessageId;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::setDisableMessageTimeStamp(bool value) {
+    this->disableTimeStamp = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackProducer::getDisableMessageTimeStamp() const {
+    return this->disableTimeStamp;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::setPriority(int priority) {
+    this->priority = priority;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int LoopbackProducer::getPriority() const {
+    return this->priority;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::setTimeToLive(long long time) {
+    this->timeToLive = time;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long LoopbackProducer::getTimeToLive() const {
+    return this->timeToLive;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::setMessageTransformer(cms::MessageTransformer* transformer) {
+    this->transformer = transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageTransformer* LoopbackProducer::getMessageTransformer() const {
+    return this->transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::detach() {
+    this->closed = true;
+    this->session = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::doSend(const cms::Destination* destination, cms::Message* message,
+                              int deliveryMode, int priority, long long timeToLive, cms::AsyncCallback* onComplete) {
+
+    if (message == NULL) {
+        throw cms::IllegalStateException("Message cannot be NULL");
+    }
+
+    // As with the ActiveMQ producer the headers are set on the caller's Message.
+    long long now = System::currentTimeMillis();
+
+    message->setCMSDestination(destination);
+    message->setCMSDeliveryMode(deliveryMode);
+    message->setCMSPriority(priority);
+    message->setCMSRedelivered(false);
+    message->setCMSTimestamp(this->disableTimeStamp ? 0 : now);
+    message->setCMSExpiration(timeToLive > 0 ? now + timeToLive : 0);
+
+    ++this->sequence;
+
+    if (!this->disableMessageId) {
+        std::ostringstream messageId;
+        messageId << "ID:loopback-" << this->connectionId << ":" << this->session->getId() << ":"
+                  << this->id << ":" << this->sequence;
+        message->setCMSMessageID(messageId.str());
+    }
+
+    cms::Message* outbound = message;
+    std::auto_ptr<cms::Message> transformed;
+
+    if (this->transformer != NULL) {
+
+        cms::Message* result = NULL;
+
+        if (this->transformer->producerTransform(this->session, this, message, &result) &&
+            result != NULL && result != message) {
+
+            transformed.reset(result);
+            outbound = result;
+        }
+    }
+
+    this->session->send(Envelope(outbound->clone(), this->connectionId));
+
+    if (onComplete != NULL) {
+        this->session->getBroker()->receipt(onComplete);
+    } else if (!this->session->getBroker()->awaitReceipt(this->sendTimeout)) {
+        throw cms::CMSException("The broker's receipt for the send did not arrive in time");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const cms::Destination* LoopbackProducer::checkDestination(const cms::Destination* destination) const {
+
+    if (destination == NULL) {
+        throw cms::InvalidDestinationException("Destination cannot be NULL");
+    }
+
+    if (this->destination.get() != NULL && !this->destination->equals(*destination)) {
+        throw cms::UnsupportedOperationException("This producer can only send to its own destination");
+    }
+
+    return destination;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackProducer::checkClosed() const {
+
+    if (this->closed) {
+        throw cms::IllegalStateException("Producer is closed");
+    }
+}
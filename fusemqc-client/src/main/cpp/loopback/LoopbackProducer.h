@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKPRODUCER_H_
+#define _LOOPBACK_LOOPBACKPRODUCER_H_
+
+#include <cms/MessageProducer.h>
+#include <cms/Destination.h>
+
+#include <memory>
+
+namespace loopback {
+
+    class LoopbackSession;
+
+    /**
+     * MessageProducer of the loopback broker.  Sends complete synchronously, an async send
+     * invokes its callback before returning unless the broker is withholding receipts.  A
+     * synchronous send waits for withheld receipts up to the send timeout, it then fails as
+     * the ActiveMQ producer does when its broker doesn't answer in time.
+     */
+    class LoopbackProducer : public cms::MessageProducer {
+    private:
+
+        LoopbackSession* session;
+        std::auto_ptr<cms::Destination> destination;
+        long long id;
+        long long sequence;
+        long long connectionId;
+        bool closed;
+
+        int deliveryMode;
+        int priority;
+        long long timeToLive;
+        bool disableMessageId;
+        bool disableTimeStamp;
+        long long sendTimeout;
+        cms::MessageTransformer* transformer;
+
+    private:
+
+        LoopbackProducer(const LoopbackProducer&);
+        LoopbackProducer& operator=(const LoopbackProducer&);
+
+    public:
+
+        LoopbackProducer(LoopbackSession* session, const cms::Destination* destination);
+
+        virtual ~LoopbackProducer();
+
+    public:  // cms::MessageProducer
+
+        virtual void close();
+
+        virtual void send(cms::Message* message);
+        virtual void send(cms::Message* message, cms::AsyncCallback* onComplete);
+        virtual void send(cms::Message* message, int deliveryMode, int priority, long long timeToLive);
+        virtual void send(cms::Message* message, int deliveryMode, int priority, long long timeToLive,
+                          cms::AsyncCallback* onComplete);
+        virtual void send(const cms::Destination* destination, cms::Message* message);
+        virtual void send(const cms::Destination* destination, cms::Message* message, cms::AsyncCallback* onComplete);
+        virtual void send(const cms::Destination* destination, cms::Message* message,
+                          int deliveryMode, int priority, long long timeToLive);
+        virtual void send(const cms::Destination* destination, cms::Message* message,
+                          int deliveryMode, int priority, long long timeToLive, cms::AsyncCallback* onComplete);
+
+        virtual void setDeliveryMode(int mode);
+        virtual int getDeliveryMode() const;
+
+        virtual void setDisableMessageID(bool value);
+        virtual bool getDisableMessageID() const;
+
+        virtual void setDisableMessageTimeStamp(bool value);
+        virtual bool getDisableMessageTimeStamp() const;
+
+        virtual void setPriority(int priority);
+        virtual int getPriority() const;
+
+        virtual void setTimeToLive(long long time);
+        virtual long long getTimeToLive() const;
+
+        virtual void setMessageTransformer(cms::MessageTransformer* transformer);
+        virtual cms::MessageTransformer* getMessageTransformer() const;
+
+    public:
+
+        /**
+         * The time in milliseconds a synchronous send waits for its receipt, as on
+         * ActiveMQProducer, zero waits forever.
+         */
+        long long getSendTimeout() const {
+            return this->sendTimeout;
+        }
+
+        void setSendTimeout(long long time) {
+            this->sendTimeout = time;
+        }
+
+    public:  // Session facing
+
+        /**
+         * Marks the Producer closed, called by the Session as it closes.
+         */
+        void detach();
+
+    private:
+
+        void doSend(const cms::Destination* destination, cms::Message* message,
+                    int deliveryMode, int priority, long long timeToLive, cms::AsyncCallback* onComplete);
+
+        const cms::Destination* checkDestination(const cms::Destination* destination) const;
+
+        void checkClosed() const;
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKPRODUCER_H_ */
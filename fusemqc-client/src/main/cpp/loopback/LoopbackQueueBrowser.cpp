@@ -0,0 +1,106 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackQueueBrowser.h>
+
+#include <cms/Queue.h>
+#include <cms/IllegalStateException.h>
+
+#include <vector>
+
+using namespace loopback;
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackQueueBrowser::LoopbackQueueBrowser(LoopbackBroker* broker, const cms::Queue* queue,
+                                           const std::string& selector) :
+    cms::QueueBrowser(), cms::MessageEnumeration(), broker(broker),
+    queue(dynamic_cast<cms::Queue*>(queue->clone())), selector(new LoopbackSelector(selector)),
+    messages(), closed(false) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackQueueBrowser::~LoopbackQueueBrowser() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackQueueBrowser::close() {
+    this->closed = true;
+    clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+const cms::Queue* LoopbackQueueBrowser::getQueue() const {
+    return this->queue.get();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string LoopbackQueueBrowser::getMessageSelector() const {
+    return this->selector->getText();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageEnumeration* LoopbackQueueBrowser::getEnumeration() {
+
+    if (this->closed) {
+        throw cms::IllegalStateException("QueueBrowser is closed");
+    }
+
+    clear();
+
+    std::vector<cms::Message*> snapshot;
+    this->broker->browse(this->queue->getQueueName(), this->selector.get(), snapshot);
+    this->messages.assign(snapshot.begin(), snapshot.end());
+
+    return this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackQueueBrowser::hasMoreMessages() {
+    return !this->closed && !this->messages.empty();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackQueueBrowser::nextMessage() {
+
+    if (this->closed) {
+        throw cms::IllegalStateException("QueueBrowser is closed");
+    }
+
+    if (this->messages.empty()) {
+        return NULL;
+    }
+
+    cms::Message* message = this->messages.front();
+    this->messages.pop_front();
+
+    return message;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackQueueBrowser::clear() {
+
+    std::deque<cms::Message*>::iterator iter = this->messages.begin();
+    for (; iter != this->messages.end(); ++iter) {
+        delete *iter;
+    }
+
+    this->messages.clear();
+}
@@ -0,0 +1,84 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKQUEUEBROWSER_H_
+#define _LOOPBACK_LOOPBACKQUEUEBROWSER_H_
+
+#include <cms/QueueBrowser.h>
+#include <cms/MessageEnumeration.h>
+
+#include <loopback/LoopbackBroker.h>
+#include <loopback/LoopbackSelector.h>
+
+#include <memory>
+#include <deque>
+
+namespace loopback {
+
+    /**
+     * QueueBrowser of the loopback broker, each enumeration walks a snapshot of the Queue
+     * taken when getEnumeration is called.  As with the ActiveMQ browser the enumeration
+     * is owned by the browser.
+     */
+    class LoopbackQueueBrowser : public cms::QueueBrowser, public cms::MessageEnumeration {
+    private:
+
+        LoopbackBroker* broker;
+        std::auto_ptr<cms::Queue> queue;
+        std::auto_ptr<LoopbackSelector> selector;
+        std::deque<cms::Message*> messages;
+        bool closed;
+
+    private:
+
+        LoopbackQueueBrowser(const LoopbackQueueBrowser&);
+        LoopbackQueueBrowser& operator=(const LoopbackQueueBrowser&);
+
+    public:
+
+        /**
+         * @throws InvalidSelectorException if the selector can't be parsed.
+         */
+        LoopbackQueueBrowser(LoopbackBroker* broker, const cms::Queue* queue, const std::string& selector);
+
+        virtual ~LoopbackQueueBrowser();
+
+    public:  // cms::QueueBrowser
+
+        virtual void close();
+
+        virtual const cms::Queue* getQueue() const;
+
+        virtual std::string getMessageSelector() const;
+
+        virtual cms::MessageEnumeration* getEnumeration();
+
+    public:  // cms::MessageEnumeration
+
+        virtual bool hasMoreMessages();
+
+        virtual cms::Message* nextMessage();
+
+    private:
+
+        void clear();
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKQUEUEBROWSER_H_ */
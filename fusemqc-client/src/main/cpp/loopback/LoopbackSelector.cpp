@@ -0,0 +1,775 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackSelector.h>
+
+#include <Config.h>
+
+#include <cms/DeliveryMode.h>
+#include <cms/InvalidSelectorException.h>
+
+#include <memory>
+#include <vector>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+using namespace loopback;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace loopback {
+
+    /**
+     * The result of evaluating part of a selector, selectors use three valued logic so
+     * a missing property evaluates to UNKNOWN rather than false.
+     */
+    struct SelectorValue {
+
+        enum Type { UNKNOWN, BOOLEAN, NUMBER, STRING };
+
+        Type type;
+        bool boolean;
+        double number;
+        std::string string;
+
+        SelectorValue() : type(UNKNOWN), boolean(false), number(0), string() {}
+
+        static SelectorValue fromBoolean(bool value) {
+            SelectorValue result;
+            result.type = BOOLEAN;
+            result.boolean = value;
+            return result;
+        }
+
+        static SelectorValue fromNumber(double value) {
+            SelectorValue result;
+            result.type = NUMBER;
+            result.number = value;
+            return result;
+        }
+
+        static SelectorValue fromString(const std::string& value) {
+            SelectorValue result;
+            result.type = STRING;
+            result.string = value;
+            return result;
+        }
+
+        bool isTrue() const {
+            return this->type == BOOLEAN && this->boolean;
+        }
+
+        bool isFalse() const {
+            return this->type == BOOLEAN && !this->boolean;
+        }
+    };
+
+    class SelectorExpression {
+    public:
+
+        virtual ~SelectorExpression() {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const = 0;
+
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    typedef std::auto_ptr<SelectorExpression> ExpressionPtr;
+
+    class LiteralExpression : public SelectorExpression {
+    private:
+
+        SelectorValue value;
+
+    public:
+
+        LiteralExpression(const SelectorValue& value) : SelectorExpression(), value(value) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message AMQC_UNUSED) const {
+            return this->value;
+        }
+    };
+
+    class IdentifierExpression : public SelectorExpression {
+    private:
+
+        std::string name;
+
+    public:
+
+        IdentifierExpression(const std::string& name) : SelectorExpression(), name(name) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            if (this->name == "JMSDeliveryMode") {
+                return SelectorValue::fromString(
+                    message->getCMSDeliveryMode() == cms::DeliveryMode::PERSISTENT ? "PERSISTENT" : "NON_PERSISTENT");
+            } else if (this->name == "JMSPriority") {
+                return SelectorValue::fromNumber((double) message->getCMSPriority());
+            } else if (this->name == "JMSTimestamp") {
+                return SelectorValue::fromNumber((double) message->getCMSTimestamp());
+            } else if (this->name == "JMSMessageID") {
+                return optionalString(message->getCMSMessageID());
+            } else if (this->name == "JMSCorrelationID") {
+                return optionalString(message->getCMSCorrelationID());
+            } else if (this->name == "JMSType") {
+                return optionalString(message->getCMSType());
+            }
+
+            if (!message->propertyExists(this->name)) {
+                return SelectorValue();
+            }
+
+            switch (message->getPropertyValueType(this->name)) {
+                case cms::Message::BOOLEAN_TYPE:
+                    return SelectorValue::fromBoolean(message->getBooleanProperty(this->name));
+                case cms::Message::BYTE_TYPE:
+                case cms::Message::SHORT_TYPE:
+                case cms::Message::INTEGER_TYPE:
+                case cms::Message::LONG_TYPE:
+                    return SelectorValue::fromNumber((double) message->getLongProperty(this->name));
+                case cms::Message::FLOAT_TYPE:
+                case cms::Message::DOUBLE_TYPE:
+                    return SelectorValue::fromNumber(message->getDoubleProperty(this->name));
+                case cms::Message::CHAR_TYPE:
+                case cms::Message::STRING_TYPE:
+                    return SelectorValue::fromString(message->getStringProperty(this->name));
+                default:
+                    return SelectorValue();
+            }
+        }
+
+    private:
+
+        static SelectorValue optionalString(const std::string& value) {
+            return value.empty() ? SelectorValue() : SelectorValue::fromString(value);
+        }
+    };
+
+    class NotExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr operand;
+
+    public:
+
+        NotExpression(ExpressionPtr operand) : SelectorExpression(), operand(operand) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            SelectorValue value = this->operand->evaluate(message);
+            if (value.type != SelectorValue::BOOLEAN) {
+                return SelectorValue();
+            }
+
+            return SelectorValue::fromBoolean(!value.boolean);
+        }
+    };
+
+    class LogicalExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr left;
+        ExpressionPtr right;
+        bool conjunction;
+
+    public:
+
+        LogicalExpression(ExpressionPtr left, ExpressionPtr right, bool conjunction) :
+            SelectorExpression(), left(left), right(right), conjunction(conjunction) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            SelectorValue lhs = this->left->evaluate(message);
+
+            if (this->conjunction) {
+
+                if (lhs.isFalse()) {
+                    return lhs;
+                }
+
+                SelectorValue rhs = this->right->evaluate(message);
+                if (rhs.isFalse()) {
+                    return rhs;
+                }
+
+                return lhs.isTrue() && rhs.isTrue() ? SelectorValue::fromBoolean(true) : SelectorValue();
+            }
+
+            if (lhs.isTrue()) {
+                return lhs;
+            }
+
+            SelectorValue rhs = this->right->evaluate(message);
+            if (rhs.isTrue()) {
+                return rhs;
+            }
+
+            return lhs.isFalse() && rhs.isFalse() ? SelectorValue::fromBoolean(false) : SelectorValue();
+        }
+    };
+
+    class ComparisonExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr left;
+        ExpressionPtr right;
+        std::string op;
+
+    public:
+
+        ComparisonExpression(ExpressionPtr left, ExpressionPtr right, const std::string& op) :
+            SelectorExpression(), left(left), right(right), op(op) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            SelectorValue lhs = this->left->evaluate(message);
+            SelectorValue rhs = this->right->evaluate(message);
+
+            if (lhs.type == SelectorValue::UNKNOWN || rhs.type == SelectorValue::UNKNOWN || lhs.type != rhs.type) {
+                return SelectorValue();
+            }
+
+            int order = 0;
+            bool ordered = false;
+
+            if (lhs.type == SelectorValue::NUMBER) {
+                order = lhs.number < rhs.number ? -1 : (lhs.number > rhs.number ? 1 : 0);
+                ordered = true;
+            } else if (lhs.type == SelectorValue::STRING) {
+                order = lhs.string.compare(rhs.string);
+            } else {
+                order = lhs.boolean == rhs.boolean ? 0 : 1;
+            }
+
+            if (this->op == "=") {
+                return SelectorValue::fromBoolean(order == 0);
+            } else if (this->op == "<>") {
+                return SelectorValue::fromBoolean(order != 0);
+            } else if (!ordered) {
+                // Strings and booleans only support equality.
+                return SelectorValue();
+            } else if (this->op == "<") {
+                return SelectorValue::fromBoolean(order < 0);
+            } else if (this->op == "<=") {
+                return SelectorValue::fromBoolean(order <= 0);
+            } else if (this->op == ">") {
+                return SelectorValue::fromBoolean(order > 0);
+            }
+
+            return SelectorValue::fromBoolean(order >= 0);
+        }
+    };
+
+    class IsNullExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr operand;
+        bool negated;
+
+    public:
+
+        IsNullExpression(ExpressionPtr operand, bool negated) :
+            SelectorExpression(), operand(operand), negated(negated) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+            bool isNull = this->operand->evaluate(message).type == SelectorValue::UNKNOWN;
+            return SelectorValue::fromBoolean(isNull != this->negated);
+        }
+    };
+
+    class InExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr operand;
+        std::vector<std::string> values;
+        bool negated;
+
+    public:
+
+        InExpression(ExpressionPtr operand, const std::vector<std::string>& values, bool negated) :
+            SelectorExpression(), operand(operand), values(values), negated(negated) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            SelectorValue value = this->operand->evaluate(message);
+            if (value.type != SelectorValue::STRING) {
+                return SelectorValue();
+            }
+
+            bool found = false;
+            for (std::size_t i = 0; i < this->values.size() && !found; ++i) {
+                found = this->values[i] == value.string;
+            }
+
+            return SelectorValue::fromBoolean(found != this->negated);
+        }
+    };
+
+    class LikeExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr operand;
+        std::string pattern;
+        int escape;
+        bool negated;
+
+    public:
+
+        LikeExpression(ExpressionPtr operand, const std::string& pattern, int escape, bool negated) :
+            SelectorExpression(), operand(operand), pattern(pattern), escape(escape), negated(negated) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            SelectorValue value = this->operand->evaluate(message);
+            if (value.type != SelectorValue::STRING) {
+                return SelectorValue();
+            }
+
+            return SelectorValue::fromBoolean(matches(value.string, 0, 0) != this->negated);
+        }
+
+    private:
+
+        bool matches(const std::string& value, std::size_t vpos, std::size_t ppos) const {
+
+            while (ppos < this->pattern.size()) {
+
+                char current = this->pattern[ppos];
+
+                if (this->escape >= 0 && current == (char) this->escape && ppos + 1 < this->pattern.size()) {
+                    if (vpos >= value.size() || value[vpos] != this->pattern[ppos + 1]) {
+                        return false;
+                    }
+                    vpos++;
+                    ppos += 2;
+                } else if (current == '%') {
+                    for (std::size_t i = vpos; i <= value.size(); ++i) {
+                        if (matches(value, i, ppos + 1)) {
+                            return true;
+                        }
+                    }
+                    return false;
+                } else {
+                    if (vpos >= value.size() || (current != '_' && value[vpos] != current)) {
+                        return false;
+                    }
+                    vpos++;
+                    ppos++;
+                }
+            }
+
+            return vpos == value.size();
+        }
+    };
+
+    class BetweenExpression : public SelectorExpression {
+    private:
+
+        ExpressionPtr operand;
+        ExpressionPtr low;
+        ExpressionPtr high;
+        bool negated;
+
+    public:
+
+        BetweenExpression(ExpressionPtr operand, ExpressionPtr low, ExpressionPtr high, bool negated) :
+            SelectorExpression(), operand(operand), low(low), high(high), negated(negated) {}
+
+        virtual SelectorValue evaluate(const cms::Message* message) const {
+
+            SelectorValue value = this->operand->evaluate(message);
+            SelectorValue lower = this->low->evaluate(message);
+            SelectorValue upper = this->high->evaluate(message);
+
+            if (value.type != SelectorValue::NUMBER ||
+                lower.type != SelectorValue::NUMBER || upper.type != SelectorValue::NUMBER) {
+                return SelectorValue();
+            }
+
+            bool inRange = value.number >= lower.number && value.number <= upper.number;
+            return SelectorValue::fromBoolean(inRange != this->negated);
+        }
+    };
+
+    struct Token {
+
+        enum Kind { END, IDENTIFIER, STRING, NUMBER, OPERATOR };
+
+        Kind kind;
+        std::string text;
+        double number;
+
+        Token() : kind(END), text(), number(0) {}
+    };
+
+    /**
+     * Recursive descent parser over the tokenized selector, precedence from lowest to
+     * highest is OR, AND, NOT and then the comparison operators.
+     */
+    class SelectorParser {
+    private:
+
+        const std::string& text;
+        std::vector<Token> tokens;
+        std::size_t position;
+
+    public:
+
+        SelectorParser(const std::string& text) : text(text), tokens(), position(0) {
+            tokenize();
+        }
+
+        SelectorExpression* parse() {
+
+            ExpressionPtr result = parseOr();
+
+            if (peek().kind != Token::END) {
+                fail("unexpected token '" + peek().text + "'");
+            }
+
+            return result.release();
+        }
+
+    private:
+
+        void fail(const std::string& reason) const {
+            throw cms::InvalidSelectorException("Invalid selector [" + this->text + "]: " + reason);
+        }
+
+        const Token& peek() const {
+            return this->tokens[this->position];
+        }
+
+        Token next() {
+            Token token = this->tokens[this->position];
+            if (token.kind != Token::END) {
+                this->position++;
+            }
+            return token;
+        }
+
+        static bool equalsIgnoreCase(const std::string& left, const char* right) {
+
+            std::size_t i = 0;
+            for (; i < left.size() && right[i] != '\0'; ++i) {
+                if (std::toupper((unsigned char) left[i]) != std::toupper((unsigned char) right[i])) {
+                    return false;
+                }
+            }
+
+            return i == left.size() && right[i] == '\0';
+        }
+
+        bool isKeyword(const char* keyword) const {
+            return peek().kind == Token::IDENTIFIER && equalsIgnoreCase(peek().text, keyword);
+        }
+
+        bool acceptKeyword(const char* keyword) {
+            if (isKeyword(keyword)) {
+                this->position++;
+                return true;
+            }
+            return false;
+        }
+
+        bool acceptOperator(const char* op) {
+            if (peek().kind == Token::OPERATOR && peek().text == op) {
+                this->position++;
+                return true;
+            }
+            return false;
+        }
+
+        void expectOperator(const char* op) {
+            if (!acceptOperator(op)) {
+                fail(std::string("expected '") + op + "'");
+            }
+        }
+
+        void tokenize() {
+
+            std::size_t pos = 0;
+
+            while (pos < this->text.size()) {
+
+                char current = this->text[pos];
+
+                if (std::isspace((unsigned char) current)) {
+                    pos++;
+                    continue;
+                }
+
+                Token token;
+
+                if (std::isalpha((unsigned char) current) || current == '_' || current == '$') {
+
+                    std::size_t start = pos;
+                    while (pos < this->text.size() &&
+                           (std::isalnum((unsigned char) this->text[pos]) || this->text[pos] == '_' ||
+                            this->text[pos] == '$' || this->text[pos] == '.')) {
+                        pos++;
+                    }
+
+                    token.kind = Token::IDENTIFIER;
+                    token.text = this->text.substr(start, pos - start);
+
+                } else if (std::isdigit((unsigned char) current) ||
+                           (current == '.' && pos + 1 < this->text.size() && std::isdigit((unsigned char) this->text[pos + 1]))) {
+
+                    const char* start = this->text.c_str() + pos;
+                    char* end = NULL;
+
+                    token.kind = Token::NUMBER;
+                    token.number = std::strtod(start, &end);
+                    token.text = this->text.substr(pos, (std::size_t) (end - start));
+                    pos += (std::size_t) (end - start);
+
+                    // Accept the Java style long and float suffixes.
+                    if (pos < this->text.size() && std::strchr("lLfFdD", this->text[pos]) != NULL) {
+                        pos++;
+                    }
+
+                } else if (current == '\'') {
+
+                    token.kind = Token::STRING;
+                    pos++;
+
+                    while (true) {
+                        if (pos >= this->text.size()) {
+                            fail("unterminated string literal");
+                        }
+                        if (this->text[pos] == '\'') {
+                            if (pos + 1 < this->text.size() && this->text[pos + 1] == '\'') {
+                                token.text += '\'';
+                                pos += 2;
+                                continue;
+                            }
+                            pos++;
+                            break;
+                        }
+                        token.text += this->text[pos++];
+                    }
+
+                } else {
+
+                    static const char* operators[] = { "<>", "<=", ">=", "=", "<", ">", "(", ")", ",", "+", "-", NULL };
+
+                    for (int i = 0; operators[i] != NULL; ++i) {
+                        std::string op(operators[i]);
+                        if (this->text.compare(pos, op.size(), op) == 0) {
+                            token.kind = Token::OPERATOR;
+                            token.text = op;
+                            pos += op.size();
+                            break;
+                        }
+                    }
+
+                    if (token.kind != Token::OPERATOR) {
+                        fail(std::string("unexpected character '") + current + "'");
+                    }
+                }
+
+                this->tokens.push_back(token);
+            }
+
+            this->tokens.push_back(Token());
+        }
+
+        ExpressionPtr parseOr() {
+
+            ExpressionPtr left = parseAnd();
+
+            while (acceptKeyword("OR")) {
+                ExpressionPtr right = parseAnd();
+                left.reset(new LogicalExpression(left, right, false));
+            }
+
+            return left;
+        }
+
+        ExpressionPtr parseAnd() {
+
+            ExpressionPtr left = parseNot();
+
+            while (acceptKeyword("AND")) {
+                ExpressionPtr right = parseNot();
+                left.reset(new LogicalExpression(left, right, true));
+            }
+
+            return left;
+        }
+
+        ExpressionPtr parseNot() {
+
+            if (acceptKeyword("NOT")) {
+                return ExpressionPtr(new NotExpression(parseNot()));
+            }
+
+            return parseComparison();
+        }
+
+        ExpressionPtr parseComparison() {
+
+            ExpressionPtr left = parsePrimary();
+
+            if (peek().kind == Token::OPERATOR) {
+
+                static const char* comparisons[] = { "=", "<>", "<", "<=", ">", ">=", NULL };
+
+                for (int i = 0; comparisons[i] != NULL; ++i) {
+                    if (acceptOperator(comparisons[i])) {
+                        ExpressionPtr right = parsePrimary();
+                        return ExpressionPtr(new ComparisonExpression(left, right, comparisons[i]));
+                    }
+                }
+
+                return left;
+            }
+
+            if (acceptKeyword("IS")) {
+                bool negated = acceptKeyword("NOT");
+                if (!acceptKeyword("NULL")) {
+                    fail("expected NULL");
+                }
+                return ExpressionPtr(new IsNullExpression(left, negated));
+            }
+
+            bool negated = acceptKeyword("NOT");
+
+            if (acceptKeyword("IN")) {
+
+                std::vector<std::string> values;
+
+                expectOperator("(");
+                do {
+                    if (peek().kind != Token::STRING) {
+                        fail("expected a string literal in IN list");
+                    }
+                    values.push_back(next().text);
+                } while (acceptOperator(","));
+                expectOperator(")");
+
+                return ExpressionPtr(new InExpression(left, values, negated));
+
+            } else if (acceptKeyword("LIKE")) {
+
+                if (peek().kind != Token::STRING) {
+                    fail("expected a string literal after LIKE");
+                }
+
+                std::string pattern = next().text;
+                int escape = -1;
+
+                if (acceptKeyword("ESCAPE")) {
+                    if (peek().kind != Token::STRING || peek().text.size() != 1) {
+                        fail("expected a single character after ESCAPE");
+                    }
+                    escape = (unsigned char) next().text[0];
+                }
+
+                return ExpressionPtr(new LikeExpression(left, pattern, escape, negated));
+
+            } else if (acceptKeyword("BETWEEN")) {
+
+                ExpressionPtr low = parsePrimary();
+                if (!acceptKeyword("AND")) {
+                    fail("expected AND in BETWEEN");
+                }
+                ExpressionPtr high = parsePrimary();
+
+                return ExpressionPtr(new BetweenExpression(left, low, high, negated));
+
+            } else if (negated) {
+                fail("expected IN, LIKE or BETWEEN after NOT");
+            }
+
+            return left;
+        }
+
+        ExpressionPtr parsePrimary() {
+
+            if (acceptOperator("(")) {
+                ExpressionPtr result = parseOr();
+                expectOperator(")");
+                return result;
+            }
+
+            bool negative = false;
+            if (acceptOperator("-")) {
+                negative = true;
+            } else {
+                acceptOperator("+");
+            }
+
+            Token token = next();
+
+            if (token.kind == Token::NUMBER) {
+                return ExpressionPtr(new LiteralExpression(SelectorValue::fromNumber(negative ? -token.number : token.number)));
+            } else if (negative) {
+                fail("expected a numeric literal after '-'");
+            }
+
+            if (token.kind == Token::STRING) {
+                return ExpressionPtr(new LiteralExpression(SelectorValue::fromString(token.text)));
+            } else if (token.kind == Token::IDENTIFIER) {
+
+                if (equalsIgnoreCase(token.text, "TRUE")) {
+                    return ExpressionPtr(new LiteralExpression(SelectorValue::fromBoolean(true)));
+                } else if (equalsIgnoreCase(token.text, "FALSE")) {
+                    return ExpressionPtr(new LiteralExpression(SelectorValue::fromBoolean(false)));
+                } else if (equalsIgnoreCase(token.text, "NULL")) {
+                    return ExpressionPtr(new LiteralExpression(SelectorValue()));
+                }
+
+                return ExpressionPtr(new IdentifierExpression(token.text));
+            }
+
+            fail(token.kind == Token::END ? "unexpected end of selector" : "unexpected token '" + token.text + "'");
+            return ExpressionPtr();
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackSelector::LoopbackSelector(const std::string& text) : text(text), expression(NULL) {
+
+    std::size_t first = text.find_first_not_of(" \t\r\n");
+
+    if (first != std::string::npos) {
+        SelectorParser parser(text);
+        this->expression = parser.parse();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackSelector::~LoopbackSelector() {
+    delete this->expression;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackSelector::matches(const cms::Message* message) const {
+
+    if (this->expression == NULL) {
+        return true;
+    }
+
+    return this->expression->evaluate(message).isTrue();
+}
@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKSELECTOR_H_
+#define _LOOPBACK_LOOPBACKSELECTOR_H_
+
+#include <cms/Message.h>
+
+#include <string>
+
+namespace loopback {
+
+    class SelectorExpression;
+
+    /**
+     * Evaluates a subset of the JMS Message selector syntax against Messages held by
+     * the loopback broker.  The supported grammar covers the comparison operators,
+     * AND, OR, NOT, parentheses, IS [NOT] NULL, [NOT] IN, [NOT] LIKE and [NOT] BETWEEN
+     * applied to Message properties and the JMSDeliveryMode, JMSPriority, JMSTimestamp,
+     * JMSMessageID, JMSCorrelationID and JMSType headers.  Arithmetic is not supported.
+     */
+    class LoopbackSelector {
+    private:
+
+        std::string text;
+        SelectorExpression* expression;
+
+    private:
+
+        LoopbackSelector(const LoopbackSelector&);
+        LoopbackSelector& operator=(const LoopbackSelector&);
+
+    public:
+
+        /**
+         * Parses the given selector text.
+         *
+         * @param text
+         *      The selector, an empty string selects every Message.
+         *
+         * @throws InvalidSelectorException if the selector can't be parsed.
+         */
+        LoopbackSelector(const std::string& text);
+
+        ~LoopbackSelector();
+
+        /**
+         * @returns the text this selector was parsed from.
+         */
+        const std::string& getText() const {
+            return this->text;
+        }
+
+        /**
+         * @returns true if the given Message is selected.
+         */
+        bool matches(const cms::Message* message) const;
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKSELECTOR_H_ */
@@ -0,0 +1,681 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <loopback/LoopbackSession.h>
+#include <loopback/LoopbackConnection.h>
+#include <loopback/LoopbackConsumer.h>
+#include <loopback/LoopbackProducer.h>
+#include <loopback/LoopbackQueueBrowser.h>
+
+#include <Config.h>
+
+#include <activemq/commands/ActiveMQMessage.h>
+#include <activemq/commands/ActiveMQTextMessage.h>
+#include <activemq/commands/ActiveMQBytesMessage.h>
+#include <activemq/commands/ActiveMQMapMessage.h>
+#include <activemq/commands/ActiveMQStreamMessage.h>
+#include <activemq/commands/ActiveMQQueue.h>
+#include <activemq/commands/ActiveMQTopic.h>
+#include <activemq/commands/ActiveMQTempQueue.h>
+#include <activemq/commands/ActiveMQTempTopic.h>
+#include <activemq/core/ActiveMQAckHandler.h>
+
+#include <cms/IllegalStateException.h>
+#include <cms/InvalidDestinationException.h>
+
+#include <decaf/util/concurrent/Lock.h>
+
+#include <algorithm>
+
+using namespace loopback;
+using namespace activemq::commands;
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    /**
+     * Routes Message::acknowledge back to the Session that delivered the Message.
+     */
+    class LoopbackAckHandler : public activemq::core::ActiveMQAckHandler {
+    private:
+
+        Pointer<LoopbackSessionToken> token;
+        long long deliveryId;
+
+    public:
+
+        LoopbackAckHandler(const Pointer<LoopbackSessionToken>& token, long long deliveryId) :
+            activemq::core::ActiveMQAckHandler(), token(token), deliveryId(deliveryId) {}
+
+        virtual ~LoopbackAckHandler() {}
+
+        virtual void acknowledgeMessage(const activemq::commands::Message* message AMQC_UNUSED) {
+
+            Lock lock(&this->token->mutex);
+
+            if (this->token->session == NULL) {
+                throw cms::IllegalStateException("The session that delivered this message is closed");
+            }
+
+            this->token->session->acknowledge(this->deliveryId);
+        }
+    };
+
+    /**
+     * Puts a Message into the state a client expects of a received Message.
+     */
+    void prepareForDelivery(cms::Message* message) {
+
+        activemq::commands::Message* command = dynamic_cast<activemq::commands::Message*>(message);
+        if (command != NULL) {
+            command->setReadOnlyBody(true);
+            command->setReadOnlyProperties(true);
+        }
+
+        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>(message);
+        if (bytesMessage != NULL) {
+            bytesMessage->reset();
+        }
+
+        cms::StreamMessage* streamMessage = dynamic_cast<cms::StreamMessage*>(message);
+        if (streamMessage != NULL) {
+            streamMessage->reset();
+        }
+    }
+
+    void discardEnvelopes(std::vector<Envelope>& envelopes) {
+
+        std::vector<Envelope>::iterator iter = envelopes.begin();
+        for (; iter != envelopes.end(); ++iter) {
+            delete iter->message;
+        }
+
+        envelopes.clear();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackSession::LoopbackSession(LoopbackConnection* connection, cms::Session::AcknowledgeMode ackMode) :
+    cms::Session(), decaf::lang::Runnable(),
+    connection(connection), broker(connection->getBroker()), ackMode(ackMode), id(connection->getBroker()->generateId()),
+    mutex(), consumers(), producers(), delivered(), uncommitted(), nextDeliveryId(0), closed(false),
+    token(new LoopbackSessionToken(this)), transformer(connection->getMessageTransformer()),
+    dispatchLock(), dispatchMonitor(), dispatcher(), dispatchPending(false), dispatching(false) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackSession::~LoopbackSession() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::close() {
+
+    std::vector<LoopbackConsumer*> consumers;
+    std::vector<LoopbackProducer*> producers;
+
+    {
+        Lock lock(&this->mutex);
+
+        if (this->closed) {
+            return;
+        }
+
+        this->closed = true;
+        consumers = this->consumers;
+        producers = this->producers;
+    }
+
+    {
+        Lock lock(&this->token->mutex);
+        this->token->session = NULL;
+    }
+
+    stopDispatcher();
+
+    std::vector<LoopbackConsumer*>::iterator consumer = consumers.begin();
+    for (; consumer != consumers.end(); ++consumer) {
+        (*consumer)->close();
+    }
+
+    std::vector<LoopbackProducer*>::iterator producer = producers.begin();
+    for (; producer != producers.end(); ++producer) {
+        (*producer)->detach();
+    }
+
+    std::vector<Envelope> sends;
+    std::vector<Delivery> deliveries;
+
+    {
+        Lock lock(&this->mutex);
+        this->producers.clear();
+        sends.swap(this->uncommitted);
+        deliveries.swap(this->delivered);
+    }
+
+    discardEnvelopes(sends);
+
+    // As a broker would, return unacknowledged Messages to their Queues as redelivered.
+    this->broker->redeliver(deliveries);
+
+    this->connection->removeSession(this);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::start() {
+
+    std::vector<LoopbackConsumer*> consumers;
+
+    {
+        Lock lock(&this->mutex);
+        consumers = this->consumers;
+    }
+
+    std::vector<LoopbackConsumer*>::iterator iter = consumers.begin();
+    for (; iter != consumers.end(); ++iter) {
+        (*iter)->wakeup();
+    }
+
+    wakeup();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::stop() {
+    // Consumers check the Connection's started state before delivering.
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::commit() {
+
+    checkClosed();
+
+    if (!isTransacted()) {
+        throw cms::IllegalStateException("Session is not transacted");
+    }
+
+    std::vector<Envelope> sends;
+    std::vector<Delivery> consumed;
+
+    {
+        Lock lock(&this->mutex);
+        sends.swap(this->uncommitted);
+        consumed.swap(this->delivered);
+    }
+
+    discard(consumed);
+
+    for (std::size_t i = 0; i < sends.size(); ++i) {
+        try {
+            this->broker->send(sends[i]);
+        } catch (...) {
+            for (std::size_t j = i + 1; j < sends.size(); ++j) {
+                delete sends[j].message;
+            }
+            throw;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::rollback() {
+
+    checkClosed();
+
+    if (!isTransacted()) {
+        throw cms::IllegalStateException("Session is not transacted");
+    }
+
+    std::vector<Envelope> sends;
+
+    {
+        Lock lock(&this->mutex);
+        sends.swap(this->uncommitted);
+    }
+
+    discardEnvelopes(sends);
+    redeliver();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::recover() {
+
+    checkClosed();
+
+    if (isTransacted()) {
+        throw cms::IllegalStateException("Session is transacted");
+    }
+
+    redeliver();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageConsumer* LoopbackSession::createConsumer(const cms::Destination* destination) {
+    return createConsumer(destination, "", false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageConsumer* LoopbackSession::createConsumer(const cms::Destination* destination,
+                                                      const std::string& selector) {
+    return createConsumer(destination, selector, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageConsumer* LoopbackSession::createConsumer(const cms::Destination* destination,
+                                                      const std::string& selector, bool noLocal) {
+
+    checkClosed();
+
+    if (destination == NULL) {
+        throw cms::InvalidDestinationException("Destination cannot be NULL");
+    }
+
+    return addConsumer(std::auto_ptr<LoopbackConsumer>(
+        new LoopbackConsumer(this, destination, selector, noLocal, "")));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageConsumer* LoopbackSession::createDurableConsumer(const cms::Topic* destination, const std::string& name,
+                                                             const std::string& selector, bool noLocal) {
+
+    checkClosed();
+
+    if (destination == NULL) {
+        throw cms::InvalidDestinationException("Destination cannot be NULL");
+    }
+
+    if (name.empty()) {
+        throw cms::IllegalStateException("A durable subscription requires a name");
+    }
+
+    std::string key = this->connection->getClientID() + ":" + name;
+
+    return addConsumer(std::auto_ptr<LoopbackConsumer>(
+        new LoopbackConsumer(this, destination, selector, noLocal, key)));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageProducer* LoopbackSession::createProducer(const cms::Destination* destination) {
+
+    checkClosed();
+
+    std::auto_ptr<LoopbackProducer> producer(new LoopbackProducer(this, destination));
+
+    Lock lock(&this->mutex);
+    this->producers.push_back(producer.get());
+
+    return producer.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::QueueBrowser* LoopbackSession::createBrowser(const cms::Queue* queue) {
+    return createBrowser(queue, "");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::QueueBrowser* LoopbackSession::createBrowser(const cms::Queue* queue, const std::string& selector) {
+
+    checkClosed();
+
+    if (queue == NULL) {
+        throw cms::InvalidDestinationException("Queue cannot be NULL");
+    }
+
+    return new LoopbackQueueBrowser(this->broker, queue, selector);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Queue* LoopbackSession::createQueue(const std::string& queueName) {
+    checkClosed();
+    return new ActiveMQQueue(queueName);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Topic* LoopbackSession::createTopic(const std::string& topicName) {
+    checkClosed();
+    return new ActiveMQTopic(topicName);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::TemporaryQueue* LoopbackSession::createTemporaryQueue() {
+    checkClosed();
+    return new ActiveMQTempQueue(this->connection->createTemporaryName(true));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::TemporaryTopic* LoopbackSession::createTemporaryTopic() {
+    checkClosed();
+    return new ActiveMQTempTopic(this->connection->createTemporaryName(false));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackSession::createMessage() {
+    checkClosed();
+    return new ActiveMQMessage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::BytesMessage* LoopbackSession::createBytesMessage() {
+    checkClosed();
+    return new ActiveMQBytesMessage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::BytesMessage* LoopbackSession::createBytesMessage(const unsigned char* bytes, int bytesSize) {
+
+    checkClosed();
+
+    std::auto_ptr<ActiveMQBytesMessage> message(new ActiveMQBytesMessage());
+    message->setBodyBytes(bytes, bytesSize);
+
+    return message.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::StreamMessage* LoopbackSession::createStreamMessage() {
+    checkClosed();
+    return new ActiveMQStreamMessage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::TextMessage* LoopbackSession::createTextMessage() {
+    checkClosed();
+    return new ActiveMQTextMessage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::TextMessage* LoopbackSession::createTextMessage(const std::string& text) {
+
+    checkClosed();
+
+    std::auto_ptr<ActiveMQTextMessage> message(new ActiveMQTextMessage());
+    message->setText(text);
+
+    return message.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MapMessage* LoopbackSession::createMapMessage() {
+    checkClosed();
+    return new ActiveMQMapMessage();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Session::AcknowledgeMode LoopbackSession::getAcknowledgeMode() const {
+    return this->ackMode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackSession::isTransacted() const {
+    return this->ackMode == cms::Session::SESSION_TRANSACTED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::unsubscribe(const std::string& name) {
+    checkClosed();
+    this->broker->unsubscribe(this->connection->getClientID() + ":" + name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::setMessageTransformer(cms::MessageTransformer* transformer) {
+    this->transformer = transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageTransformer* LoopbackSession::getMessageTransformer() const {
+    return this->transformer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::run() {
+
+    while (true) {
+
+        {
+            Lock lock(&this->dispatchMonitor);
+
+            while (this->dispatching && !this->dispatchPending) {
+                this->dispatchMonitor.wait();
+            }
+
+            if (!this->dispatching) {
+                return;
+            }
+
+            this->dispatchPending = false;
+        }
+
+        // Holding the dispatch lock keeps Consumers from being removed mid delivery.
+        Lock lock(&this->dispatchLock);
+
+        bool dispatched = true;
+        while (dispatched) {
+
+            dispatched = false;
+
+            std::vector<LoopbackConsumer*> consumers;
+            {
+                Lock sessionLock(&this->mutex);
+                consumers = this->consumers;
+            }
+
+            std::vector<LoopbackConsumer*>::iterator iter = consumers.begin();
+            for (; iter != consumers.end(); ++iter) {
+                dispatched = (*iter)->dispatch() || dispatched;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long LoopbackSession::getConnectionId() const {
+    return this->connection->getId();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool LoopbackSession::isStarted() const {
+    return this->connection->isStarted();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::send(const Envelope& envelope) {
+
+    std::auto_ptr<cms::Message> message(envelope.message);
+
+    {
+        Lock lock(&this->mutex);
+
+        checkClosed();
+
+        if (isTransacted()) {
+            this->uncommitted.push_back(Envelope(message.release(), envelope.origin));
+            return;
+        }
+    }
+
+    this->broker->send(Envelope(message.release(), envelope.origin));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* LoopbackSession::deliver(LoopbackConsumer* consumer, const Envelope& envelope) {
+
+    if (this->ackMode == cms::Session::AUTO_ACKNOWLEDGE || this->ackMode == cms::Session::DUPS_OK_ACKNOWLEDGE) {
+        prepareForDelivery(envelope.message);
+        return envelope.message;
+    }
+
+    // The client gets a copy, the original is kept in case it must be redelivered.
+    std::auto_ptr<cms::Message> message(envelope.message->clone());
+    prepareForDelivery(message.get());
+
+    Lock lock(&this->mutex);
+
+    if (this->closed) {
+        delete envelope.message;
+        return message.release();
+    }
+
+    long long deliveryId = ++this->nextDeliveryId;
+
+    if (this->ackMode != cms::Session::SESSION_TRANSACTED) {
+        activemq::commands::Message* command = dynamic_cast<activemq::commands::Message*>(message.get());
+        if (command != NULL) {
+            command->setAckHandler(Pointer<activemq::core::ActiveMQAckHandler>(
+                new LoopbackAckHandler(this->token, deliveryId)));
+        }
+    }
+
+    this->delivered.push_back(Delivery(deliveryId, consumer, envelope));
+
+    return message.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::acknowledge(long long deliveryId) {
+
+    std::vector<Delivery> acknowledged;
+
+    {
+        Lock lock(&this->mutex);
+
+        if (this->ackMode == cms::Session::CLIENT_ACKNOWLEDGE) {
+            // Acknowledging any Message acknowledges everything the Session delivered.
+            acknowledged.swap(this->delivered);
+        } else if (this->ackMode == cms::Session::INDIVIDUAL_ACKNOWLEDGE) {
+
+            std::vector<Delivery>::iterator iter = this->delivered.begin();
+            for (; iter != this->delivered.end(); ++iter) {
+                if (iter->id == deliveryId) {
+                    acknowledged.push_back(*iter);
+                    this->delivered.erase(iter);
+                    break;
+                }
+            }
+        }
+    }
+
+    discard(acknowledged);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::removeConsumer(LoopbackConsumer* consumer) {
+
+    Lock dispatch(&this->dispatchLock);
+    Lock lock(&this->mutex);
+
+    this->consumers.erase(std::remove(this->consumers.begin(), this->consumers.end(), consumer), this->consumers.end());
+
+    // Unacknowledged Messages now go back to their Queue if they are redelivered.
+    std::vector<Delivery>::iterator iter = this->delivered.begin();
+    for (; iter != this->delivered.end(); ++iter) {
+        if (iter->consumer == consumer) {
+            iter->consumer = NULL;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::removeProducer(LoopbackProducer* producer) {
+
+    Lock lock(&this->mutex);
+    this->producers.erase(std::remove(this->producers.begin(), this->producers.end(), producer), this->producers.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::wakeup() {
+
+    Lock lock(&this->dispatchMonitor);
+
+    this->dispatchPending = true;
+    this->dispatchMonitor.notifyAll();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::startDispatcher() {
+
+    Lock lock(&this->dispatchMonitor);
+
+    if (this->dispatcher.get() == NULL && !this->closed) {
+        this->dispatching = true;
+        this->dispatcher.reset(new Thread(this, "LoopbackSession Dispatcher"));
+        this->dispatcher->start();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::checkClosed() const {
+
+    if (this->closed) {
+        throw cms::IllegalStateException("Session is closed");
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::stopDispatcher() {
+
+    {
+        Lock lock(&this->dispatchMonitor);
+        this->dispatching = false;
+        this->dispatchMonitor.notifyAll();
+    }
+
+    // A listener that closes its own Session can't wait for itself to finish.
+    if (this->dispatcher.get() != NULL && Thread::currentThread() != this->dispatcher.get()) {
+        this->dispatcher->join();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::redeliver() {
+
+    {
+        Lock lock(&this->mutex);
+
+        std::vector<Delivery> deliveries;
+        deliveries.swap(this->delivered);
+
+        this->broker->redeliver(deliveries);
+    }
+
+    wakeup();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackSession::discard(std::vector<Delivery>& deliveries) {
+
+    std::vector<Delivery>::iterator iter = deliveries.begin();
+    for (; iter != deliveries.end(); ++iter) {
+        delete iter->envelope.message;
+    }
+
+    deliveries.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::MessageConsumer* LoopbackSession::addConsumer(std::auto_ptr<LoopbackConsumer> consumer) {
+
+    this->broker->addConsumer(consumer.get());
+
+    Lock lock(&this->mutex);
+    this->consumers.push_back(consumer.get());
+
+    return consumer.release();
+}
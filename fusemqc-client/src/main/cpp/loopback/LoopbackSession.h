@@ -0,0 +1,214 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LOOPBACK_LOOPBACKSESSION_H_
+#define _LOOPBACK_LOOPBACKSESSION_H_
+
+#include <cms/Session.h>
+
+#include <decaf/lang/Pointer.h>
+#include <decaf/lang/Runnable.h>
+#include <decaf/lang/Thread.h>
+#include <decaf/util/concurrent/Mutex.h>
+
+#include <loopback/LoopbackBroker.h>
+
+#include <memory>
+#include <vector>
+
+namespace loopback {
+
+    class LoopbackConnection;
+    class LoopbackConsumer;
+    class LoopbackProducer;
+    class LoopbackSession;
+
+    /**
+     * Shared between a Session and the ack handlers of the Messages it delivered, so that
+     * acknowledging a Message after its Session is gone fails cleanly.
+     */
+    class LoopbackSessionToken {
+    public:
+
+        decaf::util::concurrent::Mutex mutex;
+        LoopbackSession* session;
+
+        LoopbackSessionToken(LoopbackSession* session) : mutex(), session(session) {}
+
+    private:
+
+        LoopbackSessionToken(const LoopbackSessionToken&);
+        LoopbackSessionToken& operator=(const LoopbackSessionToken&);
+
+    };
+
+    /**
+     * Session of the loopback broker.  Tracks the Messages it delivered until they are
+     * acknowledged or committed and buffers transacted sends until commit.  Consumers that
+     * have a MessageListener are serviced by a dispatch thread that the Session starts when
+     * the first listener is set.
+     */
+    class LoopbackSession : public cms::Session, public decaf::lang::Runnable {
+    private:
+
+        LoopbackConnection* connection;
+        LoopbackBroker* broker;
+        cms::Session::AcknowledgeMode ackMode;
+        long long id;
+
+        decaf::util::concurrent::Mutex mutex;
+        std::vector<LoopbackConsumer*> consumers;
+        std::vector<LoopbackProducer*> producers;
+        std::vector<Delivery> delivered;
+        std::vector<Envelope> uncommitted;
+        long long nextDeliveryId;
+        bool closed;
+
+        decaf::lang::Pointer<LoopbackSessionToken> token;
+        cms::MessageTransformer* transformer;
+
+        decaf::util::concurrent::Mutex dispatchLock;
+        decaf::util::concurrent::Mutex dispatchMonitor;
+        std::auto_ptr<decaf::lang::Thread> dispatcher;
+        bool dispatchPending;
+        bool dispatching;
+
+    private:
+
+        LoopbackSession(const LoopbackSession&);
+        LoopbackSession& operator=(const LoopbackSession&);
+
+    public:
+
+        LoopbackSession(LoopbackConnection* connection, cms::Session::AcknowledgeMode ackMode);
+
+        virtual ~LoopbackSession();
+
+    public:  // cms::Session
+
+        virtual void close();
+        virtual void start();
+        virtual void stop();
+
+        virtual void commit();
+        virtual void rollback();
+        virtual void recover();
+
+        virtual cms::MessageConsumer* createConsumer(const cms::Destination* destination);
+        virtual cms::MessageConsumer* createConsumer(const cms::Destination* destination,
+                                                     const std::string& selector);
+        virtual cms::MessageConsumer* createConsumer(const cms::Destination* destination,
+                                                     const std::string& selector, bool noLocal);
+        virtual cms::MessageConsumer* createDurableConsumer(const cms::Topic* destination, const std::string& name,
+                                                            const std::string& selector, bool noLocal = false);
+
+        virtual cms::MessageProducer* createProducer(const cms::Destination* destination = NULL);
+
+        virtual cms::QueueBrowser* createBrowser(const cms::Queue* queue);
+        virtual cms::QueueBrowser* createBrowser(const cms::Queue* queue, const std::string& selector);
+
+        virtual cms::Queue* createQueue(const std::string& queueName);
+        virtual cms::Topic* createTopic(const std::string& topicName);
+        virtual cms::TemporaryQueue* createTemporaryQueue();
+        virtual cms::TemporaryTopic* createTemporaryTopic();
+
+        virtual cms::Message* createMessage();
+        virtual cms::BytesMessage* createBytesMessage();
+        virtual cms::BytesMessage* createBytesMessage(const unsigned char* bytes, int bytesSize);
+        virtual cms::StreamMessage* createStreamMessage();
+        virtual cms::TextMessage* createTextMessage();
+        virtual cms::TextMessage* createTextMessage(const std::string& text);
+        virtual cms::MapMessage* createMapMessage();
+
+        virtual cms::Session::AcknowledgeMode getAcknowledgeMode() const;
+        virtual bool isTransacted() const;
+
+        virtual void unsubscribe(const std::string& name);
+
+        virtual void setMessageTransformer(cms::MessageTransformer* transformer);
+        virtual cms::MessageTransformer* getMessageTransformer() const;
+
+    public:  // decaf::lang::Runnable
+
+        /**
+         * Dispatch thread that delivers Messages to the Session's MessageListeners.
+         */
+        virtual void run();
+
+    public:  // Producer and Consumer facing
+
+        LoopbackBroker* getBroker() const {
+            return this->broker;
+        }
+
+        long long getId() const {
+            return this->id;
+        }
+
+        long long getConnectionId() const;
+
+        bool isStarted() const;
+
+        /**
+         * Routes a sent Message, or holds it until commit when the Session is transacted.
+         * Ownership of the Message passes to the Session.
+         */
+        void send(const Envelope& envelope);
+
+        /**
+         * Turns a Message taken from a Consumer's buffer into the Message that is handed to
+         * the client, recording it for redelivery unless the Session acknowledges
+         * automatically.  The caller owns the returned Message.
+         */
+        cms::Message* deliver(LoopbackConsumer* consumer, const Envelope& envelope);
+
+        /**
+         * Acknowledges Messages delivered by this Session, called from Message::acknowledge.
+         */
+        void acknowledge(long long deliveryId);
+
+        void removeConsumer(LoopbackConsumer* consumer);
+
+        void removeProducer(LoopbackProducer* producer);
+
+        /**
+         * Wakes the dispatch thread when a Consumer with a MessageListener has Messages.
+         */
+        void wakeup();
+
+        /**
+         * Starts the dispatch thread if it isn't already running.
+         */
+        void startDispatcher();
+
+    private:
+
+        void checkClosed() const;
+
+        void stopDispatcher();
+
+        void redeliver();
+
+        void discard(std::vector<Delivery>& deliveries);
+
+        cms::MessageConsumer* addConsumer(std::auto_ptr<LoopbackConsumer> consumer);
+
+    };
+
+}
+
+#endif /* _LOOPBACK_LOOPBACKSESSION_H_ */
@@ -0,0 +1,496 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <private/CMS_Compression.h>
+
+#include <Config.h>
+#include <private/CMS_Types.h>
+#include <private/CMS_SharedBody.h>
+
+#include <cms/Message.h>
+#include <cms/TextMessage.h>
+#include <cms/BytesMessage.h>
+#include <cms/Session.h>
+#include <cms/MessageFormatException.h>
+#include <cms/UnsupportedOperationException.h>
+
+#include <decaf/util/concurrent/Lock.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ZLIB_H
+#include <zlib.h>
+#endif
+
+#include <map>
+#include <memory>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    const char* ZLIB_CODEC_NAME = "zlib";
+
+    /**
+     * The most that deflate can expand to, a 258 byte match coded in two bits.  A body that
+     * claims a larger expansion is malformed and isn't allocated.
+     */
+    const std::size_t MAX_EXPANSION = 1032;
+
+    int codecFromName(const std::string& name) {
+
+        if (name == ZLIB_CODEC_NAME) {
+            return CMS_COMPRESSION_ZLIB;
+        }
+
+        return CMS_COMPRESSION_NONE;
+    }
+
+    const char* codecName(int codec) {
+
+        if (codec == CMS_COMPRESSION_ZLIB) {
+            return ZLIB_CODEC_NAME;
+        }
+
+        return NULL;
+    }
+
+    bool isCompressionProperty(const std::string& name) {
+        return name == CMS_COMPRESSION_PROPERTY || name == CMS_COMPRESSED_SIZE_PROPERTY ||
+               name == CMS_COMPRESSED_TEXT_PROPERTY || name == CMS_COMPRESSION_DICTIONARY_PROPERTY;
+    }
+
+    /**
+     * Reads the whole body of a BytesMessage, leaving it reset to be read from the start.
+     */
+    void readBody(cms::BytesMessage* bytesMessage, std::vector<unsigned char>& body) {
+
+        bytesMessage->reset();
+        body.resize(bytesMessage->getBodyLength());
+
+        if (!body.empty()) {
+            bytesMessage->readBytes(&body[0], (int) body.size());
+        }
+
+        bytesMessage->reset();
+    }
+
+    /**
+     * Compresses the data, against the dictionary when one is given, returns false when
+     * the codec isn't available or fails.
+     */
+    bool compress(int codec AMQC_UNUSED, const CMS_CompressionDictionary* dictionary AMQC_UNUSED,
+                  const unsigned char* data AMQC_UNUSED, std::size_t length AMQC_UNUSED,
+                  std::vector<unsigned char>& compressed AMQC_UNUSED) {
+
+#ifdef HAVE_ZLIB_H
+        if (codec != CMS_COMPRESSION_ZLIB) {
+            return false;
+        }
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(z_stream));
+
+        // The fastest level for plain bodies, the send waits on the compression and the
+        // large bodies this is aimed at give up most of their redundancy to it anyway.
+        // Bodies compressed against a dictionary are small enough to afford a full search.
+        if (deflateInit(&stream, dictionary == NULL ? Z_BEST_SPEED : Z_DEFAULT_COMPRESSION) != Z_OK) {
+            return false;
+        }
+
+        bool done = dictionary == NULL ||
+            deflateSetDictionary(&stream, &dictionary->data[0], (uInt) dictionary->data.size()) == Z_OK;
+
+        if (done) {
+
+            compressed.resize(deflateBound(&stream, (uLong) length));
+
+            // The input is never written to, zlib just doesn't declare it const.
+            stream.next_in = const_cast<Bytef*>(data);
+            stream.avail_in = (uInt) length;
+            stream.next_out = &compressed[0];
+            stream.avail_out = (uInt) compressed.size();
+
+            done = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+            compressed.resize(stream.total_out);
+        }
+
+        deflateEnd(&stream);
+
+        return done;
+#else
+        return false;
+#endif
+    }
+
+    void decompress(int codec, const CMS_CompressionDictionary* dictionary AMQC_UNUSED,
+                    const std::vector<unsigned char>& compressed, int length,
+                    std::vector<unsigned char>& body AMQC_UNUSED) {
+
+        if (!cms_isCompressionSupported(codec)) {
+            throw cms::UnsupportedOperationException("The Message body was compressed with an unsupported codec");
+        }
+
+        if (compressed.empty() || length < 0 || (std::size_t) length / MAX_EXPANSION > compressed.size()) {
+            throw cms::MessageFormatException("The compressed Message body is malformed");
+        }
+
+#ifdef HAVE_ZLIB_H
+        z_stream stream;
+        memset(&stream, 0, sizeof(z_stream));
+
+        if (inflateInit(&stream) != Z_OK) {
+            throw cms::CMSException("Failed to allocate the decompression state");
+        }
+
+        // One spare byte so that a body longer than it claims to be is caught.
+        body.resize((std::size_t) length + 1);
+
+        stream.next_in = const_cast<Bytef*>(&compressed[0]);
+        stream.avail_in = (uInt) compressed.size();
+        stream.next_out = &body[0];
+        stream.avail_out = (uInt) body.size();
+
+        int status = inflate(&stream, Z_FINISH);
+
+        if (status == Z_NEED_DICT && dictionary != NULL && stream.adler == dictionary->id) {
+
+            status = inflateSetDictionary(&stream, &dictionary->data[0], (uInt) dictionary->data.size());
+
+            if (status == Z_OK) {
+                status = inflate(&stream, Z_FINISH);
+            }
+        }
+
+        uLong size = stream.total_out;
+        inflateEnd(&stream);
+
+        if (status == Z_NEED_DICT) {
+            throw cms::UnsupportedOperationException(
+                "The Message body was compressed against a dictionary that the Consumer doesn't have");
+        } else if (status != Z_STREAM_END || size != (uLong) length) {
+            throw cms::MessageFormatException("The compressed Message body is malformed");
+        }
+
+        body.resize((std::size_t) length);
+#endif
+    }
+
+    /**
+     * Copies the headers that the caller sets and every property but those that describe
+     * the compression, which belong to the body of the source alone.
+     */
+    void copyHeadersAndProperties(const cms::Message* source, cms::Message* target) {
+
+        target->setCMSCorrelationID(source->getCMSCorrelationID());
+        target->setCMSType(source->getCMSType());
+        target->setCMSReplyTo(source->getCMSReplyTo());
+
+        cms_copyMessageProperties(source, target);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_copyMessageProperties(const cms::Message* source, cms::Message* target) {
+
+    std::vector<std::string> names = source->getPropertyNames();
+    std::vector<std::string>::const_iterator name = names.begin();
+
+    for (; name != names.end(); ++name) {
+
+        if (isCompressionProperty(*name)) {
+            continue;
+        }
+
+        switch (source->getPropertyValueType(*name)) {
+            case cms::Message::BOOLEAN_TYPE:
+                target->setBooleanProperty(*name, source->getBooleanProperty(*name));
+                break;
+            case cms::Message::BYTE_TYPE:
+                target->setByteProperty(*name, source->getByteProperty(*name));
+                break;
+            case cms::Message::SHORT_TYPE:
+                target->setShortProperty(*name, source->getShortProperty(*name));
+                break;
+            case cms::Message::INTEGER_TYPE:
+                target->setIntProperty(*name, source->getIntProperty(*name));
+                break;
+            case cms::Message::LONG_TYPE:
+                target->setLongProperty(*name, source->getLongProperty(*name));
+                break;
+            case cms::Message::FLOAT_TYPE:
+                target->setFloatProperty(*name, source->getFloatProperty(*name));
+                break;
+            case cms::Message::DOUBLE_TYPE:
+                target->setDoubleProperty(*name, source->getDoubleProperty(*name));
+                break;
+            case cms::Message::CHAR_TYPE:
+            case cms::Message::STRING_TYPE:
+                target->setStringProperty(*name, source->getStringProperty(*name));
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool cms_isCompressionSupported(int codec AMQC_UNUSED) {
+
+#ifdef HAVE_ZLIB_H
+    return codec == CMS_COMPRESSION_ZLIB;
+#else
+    return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* cms_createSendCopy(cms::Session* session, CMS_Message* message, int codec, int threshold,
+                                 const CMS_CompressionDictionary* dictionary, CMS_EndpointStatistics* statistics) {
+
+    // A body that is still compressed is forwarded as it arrived.
+    if (message->compression == CMS_BODY_COMPRESSED ||
+        (message->type != CMS_TEXT_MESSAGE && message->type != CMS_BYTES_MESSAGE)) {
+        return NULL;
+    }
+
+    bool plain = message->compression == CMS_BODY_PLAIN;
+    bool text = message->type == CMS_TEXT_MESSAGE;
+
+    if (plain && (codec == CMS_COMPRESSION_NONE || threshold < 0)) {
+        return NULL;
+    }
+
+    cms::TextMessage* textMessage = dynamic_cast<cms::TextMessage*>(message->message);
+    std::string body;
+    std::vector<unsigned char> bytes;
+    const unsigned char* data = NULL;
+    std::size_t length = 0;
+
+    if (textMessage != NULL) {
+        body = textMessage->getText();
+        data = (const unsigned char*) body.data();
+        length = body.size();
+    } else {
+
+        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>(message->message);
+
+        // Only the length is needed to pass over a body that is too small to compress.
+        bytesMessage->reset();
+        if (plain && bytesMessage->getBodyLength() < threshold) {
+            return NULL;
+        }
+
+        readBody(bytesMessage, bytes);
+        data = bytes.empty() ? NULL : &bytes[0];
+        length = bytes.size();
+    }
+
+    std::vector<unsigned char> compressed;
+    bool compressing = codec != CMS_COMPRESSION_NONE && threshold >= 0 && length > 0 &&
+                       length >= (std::size_t) threshold &&
+                       compress(codec, dictionary, data, length, compressed) && compressed.size() < length;
+
+    if (!compressing && plain) {
+        return NULL;
+    }
+
+    std::auto_ptr<cms::Message> copy;
+
+    if (compressing) {
+
+        copy.reset(session->createBytesMessage(&compressed[0], (int) compressed.size()));
+        copy->setStringProperty(CMS_COMPRESSION_PROPERTY, codecName(codec));
+        copy->setIntProperty(CMS_COMPRESSED_SIZE_PROPERTY, (int) length);
+
+        if (text) {
+            copy->setBooleanProperty(CMS_COMPRESSED_TEXT_PROPERTY, true);
+        }
+
+        if (dictionary != NULL) {
+            copy->setLongProperty(CMS_COMPRESSION_DICTIONARY_PROPERTY, (long long) dictionary->id);
+        }
+
+        cms_endpointStatisticsAdd(statistics, CMS_STAT_COMPRESSED_MESSAGES, 1);
+        cms_endpointStatisticsAdd(statistics, CMS_STAT_UNCOMPRESSED_BYTES, (long long) length);
+        cms_endpointStatisticsAdd(statistics, CMS_STAT_COMPRESSED_BYTES, (long long) compressed.size());
+
+    } else if (text) {
+        copy.reset(session->createTextMessage(std::string((const char*) data, length)));
+    } else if (length > 0) {
+        copy.reset(session->createBytesMessage(data, (int) length));
+    } else {
+        copy.reset(session->createBytesMessage());
+    }
+
+    copyHeadersAndProperties(message->message, copy.get());
+
+    return copy.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_copySentHeaders(const cms::Message* sent, cms::Message* message) {
+
+    message->setCMSMessageID(sent->getCMSMessageID());
+    message->setCMSTimestamp(sent->getCMSTimestamp());
+    message->setCMSDestination(sent->getCMSDestination());
+    message->setCMSDeliveryMode(sent->getCMSDeliveryMode());
+    message->setCMSPriority(sent->getCMSPriority());
+    message->setCMSExpiration(sent->getCMSExpiration());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_inspectReceivedMessage(CMS_Message* message, CMS_MessageConsumer* consumer) {
+
+    message->compression = CMS_BODY_PLAIN;
+    message->dictionary = NULL;
+
+    if (message->type != CMS_BYTES_MESSAGE || !message->message->propertyExists(CMS_COMPRESSION_PROPERTY)) {
+        return;
+    }
+
+    message->compression = CMS_BODY_COMPRESSED;
+
+    try{
+
+        if (message->message->propertyExists(CMS_COMPRESSED_TEXT_PROPERTY) &&
+            message->message->getBooleanProperty(CMS_COMPRESSED_TEXT_PROPERTY)) {
+
+            message->type = CMS_TEXT_MESSAGE;
+        }
+
+        if (consumer == NULL) {
+            return;
+        }
+
+        if (message->message->propertyExists(CMS_COMPRESSION_DICTIONARY_PROPERTY)) {
+
+            unsigned int id = (unsigned int) message->message->getLongProperty(CMS_COMPRESSION_DICTIONARY_PROPERTY);
+
+            decaf::util::concurrent::Lock lock(&consumer->dictionariesLock);
+            std::map<unsigned int, CMS_CompressionDictionary*>::const_iterator found = consumer->dictionaries.find(id);
+
+            if (found != consumer->dictionaries.end()) {
+                message->dictionary = cms_retainCompressionDictionary(found->second);
+            }
+        }
+
+        cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>(message->message);
+
+        cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_COMPRESSED_MESSAGES, 1);
+        cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_UNCOMPRESSED_BYTES,
+                                  message->message->getIntProperty(CMS_COMPRESSED_SIZE_PROPERTY));
+        cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_COMPRESSED_BYTES, bytesMessage->getBodyLength());
+
+    } catch(cms::CMSException&) {
+        // A malformed Message fails when its body is accessed rather than on its receipt.
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_decompressMessageBody(CMS_Message* message) {
+
+    if (message->compression != CMS_BODY_COMPRESSED) {
+        return;
+    }
+
+    cms::BytesMessage* bytesMessage = dynamic_cast<cms::BytesMessage*>(message->message);
+
+    int codec = codecFromName(message->message->getStringProperty(CMS_COMPRESSION_PROPERTY));
+    int length = message->message->getIntProperty(CMS_COMPRESSED_SIZE_PROPERTY);
+
+    std::vector<unsigned char> compressed;
+    std::vector<unsigned char> body;
+
+    readBody(bytesMessage, compressed);
+    decompress(codec, message->dictionary, compressed, length, body);
+
+    bytesMessage->clearBody();
+    bytesMessage->setBodyBytes(body.empty() ? NULL : &body[0], (int) body.size());
+    bytesMessage->reset();
+
+    message->compression = CMS_BODY_DECOMPRESSED;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string cms_getDecompressedText(CMS_Message* message) {
+
+    cms_decompressMessageBody(message);
+
+    std::vector<unsigned char> body;
+    readBody(dynamic_cast<cms::BytesMessage*>(message->message), body);
+
+    return body.empty() ? std::string() : std::string((const char*) &body[0], body.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_readMessageBody(CMS_Message* message, std::string& body) {
+
+    cms::TextMessage* textMessage = dynamic_cast<cms::TextMessage*>(message->message);
+
+    if (textMessage != NULL) {
+        body = textMessage->getText();
+    } else if (message->type == CMS_TEXT_MESSAGE) {
+        body = cms_isSharingBody(message) ? cms_getSharedText(message) : cms_getDecompressedText(message);
+    } else {
+
+        std::vector<unsigned char> bytes;
+
+        cms_unshareMessageBody(message);
+        cms_decompressMessageBody(message);
+        readBody(dynamic_cast<cms::BytesMessage*>(message->message), bytes);
+
+        body = bytes.empty() ? std::string() : std::string((const char*) &bytes[0], bytes.size());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+unsigned int cms_compressionDictionaryId(const unsigned char* data, std::size_t length) {
+
+    // Adler-32, the checksum that zlib streams name their preset dictionary by.
+    const unsigned int MODULUS = 65521;
+
+    unsigned int a = 1;
+    unsigned int b = 0;
+
+    for (std::size_t i = 0; i < length; ++i) {
+        a = (a + data[i]) % MODULUS;
+        b = (b + a) % MODULUS;
+    }
+
+    return (b << 16) | a;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CMS_CompressionDictionary* cms_retainCompressionDictionary(CMS_CompressionDictionary* dictionary) {
+
+    if (dictionary != NULL) {
+        dictionary->references.incrementAndGet();
+    }
+
+    return dictionary;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_releaseCompressionDictionary(CMS_CompressionDictionary* dictionary) {
+
+    if (dictionary != NULL && dictionary->references.decrementAndGet() == 0) {
+        delete dictionary;
+    }
+}
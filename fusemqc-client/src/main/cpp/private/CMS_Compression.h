@@ -0,0 +1,175 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CMS_COMPRESSION_H_
+#define _CMS_COMPRESSION_H_
+
+#include <cms.h>
+#include <private/CMS_Statistics.h>
+
+#include <cstddef>
+#include <string>
+
+namespace cms {
+    class Message;
+    class Session;
+}
+
+/**
+ * Where the body of a Message stands with respect to compression.
+ */
+enum CMS_BodyCompression {
+
+    /** The body is as it was written and the Message carries no compression properties. */
+    CMS_BODY_PLAIN,
+
+    /** The body is compressed, it is decompressed in place the first time it is accessed. */
+    CMS_BODY_COMPRESSED,
+
+    /**
+     * The body was decompressed in place but the Message still carries the compression
+     * properties, and the text of a TextMessage is still held by a BytesMessage.
+     */
+    CMS_BODY_DECOMPRESSED
+};
+
+/**
+ * Checks whether the codec can be used by this build of the library.
+ *
+ * @param codec
+ * 		The codec to check.
+ */
+bool cms_isCompressionSupported(int codec);
+
+/**
+ * Creates the copy of a Message that is handed to the CMS Producer in its place, either
+ * because its body is compressed or because it was received compressed and must now be
+ * sent in its plain form.  The copy has the headers and properties of the Message.
+ *
+ * @param session
+ * 		The Session used to create the copy.
+ * @param message
+ * 		The Message that is being sent, for one that shares its body the wrapper of the
+ * 		Message lent by cms_lendSharedBody.
+ * @param codec
+ * 		The codec to compress with, CMS_COMPRESSION_NONE to leave the body as it is.
+ * @param threshold
+ * 		The smallest body length that is compressed.
+ * @param dictionary
+ * 		The dictionary to compress against, can be NULL.
+ * @param statistics
+ * 		The statistics of the Producer where compressed bodies are counted.
+ *
+ * @returns the copy, or NULL when the Message is to be sent as it is.
+ */
+cms::Message* cms_createSendCopy(cms::Session* session, CMS_Message* message, int codec, int threshold,
+                                 const CMS_CompressionDictionary* dictionary, CMS_EndpointStatistics* statistics);
+
+/**
+ * Copies every property of a Message to another but those that describe the compression
+ * of its body.
+ *
+ * @param source
+ * 		The Message whose properties are copied.
+ * @param target
+ * 		The Message that the properties are set on.
+ */
+void cms_copyMessageProperties(const cms::Message* source, cms::Message* target);
+
+/**
+ * Copies the headers that the send assigned to the copy of a Message back to the Message
+ * that the caller sent, so the copy is never visible to the caller.
+ *
+ * @param sent
+ * 		The copy that was sent.
+ * @param message
+ * 		The Message that the caller sent.
+ */
+void cms_copySentHeaders(const cms::Message* sent, cms::Message* message);
+
+/**
+ * Marks a received Message whose body is compressed so it is decompressed on the first
+ * access of its body, a compressed TextMessage is given back its type.  The Message keeps
+ * the Consumer's dictionary that its body was compressed against.
+ *
+ * @param message
+ * 		The newly received Message.
+ * @param consumer
+ * 		The Consumer that received it, where compressed bodies are counted, NULL for
+ * 		Messages that were browsed.
+ */
+void cms_inspectReceivedMessage(CMS_Message* message, CMS_MessageConsumer* consumer);
+
+/**
+ * Decompresses the body of the Message in place if it is still compressed, throws a
+ * CMSException if the body can't be decompressed.
+ *
+ * @param message
+ * 		The Message whose body is about to be accessed.
+ */
+void cms_decompressMessageBody(CMS_Message* message);
+
+/**
+ * Gets the text of a TextMessage that was received compressed and so is held by the
+ * body of a BytesMessage, decompressing it first if needed.
+ *
+ * @param message
+ * 		The Message whose text is needed.
+ */
+std::string cms_getDecompressedText(CMS_Message* message);
+
+/**
+ * Reads the whole body of a TextMessage or BytesMessage, decompressing it first if needed.
+ * A BytesMessage is left reset to be read from the start.
+ *
+ * @param message
+ * 		The Message whose body is needed.
+ * @param body
+ * 		The string that the body is copied to.
+ */
+void cms_readMessageBody(CMS_Message* message, std::string& body);
+
+/**
+ * Computes the identifier of a dictionary with the given content.
+ *
+ * @param data
+ * 		The content of the dictionary.
+ * @param length
+ * 		The length of the content in bytes.
+ */
+unsigned int cms_compressionDictionaryId(const unsigned char* data, std::size_t length);
+
+/**
+ * Takes a reference to the dictionary, does nothing when given NULL.
+ *
+ * @param dictionary
+ * 		The dictionary to retain.
+ *
+ * @returns the dictionary.
+ */
+CMS_CompressionDictionary* cms_retainCompressionDictionary(CMS_CompressionDictionary* dictionary);
+
+/**
+ * Drops a reference to the dictionary and destroys it once the last is gone, does nothing
+ * when given NULL.
+ *
+ * @param dictionary
+ * 		The dictionary to release.
+ */
+void cms_releaseCompressionDictionary(CMS_CompressionDictionary* dictionary);
+
+#endif /* _CMS_COMPRESSION_H_ */
@@ -0,0 +1,67 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <private/CMS_Readiness.h>
+
+#include <Config.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+int cms_createReadyFd() {
+
+#ifdef HAVE_SYS_EVENTFD_H
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    return -1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_raiseReadyFd(int fd AMQC_UNUSED) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (fd >= 0) {
+        eventfd_write(fd, 1);
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_clearReadyFd(int fd AMQC_UNUSED) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (fd >= 0) {
+        // The counter is reset by a single read, it fails with EAGAIN when already clear.
+        eventfd_t value;
+        eventfd_read(fd, &value);
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_closeReadyFd(int fd AMQC_UNUSED) {
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
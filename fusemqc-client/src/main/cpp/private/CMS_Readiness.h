@@ -0,0 +1,67 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CMS_READINESS_H_
+#define _CMS_READINESS_H_
+
+#include <cms.h>
+
+/**
+ * Records that a Message may be waiting in the Consumer's prefetch buffer and wakes
+ * any cms_pollConsumers call that is waiting on the Consumer.  Called by the library
+ * whenever Messages are dispatched to the Consumer, and by the Session when a rollback
+ * or recover returns delivered Messages to the prefetch buffer without a dispatch.
+ *
+ * @param consumer
+ * 		The Consumer that may have Messages available.
+ */
+void cms_signalConsumerAvailable(CMS_MessageConsumer* consumer);
+
+/**
+ * Creates a non-blocking event descriptor that an application event loop can wait on.
+ *
+ * @returns the new descriptor or -1 if it could not be created or the platform has no
+ *          support for event descriptors.
+ */
+int cms_createReadyFd();
+
+/**
+ * Makes the given event descriptor readable, does nothing when the descriptor is -1.
+ *
+ * @param fd
+ * 		The descriptor that is to be raised.
+ */
+void cms_raiseReadyFd(int fd);
+
+/**
+ * Resets the given event descriptor so that it is no longer readable, does nothing when
+ * the descriptor is -1.
+ *
+ * @param fd
+ * 		The descriptor that is to be cleared.
+ */
+void cms_clearReadyFd(int fd);
+
+/**
+ * Closes the given event descriptor, does nothing when the descriptor is -1.
+ *
+ * @param fd
+ * 		The descriptor that is to be closed.
+ */
+void cms_closeReadyFd(int fd);
+
+#endif /* _CMS_READINESS_H_ */
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <private/CMS_SharedBody.h>
+
+#include <Config.h>
+#include <private/CMS_Types.h>
+#include <private/CMS_Compression.h>
+#include <private/CMS_Trace.h>
+
+#include <cms/Message.h>
+#include <cms/TextMessage.h>
+
+#include <activemq/commands/ActiveMQMessage.h>
+#include <activemq/commands/ActiveMQTextMessage.h>
+#include <activemq/commands/ActiveMQBytesMessage.h>
+
+#include <decaf/util/concurrent/Lock.h>
+
+#include <memory>
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    void copyHeaders(const cms::Message* source, cms::Message* target) {
+
+        target->setCMSCorrelationID(source->getCMSCorrelationID());
+        target->setCMSDeliveryMode(source->getCMSDeliveryMode());
+        target->setCMSDestination(source->getCMSDestination());
+        target->setCMSExpiration(source->getCMSExpiration());
+        target->setCMSMessageID(source->getCMSMessageID());
+        target->setCMSPriority(source->getCMSPriority());
+        target->setCMSRedelivered(source->getCMSRedelivered());
+        target->setCMSReplyTo(source->getCMSReplyTo());
+        target->setCMSTimestamp(source->getCMSTimestamp());
+        target->setCMSType(source->getCMSType());
+    }
+
+    /**
+     * Gives the target, a Message with the body that is wanted, the headers and properties
+     * of the source in place of its own.
+     */
+    void copyHeadersAndProperties(const cms::Message* source, cms::Message* target) {
+
+        target->clearProperties();
+        copyHeaders(source, target);
+        cms_copyMessageProperties(source, target);
+    }
+
+    /**
+     * Points the Destination handles that the Message lent out at the headers of the
+     * cms::Message it now holds.
+     */
+    void relendDestinations(CMS_Message* message) {
+
+        if (message->destinationHandle.destination != NULL) {
+            message->destinationHandle.destination = const_cast<cms::Destination*>(message->message->getCMSDestination());
+        }
+
+        if (message->replyToHandle.destination != NULL) {
+            message->replyToHandle.destination = const_cast<cms::Destination*>(message->message->getCMSReplyTo());
+        }
+    }
+
+    /**
+     * Creates a Message without a body that carries the headers and properties of another.
+     */
+    cms::Message* createHeaders(const cms::Message* source) {
+
+        std::auto_ptr<cms::Message> headers(new activemq::commands::ActiveMQMessage());
+
+        copyHeaders(source, headers.get());
+        cms_copyMessageProperties(source, headers.get());
+
+        return headers.release();
+    }
+
+    /**
+     * Replaces the Message held by the wrapper with one that has the same headers and
+     * properties but the body of the replacement.
+     */
+    void replaceMessage(CMS_Message* message, cms::Message* replacement) {
+
+        std::auto_ptr<cms::Message> owned(replacement);
+
+        copyHeadersAndProperties(message->message, owned.get());
+
+        delete message->message;
+        message->message = owned.release();
+
+        relendDestinations(message);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_shareMessageBody(CMS_Message* original, CMS_Message* copy) {
+
+    // The copy's own Message only carries its headers and properties.
+    std::auto_ptr<cms::Message> headers(createHeaders(original->message));
+
+    CMS_SharedBody* body = original->sharedBody;
+
+    if (body == NULL) {
+
+        // Text that is decoded lazily is settled before any copy reads it.
+        cms::TextMessage* textMessage = dynamic_cast<cms::TextMessage*>(original->message);
+        if (textMessage != NULL) {
+            textMessage->getText();
+        }
+
+        // The original keeps its headers apart from the body as well, leaving those of the
+        // shared Message free to be overwritten by whichever Message sends it.
+        std::auto_ptr<cms::Message> own(createHeaders(original->message));
+
+        body = new CMS_SharedBody;
+        body->message = original->message;
+        body->references.set(1);
+
+        original->message = own.release();
+        original->sharedBody = body;
+        relendDestinations(original);
+    }
+
+    body->references.incrementAndGet();
+
+    copy->message = headers.release();
+    copy->type = original->type;
+    copy->sharedBody = body;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+bool cms_isSharingBody(const CMS_Message* message) {
+    return message->sharedBody != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_unshareMessageBody(CMS_Message* message) {
+
+    CMS_SharedBody* body = message->sharedBody;
+
+    if (body == NULL) {
+        return;
+    }
+
+    if (body->references.get() > 1) {
+
+        cms::Message* clone = NULL;
+
+        {
+            decaf::util::concurrent::Lock lock(&body->lock);
+            clone = body->message->clone();
+        }
+
+        cms_traceBodyCopy(message);
+        replaceMessage(message, clone);
+
+    } else {
+
+        // The others are all gone, the last one takes the shared Message as it is.
+        cms::Message* shared = body->message;
+        body->message = NULL;
+        replaceMessage(message, shared);
+    }
+
+    message->sharedBody = NULL;
+    cms_releaseSharedBody(body);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_discardSharedBody(CMS_Message* message) {
+
+    CMS_SharedBody* body = message->sharedBody;
+
+    if (body == NULL) {
+        return;
+    }
+
+    if (message->type == CMS_TEXT_MESSAGE) {
+        replaceMessage(message, new activemq::commands::ActiveMQTextMessage());
+    } else {
+        replaceMessage(message, new activemq::commands::ActiveMQBytesMessage());
+    }
+
+    message->sharedBody = NULL;
+    cms_releaseSharedBody(body);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+std::string cms_getSharedText(const CMS_Message* message) {
+
+    const cms::TextMessage* textMessage = dynamic_cast<const cms::TextMessage*>(message->sharedBody->message);
+
+    return textMessage != NULL ? textMessage->getText() : std::string();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* cms_createFullCopy(CMS_Message* message) {
+
+    std::auto_ptr<cms::Message> full;
+
+    {
+        decaf::util::concurrent::Lock lock(&message->sharedBody->lock);
+        full.reset(message->sharedBody->message->clone());
+    }
+
+    cms_traceBodyCopy(message);
+    copyHeadersAndProperties(message->message, full.get());
+
+    return full.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+cms::Message* cms_lendSharedBody(CMS_Message* message) {
+
+    CMS_SharedBody* body = message->sharedBody;
+
+    body->lock.lock();
+
+    try{
+        copyHeadersAndProperties(message->message, body->message);
+    } catch(...) {
+        body->lock.unlock();
+        throw;
+    }
+
+    return body->message;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_returnSharedBody(CMS_Message* message) {
+    message->sharedBody->lock.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_releaseSharedBody(CMS_SharedBody* body) {
+
+    if (body != NULL && body->references.decrementAndGet() == 0) {
+        delete body->message;
+        delete body;
+    }
+}
@@ -0,0 +1,118 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef _CMS_SHAREDBODY_H_
+#define _CMS_SHAREDBODY_H_
+
+#include <cms.h>
+
+#include <string>
+
+namespace cms {
+    class Message;
+}
+
+struct CMS_SharedBody;
+
+/**
+ * Makes a Message a shallow copy of another, the copy has headers and properties of its
+ * own but reads the body of the original, which both share until either of them writes
+ * to it.  The original must be a TextMessage or BytesMessage whose body is not compressed,
+ * on the first copy it hands its own Message over to the shared body and keeps its headers
+ * and properties in a new one like the copy does.
+ *
+ * @param original
+ * 		The Message whose body is shared, it may itself be a shallow copy.
+ * @param copy
+ * 		The new Message that is made the copy.
+ */
+void cms_shareMessageBody(CMS_Message* original, CMS_Message* copy);
+
+/**
+ * Checks whether the Message reads a body it shares with others, which is the case for
+ * the shallow copies and for the Message they were made from.
+ *
+ * @param message
+ * 		The Message to check.
+ */
+bool cms_isSharingBody(const CMS_Message* message);
+
+/**
+ * Gives a Message that shares its body a body of its own, copying the shared body unless
+ * no other Message shares it any longer.  Called before any access to a body that has a
+ * position or that modifies it, does nothing for a Message whose body is its own.
+ *
+ * @param message
+ * 		The Message whose body is about to be accessed.
+ */
+void cms_unshareMessageBody(CMS_Message* message);
+
+/**
+ * Stops a Message sharing its body because the body is about to be replaced as a whole,
+ * a shallow copy is given an empty body rather than a copy of the shared one.
+ *
+ * @param message
+ * 		The Message whose body is about to be replaced.
+ */
+void cms_discardSharedBody(CMS_Message* message);
+
+/**
+ * Gets the text of the TextMessage body that a Message shares.
+ *
+ * @param message
+ * 		The Message whose text is needed.
+ */
+std::string cms_getSharedText(const CMS_Message* message);
+
+/**
+ * Creates a complete Message from one that shares its body, with the headers and
+ * properties of the Message and a copy of the body, the caller owns the new Message.
+ *
+ * @param message
+ * 		The Message that is to be completed.
+ */
+cms::Message* cms_createFullCopy(CMS_Message* message);
+
+/**
+ * Lends the shared Message to a Message that shares its body so it can be sent without
+ * copying the body, the shared Message is given the headers and properties of the sender.
+ * The others sharing the body wait to send or copy it until cms_returnSharedBody is called.
+ *
+ * @param message
+ * 		The Message that is being sent.
+ *
+ * @returns the shared Message, to be handed to the CMS Producer in place of the sender's.
+ */
+cms::Message* cms_lendSharedBody(CMS_Message* message);
+
+/**
+ * Returns the shared Message lent by cms_lendSharedBody once the send is over.
+ *
+ * @param message
+ * 		The Message that was sent.
+ */
+void cms_returnSharedBody(CMS_Message* message);
+
+/**
+ * Drops the share that a Message had in a shared body and destroys the body once no
+ * Message shares it, does nothing when given NULL.
+ *
+ * @param body
+ * 		The shared body to release.
+ */
+void cms_releaseSharedBody(CMS_SharedBody* body);
+
+#endif /* _CMS_SHAREDBODY_H_ */
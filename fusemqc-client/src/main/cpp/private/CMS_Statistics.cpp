@@ -0,0 +1,394 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <private/CMS_Statistics.h>
+
+#include <Config.h>
+#include <private/CMS_Types.h>
+
+#include <cms/Message.h>
+
+#include <activemq/commands/Message.h>
+
+#include <decaf/lang/System.h>
+#include <decaf/util/concurrent/Lock.h>
+
+#if !defined(__GNUC__) && defined(_WIN32)
+#include <windows.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#if defined(HAVE_CLOCK_GETTIME)
+#include <time.h>
+#elif defined(HAVE_SYS_TIME_H)
+#include <sys/time.h>
+#endif
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    // Enough stripes that threads rarely share one, each thread keeps the stripe it is
+    // first given so a stripe's cache lines stay with the core running that thread.
+    const int STRIPE_COUNT = 16;
+    const int CACHE_LINE_SIZE = 64;
+
+#if defined(__GNUC__)
+
+    inline void atomicAdd(volatile long long* target, long long amount) {
+        __sync_fetch_and_add(target, amount);
+    }
+
+    inline long long atomicGet(volatile long long* target) {
+        return __sync_fetch_and_add(target, 0LL);
+    }
+
+    inline bool atomicCompareAndSet(volatile long long* target, long long expected, long long value) {
+        return __sync_bool_compare_and_swap(target, expected, value);
+    }
+
+    inline int nextStripe() {
+        static volatile int next = 0;
+        return (int) ((unsigned int) __sync_fetch_and_add(&next, 1) % STRIPE_COUNT);
+    }
+
+    inline int currentStripe() {
+        static __thread int stripe = -1;
+        if (stripe < 0) {
+            stripe = nextStripe();
+        }
+        return stripe;
+    }
+
+#elif defined(_WIN32)
+
+    inline void atomicAdd(volatile long long* target, long long amount) {
+        InterlockedExchangeAdd64(target, amount);
+    }
+
+    inline long long atomicGet(volatile long long* target) {
+        return InterlockedExchangeAdd64(target, 0);
+    }
+
+    inline bool atomicCompareAndSet(volatile long long* target, long long expected, long long value) {
+        return InterlockedCompareExchange64(target, value, expected) == expected;
+    }
+
+    inline int nextStripe() {
+        static volatile long next = 0;
+        return (int) ((unsigned long) InterlockedIncrement(&next) % STRIPE_COUNT);
+    }
+
+    inline int currentStripe() {
+        static __declspec(thread) int stripe = -1;
+        if (stripe < 0) {
+            stripe = nextStripe();
+        }
+        return stripe;
+    }
+
+#else
+    #error "The connection statistics need atomic operations for this platform"
+#endif
+
+    inline int highestBit(unsigned long long value) {
+
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1) {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+struct CMS_StatisticsStripe {
+    volatile long long counters[CMS_STAT_COUNTER_COUNT];
+    CMS_AtomicHistogram histograms[CMS_STAT_HISTOGRAM_COUNT];
+
+    // Keeps the last fields of this stripe off the cache line holding the counters of
+    // the next one.
+    char padding[CACHE_LINE_SIZE];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+struct CMS_ConnectionStatistics {
+    char padding[CACHE_LINE_SIZE];
+    CMS_StatisticsStripe stripes[STRIPE_COUNT];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+long long cms_statisticsTime() {
+    return decaf::lang::System::nanoTime();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long cms_statisticsWallTime() {
+
+#if defined(HAVE_CLOCK_GETTIME)
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+#elif defined(HAVE_SYS_TIME_H)
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (long long) now.tv_sec * 1000000000LL + (long long) now.tv_usec * 1000LL;
+#else
+    return decaf::lang::System::currentTimeMillis() * 1000000LL;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cms_statisticsMessageSize(const cms::Message* message) {
+
+    const activemq::commands::Message* amqMessage =
+        dynamic_cast<const activemq::commands::Message*>(message);
+
+    return amqMessage != NULL ? (int) amqMessage->getSize() : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+int cms_histogramBucket(long long nanos) {
+
+    if (nanos < 4) {
+        return nanos < 0 ? 0 : (int) nanos;
+    }
+
+    // Four buckets for each power of two, picked by the two bits below the highest.
+    int bit = highestBit((unsigned long long) nanos);
+    int bucket = (bit - 1) * 4 + (int) ((nanos >> (bit - 2)) & 3);
+
+    return bucket < CMS_LATENCY_HISTOGRAM_BUCKETS ? bucket : CMS_LATENCY_HISTOGRAM_BUCKETS - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long cms_histogramBucketLowerBound(int bucket) {
+
+    if (bucket < 4) {
+        return bucket;
+    }
+
+    int bit = bucket / 4 + 1;
+    return (long long) (4 + bucket % 4) << (bit - 2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_histogramRecord(CMS_AtomicHistogram* histogram, long long nanos) {
+
+    if (nanos < 0) {
+        nanos = 0;
+    }
+
+    // The count is the sum of the buckets and is only worked out when read.
+    atomicAdd(&histogram->counts[cms_histogramBucket(nanos)], 1);
+    atomicAdd(&histogram->total, nanos);
+
+    long long max = histogram->max;
+    while (nanos > max && !atomicCompareAndSet(&histogram->max, max, nanos)) {
+        max = histogram->max;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_histogramAddTo(const CMS_AtomicHistogram* histogram, CMS_LatencyHistogram* snapshot) {
+
+    CMS_AtomicHistogram* source = const_cast<CMS_AtomicHistogram*>(histogram);
+
+    for (int i = 0; i < CMS_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+        long long count = atomicGet(&source->counts[i]);
+        snapshot->counts[i] += count;
+        snapshot->count += count;
+    }
+
+    snapshot->total += atomicGet(&source->total);
+
+    long long max = atomicGet(&source->max);
+    if (max > snapshot->max) {
+        snapshot->max = max;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_histogramReset(CMS_AtomicHistogram* histogram) {
+
+    for (int i = 0; i < CMS_LATENCY_HISTOGRAM_BUCKETS; ++i) {
+        atomicAdd(&histogram->counts[i], -atomicGet(&histogram->counts[i]));
+    }
+
+    atomicAdd(&histogram->total, -atomicGet(&histogram->total));
+
+    long long max = atomicGet(&histogram->max);
+    while (!atomicCompareAndSet(&histogram->max, max, 0)) {
+        max = atomicGet(&histogram->max);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+CMS_ConnectionStatistics* cms_createConnectionStatistics() {
+
+    CMS_ConnectionStatistics* statistics = new CMS_ConnectionStatistics;
+    memset(statistics, 0, sizeof(CMS_ConnectionStatistics));
+
+    return statistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_destroyConnectionStatistics(CMS_ConnectionStatistics* statistics) {
+    delete statistics;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_statisticsAdd(CMS_ConnectionStatistics* statistics, CMS_StatisticsCounter counter, long long amount) {
+
+    if (statistics != NULL) {
+        atomicAdd(&statistics->stripes[currentStripe()].counters[counter], amount);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_statisticsRecord(CMS_ConnectionStatistics* statistics, CMS_StatisticsHistogram histogram, long long nanos) {
+
+    if (statistics != NULL) {
+        cms_histogramRecord(&statistics->stripes[currentStripe()].histograms[histogram], nanos);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_statisticsSnapshot(const CMS_ConnectionStatistics* statistics, CMS_ConnectionStats* snapshot) {
+
+    long long counters[CMS_STAT_COUNTER_COUNT];
+    memset(counters, 0, sizeof(counters));
+    memset(snapshot, 0, sizeof(CMS_ConnectionStats));
+
+    CMS_ConnectionStatistics* source = const_cast<CMS_ConnectionStatistics*>(statistics);
+
+    for (int stripe = 0; stripe < STRIPE_COUNT; ++stripe) {
+
+        for (int i = 0; i < CMS_STAT_COUNTER_COUNT; ++i) {
+            counters[i] += atomicGet(&source->stripes[stripe].counters[i]);
+        }
+
+        cms_histogramAddTo(&source->stripes[stripe].histograms[CMS_STAT_SEND_LATENCY], &snapshot->sendLatency);
+        cms_histogramAddTo(&source->stripes[stripe].histograms[CMS_STAT_RECEIVE_WAIT], &snapshot->receiveWait);
+    }
+
+    snapshot->messagesSent = counters[CMS_STAT_MESSAGES_SENT];
+    snapshot->bytesSent = counters[CMS_STAT_BYTES_SENT];
+    snapshot->sendErrors = counters[CMS_STAT_SEND_ERRORS];
+    snapshot->messagesReceived = counters[CMS_STAT_MESSAGES_RECEIVED];
+    snapshot->bytesReceived = counters[CMS_STAT_BYTES_RECEIVED];
+    snapshot->receiveTimeouts = counters[CMS_STAT_RECEIVE_TIMEOUTS];
+    snapshot->acknowledgements = counters[CMS_STAT_ACKNOWLEDGEMENTS];
+    snapshot->commits = counters[CMS_STAT_COMMITS];
+    snapshot->rollbacks = counters[CMS_STAT_ROLLBACKS];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_statisticsReset(CMS_ConnectionStatistics* statistics) {
+
+    // Subtracting what was read rather than storing zero keeps any value that another
+    // thread adds while the reset is running.
+    for (int stripe = 0; stripe < STRIPE_COUNT; ++stripe) {
+
+        for (int i = 0; i < CMS_STAT_COUNTER_COUNT; ++i) {
+            volatile long long* counter = &statistics->stripes[stripe].counters[i];
+            atomicAdd(counter, -atomicGet(counter));
+        }
+
+        for (int i = 0; i < CMS_STAT_HISTOGRAM_COUNT; ++i) {
+            cms_histogramReset(&statistics->stripes[stripe].histograms[i]);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_clearEndpointStatistics(CMS_EndpointStatistics* statistics) {
+    memset(statistics, 0, sizeof(CMS_EndpointStatistics));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_endpointStatisticsAdd(CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter, long long amount) {
+    atomicAdd(&statistics->counters[counter], amount);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long cms_endpointStatisticsGet(const CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter) {
+    return atomicGet(&const_cast<CMS_EndpointStatistics*>(statistics)->counters[counter]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_endpointStatisticsSet(CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter, long long value) {
+
+    volatile long long* target = &statistics->counters[counter];
+
+    long long current = atomicGet(target);
+    while (!atomicCompareAndSet(target, current, value)) {
+        current = atomicGet(target);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+long long cms_endpointStatisticsTake(CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter) {
+
+    volatile long long* target = &statistics->counters[counter];
+
+    long long value = atomicGet(target);
+    while (!atomicCompareAndSet(target, value, 0)) {
+        value = atomicGet(target);
+    }
+
+    return value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_endpointStatisticsRecord(CMS_EndpointStatistics* statistics, CMS_StatisticsHistogram histogram, long long nanos) {
+    cms_histogramRecord(&statistics->histograms[histogram], nanos);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void cms_statisticsAcknowledged(CMS_Session* session, CMS_MessageConsumer* consumer) {
+
+    long long acknowledged = 0;
+
+    decaf::util::concurrent::Lock lock(&session->consumersLock);
+
+    std::vector<CMS_MessageConsumer*>::const_iterator iter = session->consumers.begin();
+    for (; iter != session->consumers.end(); ++iter) {
+
+        long long count = 0;
+
+        if (consumer == NULL) {
+            count = cms_endpointStatisticsTake(&(*iter)->statistics, CMS_STAT_UNACKNOWLEDGED);
+        } else if (*iter == consumer) {
+            count = 1;
+            cms_endpointStatisticsAdd(&consumer->statistics, CMS_STAT_UNACKNOWLEDGED, -1);
+        }
+
+        cms_endpointStatisticsAdd(&(*iter)->statistics, CMS_STAT_ACKNOWLEDGEMENTS, count);
+        acknowledged += count;
+    }
+
+    cms_statisticsAdd(session->connection->statistics, CMS_STAT_ACKNOWLEDGEMENTS, acknowledged);
+}
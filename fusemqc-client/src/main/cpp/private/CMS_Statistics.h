@@ -0,0 +1,292 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CMS_STATISTICS_H_
+#define _CMS_STATISTICS_H_
+
+#include <cms.h>
+#include <CMS_Connection.h>
+
+namespace cms {
+    class Message;
+}
+
+/**
+ * The counters that are kept for Connections, Producers and Consumers, each keeps only
+ * the counters that are reported in its statistics snapshot.
+ */
+enum CMS_StatisticsCounter {
+    CMS_STAT_MESSAGES_SENT,
+    CMS_STAT_BYTES_SENT,
+    CMS_STAT_SEND_ERRORS,
+    CMS_STAT_MESSAGES_RECEIVED,
+    CMS_STAT_BYTES_RECEIVED,
+    CMS_STAT_RECEIVE_TIMEOUTS,
+    CMS_STAT_ACKNOWLEDGEMENTS,
+    CMS_STAT_COMMITS,
+    CMS_STAT_ROLLBACKS,
+    CMS_STAT_REDELIVERED,
+    CMS_STAT_UNACKNOWLEDGED,
+    CMS_STAT_LAST_LATENCY,
+    CMS_STAT_UNMEASURED,
+    CMS_STAT_COMPRESSED_MESSAGES,
+    CMS_STAT_UNCOMPRESSED_BYTES,
+    CMS_STAT_COMPRESSED_BYTES,
+    CMS_STAT_COUNTER_COUNT
+};
+
+/**
+ * The latency histograms that are kept for Connections, Producers and Consumers.
+ */
+enum CMS_StatisticsHistogram {
+    CMS_STAT_SEND_LATENCY,
+    CMS_STAT_RECEIVE_WAIT,
+    CMS_STAT_END_TO_END_LATENCY,
+    CMS_STAT_HISTOGRAM_COUNT
+};
+
+/**
+ * A CMS_LatencyHistogram that any number of threads can record into at once, the
+ * fields are only ever updated with atomic instructions.
+ */
+struct CMS_AtomicHistogram {
+    volatile long long counts[CMS_LATENCY_HISTOGRAM_BUCKETS];
+    volatile long long total;
+    volatile long long max;
+};
+
+/**
+ * The statistics of a Connection, kept in per thread stripes so that threads sending
+ * and receiving on the same Connection don't contend for the same cache lines.
+ */
+struct CMS_ConnectionStatistics;
+
+/**
+ * The statistics of a single Producer or Consumer.  These are not striped since a
+ * Producer or Consumer is used from one thread at a time, the atomic updates are only
+ * needed for the asynchronous send completions and for snapshots taken by other threads.
+ */
+struct CMS_EndpointStatistics {
+    volatile long long counters[CMS_STAT_COUNTER_COUNT];
+    CMS_AtomicHistogram histograms[CMS_STAT_HISTOGRAM_COUNT];
+};
+
+/**
+ * Reads the monotonic clock that latencies are measured with.
+ *
+ * @returns the current time in nanoseconds from an arbitrary origin.
+ */
+long long cms_statisticsTime();
+
+/**
+ * Reads the wall clock that the end to end latency of Messages is measured with, at the
+ * best resolution the platform offers.
+ *
+ * @returns the current time in nanoseconds since the epoch.
+ */
+long long cms_statisticsWallTime();
+
+/**
+ * Gets the size in bytes that the given Message is accounted for in the statistics,
+ * the encoded size for Messages of the ActiveMQ client and zero for any other.
+ *
+ * @param message
+ * 		The Message whose size is needed, can be NULL.
+ */
+int cms_statisticsMessageSize(const cms::Message* message);
+
+/**
+ * Gets the bucket of a CMS_LatencyHistogram that the given value is counted in.
+ *
+ * @param nanos
+ * 		The value, negative values are counted as zero.
+ */
+int cms_histogramBucket(long long nanos);
+
+/**
+ * Gets the smallest value that is counted in the given bucket, the index must be valid.
+ *
+ * @param bucket
+ * 		The index of the bucket.
+ */
+long long cms_histogramBucketLowerBound(int bucket);
+
+/**
+ * Records a value into the histogram without locking.
+ *
+ * @param histogram
+ * 		The histogram to record into.
+ * @param nanos
+ * 		The value to record.
+ */
+void cms_histogramRecord(CMS_AtomicHistogram* histogram, long long nanos);
+
+/**
+ * Adds every value recorded in the histogram to the given snapshot.
+ *
+ * @param histogram
+ * 		The histogram to read.
+ * @param snapshot
+ * 		The histogram that the values are added to.
+ */
+void cms_histogramAddTo(const CMS_AtomicHistogram* histogram, CMS_LatencyHistogram* snapshot);
+
+/**
+ * Clears the histogram, values recorded while it is being cleared may be lost.
+ *
+ * @param histogram
+ * 		The histogram to clear.
+ */
+void cms_histogramReset(CMS_AtomicHistogram* histogram);
+
+/**
+ * Creates the statistics of a newly created Connection with every counter at zero.
+ */
+CMS_ConnectionStatistics* cms_createConnectionStatistics();
+
+/**
+ * Destroys the statistics of a Connection, does nothing when given NULL.
+ *
+ * @param statistics
+ * 		The statistics to destroy.
+ */
+void cms_destroyConnectionStatistics(CMS_ConnectionStatistics* statistics);
+
+/**
+ * Adds to one of the Connection's counters.
+ *
+ * @param statistics
+ * 		The statistics of the Connection, does nothing when NULL.
+ * @param counter
+ * 		The counter to add to.
+ * @param amount
+ * 		The amount added.
+ */
+void cms_statisticsAdd(CMS_ConnectionStatistics* statistics, CMS_StatisticsCounter counter, long long amount);
+
+/**
+ * Records a latency into one of the Connection's histograms.
+ *
+ * @param statistics
+ * 		The statistics of the Connection, does nothing when NULL.
+ * @param histogram
+ * 		The histogram to record into.
+ * @param nanos
+ * 		The latency in nanoseconds.
+ */
+void cms_statisticsRecord(CMS_ConnectionStatistics* statistics, CMS_StatisticsHistogram histogram, long long nanos);
+
+/**
+ * Totals the stripes of the Connection's statistics into the given snapshot.
+ *
+ * @param statistics
+ * 		The statistics of the Connection.
+ * @param snapshot
+ * 		The snapshot that is overwritten with the totals.
+ */
+void cms_statisticsSnapshot(const CMS_ConnectionStatistics* statistics, CMS_ConnectionStats* snapshot);
+
+/**
+ * Sets every counter and histogram of the Connection back to zero.
+ *
+ * @param statistics
+ * 		The statistics of the Connection.
+ */
+void cms_statisticsReset(CMS_ConnectionStatistics* statistics);
+
+/**
+ * Sets every counter and histogram of a Producer's or Consumer's statistics to zero.
+ *
+ * @param statistics
+ * 		The statistics to clear.
+ */
+void cms_clearEndpointStatistics(CMS_EndpointStatistics* statistics);
+
+/**
+ * Adds to one of the counters of a Producer or Consumer.
+ *
+ * @param statistics
+ * 		The statistics of the Producer or Consumer.
+ * @param counter
+ * 		The counter to add to.
+ * @param amount
+ * 		The amount added.
+ */
+void cms_endpointStatisticsAdd(CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter, long long amount);
+
+/**
+ * Reads one of the counters of a Producer or Consumer.
+ *
+ * @param statistics
+ * 		The statistics of the Producer or Consumer.
+ * @param counter
+ * 		The counter to read.
+ *
+ * @returns the current value of the counter.
+ */
+long long cms_endpointStatisticsGet(const CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter);
+
+/**
+ * Sets one of the counters of a Producer or Consumer that is used as a gauge.
+ *
+ * @param statistics
+ * 		The statistics of the Producer or Consumer.
+ * @param counter
+ * 		The counter to set.
+ * @param value
+ * 		The new value of the counter.
+ */
+void cms_endpointStatisticsSet(CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter, long long value);
+
+/**
+ * Reads one of the counters of a Producer or Consumer and sets it to zero in a single
+ * atomic step.
+ *
+ * @param statistics
+ * 		The statistics of the Producer or Consumer.
+ * @param counter
+ * 		The counter to take.
+ *
+ * @returns the value the counter held.
+ */
+long long cms_endpointStatisticsTake(CMS_EndpointStatistics* statistics, CMS_StatisticsCounter counter);
+
+/**
+ * Records a latency into one of the histograms of a Producer or Consumer.
+ *
+ * @param statistics
+ * 		The statistics of the Producer or Consumer.
+ * @param histogram
+ * 		The histogram to record into.
+ * @param nanos
+ * 		The latency in nanoseconds.
+ */
+void cms_endpointStatisticsRecord(CMS_EndpointStatistics* statistics, CMS_StatisticsHistogram histogram, long long nanos);
+
+/**
+ * Counts the acknowledgement of Messages received by the Session's Consumers, moving
+ * their unacknowledged Messages to the acknowledged counts.
+ *
+ * @param session
+ * 		The Session whose Messages were acknowledged.
+ * @param consumer
+ * 		The only Consumer whose Message was acknowledged for an individual acknowledgement,
+ * 		NULL when every Consumer of the Session has had its Messages acknowledged.
+ */
+void cms_statisticsAcknowledged(CMS_Session* session, CMS_MessageConsumer* consumer);
+
+#endif /* _CMS_STATISTICS_H_ */
@@ -0,0 +1,229 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CMS_TRACE_H_
+#define _CMS_TRACE_H_
+
+#include <Config.h>
+#include <CMS_Trace.h>
+#include <private/CMS_Statistics.h>
+
+#include <stddef.h>
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define CMS_TRACE_PROBE1(name, arg1) DTRACE_PROBE1(activemq_c, name, arg1)
+#define CMS_TRACE_PROBE2(name, arg1, arg2) DTRACE_PROBE2(activemq_c, name, arg1, arg2)
+#define CMS_TRACE_PROBE3(name, arg1, arg2, arg3) DTRACE_PROBE3(activemq_c, name, arg1, arg2, arg3)
+#else
+#define CMS_TRACE_PROBE1(name, arg1)
+#define CMS_TRACE_PROBE2(name, arg1, arg2)
+#define CMS_TRACE_PROBE3(name, arg1, arg2, arg3)
+#endif
+
+/**
+ * The hooks installed by cms_setTraceHooks, NULL while none are installed so that the
+ * traced operations only pay for a single test of this pointer.
+ */
+extern const CMS_TraceHooks* cms_traceHooks;
+
+/**
+ * Marks the start of a send, the returned time is also used for the send statistics.
+ *
+ * @returns the monotonic time in nanoseconds that the send started.
+ */
+inline long long cms_traceSendStart(CMS_MessageProducer* producer, CMS_Message* message) {
+
+    long long start = cms_statisticsTime();
+
+    CMS_TRACE_PROBE2(send__start, producer, message);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->beforeSend != NULL) {
+        hooks->beforeSend(producer, message, start, hooks->userData);
+    }
+
+    return start;
+}
+
+/**
+ * Marks the end of a send that started at the given time.
+ */
+inline void cms_traceSendDone(CMS_MessageProducer* producer, CMS_Message* message, cms_status status, long long start) {
+
+    CMS_TRACE_PROBE3(send__done, producer, message, status);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->afterSend != NULL) {
+        hooks->afterSend(producer, message, status, start, cms_statisticsTime(), hooks->userData);
+    }
+}
+
+/**
+ * Marks the start of a receive, the returned time is also used for the receive statistics.
+ *
+ * @returns the monotonic time in nanoseconds that the receive started.
+ */
+inline long long cms_traceReceiveStart(CMS_MessageConsumer* consumer) {
+
+    long long start = cms_statisticsTime();
+
+    CMS_TRACE_PROBE1(receive__start, consumer);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->beforeReceive != NULL) {
+        hooks->beforeReceive(consumer, start, hooks->userData);
+    }
+
+    return start;
+}
+
+/**
+ * Marks the end of a receive that started at the given time.
+ */
+inline void cms_traceReceiveDone(CMS_MessageConsumer* consumer, CMS_Message* message, cms_status status, long long start) {
+
+    CMS_TRACE_PROBE3(receive__done, consumer, message, status);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->afterReceive != NULL) {
+        hooks->afterReceive(consumer, message, status, start, cms_statisticsTime(), hooks->userData);
+    }
+}
+
+/**
+ * Marks the start of an acknowledgement.
+ *
+ * @returns the monotonic time in nanoseconds that it started, zero when no hooks are installed.
+ */
+inline long long cms_traceAcknowledgeStart(CMS_Message* message) {
+
+    CMS_TRACE_PROBE1(ack__start, message);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks == NULL) {
+        return 0;
+    }
+
+    long long start = cms_statisticsTime();
+
+    if (hooks->beforeAcknowledge != NULL) {
+        hooks->beforeAcknowledge(message, start, hooks->userData);
+    }
+
+    return start;
+}
+
+/**
+ * Marks the end of an acknowledgement that started at the given time.
+ */
+inline void cms_traceAcknowledgeDone(CMS_Message* message, cms_status status, long long start) {
+
+    CMS_TRACE_PROBE2(ack__done, message, status);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->afterAcknowledge != NULL) {
+        hooks->afterAcknowledge(message, status, start, cms_statisticsTime(), hooks->userData);
+    }
+}
+
+/**
+ * Marks the start of a commit.
+ *
+ * @returns the monotonic time in nanoseconds that it started, zero when no hooks are installed.
+ */
+inline long long cms_traceCommitStart(CMS_Session* session) {
+
+    CMS_TRACE_PROBE1(commit__start, session);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks == NULL) {
+        return 0;
+    }
+
+    long long start = cms_statisticsTime();
+
+    if (hooks->beforeCommit != NULL) {
+        hooks->beforeCommit(session, start, hooks->userData);
+    }
+
+    return start;
+}
+
+/**
+ * Marks the end of a commit that started at the given time.
+ */
+inline void cms_traceCommitDone(CMS_Session* session, cms_status status, long long start) {
+
+    CMS_TRACE_PROBE2(commit__done, session, status);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->afterCommit != NULL) {
+        hooks->afterCommit(session, status, start, cms_statisticsTime(), hooks->userData);
+    }
+}
+
+/**
+ * Marks the start of a rollback.
+ *
+ * @returns the monotonic time in nanoseconds that it started, zero when no hooks are installed.
+ */
+inline long long cms_traceRollbackStart(CMS_Session* session) {
+
+    CMS_TRACE_PROBE1(rollback__start, session);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks == NULL) {
+        return 0;
+    }
+
+    long long start = cms_statisticsTime();
+
+    if (hooks->beforeRollback != NULL) {
+        hooks->beforeRollback(session, start, hooks->userData);
+    }
+
+    return start;
+}
+
+/**
+ * Marks the end of a rollback that started at the given time.
+ */
+inline void cms_traceRollbackDone(CMS_Session* session, cms_status status, long long start) {
+
+    CMS_TRACE_PROBE2(rollback__done, session, status);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->afterRollback != NULL) {
+        hooks->afterRollback(session, status, start, cms_statisticsTime(), hooks->userData);
+    }
+}
+
+/**
+ * Marks the copy of a body that the Message shared with others.
+ */
+inline void cms_traceBodyCopy(CMS_Message* message) {
+
+    CMS_TRACE_PROBE1(body__copy, message);
+
+    const CMS_TraceHooks* hooks = cms_traceHooks;
+    if (hooks != NULL && hooks->bodyCopied != NULL) {
+        hooks->bodyCopied(message, hooks->userData);
+    }
+}
+
+#endif /* _CMS_TRACE_H_ */
@@ -19,6 +19,8 @@
 #define _CMS_TYPES_H_
 
 #include <cms.h>
+#include <private/CMS_Statistics.h>
+#include <private/CMS_Compression.h>
 
 #include <cms/ConnectionFactory.h>
 #include <cms/Connection.h>
@@ -30,6 +32,15 @@
 #include <cms/CMSException.h>
 #include <cms/QueueBrowser.h>
 #include <cms/ExceptionListener.h>
+#include <cms/MessageAvailableListener.h>
+#include <cms/MessageListener.h>
+
+#include <decaf/util/concurrent/Mutex.h>
+#include <decaf/util/concurrent/atomic/AtomicInteger.h>
+
+#include <map>
+#include <string>
+#include <vector>
 
 /**
  * Structure used to Wrap the CMS ConnectionFactory type.
@@ -45,6 +56,13 @@ struct CMS_Connection {
     cms::Connection* connection;
     cms::CMSException* lastException;
     cms::ExceptionListener* asyncExListener;
+
+    /** Event descriptor raised on asynchronous exceptions, -1 until first requested. */
+    int exceptionFd;
+    decaf::util::concurrent::Mutex exceptionFdLock;
+
+    /** Counters and latency histograms updated by everything created from this Connection. */
+    CMS_ConnectionStatistics* statistics;
 };
 
 /**
@@ -52,6 +70,18 @@ struct CMS_Connection {
  */
 struct CMS_Session {
     cms::Session* session;
+    CMS_Connection* connection;
+
+    /** The Consumers created from this Session that have not yet been destroyed. */
+    std::vector<CMS_MessageConsumer*> consumers;
+    decaf::util::concurrent::Mutex consumersLock;
+
+    /**
+     * The Destinations handed out by cms_getCachedDestination keyed by their name qualified
+     * with queue:// or topic://, they are owned by the Session.
+     */
+    std::map<std::string, CMS_Destination*> destinations;
+    decaf::util::concurrent::Mutex destinationsLock;
 };
 
 /**
@@ -59,6 +89,42 @@ struct CMS_Session {
  */
 struct CMS_MessageConsumer {
     cms::MessageConsumer* consumer;
+    CMS_Session* session;
+    cms::MessageAvailableListener* availableListener;
+
+    /**
+     * Hint of the number of Messages waiting in the prefetch buffer, this can over count
+     * when Messages expire in the buffer and is corrected when a receive finds none.
+     */
+    decaf::util::concurrent::atomic::AtomicInteger available;
+
+    /** Monitors of the cms_pollConsumers calls that are currently waiting on this Consumer. */
+    std::vector<decaf::util::concurrent::Mutex*> pollers;
+    decaf::util::concurrent::Mutex pollersLock;
+
+    /** Event descriptor that is readable while Messages may be available, -1 until first requested. */
+    int readyFd;
+
+    /** Counts of the Messages delivered to this Consumer and the time spent waiting for them. */
+    CMS_EndpointStatistics statistics;
+
+    /** The statistics of the Connection, which outlive the Session the Consumer belongs to. */
+    CMS_ConnectionStatistics* connectionStatistics;
+
+    /** Whether the end to end latency of the Messages delivered is measured. */
+    bool measureLatency;
+
+    /** The dictionaries that compressed Messages can name, keyed by their identifier. */
+    std::map<unsigned int, CMS_CompressionDictionary*> dictionaries;
+    decaf::util::concurrent::Mutex dictionariesLock;
+
+    /**
+     * The received Messages that have not been destroyed, linked through the Messages so
+     * that a receive does not allocate.  Their reference back to this Consumer is cleared
+     * when it is destroyed, a Message must not be destroyed concurrently with its Consumer.
+     */
+    CMS_Message* received;
+    decaf::util::concurrent::Mutex receivedLock;
 };
 
 /**
@@ -74,6 +140,68 @@ struct CMS_QueueBrowser {
  */
 struct CMS_MessageProducer {
     cms::MessageProducer* producer;
+    CMS_Session* session;
+
+    /** Size in bytes of the Connection's producer window, zero when unbounded. */
+    int windowSize;
+
+    /**
+     * Whether the Connection sends every Message synchronously, and whether persistent
+     * Messages are sent asynchronously because the Connection uses async sends or the
+     * Session is transacted.
+     */
+    bool alwaysSyncSend;
+    bool persistentSendsAsync;
+
+    /** Messages and bytes sent asynchronously that the broker has yet to acknowledge. */
+    decaf::util::concurrent::atomic::AtomicInteger inFlightCount;
+    decaf::util::concurrent::atomic::AtomicInteger inFlightBytes;
+
+    /** Signalled as sends complete, for senders waiting for credit and for cms_destroyProducer. */
+    decaf::util::concurrent::Mutex windowLock;
+
+    /** Counts of the Messages sent by this Producer and the time taken to send them. */
+    CMS_EndpointStatistics statistics;
+
+    /** The statistics of the Connection, which outlive the Session the Producer belongs to. */
+    CMS_ConnectionStatistics* connectionStatistics;
+
+    /** Whether every Message sent is stamped with the CMS_SEND_TIME_PROPERTY. */
+    bool stampSendTime;
+
+    /** The codec that bodies of at least compressionThreshold bytes are compressed with. */
+    int compressionCodec;
+    int compressionThreshold;
+
+    /** The dictionary that bodies are compressed against, NULL for none. */
+    CMS_CompressionDictionary* dictionary;
+};
+
+/**
+ * Structure used to Wrap the CMS Destination type.
+ */
+struct CMS_Destination {
+    cms::Destination* destination;
+    CMS_DESTINATION_TYPE type;
+
+    /** Whether the handle is owned by the library, cms_destroyDestination leaves it alone. */
+    bool borrowed;
+
+    CMS_Destination() : destination(NULL), type(CMS_QUEUE), borrowed(false) {
+    }
+};
+
+/**
+ * A cms::Message whose body is shared by an original Message and its shallow copies, each
+ * of which keeps its headers and properties in a Message of its own.  The headers and
+ * properties of the shared Message are those of the last sender that borrowed it.
+ */
+struct CMS_SharedBody {
+    cms::Message* message;
+    decaf::util::concurrent::atomic::AtomicInteger references;
+
+    /** Held while the Message is lent to a send or copied. */
+    decaf::util::concurrent::Mutex lock;
 };
 
 /**
@@ -82,14 +210,94 @@ struct CMS_MessageProducer {
 struct CMS_Message {
     cms::Message* message;
     CMS_MESSAGE_TYPE type;
+
+    /**
+     * The Consumer that received this Message, used to count its acknowledgement.  NULL
+     * for Messages that were created, cloned or browsed and once the Consumer is destroyed.
+     */
+    CMS_MessageConsumer* consumer;
+
+    /** Links in the Consumer's list of the received Messages that are still alive. */
+    CMS_Message* previousReceived;
+    CMS_Message* nextReceived;
+
+    /** Whether the body is still compressed as it was received. */
+    CMS_BodyCompression compression;
+
+    /** The dictionary that the compressed body is decompressed against, NULL for none. */
+    CMS_CompressionDictionary* dictionary;
+
+    /**
+     * The body shared with the shallow copies made by cms_cloneMessageShallow or with the
+     * Message they were made from, NULL when the body is the Message's own.
+     */
+    CMS_SharedBody* sharedBody;
+
+    /**
+     * The handles lent out by cms_borrowCMSMessageDestination and cms_borrowCMSMessageReplyTo,
+     * they refer to the headers' own Destinations.
+     */
+    CMS_Destination destinationHandle;
+    CMS_Destination replyToHandle;
+
+    /** The references held by cms_retainMessage callers, plus that of the creator. */
+    decaf::util::concurrent::atomic::AtomicInteger references;
+
+    CMS_Message() : message(NULL), type(CMS_MESSAGE), consumer(NULL), previousReceived(NULL), nextReceived(NULL),
+                    compression(CMS_BODY_PLAIN), dictionary(NULL), sharedBody(NULL), destinationHandle(),
+                    replyToHandle(), references(1) {
+        destinationHandle.borrowed = true;
+        replyToHandle.borrowed = true;
+    }
 };
 
+/** The number of stripes that the requests awaiting a reply are spread over. */
+const int CMS_REQUEST_STRIPES = 16;
+
+/** A request awaiting its reply, defined by the requestor. */
+struct CMS_PendingRequest;
+
 /**
- * Structure used to Wrap the CMS Destination type.
+ * A share of the requests awaiting a reply keyed by their sequence number, each stripe has
+ * its own lock so that requests made and answered on different threads rarely contend.
  */
-struct CMS_Destination {
-    cms::Destination* destination;
-    CMS_DESTINATION_TYPE type;
+struct CMS_RequestStripe {
+    decaf::util::concurrent::Mutex lock;
+    std::map<int, CMS_PendingRequest*> requests;
+};
+
+/**
+ * Structure used to Wrap a request/reply client, it owns the Session, the Temporary Queue
+ * that replies come back to and the Consumer of that Queue.
+ */
+struct CMS_Requestor {
+    CMS_Session* session;
+    CMS_Destination* replyTo;
+    CMS_MessageProducer* producer;
+    CMS_MessageConsumer* consumer;
+
+    /** Hands each reply to its request on the Session's dispatch thread. */
+    cms::MessageListener* listener;
+
+    /** The threads making requests take turns sending on the Session. */
+    decaf::util::concurrent::Mutex sendLock;
+
+    /** Correlation ids are this prefix, unique to the requestor, and a sequence number. */
+    std::string correlationPrefix;
+    decaf::util::concurrent::atomic::AtomicInteger sequence;
+
+    CMS_RequestStripe stripes[CMS_REQUEST_STRIPES];
+};
+
+/**
+ * The content of a compression dictionary and the identifier that Messages name it by.
+ */
+struct CMS_CompressionDictionary {
+    std::vector<unsigned char> data;
+    unsigned int id;
+
+    /** The caller's reference and those of the Producers, Consumers and Messages using it. */
+    decaf::util::concurrent::atomic::AtomicInteger references;
 };
 
 #endif /* _CMS_TYPES_H_ */
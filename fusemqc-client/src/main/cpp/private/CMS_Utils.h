@@ -148,4 +148,41 @@
         result = CMS_ERROR; \
     }
 
+/**
+ * Maps an exception that was reported asynchronously, such as the failure of an
+ * async send, onto the same CMS Error value that CMS_CATCH_EXCEPTION would assign
+ * had it been thrown from the calling thread.
+ *
+ * @param ex
+ * 		The exception whose type is to be mapped.
+ *
+ * @return the CMS Error value that describes the exception.
+ */
+inline cms_status cms_statusFromException( const cms::CMSException& ex ) {
+
+    if( dynamic_cast<const cms::CMSSecurityException*>( &ex ) != NULL ) {
+        return CMS_SECURITY_ERROR;
+    } else if( dynamic_cast<const cms::IllegalStateException*>( &ex ) != NULL ) {
+        return CMS_ILLEGAL_STATE;
+    } else if( dynamic_cast<const cms::InvalidClientIdException*>( &ex ) != NULL ) {
+        return CMS_INVALID_CLIENTID;
+    } else if( dynamic_cast<const cms::InvalidDestinationException*>( &ex ) != NULL ) {
+        return CMS_INVALID_DESTINATION;
+    } else if( dynamic_cast<const cms::InvalidSelectorException*>( &ex ) != NULL ) {
+        return CMS_INVALID_SELECTOR;
+    } else if( dynamic_cast<const cms::MessageEOFException*>( &ex ) != NULL ) {
+        return CMS_MESSAGE_EOF;
+    } else if( dynamic_cast<const cms::MessageFormatException*>( &ex ) != NULL ) {
+        return CMS_MESSAGE_FORMAT_ERROR;
+    } else if( dynamic_cast<const cms::MessageNotReadableException*>( &ex ) != NULL ) {
+        return CMS_MESSAGE_NOT_READABLE;
+    } else if( dynamic_cast<const cms::MessageNotWriteableException*>( &ex ) != NULL ) {
+        return CMS_MESSAGE_NOT_WRITABLE;
+    } else if( dynamic_cast<const cms::UnsupportedOperationException*>( &ex ) != NULL ) {
+        return CMS_UNSUPPORTEDOP;
+    }
+
+    return CMS_ERROR;
+}
+
 #endif /* CMS_UTILS_H_ */
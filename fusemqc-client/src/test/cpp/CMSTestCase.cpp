@@ -17,11 +17,16 @@
 
 #include "CMSTestCase.h"
 
+#include <stdlib.h>
+
 using namespace cms;
 
 ////////////////////////////////////////////////////////////////////////////////
 const std::string CMSTestCase::DEFAULT_BROKER_HOST = "localhost:61616";
 
+////////////////////////////////////////////////////////////////////////////////
+std::string CMSTestCase::brokerURI;
+
 ////////////////////////////////////////////////////////////////////////////////
 CMSTestCase::CMSTestCase() {
 }
@@ -29,3 +34,23 @@ CMSTestCase::CMSTestCase() {
 ////////////////////////////////////////////////////////////////////////////////
 CMSTestCase::~CMSTestCase() {
 }
+
+////////////////////////////////////////////////////////////////////////////////
+std::string CMSTestCase::getBrokerURI() {
+
+    if (!brokerURI.empty()) {
+        return brokerURI;
+    }
+
+    const char* configured = ::getenv("AMQC_TEST_BROKER_URI");
+    if (configured != NULL && *configured != '\0') {
+        return configured;
+    }
+
+    return std::string("tcp://") + DEFAULT_BROKER_HOST;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void CMSTestCase::setBrokerURI(const std::string& uri) {
+    brokerURI = uri;
+}
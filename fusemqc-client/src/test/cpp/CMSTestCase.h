@@ -21,6 +21,8 @@
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <string>
+
 namespace cms {
 
 	class CMSTestCase : public CppUnit::TestFixture {
@@ -28,11 +30,24 @@ namespace cms {
 
 		static const std::string DEFAULT_BROKER_HOST;
 
+	private:
+
+		static std::string brokerURI;
+
 	public:
 
 		CMSTestCase();
 		virtual ~CMSTestCase();
 
+		/**
+		 * Gets the URI of the broker the tests connect to, set with the -broker option
+		 * or the AMQC_TEST_BROKER_URI environment variable.  Defaults to the broker at
+		 * DEFAULT_BROKER_HOST, use loop:// to run without a broker.
+		 */
+		static std::string getBrokerURI();
+
+		static void setBrokerURI(const std::string& uri);
+
 	};
 
 }
@@ -18,6 +18,11 @@
 #include "ConnectionTest.h"
 
 #include <cms.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
+#include <CMS_Destination.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
 #include <CMS_Session.h>
 #include <CMS_Connection.h>
 #include <CMS_ConnectionFactory.h>
@@ -45,7 +50,7 @@ void ConnectionTest::testConnectToNullHost() {
 ////////////////////////////////////////////////////////////////////////////////
 void ConnectionTest::testConnectToValidHost() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -79,7 +84,7 @@ void ConnectionTest::testConnectToInvalidHost() {
 ////////////////////////////////////////////////////////////////////////////////
 void ConnectionTest::testCreateSessionFromConnection() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -113,7 +118,7 @@ void ConnectionTest::testGetErrorString() {
     const int length = 256;
     char buffer[256] = {};
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -126,3 +131,81 @@ void ConnectionTest::testGetErrorString() {
     CPPUNIT_ASSERT(cms_destroyConnectionFactory(factory) == CMS_SUCCESS);
     CPPUNIT_ASSERT(cms_destroyConnection(connection) == CMS_SUCCESS);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+void ConnectionTest::testConnectionStatistics() {
+
+    const std::string uri = CMSTestCase::getBrokerURI();
+
+    CMS_ConnectionFactory* factory = NULL;
+    CMS_Connection* connection = NULL;
+    CMS_Session* session = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_ConnectionStats stats;
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&factory, uri.c_str(), NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultConnection(factory, &connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultSession(connection, &session) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT(cms_getConnectionStatistics(connection, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.messagesSent);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.sendLatency.count);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "statistics");
+    for( int i = 0; i < 5; ++i ) {
+        CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    }
+    cms_destroyMessage(message);
+
+    for( int i = 0; i < 5; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 10) == CMS_RECEIVE_TIMEDOUT);
+
+    CPPUNIT_ASSERT(cms_getConnectionStatistics(connection, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(5LL, stats.messagesSent);
+    CPPUNIT_ASSERT_EQUAL(5LL, stats.messagesReceived);
+    CPPUNIT_ASSERT_EQUAL(1LL, stats.receiveTimeouts);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.sendErrors);
+    CPPUNIT_ASSERT(stats.bytesSent > 0);
+    CPPUNIT_ASSERT_EQUAL(stats.bytesSent, stats.bytesReceived);
+    CPPUNIT_ASSERT_EQUAL(5LL, stats.sendLatency.count);
+    CPPUNIT_ASSERT_EQUAL(5LL, stats.receiveWait.count);
+
+    // Percentiles are the highest value of their bucket but never above the max.
+    long long latency = 0;
+    CPPUNIT_ASSERT(cms_getLatencyHistogramPercentile(&stats.sendLatency, 100.0, &latency) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(stats.sendLatency.max, latency);
+    CPPUNIT_ASSERT(cms_getLatencyHistogramPercentile(&stats.sendLatency, 50.0, &latency) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(latency > 0 && latency <= stats.sendLatency.max);
+
+    CPPUNIT_ASSERT_EQUAL(3LL, cms_getLatencyHistogramBucketLowerBound(3));
+    CPPUNIT_ASSERT_EQUAL(1024LL, cms_getLatencyHistogramBucketLowerBound(36));
+    CPPUNIT_ASSERT_EQUAL(1280LL, cms_getLatencyHistogramBucketLowerBound(37));
+    CPPUNIT_ASSERT_EQUAL(-1LL, cms_getLatencyHistogramBucketLowerBound(CMS_LATENCY_HISTOGRAM_BUCKETS));
+
+    CPPUNIT_ASSERT(cms_resetConnectionStatistics(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getConnectionStatistics(connection, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.messagesSent);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.messagesReceived);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.receiveWait.count);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.receiveWait.max);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+
+    CPPUNIT_ASSERT(cms_destroySession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnection(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnectionFactory(factory) == CMS_SUCCESS);
+}
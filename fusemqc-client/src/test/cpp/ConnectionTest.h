@@ -30,6 +30,7 @@ namespace cms {
         CPPUNIT_TEST( testConnectToInvalidHost );
         CPPUNIT_TEST( testCreateSessionFromConnection );
         CPPUNIT_TEST( testGetErrorString );
+        CPPUNIT_TEST( testConnectionStatistics );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -44,6 +45,7 @@ namespace cms {
         void testConnectToInvalidHost();
         void testCreateSessionFromConnection();
         void testGetErrorString();
+        void testConnectionStatistics();
 
     };
 
@@ -0,0 +1,794 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LoopbackTest.h"
+
+#include <Config.h>
+
+#include <CMS_ConnectionFactory.h>
+#include <CMS_Connection.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+
+#include <loopback/LoopbackBroker.h>
+
+#include <decaf/lang/Thread.h>
+#include <decaf/lang/Runnable.h>
+#include <decaf/util/concurrent/CountDownLatch.h>
+
+#include <string>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <poll.h>
+#endif
+
+using namespace cms;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    class ExceptionFdFetcher : public decaf::lang::Runnable {
+    public:
+
+        CMS_Connection* connection;
+        cms_status status;
+        int fd;
+
+        ExceptionFdFetcher() : decaf::lang::Runnable(), connection(NULL), status(CMS_ERROR), fd(-1) {}
+        virtual ~ExceptionFdFetcher() {}
+
+        virtual void run() {
+            status = cms_getConnectionExceptionFd(connection, &fd);
+        }
+    };
+
+    class ProducerDestroyer : public decaf::lang::Runnable {
+    public:
+
+        CMS_MessageProducer* producer;
+        decaf::util::concurrent::CountDownLatch destroyed;
+
+        ProducerDestroyer(CMS_MessageProducer* producer) :
+            decaf::lang::Runnable(), producer(producer), destroyed(1) {}
+        virtual ~ProducerDestroyer() {}
+
+        virtual void run() {
+            cms_destroyProducer(producer);
+            destroyed.countDown();
+        }
+    };
+
+    class BlockingSender : public decaf::lang::Runnable {
+    public:
+
+        CMS_MessageProducer* producer;
+        CMS_Message* message;
+        cms_status status;
+        decaf::util::concurrent::CountDownLatch sent;
+
+        BlockingSender(CMS_MessageProducer* producer, CMS_Message* message) :
+            decaf::lang::Runnable(), producer(producer), message(message), status(CMS_ERROR), sent(1) {}
+        virtual ~BlockingSender() {}
+
+        virtual void run() {
+            status = cms_producerSendWithDefaults(producer, message);
+            sent.countDown();
+        }
+    };
+
+    void countDownOnSuccess(CMS_MessageProducer*, cms_status status, void* userData) {
+        if (status == CMS_SUCCESS) {
+            static_cast<decaf::util::concurrent::CountDownLatch*>(userData)->countDown();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackTest::LoopbackTest() : CMSTestCase(), factory(NULL), connection(NULL), session(NULL) {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+LoopbackTest::~LoopbackTest() {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::setUp() {
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&factory, "loop://LoopbackTest", NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createConnection(factory, &connection, NULL, NULL, "LoopbackTest") == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultSession(connection, &session) == CMS_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::tearDown() {
+
+    CPPUNIT_ASSERT(cms_destroySession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_closeConnection(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnection(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnectionFactory(factory) == CMS_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testQueueSendReceive() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    CPPUNIT_ASSERT(cms_createDestination(session, CMS_QUEUE, "loopback.queue", &destination) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createProducer(session, destination, &producer) == CMS_SUCCESS);
+
+    // Messages sent before a Consumer exists wait on the Queue.
+    for( int i = 0; i < 10; ++i ) {
+        CPPUNIT_ASSERT(cms_createTextMessage(session, &message, "loopback") == CMS_SUCCESS);
+        CPPUNIT_ASSERT(cms_setMessageIntProperty(message, "index", i) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_createDefaultConsumer(session, destination, &consumer) == CMS_SUCCESS);
+
+    // Nothing is delivered until the Connection is started.
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+    cms_startConnection(connection);
+
+    for( int i = 0; i < 10; ++i ) {
+
+        CMS_Message* received = NULL;
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+
+        int index = -1;
+        char text[32] = "";
+        CPPUNIT_ASSERT(cms_getMessageIntProperty(received, "index", &index) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(cms_getMessageText(received, text, sizeof(text)) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(i, index);
+        CPPUNIT_ASSERT(std::string("loopback") == std::string(text));
+
+        cms_destroyMessage(received);
+    }
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 100) == CMS_RECEIVE_TIMEDOUT);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testQueueCompetingConsumers() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer1 = NULL;
+    CMS_MessageConsumer* consumer2 = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createDestination(session, CMS_QUEUE, "loopback.competing", &destination);
+    cms_createDefaultConsumer(session, destination, &consumer1);
+    cms_createDefaultConsumer(session, destination, &consumer2);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, NULL);
+    for( int i = 0; i < 20; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    // Each Message on a Queue goes to exactly one of its Consumers.
+    int received = 0;
+    while( cms_consumerReceiveNoWait(consumer1, &message) == CMS_SUCCESS && message != NULL ) {
+        cms_destroyMessage(message);
+        received++;
+    }
+
+    CPPUNIT_ASSERT_EQUAL(10, received);
+
+    while( cms_consumerReceiveNoWait(consumer2, &message) == CMS_SUCCESS && message != NULL ) {
+        cms_destroyMessage(message);
+        received++;
+    }
+
+    CPPUNIT_ASSERT_EQUAL(20, received);
+
+    cms_destroyConsumer(consumer1);
+    cms_destroyConsumer(consumer2);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testTopicFanOut() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer1 = NULL;
+    CMS_MessageConsumer* consumer2 = NULL;
+    CMS_MessageConsumer* noLocal = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_TOPIC, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer1);
+    cms_createDefaultConsumer(session, destination, &consumer2);
+    cms_createConsumer(session, destination, &noLocal, NULL, 1);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, NULL);
+    for( int i = 0; i < 5; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    for( int i = 0; i < 5; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer1, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_destroyMessage(message);
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer2, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_destroyMessage(message);
+    }
+
+    // The no local Consumer shares the producing Connection so it sees nothing.
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(noLocal, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+
+    cms_destroyConsumer(consumer1);
+    cms_destroyConsumer(consumer2);
+    cms_destroyConsumer(noLocal);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testSelector() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* red = NULL;
+    CMS_MessageConsumer* large = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    CPPUNIT_ASSERT(cms_createConsumer(session, destination, &red, "color = 'red'", 0) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createConsumer(session, destination, &large,
+                                      "size BETWEEN 10 AND 20 AND color NOT IN ('red')", 0) == CMS_SUCCESS);
+    cms_createProducer(session, destination, &producer);
+
+    CPPUNIT_ASSERT(cms_createConsumer(session, destination, &large, "color = ", 0) != CMS_SUCCESS);
+
+    cms_startConnection(connection);
+
+    const char* colors[] = { "red", "blue", "green", "red" };
+    const int sizes[] = { 15, 15, 5, 1 };
+
+    for( int i = 0; i < 4; ++i ) {
+        cms_createTextMessage(session, &message, NULL);
+        cms_setMessageStringProperty(message, "color", colors[i]);
+        cms_setMessageIntProperty(message, "size", sizes[i]);
+        cms_producerSendWithDefaults(producer, message);
+        cms_destroyMessage(message);
+    }
+
+    char color[32] = "";
+
+    for( int i = 0; i < 2; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(red, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_getMessageStringProperty(message, "color", color, sizeof(color));
+        CPPUNIT_ASSERT(std::string("red") == std::string(color));
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(large, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message != NULL);
+    cms_getMessageStringProperty(message, "color", color, sizeof(color));
+    CPPUNIT_ASSERT(std::string("blue") == std::string(color));
+    cms_destroyMessage(message);
+
+    // The green Message matches neither selector and stays on the Queue.
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(red, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(large, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+
+    cms_destroyConsumer(red);
+    cms_destroyConsumer(large);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testClientAckRecover() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Session* session = NULL;
+
+    cms_createSession(connection, &session, CMS_CLIENT_ACKNOWLEDGE);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, NULL);
+    for( int i = 0; i < 3; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    int redelivered = 1;
+
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_getCMSMessageRedelivered(message, &redelivered);
+        CPPUNIT_ASSERT(redelivered == 0);
+        cms_destroyMessage(message);
+    }
+
+    // Nothing was acknowledged so recover delivers all three again.
+    CPPUNIT_ASSERT(cms_recoverSession(session) == CMS_SUCCESS);
+
+    for( int i = 0; i < 3; ++i ) {
+
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_getCMSMessageRedelivered(message, &redelivered);
+        CPPUNIT_ASSERT(redelivered != 0);
+
+        if( i == 2 ) {
+            CPPUNIT_ASSERT(cms_acknowledgeMessage(message) == CMS_SUCCESS);
+        }
+
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_recoverSession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(session);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testTransactionRollback() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Session* session = NULL;
+
+    cms_createSession(connection, &session, CMS_SESSION_TRANSACTED);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_createTextMessage(session, &message, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    // Sends are held until commit, a rollback discards them.
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+    CPPUNIT_ASSERT(cms_rollbackSession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+
+    CPPUNIT_ASSERT(cms_createTextMessage(session, &message, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+    CPPUNIT_ASSERT(cms_commitSession(session) == CMS_SUCCESS);
+
+    for( int i = 0; i < 2; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_destroyMessage(message);
+    }
+
+    // Rolling back the receives puts both Messages back.
+    CPPUNIT_ASSERT(cms_rollbackSession(session) == CMS_SUCCESS);
+
+    for( int i = 0; i < 2; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_commitSession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_rollbackSession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(message == NULL);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(session);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testDurableSubscription() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createDestination(session, CMS_TOPIC, "loopback.durable", &destination);
+    cms_createProducer(session, destination, &producer);
+
+    CPPUNIT_ASSERT(cms_createDurableConsumer(session, destination, &consumer, "durable", NULL, 0) == CMS_SUCCESS);
+    cms_destroyConsumer(consumer);
+
+    // The subscription keeps Messages published while it has no Consumer.
+    cms_createTextMessage(session, &message, NULL);
+    for( int i = 0; i < 3; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_createDurableConsumer(session, destination, &consumer, "durable", NULL, 0) == CMS_SUCCESS);
+
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_unsubscribeSessionDurableConsumer(session, "durable") != CMS_SUCCESS);
+    cms_destroyConsumer(consumer);
+    CPPUNIT_ASSERT(cms_unsubscribeSessionDurableConsumer(session, "durable") == CMS_SUCCESS);
+
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testPendingBacklog() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_ConsumerStats stats;
+    int ready[1] = { -1 };
+    int readyCount = 0;
+    int pending = -1;
+
+    cms_createDestination(session, CMS_QUEUE, "loopback.backlog", &destination);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_createTextMessage(session, &message, NULL) == CMS_SUCCESS);
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    }
+    cms_destroyMessage(message);
+
+    // The backlog is dispatched as the Consumer is created, before it can be signalled.
+    CPPUNIT_ASSERT(cms_createDefaultConsumer(session, destination, &consumer) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(3, pending);
+    CPPUNIT_ASSERT(cms_getConsumerStatistics(consumer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.prefetched);
+    CPPUNIT_ASSERT(cms_pollConsumers(&consumer, 1, 0, ready, &readyCount) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1, readyCount);
+    CPPUNIT_ASSERT_EQUAL(0, ready[0]);
+
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(message != NULL);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, pending);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testTrySendWouldBlock() {
+
+    CMS_ConnectionFactory* flowFactory = NULL;
+    CMS_Connection* flowConnection = NULL;
+    CMS_Session* flowSession = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+    CMS_ProducerStats stats;
+    long long credit = 0;
+
+    loopback::LoopbackBroker* broker = loopback::LoopbackBroker::getInstance("LoopbackFlow");
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&flowFactory, "loop://LoopbackFlow?connection.producerWindowSize=4096",
+                                               NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createConnection(flowFactory, &flowConnection, NULL, NULL, "LoopbackFlow") == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultSession(flowConnection, &flowSession) == CMS_SUCCESS);
+    cms_createDestination(flowSession, CMS_QUEUE, "loopback.flow", &destination);
+    cms_createDefaultConsumer(flowSession, destination, &consumer);
+    cms_createProducer(flowSession, destination, &producer);
+    cms_startConnection(flowConnection);
+
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, &credit) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(4096LL, credit);
+
+    std::string body(1000, 'x');
+    cms_createTextMessage(flowSession, &message, body.c_str());
+
+    // Without receipts nothing gives back credit, so the window fills.
+    broker->setReceiptsWithheld(true);
+
+    cms_status result = CMS_SUCCESS;
+    int sent = 0;
+
+    while (sent < 16 && (result = cms_producerTrySend(producer, message)) == CMS_SUCCESS) {
+        ++sent;
+    }
+
+    CPPUNIT_ASSERT(result == CMS_WOULD_BLOCK);
+    CPPUNIT_ASSERT(sent > 0 && sent < 5);
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, &credit) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(credit < 4096);
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL((long long) sent, (long long) stats.inFlightCount);
+    CPPUNIT_ASSERT(cms_producerTrySend(producer, message) == CMS_WOULD_BLOCK);
+
+    // The receipts return the credit.
+    broker->setReceiptsWithheld(false);
+
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, &credit) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(4096LL, credit);
+    CPPUNIT_ASSERT(cms_producerTrySend(producer, message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, &credit) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(4096LL, credit);
+
+    // Non persistent sends don't wait for the broker either, they use up the same window.
+    broker->setReceiptsWithheld(true);
+    CPPUNIT_ASSERT(cms_setProducerDeliveryMode(producer, CMS_MSG_NON_PERSISTENT) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, &credit) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(credit < 4096);
+
+    for (int i = 0; i < 16 && cms_producerTrySend(producer, message) == CMS_SUCCESS; ++i) {
+        ++sent;
+    }
+
+    CPPUNIT_ASSERT(cms_producerTrySend(producer, message) == CMS_WOULD_BLOCK);
+    cms_destroyMessage(message);
+
+    // The Producer is only deleted once its outstanding sends have completed.
+    ProducerDestroyer destroyer(producer);
+    decaf::lang::Thread destroyerThread(&destroyer);
+    destroyerThread.start();
+
+    CPPUNIT_ASSERT(!destroyer.destroyed.await(100));
+    broker->setReceiptsWithheld(false);
+    CPPUNIT_ASSERT(destroyer.destroyed.await(2000));
+    destroyerThread.join();
+
+    for (int i = 0; i < sent + 2; ++i) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    cms_destroyConsumer(consumer);
+    cms_destroyDestination(destination);
+    cms_destroySession(flowSession);
+    cms_closeConnection(flowConnection);
+    cms_destroyConnection(flowConnection);
+    cms_destroyConnectionFactory(flowFactory);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testSendTimeout() {
+
+    CMS_ConnectionFactory* receiptFactory = NULL;
+    CMS_Connection* receiptConnection = NULL;
+    CMS_Session* receiptSession = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+
+    loopback::LoopbackBroker* broker = loopback::LoopbackBroker::getInstance("LoopbackReceipts");
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&receiptFactory, "loop://LoopbackReceipts", NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createConnection(receiptFactory, &receiptConnection, NULL, NULL, "LoopbackReceipts") == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultSession(receiptConnection, &receiptSession) == CMS_SUCCESS);
+    cms_createDestination(receiptSession, CMS_QUEUE, "loopback.receipts", &destination);
+    cms_createDefaultConsumer(receiptSession, destination, &consumer);
+    cms_createProducer(receiptSession, destination, &producer);
+    cms_startConnection(receiptConnection);
+
+    cms_createTextMessage(receiptSession, &message, "receipt");
+
+    // The broker takes the Message but its receipt never comes.
+    broker->setReceiptsWithheld(true);
+    cms_status result = cms_producerSendWithTimeOut(producer, message, 100);
+    broker->setReceiptsWithheld(false);
+
+    CPPUNIT_ASSERT(result == CMS_SEND_TIMEDOUT);
+    CPPUNIT_ASSERT(cms_producerSendWithTimeOut(producer, message, 100) == CMS_SUCCESS);
+
+    for (int i = 0; i < 2; ++i) {
+
+        CMS_Message* received = NULL;
+
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(received);
+    }
+
+    // A send that fails at once is reported for what it is.
+    CPPUNIT_ASSERT(cms_closeProducer(producer) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_producerSendWithTimeOut(producer, message, 100) == CMS_ILLEGAL_STATE);
+    cms_destroyMessage(message);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(receiptSession);
+    cms_closeConnection(receiptConnection);
+    cms_destroyConnection(receiptConnection);
+    cms_destroyConnectionFactory(receiptFactory);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testConnectionExceptionFd() {
+
+    int fd = -1;
+    CPPUNIT_ASSERT(cms_getConnectionExceptionFd(NULL, &fd) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_getConnectionExceptionFd(connection, NULL) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_clearConnectionExceptionFd(NULL) == CMS_ERROR);
+
+#ifdef HAVE_SYS_EVENTFD_H
+    // Callers racing for the first request of the descriptor must all be given the same one.
+    const int count = 8;
+    ExceptionFdFetcher fetchers[count];
+    decaf::lang::Thread* threads[count];
+
+    for (int i = 0; i < count; ++i) {
+        fetchers[i].connection = connection;
+        threads[i] = new decaf::lang::Thread(&fetchers[i]);
+    }
+    for (int i = 0; i < count; ++i) {
+        threads[i]->start();
+    }
+    for (int i = 0; i < count; ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    CPPUNIT_ASSERT(cms_getConnectionExceptionFd(connection, &fd) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(fd >= 0);
+    for (int i = 0; i < count; ++i) {
+        CPPUNIT_ASSERT(fetchers[i].status == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(fd, fetchers[i].fd);
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    CPPUNIT_ASSERT_EQUAL(0, ::poll(&pfd, 1, 0));
+
+    loopback::LoopbackBroker::getInstance("LoopbackTest")->fail(cms::CMSException("Transport failed"));
+
+    CPPUNIT_ASSERT_EQUAL(1, ::poll(&pfd, 1, 1000));
+    CPPUNIT_ASSERT(pfd.revents & POLLIN);
+
+    // Stays readable until cleared, clearing an idle descriptor is harmless.
+    CPPUNIT_ASSERT_EQUAL(1, ::poll(&pfd, 1, 0));
+    CPPUNIT_ASSERT(cms_clearConnectionExceptionFd(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, ::poll(&pfd, 1, 0));
+    CPPUNIT_ASSERT(cms_clearConnectionExceptionFd(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, ::poll(&pfd, 1, 0));
+#else
+    CPPUNIT_ASSERT(cms_getConnectionExceptionFd(connection, &fd) == CMS_UNSUPPORTEDOP);
+    CPPUNIT_ASSERT(cms_clearConnectionExceptionFd(connection) == CMS_SUCCESS);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LoopbackTest::testShallowCloneSendsInParallel() {
+
+    CMS_ConnectionFactory* parallelFactory = NULL;
+    CMS_Connection* parallelConnection = NULL;
+    CMS_Session* parallelSession = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+    CMS_Message* copies[2] = { NULL, NULL };
+    decaf::util::concurrent::CountDownLatch acknowledged(1);
+
+    loopback::LoopbackBroker* broker = loopback::LoopbackBroker::getInstance("LoopbackParallel");
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&parallelFactory, "loop://LoopbackParallel", NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createConnection(parallelFactory, &parallelConnection, NULL, NULL, "LoopbackParallel") == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultSession(parallelConnection, &parallelSession) == CMS_SUCCESS);
+    cms_createDestination(parallelSession, CMS_QUEUE, "loopback.parallel", &destination);
+    cms_createDefaultConsumer(parallelSession, destination, &consumer);
+    cms_createProducer(parallelSession, destination, &producer);
+    cms_startConnection(parallelConnection);
+
+    cms_createTextMessage(parallelSession, &message, "shared");
+    CPPUNIT_ASSERT(cms_cloneMessageShallow(message, &copies[0]) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_cloneMessageShallow(message, &copies[1]) == CMS_SUCCESS);
+
+    // The first send waits for its receipt without holding on to the body they share.
+    broker->setReceiptsWithheld(true);
+
+    BlockingSender sender(producer, copies[0]);
+    decaf::lang::Thread senderThread(&sender);
+    senderThread.start();
+
+    CMS_Message* received = NULL;
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+    cms_destroyMessage(received);
+
+    CPPUNIT_ASSERT(cms_producerSendAsync(producer, copies[1], countDownOnSuccess, &acknowledged) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+    cms_destroyMessage(received);
+    CPPUNIT_ASSERT(!sender.sent.await(0));
+
+    broker->setReceiptsWithheld(false);
+
+    CPPUNIT_ASSERT(sender.sent.await(2000));
+    senderThread.join();
+    CPPUNIT_ASSERT(sender.status == CMS_SUCCESS);
+    CPPUNIT_ASSERT(acknowledged.await(2000));
+
+    cms_destroyMessage(message);
+    cms_destroyMessage(copies[0]);
+    cms_destroyMessage(copies[1]);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(parallelSession);
+    cms_closeConnection(parallelConnection);
+    cms_destroyConnection(parallelConnection);
+    cms_destroyConnectionFactory(parallelFactory);
+}
@@ -0,0 +1,80 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CMS_LOOPBACKTEST_H_
+#define _CMS_LOOPBACKTEST_H_
+
+#include <CMSTestCase.h>
+
+#include <cms.h>
+
+namespace cms {
+
+    /**
+     * Exercises the C API against the in-process loop:// broker, these tests run
+     * whether or not an ActiveMQ broker is available.  Tests that need the broker to
+     * withhold receipts or fail its transport live here as well.
+     */
+    class LoopbackTest : public CMSTestCase {
+
+        CPPUNIT_TEST_SUITE( LoopbackTest );
+        CPPUNIT_TEST( testQueueSendReceive );
+        CPPUNIT_TEST( testQueueCompetingConsumers );
+        CPPUNIT_TEST( testTopicFanOut );
+        CPPUNIT_TEST( testSelector );
+        CPPUNIT_TEST( testClientAckRecover );
+        CPPUNIT_TEST( testTransactionRollback );
+        CPPUNIT_TEST( testDurableSubscription );
+        CPPUNIT_TEST( testPendingBacklog );
+        CPPUNIT_TEST( testTrySendWouldBlock );
+        CPPUNIT_TEST( testSendTimeout );
+        CPPUNIT_TEST( testConnectionExceptionFd );
+        CPPUNIT_TEST( testShallowCloneSendsInParallel );
+        CPPUNIT_TEST_SUITE_END();
+
+    private:
+
+        CMS_ConnectionFactory* factory;
+        CMS_Connection* connection;
+        CMS_Session* session;
+
+    public:
+
+        LoopbackTest();
+        virtual ~LoopbackTest();
+
+        virtual void setUp();
+        virtual void tearDown();
+
+        void testQueueSendReceive();
+        void testQueueCompetingConsumers();
+        void testTopicFanOut();
+        void testSelector();
+        void testClientAckRecover();
+        void testTransactionRollback();
+        void testDurableSubscription();
+        void testPendingBacklog();
+        void testTrySendWouldBlock();
+        void testSendTimeout();
+        void testConnectionExceptionFd();
+        void testShallowCloneSendsInParallel();
+
+    };
+
+}
+
+#endif /* _CMS_LOOPBACKTEST_H_ */
@@ -17,20 +17,50 @@
 
 #include "MessageConsumerTest.h"
 
+#include <Config.h>
+
 #include <cms.h>
 #include <CMS_Connection.h>
 #include <CMS_Session.h>
 #include <CMS_Destination.h>
 #include <CMS_TextMessage.h>
+#include <CMS_BytesMessage.h>
 #include <CMS_MessageProducer.h>
 #include <CMS_MessageConsumer.h>
 
 #include <decaf/lang/Thread.h>
 
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <poll.h>
+#endif
+
 using namespace cms;
 using namespace decaf;
 using namespace decaf::lang;
 
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    struct ChunkCompletion {
+        std::string group;
+        long long length;
+        cms_status status;
+    };
+
+    void chunksComplete(const char* groupId, long long length, cms_status status, void* userData) {
+
+        ChunkCompletion* completion = (ChunkCompletion*) userData;
+        completion->group = groupId;
+        completion->length = length;
+        completion->status = status;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 MessageConsumerTest::MessageConsumerTest() {
 }
@@ -241,3 +271,422 @@ void MessageConsumerTest::testTransactionRollback() {
     cms_destroyMessage(received);
     CPPUNIT_ASSERT(cms_commitSession(session) == CMS_SUCCESS);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testPollConsumers() {
+
+    CMS_Destination* destinations[2] = { NULL, NULL };
+    CMS_MessageConsumer* consumers[2] = { NULL, NULL };
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+
+    int ready[2] = { -1, -1 };
+    int readyCount = -1;
+
+    for( int i = 0; i < 2; ++i ) {
+        cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destinations[i]);
+        cms_createDefaultConsumer(session, destinations[i], &consumers[i]);
+    }
+
+    cms_createProducer(session, NULL, &producer);
+    cms_setProducerDeliveryMode(producer, CMS_MSG_NON_PERSISTENT);
+
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_pollConsumers(NULL, 2, 0, ready, &readyCount) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_pollConsumers(consumers, 2, 0, NULL, &readyCount) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_pollConsumers(consumers, 2, 0, ready, NULL) == CMS_ERROR);
+
+    CPPUNIT_ASSERT(cms_pollConsumers(consumers, 2, 0, ready, &readyCount) == CMS_RECEIVE_TIMEDOUT);
+    CPPUNIT_ASSERT_EQUAL(0, readyCount);
+    CPPUNIT_ASSERT(cms_pollConsumers(consumers, 2, 100, ready, &readyCount) == CMS_RECEIVE_TIMEDOUT);
+    CPPUNIT_ASSERT_EQUAL(0, readyCount);
+
+    cms_createTextMessage(session, &message, "poll");
+    CPPUNIT_ASSERT(cms_producerSendToDestination(producer, message, destinations[1],
+                                                 CMS_MSG_NON_PERSISTENT, 4, 0) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_pollConsumers(consumers, 2, 2000, ready, &readyCount) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1, readyCount);
+    CPPUNIT_ASSERT_EQUAL(1, ready[0]);
+
+    CMS_Message* received = NULL;
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumers[1], &received) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(received != NULL);
+    cms_destroyMessage(received);
+
+    CPPUNIT_ASSERT(cms_pollConsumers(consumers, 2, 0, ready, &readyCount) == CMS_RECEIVE_TIMEDOUT);
+    CPPUNIT_ASSERT_EQUAL(0, readyCount);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumers[0], &received) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(received == NULL);
+
+    cms_destroyProducer(producer);
+
+    for( int i = 0; i < 2; ++i ) {
+        cms_destroyConsumer(consumers[i]);
+        cms_destroyDestination(destinations[i]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testConsumerReadyFd() {
+
+#ifdef HAVE_SYS_EVENTFD_H
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+    CMS_Message* received = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_setProducerDeliveryMode(producer, CMS_MSG_NON_PERSISTENT);
+
+    int fd = -1;
+    CPPUNIT_ASSERT(cms_getConsumerReadyFd(NULL, &fd) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_getConsumerReadyFd(consumer, NULL) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_getConsumerReadyFd(consumer, &fd) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(fd >= 0);
+
+    int again = -1;
+    CPPUNIT_ASSERT(cms_getConsumerReadyFd(consumer, &again) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(fd, again);
+
+    cms_startConnection(connection);
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    CPPUNIT_ASSERT_EQUAL(0, ::poll(&pfd, 1, 100));
+
+    cms_createTextMessage(session, &message, "ready");
+    for( int i = 0; i < 3; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT_EQUAL(1, ::poll(&pfd, 1, 2000));
+    CPPUNIT_ASSERT((pfd.revents & POLLIN) != 0);
+
+    int count = 0;
+    while( count < 3 ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(received);
+        count++;
+    }
+
+    CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &received) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(received == NULL);
+
+    pfd.revents = 0;
+    CPPUNIT_ASSERT_EQUAL(0, ::poll(&pfd, 1, 100));
+
+    cms_destroyProducer(producer);
+    cms_destroyConsumer(consumer);
+    cms_destroyDestination(destination);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testConsumerStatistics() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Session* session = NULL;
+    CMS_ConsumerStats stats;
+
+    cms_createSession(connection, &session, CMS_CLIENT_ACKNOWLEDGE);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "statistics");
+    for( int i = 0; i < 3; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_getConsumerStatistics(consumer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.messagesDelivered);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.messagesAcknowledged);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.messagesUnacknowledged);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.prefetched);
+
+    // The recovered Messages are delivered again as redelivered.
+    cms_recoverSession(session);
+
+    for( int i = 0; i < 3; ++i ) {
+
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+
+        if( i == 2 ) {
+            CPPUNIT_ASSERT(cms_acknowledgeMessage(message) == CMS_SUCCESS);
+        }
+
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_getConsumerStatistics(consumer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(6LL, stats.messagesDelivered);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.messagesAcknowledged);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.messagesUnacknowledged);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.messagesRedelivered);
+    CPPUNIT_ASSERT_EQUAL(6LL, stats.deliveryWait.count);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(session);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testEndToEndLatency() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_ConsumerLatency latency;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_setConsumerLatencyMeasurement(consumer, 1) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_setProducerSendTimeStamp(producer, 1) == CMS_SUCCESS);
+
+    cms_createTextMessage(session, &message, "latency");
+    cms_producerSendWithDefaults(producer, message);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    long long sendTime = 0;
+    CPPUNIT_ASSERT(cms_getMessageLongProperty(message, CMS_SEND_TIME_PROPERTY, &sendTime) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(sendTime > 0);
+    cms_destroyMessage(message);
+
+    // Without the send time stamp the CMSTimestamp is used, without either the
+    // Message can't be measured.
+    cms_setProducerSendTimeStamp(producer, 0);
+    cms_createTextMessage(session, &message, "latency");
+    cms_producerSendWithDefaults(producer, message);
+    cms_setProducerDisableMessageTimeStamp(producer, 1);
+    cms_producerSendWithDefaults(producer, message);
+    cms_destroyMessage(message);
+
+    for( int i = 0; i < 2; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_getConsumerLatency(consumer, &latency, 1) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(2LL, latency.latency.count);
+    CPPUNIT_ASSERT_EQUAL(1LL, latency.unmeasured);
+    CPPUNIT_ASSERT(latency.lastLatency >= 0);
+    CPPUNIT_ASSERT(latency.latency.max >= latency.lastLatency);
+
+    CPPUNIT_ASSERT(cms_getConsumerLatency(consumer, &latency, 0) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, latency.latency.count);
+    CPPUNIT_ASSERT_EQUAL(0LL, latency.unmeasured);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testPendingCount() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Session* session = NULL;
+    int pending = -1;
+
+    cms_createSession(connection, &session, CMS_CLIENT_ACKNOWLEDGE);
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(NULL, &pending) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, pending);
+
+    cms_createTextMessage(session, &message, NULL);
+    for( int i = 0; i < 5; ++i ) {
+        cms_producerSendWithDefaults(producer, message);
+    }
+    cms_destroyMessage(message);
+
+    for( int i = 0; i < 5; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, pending);
+
+    // The unacknowledged Messages go back into the prefetch buffer.
+    cms_recoverSession(session);
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(5, pending);
+    CPPUNIT_ASSERT(cms_getSessionPendingCount(session, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(5, pending);
+
+    for( int i = 0; i < 2; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveNoWait(consumer, &message) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(3, pending);
+    CPPUNIT_ASSERT(cms_getSessionPendingCount(session, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(3, pending);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(session);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testReceiveChunked() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    char path[] = "/tmp/amqc-chunked-XXXXXX";
+    int fd = mkstemp(path);
+    CPPUNIT_ASSERT(fd >= 0);
+    unlink(path);
+
+    unsigned char contents[2500];
+    for( int i = 0; i < 2500; ++i ) {
+        contents[i] = (unsigned char) (i * 13);
+    }
+    CPPUNIT_ASSERT_EQUAL(2500, (int) write(fd, contents, 2500));
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    char sentGroup[128];
+    CPPUNIT_ASSERT(cms_producerSendFile(producer, fd, 0, 2500, 1000, sentGroup, (int) sizeof(sentGroup)) == CMS_SUCCESS);
+    close(fd);
+
+    unsigned char payload[2500];
+    ChunkCompletion completion = { "", -1, CMS_ERROR };
+
+    CMS_ChunkSink sink;
+    memset(&sink, 0, sizeof(sink));
+    sink.type = CMS_CHUNK_SINK_MEMORY;
+    sink.buffer = payload;
+    sink.capacity = sizeof(payload);
+    sink.complete = chunksComplete;
+    sink.userData = &completion;
+
+    char group[128];
+    long long length = 0;
+
+    CPPUNIT_ASSERT(cms_consumerReceiveChunked(consumer, &sink, 2000, group, (int) sizeof(group), &length) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string(sentGroup), std::string(group));
+    CPPUNIT_ASSERT_EQUAL(2500LL, length);
+    CPPUNIT_ASSERT(memcmp(contents, payload, 2500) == 0);
+    CPPUNIT_ASSERT_EQUAL(std::string(sentGroup), completion.group);
+    CPPUNIT_ASSERT_EQUAL(2500LL, completion.length);
+    CPPUNIT_ASSERT_EQUAL((int) CMS_SUCCESS, completion.status);
+
+    // A group that starts part way through is reported rather than written.
+    cms_createBytesMessage(session, &message, contents, 1000);
+    cms_setMessageStringProperty(message, CMS_GROUP_ID_PROPERTY, "partial");
+    cms_setMessageIntProperty(message, CMS_GROUP_SEQUENCE_PROPERTY, 2);
+    cms_setMessageLongProperty(message, CMS_CHUNK_OFFSET_PROPERTY, 1000);
+    cms_setMessageLongProperty(message, CMS_CHUNK_TOTAL_PROPERTY, 2500);
+    cms_setMessageBooleanProperty(message, CMS_CHUNK_FINAL_PROPERTY, 0);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveChunked(consumer, &sink, 2000, NULL, 0, &length) == CMS_MESSAGE_FORMAT_ERROR);
+    CPPUNIT_ASSERT_EQUAL(0LL, length);
+    CPPUNIT_ASSERT_EQUAL((int) CMS_MESSAGE_FORMAT_ERROR, completion.status);
+
+    // Nothing more arrives, the missing chunk times out.
+    CPPUNIT_ASSERT(cms_consumerReceiveChunked(consumer, &sink, 100, NULL, 0, &length) == CMS_RECEIVE_TIMEDOUT);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageConsumerTest::testAcknowledgeAfterConsumerDestroyed() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_Message* received[3] = { NULL, NULL, NULL };
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Session* session = NULL;
+    CMS_ConnectionStats stats;
+
+    cms_createSession(connection, &session, CMS_INDIVIDUAL_ACKNOWLEDGE);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "outlives");
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    }
+    cms_destroyMessage(message);
+
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received[i], 1000) == CMS_SUCCESS);
+    }
+
+    CPPUNIT_ASSERT(cms_acknowledgeMessage(received[0]) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getConnectionStatistics(connection, &stats) == CMS_SUCCESS);
+    long long acknowledgements = stats.acknowledgements;
+
+    // The Messages still held must let go of the Consumer as it is destroyed.
+    CPPUNIT_ASSERT(cms_destroyMessage(received[1]) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConsumer(consumer) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT(cms_acknowledgeMessage(received[2]) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_acknowledgeMessage(received[0]) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT(cms_getConnectionStatistics(connection, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(acknowledgements, stats.acknowledgements);
+
+    CPPUNIT_ASSERT(cms_destroyMessage(received[2]) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyMessage(received[0]) == CMS_SUCCESS);
+
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+    cms_destroySession(session);
+}
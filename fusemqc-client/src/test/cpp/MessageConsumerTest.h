@@ -29,6 +29,13 @@ namespace cms {
         CPPUNIT_TEST( testAutoAckConsumerReceive );
         CPPUNIT_TEST( testClientAckConsumerReceive );
         CPPUNIT_TEST( testIndividualAckConsumerReceive );
+        CPPUNIT_TEST( testPollConsumers );
+        CPPUNIT_TEST( testConsumerReadyFd );
+        CPPUNIT_TEST( testConsumerStatistics );
+        CPPUNIT_TEST( testEndToEndLatency );
+        CPPUNIT_TEST( testPendingCount );
+        CPPUNIT_TEST( testReceiveChunked );
+        CPPUNIT_TEST( testAcknowledgeAfterConsumerDestroyed );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -41,6 +48,13 @@ namespace cms {
         void testClientAckConsumerReceive();
         void testIndividualAckConsumerReceive();
         void testTransactionRollback();
+        void testPollConsumers();
+        void testConsumerReadyFd();
+        void testConsumerStatistics();
+        void testEndToEndLatency();
+        void testPendingCount();
+        void testReceiveChunked();
+        void testAcknowledgeAfterConsumerDestroyed();
 
     };
 
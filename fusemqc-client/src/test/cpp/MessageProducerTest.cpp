@@ -22,14 +22,41 @@
 #include <CMS_Session.h>
 #include <CMS_Destination.h>
 #include <CMS_TextMessage.h>
+#include <CMS_BytesMessage.h>
+#include <CMS_Compression.h>
 #include <CMS_MessageProducer.h>
 #include <CMS_MessageConsumer.h>
+#include <CMS_Trace.h>
 
 #include <decaf/lang/Thread.h>
+#include <decaf/util/concurrent/CountDownLatch.h>
+
+#include <string>
+#include <vector>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 using namespace cms;
 using namespace decaf;
 using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    void countDownOnSuccess(CMS_MessageProducer*, cms_status status, void* userData) {
+        if (status == CMS_SUCCESS) {
+            static_cast<CountDownLatch*>(userData)->countDown();
+        }
+    }
+
+    void countBodyCopy(CMS_Message*, void* userData) {
+        (*static_cast<int*>(userData))++;
+    }
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 MessageProducerTest::MessageProducerTest() {
@@ -294,7 +321,7 @@ void MessageProducerTest::testSend() {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-void MessageProducerTest::testSendWithTimeoutMessageExpires() {
+void MessageProducerTest::testSendWithTimeToLiveMessageExpires() {
 
     CMS_Destination* destination = NULL;
     CMS_Message* message = NULL;
@@ -304,14 +331,13 @@ void MessageProducerTest::testSendWithTimeoutMessageExpires() {
     cms_createTemporaryDestination(session, CMS_TEMPORARY_TOPIC, &destination);
     cms_createDefaultConsumer(session, destination, &consumer);
     cms_createProducer(session, destination, &producer);
-    cms_setProducerDeliveryMode(producer, CMS_MSG_NON_PERSISTENT);
 
     cms_startConnection(connection);
 
     cms_createTextMessage(session, &message, NULL);
 
-    // Send with 1 Second TTL
-    cms_producerSendWithTimeOut(producer, message, 500);
+    // Send with a half Second TTL
+    cms_producerSend(producer, message, CMS_MSG_NON_PERSISTENT, 4, 500);
 
     Thread::sleep(750);
 
@@ -343,8 +369,11 @@ void MessageProducerTest::testSendWithTimeoutMessageArrives() {
 
     cms_createTextMessage(session, &message, NULL);
 
-    // Send with 1 Second TTL
-    cms_producerSendWithTimeOut(producer, message, 5000);
+    CPPUNIT_ASSERT(cms_producerSendWithTimeOut(NULL, message, 5000) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_producerSendWithTimeOut(producer, NULL, 5000) == CMS_ERROR);
+
+    // Wait at most 5 Seconds for the send to complete
+    CPPUNIT_ASSERT(cms_producerSendWithTimeOut(producer, message, 5000) == CMS_SUCCESS);
 
     Thread::sleep(500);
 
@@ -352,9 +381,616 @@ void MessageProducerTest::testSendWithTimeoutMessageArrives() {
     CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
     CPPUNIT_ASSERT(NULL != received);
 
+    // The time out bounds the send, it must not be applied as the time to live
+    long long expiration = -1;
+    CPPUNIT_ASSERT(cms_getCMSMessageExpiration(received, &expiration) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, expiration);
+
+    cms_destroyMessage(received);
+    cms_destroyMessage(message);
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testSendAsync() {
+
+    static const int MSG_COUNT = 100;
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_setProducerDeliveryMode(producer, CMS_MSG_PERSISTENT);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "Async");
+
+    CountDownLatch done(MSG_COUNT);
+
+    CPPUNIT_ASSERT(cms_producerSendAsync(producer, message, NULL, &done) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_producerSendAsync(NULL, message, &countDownOnSuccess, &done) == CMS_ERROR);
+
+    for (int i = 0; i < MSG_COUNT; ++i) {
+        CPPUNIT_ASSERT(cms_producerSendAsync(producer, message, &countDownOnSuccess, &done) == CMS_SUCCESS);
+    }
+
+    CPPUNIT_ASSERT(done.await(10000));
+
+    for (int i = 0; i < MSG_COUNT; ++i) {
+        CMS_Message* received = NULL;
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(received);
+    }
+
+    cms_destroyMessage(message);
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testTrySend() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    long long credit = 0;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "TrySend");
+
+    // The default Connection has no producer window so the credit is unbounded.
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, NULL) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_getProducerAvailableCredit(producer, &credit) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(-1LL, credit);
+
+    CPPUNIT_ASSERT(cms_producerTrySend(NULL, message) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_producerTrySend(producer, NULL) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_producerTrySend(producer, message) == CMS_SUCCESS);
+
+    CMS_Message* received = NULL;
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(NULL != received);
+
     cms_destroyMessage(received);
     cms_destroyMessage(message);
     cms_destroyConsumer(consumer);
     cms_destroyProducer(producer);
     cms_destroyDestination(destination);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testProducerStatistics() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_ProducerStats stats;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, NULL) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.messagesSent);
+
+    cms_createTextMessage(session, &message, "statistics");
+    for( int i = 0; i < 3; ++i ) {
+        CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    }
+
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.messagesSent);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.sendErrors);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.inFlightCount);
+    CPPUNIT_ASSERT_EQUAL(3LL, stats.sendLatency.count);
+    CPPUNIT_ASSERT(stats.bytesSent > 0);
+
+    // Asynchronous sends are counted before their callbacks run.
+    CountDownLatch done(2);
+    for( int i = 0; i < 2; ++i ) {
+        CPPUNIT_ASSERT(cms_producerSendAsync(producer, message, &countDownOnSuccess, &done) == CMS_SUCCESS);
+    }
+    CPPUNIT_ASSERT(done.await(10000));
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(5LL, stats.messagesSent);
+    CPPUNIT_ASSERT_EQUAL(0LL, stats.sendErrors);
+
+    for( int i = 0; i < 5; ++i ) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(message);
+    }
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testCompression() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_ProducerStats producerStats;
+    CMS_ConsumerStats consumerStats;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    if (cms_setProducerCompression(producer, CMS_COMPRESSION_ZLIB, 256) == CMS_UNSUPPORTEDOP) {
+        cms_destroyConsumer(consumer);
+        cms_destroyProducer(producer);
+        cms_destroyDestination(destination);
+        return;
+    }
+
+    int codec = CMS_COMPRESSION_NONE;
+    int threshold = 0;
+    CPPUNIT_ASSERT(cms_getProducerCompression(producer, &codec, &threshold) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL((int) CMS_COMPRESSION_ZLIB, codec);
+    CPPUNIT_ASSERT_EQUAL(256, threshold);
+
+    std::string text;
+    for( int i = 0; i < 100; ++i ) {
+        text += "{\"symbol\":\"AMQ\",\"price\":42},";
+    }
+
+    unsigned char bytes[1024];
+    for( int i = 0; i < 1024; ++i ) {
+        bytes[i] = (unsigned char) (i % 16);
+    }
+
+    cms_createTextMessage(session, &message, text.c_str());
+    cms_setMessageIntProperty(message, "sequence", 1);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    cms_createBytesMessage(session, &message, bytes, 1024);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    // Bodies under the threshold are sent as they are.
+    cms_createTextMessage(session, &message, "small");
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    int type = -1;
+    int exists = 0;
+    int sequence = 0;
+    std::string received(text.size() + 1, '\0');
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageType(message, &type) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL((int) CMS_TEXT_MESSAGE, type);
+    CPPUNIT_ASSERT(cms_messagePropertyExists(message, CMS_COMPRESSION_PROPERTY, &exists) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1, exists);
+    CPPUNIT_ASSERT(cms_getMessageIntProperty(message, "sequence", &sequence) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1, sequence);
+    CPPUNIT_ASSERT(cms_getMessageText(message, &received[0], (int) received.size()) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(text, std::string(received.c_str()));
+    cms_destroyMessage(message);
+
+    unsigned char body[1024];
+    int length = 0;
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageType(message, &type) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL((int) CMS_BYTES_MESSAGE, type);
+    CPPUNIT_ASSERT(cms_getBytesMessageBodyLength(message, &length) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1024, length);
+    CPPUNIT_ASSERT(cms_readBytesFromBytesMessage(message, body, 1024) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(memcmp(bytes, body, 1024) == 0);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_messagePropertyExists(message, CMS_COMPRESSION_PROPERTY, &exists) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, exists);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, &producerStats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(2LL, producerStats.compression.messages);
+    CPPUNIT_ASSERT_EQUAL((long long) text.size() + 1024, producerStats.compression.uncompressedBytes);
+    CPPUNIT_ASSERT(producerStats.compression.compressedBytes < producerStats.compression.uncompressedBytes / 4);
+
+    CPPUNIT_ASSERT(cms_getConsumerStatistics(consumer, &consumerStats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(2LL, consumerStats.compression.messages);
+    CPPUNIT_ASSERT_EQUAL(producerStats.compression.uncompressedBytes, consumerStats.compression.uncompressedBytes);
+    CPPUNIT_ASSERT_EQUAL(producerStats.compression.compressedBytes, consumerStats.compression.compressedBytes);
+
+    // A size that the body could never expand to is rejected before anything is allocated.
+    cms_createBytesMessage(session, &message, bytes, 16);
+    cms_setMessageStringProperty(message, CMS_COMPRESSION_PROPERTY, "zlib");
+    cms_setMessageIntProperty(message, CMS_COMPRESSED_SIZE_PROPERTY, INT_MAX);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getBytesMessageBodyLength(message, &length) == CMS_MESSAGE_FORMAT_ERROR);
+    cms_destroyMessage(message);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testDictionaryCompression() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageConsumer* other = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_CompressionDictionary* dictionary = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_TOPIC, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createDefaultConsumer(session, destination, &other);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    if (cms_setProducerCompression(producer, CMS_COMPRESSION_ZLIB, 0) == CMS_UNSUPPORTEDOP) {
+        cms_destroyConsumer(consumer);
+        cms_destroyConsumer(other);
+        cms_destroyProducer(producer);
+        cms_destroyDestination(destination);
+        return;
+    }
+
+    const int SAMPLES = 20;
+    CMS_Message* samples[SAMPLES];
+    char text[128];
+
+    for( int i = 0; i < SAMPLES; ++i ) {
+        sprintf(text, "{\"symbol\":\"AMQ%d\",\"price\":%d,\"side\":\"%s\",\"venue\":\"XNAS\"}",
+                i % 5, 100 + i, i % 2 ? "BUY" : "SELL");
+        cms_createTextMessage(session, &samples[i], text);
+    }
+
+    CPPUNIT_ASSERT(cms_trainCompressionDictionary(samples, SAMPLES, 1024, &dictionary) == CMS_SUCCESS);
+
+    for( int i = 0; i < SAMPLES; ++i ) {
+        cms_destroyMessage(samples[i]);
+    }
+
+    long long id = 0;
+    const unsigned char* data = NULL;
+    int length = 0;
+
+    CPPUNIT_ASSERT(cms_getCompressionDictionaryId(dictionary, &id) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getCompressionDictionaryData(dictionary, &data, &length) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(length > 0 && length <= 1024);
+
+    CPPUNIT_ASSERT(cms_setProducerCompressionDictionary(producer, dictionary) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_addConsumerCompressionDictionary(consumer, dictionary) == CMS_SUCCESS);
+
+    // The Producer and Consumer hold their own references.
+    CPPUNIT_ASSERT(cms_destroyCompressionDictionary(dictionary) == CMS_SUCCESS);
+
+    std::string sent = "{\"symbol\":\"AMQ2\",\"price\":117,\"side\":\"BUY\",\"venue\":\"XNAS\"}";
+    cms_createTextMessage(session, &message, sent.c_str());
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    long long named = 0;
+    char received[128];
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageLongProperty(message, CMS_COMPRESSION_DICTIONARY_PROPERTY, &named) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(id, named);
+    CPPUNIT_ASSERT(cms_getMessageText(message, received, (int) sizeof(received)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(sent, std::string(received));
+    cms_destroyMessage(message);
+
+    // A Consumer without the dictionary can't get at the body.
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(other, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageText(message, received, (int) sizeof(received)) == CMS_UNSUPPORTEDOP);
+    cms_destroyMessage(message);
+
+    CMS_ProducerStats stats;
+    CPPUNIT_ASSERT(cms_getProducerStatistics(producer, &stats) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1LL, stats.compression.messages);
+    CPPUNIT_ASSERT(stats.compression.compressedBytes < stats.compression.uncompressedBytes);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyConsumer(other);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testSendFile() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    char path[] = "/tmp/amqc-sendfile-XXXXXX";
+    int fd = mkstemp(path);
+    CPPUNIT_ASSERT(fd >= 0);
+    unlink(path);
+
+    unsigned char contents[10000];
+    for( int i = 0; i < 10000; ++i ) {
+        contents[i] = (unsigned char) (i * 7);
+    }
+    CPPUNIT_ASSERT_EQUAL(10000, (int) write(fd, contents, 10000));
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    char groupId[128];
+
+    // Sends all but the first hundred bytes, in chunks of 4 KB.
+    CPPUNIT_ASSERT(cms_producerSendFile(producer, fd, 100, 9900, 4096, groupId, (int) sizeof(groupId)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(strlen(groupId) > 0);
+
+    // Asking for more than the file holds sends nothing.
+    CPPUNIT_ASSERT(cms_producerSendFile(producer, fd, 100, 10000, 4096, NULL, 0) == CMS_ERROR);
+
+    const int lengths[] = { 4096, 4096, 1708 };
+    long long received = 0;
+
+    for( int i = 0; i < 3; ++i ) {
+
+        char group[128];
+        int sequence = 0;
+        long long offset = -1;
+        long long total = 0;
+        int last = 0;
+        int length = 0;
+        unsigned char body[4096];
+
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(cms_getMessageStringProperty(message, CMS_GROUP_ID_PROPERTY, group, (int) sizeof(group)) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(std::string(groupId), std::string(group));
+        CPPUNIT_ASSERT(cms_getMessageIntProperty(message, CMS_GROUP_SEQUENCE_PROPERTY, &sequence) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(i + 1, sequence);
+        CPPUNIT_ASSERT(cms_getMessageLongProperty(message, CMS_CHUNK_OFFSET_PROPERTY, &offset) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(received, offset);
+        CPPUNIT_ASSERT(cms_getMessageLongProperty(message, CMS_CHUNK_TOTAL_PROPERTY, &total) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(9900LL, total);
+        CPPUNIT_ASSERT(cms_getMessageBooleanProperty(message, CMS_CHUNK_FINAL_PROPERTY, &last) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(i == 2 ? 1 : 0, last);
+
+        CPPUNIT_ASSERT(cms_getBytesMessageBodyLength(message, &length) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(lengths[i], length);
+        CPPUNIT_ASSERT(cms_readBytesFromBytesMessage(message, body, length) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(memcmp(contents + 100 + received, body, length) == 0);
+        cms_destroyMessage(message);
+
+        received += length;
+    }
+
+    close(fd);
+
+    // An empty file is still sent, as a single empty chunk.
+    char emptyPath[] = "/tmp/amqc-sendfile-empty-XXXXXX";
+    fd = mkstemp(emptyPath);
+    CPPUNIT_ASSERT(fd >= 0);
+    unlink(emptyPath);
+
+    CPPUNIT_ASSERT(cms_producerSendFile(producer, fd, 0, 0, 4096, groupId, (int) sizeof(groupId)) == CMS_SUCCESS);
+    close(fd);
+
+    char group[128];
+    long long offset = -1;
+    long long total = -1;
+    int last = 0;
+    int length = -1;
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageStringProperty(message, CMS_GROUP_ID_PROPERTY, group, (int) sizeof(group)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string(groupId), std::string(group));
+    CPPUNIT_ASSERT(cms_getMessageLongProperty(message, CMS_CHUNK_OFFSET_PROPERTY, &offset) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, offset);
+    CPPUNIT_ASSERT(cms_getMessageLongProperty(message, CMS_CHUNK_TOTAL_PROPERTY, &total) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, total);
+    CPPUNIT_ASSERT(cms_getMessageBooleanProperty(message, CMS_CHUNK_FINAL_PROPERTY, &last) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1, last);
+    CPPUNIT_ASSERT(cms_getBytesMessageBodyLength(message, &length) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, length);
+    cms_destroyMessage(message);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testSendToDestinations() {
+
+    CMS_Destination* destinations[4] = { NULL, NULL, NULL, NULL };
+    CMS_MessageConsumer* consumers[4] = { NULL, NULL, NULL, NULL };
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destinations[0]);
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destinations[1]);
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_TOPIC, &destinations[2]);
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destinations[3]);
+
+    for (int i = 0; i < 4; ++i) {
+        cms_createDefaultConsumer(session, destinations[i], &consumers[i]);
+    }
+
+    cms_createProducer(session, NULL, &producer);
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "everywhere");
+    CPPUNIT_ASSERT(cms_producerSendToDestinations(producer, message, destinations, 0, 1, 4, 0) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_producerSendToDestinations(producer, message, destinations, 4, 1, 4, 0) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    // Each Destination receives its own copy, addressed to itself.
+    for (int i = 0; i < 4; ++i) {
+
+        char text[32];
+        int equal = 0;
+        CMS_Destination* destination = NULL;
+
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumers[i], &message, 2000) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(cms_getMessageText(message, text, (int) sizeof(text)) == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(std::string("everywhere"), std::string(text));
+
+        CPPUNIT_ASSERT(cms_getCMSMessageDestination(message, &destination) == CMS_SUCCESS);
+        cms_compareDestinations(destination, destinations[i], &equal);
+        CPPUNIT_ASSERT(equal != 0);
+
+        cms_destroyDestination(destination);
+        cms_destroyMessage(message);
+        cms_destroyConsumer(consumers[i]);
+        cms_destroyDestination(destinations[i]);
+    }
+
+    cms_destroyProducer(producer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testSendToName() {
+
+    CMS_Destination* queue = NULL;
+    CMS_Destination* cached = NULL;
+    CMS_Destination* topic = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_Message* message = NULL;
+
+    CPPUNIT_ASSERT(cms_getDestinationByName(session, "queue://cms.test.SendToName", &queue) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getCachedDestination(session, CMS_QUEUE, "cms.test.SendToName", &cached) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(queue == cached);
+    CPPUNIT_ASSERT(cms_getDestinationByName(session, "cms.test.SendToName", &cached) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(queue == cached);
+    CPPUNIT_ASSERT(cms_getDestinationByName(session, "topic://cms.test.SendToName", &topic) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(queue != topic);
+    CPPUNIT_ASSERT(cms_getCachedDestination(session, CMS_TEMPORARY_QUEUE, "cms.test.SendToName", &cached) == CMS_ERROR);
+
+    // The handles belong to the Session, destroying one is harmless.
+    CPPUNIT_ASSERT(cms_destroyDestination(queue) == CMS_SUCCESS);
+
+    // The Queue outlives the test on a real broker, anything left from an earlier run goes.
+    drainDestination(queue);
+
+    cms_createDefaultConsumer(session, queue, &consumer);
+    cms_createProducer(session, NULL, &producer);
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "routed");
+    CPPUNIT_ASSERT(cms_producerSendToName(producer, "queue://cms.test.SendToName", message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    char text[32];
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageText(message, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("routed"), std::string(text));
+    cms_destroyMessage(message);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageProducerTest::testShallowCloneSendSharesBody() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_Message* copies[3] = { NULL, NULL, NULL };
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    const char* regions[3] = { "eu", "us", "apac" };
+
+    int bodyCopies = 0;
+    CMS_TraceHooks hooks;
+    memset(&hooks, 0, sizeof(hooks));
+    hooks.bodyCopied = countBodyCopy;
+    hooks.userData = &bodyCopies;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_setTraceHooks(&hooks) == CMS_SUCCESS);
+
+    std::string body(64 * 1024, 'x');
+    cms_createTextMessage(session, &message, body.c_str());
+
+    for (int i = 0; i < 3; ++i) {
+        CPPUNIT_ASSERT(cms_cloneMessageShallow(message, &copies[i]) == CMS_SUCCESS);
+        cms_setMessageStringProperty(copies[i], "region", regions[i]);
+    }
+
+    // Every copy and then the original are sent from the one body they share.
+    for (int i = 0; i < 3; ++i) {
+        CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, copies[i]) == CMS_SUCCESS);
+    }
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT_EQUAL(0, bodyCopies);
+
+    int exists = 1;
+    char text[32];
+    std::vector<char> receivedText(body.size() + 1);
+    for (int i = 0; i < 4; ++i) {
+
+        CMS_Message* received = NULL;
+
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(cms_getMessageText(received, &receivedText[0], (int) receivedText.size()) == CMS_SUCCESS);
+        CPPUNIT_ASSERT(body == std::string(&receivedText[0]));
+
+        // A sender's properties are not left behind for the next one.
+        if (i < 3) {
+            CPPUNIT_ASSERT(cms_getMessageStringProperty(received, "region", text, (int) sizeof(text)) == CMS_SUCCESS);
+            CPPUNIT_ASSERT_EQUAL(std::string(regions[i]), std::string(text));
+        } else {
+            CPPUNIT_ASSERT(cms_messagePropertyExists(received, "region", &exists) == CMS_SUCCESS);
+            CPPUNIT_ASSERT(exists == 0);
+        }
+
+        cms_destroyMessage(received);
+    }
+
+    // Cloning in full is what copies the body.
+    CMS_Message* clone = NULL;
+    CPPUNIT_ASSERT(cms_cloneMessage(copies[0], &clone) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(1, bodyCopies);
+    cms_destroyMessage(clone);
+
+    CPPUNIT_ASSERT(cms_setTraceHooks(NULL) == CMS_SUCCESS);
+
+    cms_destroyMessage(message);
+    for (int i = 0; i < 3; ++i) {
+        cms_destroyMessage(copies[i]);
+    }
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
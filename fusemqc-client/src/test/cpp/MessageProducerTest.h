@@ -34,8 +34,17 @@ namespace cms {
         CPPUNIT_TEST( testSend );
         CPPUNIT_TEST( testSendWithDefaults );
         CPPUNIT_TEST( testSendToDestination );
-        CPPUNIT_TEST( testSendWithTimeoutMessageExpires );
+        CPPUNIT_TEST( testSendWithTimeToLiveMessageExpires );
         CPPUNIT_TEST( testSendWithTimeoutMessageArrives );
+        CPPUNIT_TEST( testSendAsync );
+        CPPUNIT_TEST( testTrySend );
+        CPPUNIT_TEST( testProducerStatistics );
+        CPPUNIT_TEST( testCompression );
+        CPPUNIT_TEST( testDictionaryCompression );
+        CPPUNIT_TEST( testSendFile );
+        CPPUNIT_TEST( testSendToDestinations );
+        CPPUNIT_TEST( testSendToName );
+        CPPUNIT_TEST( testShallowCloneSendSharesBody );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -52,8 +61,17 @@ namespace cms {
         void testSend();
         void testSendWithDefaults();
         void testSendToDestination();
-        void testSendWithTimeoutMessageExpires();
+        void testSendWithTimeToLiveMessageExpires();
         void testSendWithTimeoutMessageArrives();
+        void testSendAsync();
+        void testTrySend();
+        void testProducerStatistics();
+        void testCompression();
+        void testDictionaryCompression();
+        void testSendFile();
+        void testSendToDestinations();
+        void testSendToName();
+        void testShallowCloneSendSharesBody();
 
     };
 
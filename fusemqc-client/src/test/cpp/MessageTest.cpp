@@ -20,6 +20,10 @@
 #include <CMS_Message.h>
 #include <CMS_Destination.h>
 #include <CMS_BytesMessage.h>
+#include <CMS_TextMessage.h>
+#include <CMS_Connection.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
 
 #include <decaf/lang/Integer.h>
 
@@ -841,3 +845,168 @@ void MessageTest::testCMSMessageType() {
     cms_destroyMessage(message);
     delete [] outValue;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageTest::testRetainMessage() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_retainMessage(NULL) == CMS_ERROR);
+
+    cms_createTextMessage(session, &message, "shared");
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, message) == CMS_SUCCESS);
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_retainMessage(message) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_retainMessage(message) == CMS_SUCCESS);
+
+    // The receiver's own reference goes first, the holders can still read the Message.
+    CPPUNIT_ASSERT(cms_destroyMessage(message) == CMS_SUCCESS);
+
+    char text[32];
+    CPPUNIT_ASSERT(cms_getMessageText(message, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("shared"), std::string(text));
+    CPPUNIT_ASSERT(cms_releaseMessage(message) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT(cms_getMessageText(message, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("shared"), std::string(text));
+    CPPUNIT_ASSERT(cms_releaseMessage(message) == CMS_SUCCESS);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageTest::testShallowClone() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_Message* first = NULL;
+    CMS_Message* second = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &message, "fan out");
+    CPPUNIT_ASSERT(cms_cloneMessageShallow(message, &first) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_cloneMessageShallow(first, &second) == CMS_SUCCESS);
+
+    cms_setMessageStringProperty(first, "region", "eu");
+    cms_setMessageStringProperty(second, "region", "us");
+
+    int exists = 1;
+    char text[32];
+    CPPUNIT_ASSERT(cms_messagePropertyExists(message, "region", &exists) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(exists == 0);
+    CPPUNIT_ASSERT(cms_getMessageText(second, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("fan out"), std::string(text));
+
+    // Writing the body of a copy leaves the body the others share as it was.
+    CPPUNIT_ASSERT(cms_setMessageText(second, "changed") == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageText(second, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("changed"), std::string(text));
+    CPPUNIT_ASSERT(cms_getMessageText(message, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("fan out"), std::string(text));
+
+    // The original may go before its copies.
+    cms_destroyMessage(message);
+
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, first) == CMS_SUCCESS);
+    cms_destroyMessage(first);
+    cms_destroyMessage(second);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &message, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageText(message, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("fan out"), std::string(text));
+    CPPUNIT_ASSERT(cms_getMessageStringProperty(message, "region", text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("eu"), std::string(text));
+    cms_destroyMessage(message);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void MessageTest::testBorrowReplyTo() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Destination* replyQueue = NULL;
+    CMS_Destination* replyTo = NULL;
+    CMS_Destination* borrowed = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageConsumer* replyConsumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+    CMS_MessageProducer* replier = NULL;
+    CMS_Message* request = NULL;
+    CMS_Message* reply = NULL;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &replyQueue);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createDefaultConsumer(session, replyQueue, &replyConsumer);
+    cms_createProducer(session, destination, &producer);
+    cms_createProducer(session, NULL, &replier);
+    cms_startConnection(connection);
+
+    cms_createTextMessage(session, &request, "request");
+    cms_setCMSMessageReplyTo(request, replyQueue);
+    CPPUNIT_ASSERT(cms_producerSendWithDefaults(producer, request) == CMS_SUCCESS);
+    cms_destroyMessage(request);
+
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &request, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_borrowCMSMessageReplyTo(request, &replyTo) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(replyTo != NULL);
+    CPPUNIT_ASSERT(cms_borrowCMSMessageReplyTo(request, &borrowed) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(replyTo == borrowed);
+
+    int temporary = 0;
+    int equal = 0;
+    cms_isDestinationTemporary(replyTo, &temporary);
+    CPPUNIT_ASSERT(temporary != 0);
+    cms_compareDestinations(replyTo, replyQueue, &equal);
+    CPPUNIT_ASSERT(equal != 0);
+
+    // The handle belongs to the request, destroying it is harmless.
+    CPPUNIT_ASSERT(cms_destroyDestination(replyTo) == CMS_SUCCESS);
+
+    cms_createTextMessage(session, &reply, "reply");
+    CPPUNIT_ASSERT(cms_producerSendToDestination(replier, reply, replyTo, 1, 4, 0) == CMS_SUCCESS);
+    cms_destroyMessage(reply);
+
+    // Setting the header moves the handle along with it.
+    CPPUNIT_ASSERT(cms_setCMSMessageReplyTo(request, destination) == CMS_SUCCESS);
+    cms_compareDestinations(replyTo, destination, &equal);
+    CPPUNIT_ASSERT(equal != 0);
+    CPPUNIT_ASSERT(cms_setCMSMessageReplyTo(request, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_borrowCMSMessageReplyTo(request, &borrowed) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(borrowed == NULL);
+    cms_destroyMessage(request);
+
+    char text[32];
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(replyConsumer, &reply, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getMessageText(reply, text, (int) sizeof(text)) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(std::string("reply"), std::string(text));
+    cms_destroyMessage(reply);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyConsumer(replyConsumer);
+    cms_destroyProducer(producer);
+    cms_destroyProducer(replier);
+    cms_destroyDestination(replyQueue);
+    cms_destroyDestination(destination);
+}
@@ -49,6 +49,9 @@ namespace cms {
         CPPUNIT_TEST( testCMSMessageReplyTo );
         CPPUNIT_TEST( testCMSMessageTimestamp );
         CPPUNIT_TEST( testCMSMessageType );
+        CPPUNIT_TEST( testRetainMessage );
+        CPPUNIT_TEST( testShallowClone );
+        CPPUNIT_TEST( testBorrowReplyTo );
         CPPUNIT_TEST_SUITE_END();
 
     public:
@@ -80,6 +83,9 @@ namespace cms {
         void testCMSMessageReplyTo();
         void testCMSMessageTimestamp();
         void testCMSMessageType();
+        void testRetainMessage();
+        void testShallowClone();
+        void testBorrowReplyTo();
 
     };
 
@@ -0,0 +1,417 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RequestorTest.h"
+
+#include <cms.h>
+#include <CMS_Connection.h>
+#include <CMS_Session.h>
+#include <CMS_Destination.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
+#include <CMS_MessageProducer.h>
+#include <CMS_MessageConsumer.h>
+#include <CMS_Requestor.h>
+
+#include <decaf/lang/Thread.h>
+#include <decaf/lang/Runnable.h>
+#include <decaf/util/concurrent/CountDownLatch.h>
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdio.h>
+
+using namespace cms;
+using namespace decaf;
+using namespace decaf::lang;
+using namespace decaf::util::concurrent;
+
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    /**
+     * The outcome of an asynchronous request, counted down once its callback has run.
+     */
+    struct AwaitedReply {
+        CountDownLatch arrived;
+        cms_status status;
+        std::string text;
+
+        AwaitedReply() : arrived(1), status(CMS_ERROR), text() {}
+    };
+
+    void replyArrived(CMS_Requestor*, CMS_Message* reply, cms_status status, void* userData) {
+
+        AwaitedReply* awaited = (AwaitedReply*) userData;
+
+        awaited->status = status;
+
+        if (status == CMS_SUCCESS) {
+            char text[32];
+            cms_getMessageText(reply, text, (int) sizeof(text));
+            cms_destroyMessage(reply);
+
+            awaited->text = text;
+        }
+
+        awaited->arrived.countDown();
+    }
+
+    /**
+     * Replies to a request the way a replier is expected to, with the request's text and
+     * correlation ID sent to its Reply To Destination, and destroys the request.
+     */
+    bool sendReply(CMS_Message* request, CMS_MessageProducer* replier, CMS_Session* session) {
+
+        CMS_Message* reply = NULL;
+        CMS_Destination* replyTo = NULL;
+        char text[32];
+        char correlationId[128];
+
+        cms_getMessageText(request, text, (int) sizeof(text));
+        cms_getCMSMessageCorrelationID(request, correlationId, (int) sizeof(correlationId));
+        cms_borrowCMSMessageReplyTo(request, &replyTo);
+
+        cms_createTextMessage(session, &reply, text);
+        cms_setCMSMessageCorrelationID(reply, correlationId);
+        cms_status result = cms_producerSendToDestination(replier, reply, replyTo, 1, 4, 0);
+
+        cms_destroyMessage(reply);
+        cms_destroyMessage(request);
+
+        return result == CMS_SUCCESS;
+    }
+
+    /**
+     * Answers the next request that arrives.
+     */
+    bool answerRequest(CMS_MessageConsumer* consumer, CMS_MessageProducer* replier, CMS_Session* session) {
+
+        CMS_Message* request = NULL;
+
+        if (cms_consumerReceiveWithTimeout(consumer, &request, 2000) != CMS_SUCCESS) {
+            return false;
+        }
+
+        return sendReply(request, replier, session);
+    }
+
+    /**
+     * The text an asynchronous request was sent with and whether its reply carried it.
+     */
+    struct ExpectedReply {
+        char text[32];
+        int replies;
+        bool matched;
+        CountDownLatch* answered;
+    };
+
+    void replyMatched(CMS_Requestor*, CMS_Message* reply, cms_status status, void* userData) {
+
+        ExpectedReply* expected = (ExpectedReply*) userData;
+        char text[32];
+
+        expected->matched = status == CMS_SUCCESS &&
+                            cms_getMessageText(reply, text, (int) sizeof(text)) == CMS_SUCCESS &&
+                            strcmp(text, expected->text) == 0;
+        expected->replies++;
+
+        cms_destroyMessage(reply);
+
+        expected->answered->countDown();
+    }
+
+    /**
+     * Answers a number of requests from a thread of its own.
+     */
+    class Responder : public Runnable {
+    public:
+
+        CMS_MessageConsumer* consumer;
+        CMS_MessageProducer* replier;
+        CMS_Session* session;
+        int requests;
+        int answered;
+
+        Responder(CMS_MessageConsumer* consumer, CMS_MessageProducer* replier, CMS_Session* session, int requests) :
+            Runnable(), consumer(consumer), replier(replier), session(session), requests(requests), answered(0) {}
+        virtual ~Responder() {}
+
+        virtual void run() {
+            while (answered < requests && answerRequest(consumer, replier, session)) {
+                answered++;
+            }
+        }
+    };
+
+    /**
+     * Makes blocking requests from a thread of its own and counts the replies that answer
+     * the request they were returned for.
+     */
+    class BlockingRequester : public Runnable {
+    public:
+
+        CMS_Requestor* requestor;
+        CMS_Destination* destination;
+        CMS_Session* session;
+        int id;
+        int requests;
+        int matched;
+
+        BlockingRequester() : Runnable(), requestor(NULL), destination(NULL), session(NULL),
+                              id(0), requests(0), matched(0) {}
+        virtual ~BlockingRequester() {}
+
+        virtual void run() {
+
+            for (int i = 0; i < requests; ++i) {
+
+                CMS_Message* request = NULL;
+                CMS_Message* reply = NULL;
+                char text[32];
+                char answer[32];
+
+                sprintf(text, "thread-%d-%d", id, i);
+                cms_createTextMessage(session, &request, text);
+
+                if (cms_requestWithTimeout(requestor, destination, request, &reply, 5000) == CMS_SUCCESS &&
+                    cms_getMessageText(reply, answer, (int) sizeof(answer)) == CMS_SUCCESS &&
+                    strcmp(text, answer) == 0) {
+
+                    matched++;
+                }
+
+                cms_destroyMessage(reply);
+                cms_destroyMessage(request);
+            }
+        }
+    };
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RequestorTest::RequestorTest() {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RequestorTest::~RequestorTest() {
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RequestorTest::testRequestor() {
+
+    CMS_Destination* destination = NULL;
+    CMS_Destination* unanswered = NULL;
+    CMS_MessageConsumer* responder = NULL;
+    CMS_MessageProducer* replier = NULL;
+    CMS_Requestor* requestor = NULL;
+    CMS_Message* request = NULL;
+    CMS_Message* reply = NULL;
+
+    AwaitedReply answered[10];
+    AwaitedReply first;
+    AwaitedReply second;
+    AwaitedReply abandoned;
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &unanswered);
+    cms_createDefaultConsumer(session, destination, &responder);
+    cms_createProducer(session, NULL, &replier);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_createRequestor(connection, &requestor) == CMS_SUCCESS);
+
+    // Every request is answered by way of the one shared reply Queue.
+    for (int i = 0; i < 10; ++i) {
+
+        char text[32];
+        sprintf(text, "request-%d", i);
+
+        cms_createTextMessage(session, &request, text);
+        CPPUNIT_ASSERT(cms_requestAsync(requestor, destination, request, replyArrived, &answered[i]) == CMS_SUCCESS);
+        cms_destroyMessage(request);
+
+        CPPUNIT_ASSERT(answerRequest(responder, replier, session));
+
+        CPPUNIT_ASSERT(answered[i].arrived.await(2000));
+        CPPUNIT_ASSERT(answered[i].status == CMS_SUCCESS);
+        CPPUNIT_ASSERT_EQUAL(std::string(text), answered[i].text);
+    }
+
+    // Any number of requests can await their replies at once.
+    cms_createTextMessage(session, &request, "first");
+    CPPUNIT_ASSERT(cms_requestAsync(requestor, destination, request, replyArrived, &first) == CMS_SUCCESS);
+    cms_destroyMessage(request);
+    cms_createTextMessage(session, &request, "second");
+    CPPUNIT_ASSERT(cms_requestAsync(requestor, destination, request, replyArrived, &second) == CMS_SUCCESS);
+    cms_destroyMessage(request);
+
+    CPPUNIT_ASSERT(answerRequest(responder, replier, session));
+    CPPUNIT_ASSERT(answerRequest(responder, replier, session));
+    CPPUNIT_ASSERT(first.arrived.await(2000));
+    CPPUNIT_ASSERT(second.arrived.await(2000));
+    CPPUNIT_ASSERT_EQUAL(std::string("first"), first.text);
+    CPPUNIT_ASSERT_EQUAL(std::string("second"), second.text);
+
+    cms_createTextMessage(session, &request, "nobody");
+    CPPUNIT_ASSERT(cms_requestWithTimeout(requestor, unanswered, request, &reply, 0) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_requestWithTimeout(requestor, unanswered, request, &reply, -1) == CMS_ERROR);
+    CPPUNIT_ASSERT(cms_requestWithTimeout(requestor, unanswered, request, &reply, 100) == CMS_RECEIVE_TIMEDOUT);
+    CPPUNIT_ASSERT(reply == NULL);
+
+    // The time out is not sent as a time to live, the request is still there to be consumed.
+    CMS_MessageConsumer* late = NULL;
+    long long expiration = -1;
+    cms_createDefaultConsumer(session, unanswered, &late);
+    CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(late, &reply, 2000) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_getCMSMessageExpiration(reply, &expiration) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0LL, expiration);
+    cms_destroyMessage(reply);
+    cms_destroyConsumer(late);
+    reply = NULL;
+
+    // A request still awaiting its reply is failed when the Requestor goes.
+    CPPUNIT_ASSERT(cms_requestAsync(requestor, unanswered, request, replyArrived, &abandoned) == CMS_SUCCESS);
+    cms_destroyMessage(request);
+
+    CPPUNIT_ASSERT(cms_destroyRequestor(requestor) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(abandoned.arrived.await(2000));
+    CPPUNIT_ASSERT(abandoned.status != CMS_SUCCESS);
+
+    cms_destroyConsumer(responder);
+    cms_destroyProducer(replier);
+    cms_destroyDestination(unanswered);
+    cms_destroyDestination(destination);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RequestorTest::testConcurrentRequests() {
+
+    CMS_Session* responderSession = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* replier = NULL;
+    CMS_Requestor* requestor = NULL;
+
+    const int threads = 4;
+    const int requests = 25;
+
+    cms_createDefaultSession(connection, &responderSession);
+    cms_createTemporaryDestination(responderSession, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(responderSession, destination, &consumer);
+    cms_createProducer(responderSession, NULL, &replier);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_createRequestor(connection, &requestor) == CMS_SUCCESS);
+
+    Responder responder(consumer, replier, responderSession, threads * requests);
+    Thread responderThread(&responder);
+    responderThread.start();
+
+    // Threads blocked on their own requests are each woken by the reply to theirs.
+    BlockingRequester requesters[threads];
+    Thread* requesterThreads[threads];
+
+    for (int i = 0; i < threads; ++i) {
+        requesters[i].requestor = requestor;
+        requesters[i].destination = destination;
+        requesters[i].session = session;
+        requesters[i].id = i;
+        requesters[i].requests = requests;
+        requesterThreads[i] = new Thread(&requesters[i]);
+    }
+    for (int i = 0; i < threads; ++i) {
+        requesterThreads[i]->start();
+    }
+    for (int i = 0; i < threads; ++i) {
+        requesterThreads[i]->join();
+        delete requesterThreads[i];
+    }
+
+    responderThread.join();
+
+    CPPUNIT_ASSERT_EQUAL(threads * requests, responder.answered);
+    for (int i = 0; i < threads; ++i) {
+        CPPUNIT_ASSERT_EQUAL(requests, requesters[i].matched);
+    }
+
+    CPPUNIT_ASSERT(cms_destroyRequestor(requestor) == CMS_SUCCESS);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(replier);
+    cms_destroyDestination(destination);
+    cms_destroySession(responderSession);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void RequestorTest::testManyOutstandingRequests() {
+
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* replier = NULL;
+    CMS_Requestor* requestor = NULL;
+    CMS_Message* request = NULL;
+
+    const int count = 300;
+    CountDownLatch answered(count);
+    std::vector<ExpectedReply> expected(count);
+    std::vector<CMS_Message*> received(count, (CMS_Message*) NULL);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, NULL, &replier);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_createRequestor(connection, &requestor) == CMS_SUCCESS);
+
+    for (int i = 0; i < count; ++i) {
+
+        sprintf(expected[i].text, "outstanding-%d", i);
+        expected[i].replies = 0;
+        expected[i].matched = false;
+        expected[i].answered = &answered;
+
+        cms_createTextMessage(session, &request, expected[i].text);
+        CPPUNIT_ASSERT(cms_requestAsync(requestor, destination, request, replyMatched, &expected[i]) == CMS_SUCCESS);
+        cms_destroyMessage(request);
+    }
+
+    // Every request is outstanding before any is answered, the answers go in reverse.
+    for (int i = 0; i < count; ++i) {
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received[i], 2000) == CMS_SUCCESS);
+    }
+    for (int i = count - 1; i >= 0; --i) {
+        CPPUNIT_ASSERT(sendReply(received[i], replier, session));
+    }
+
+    CPPUNIT_ASSERT(answered.await(10000));
+
+    for (int i = 0; i < count; ++i) {
+        CPPUNIT_ASSERT_EQUAL(1, expected[i].replies);
+        CPPUNIT_ASSERT(expected[i].matched);
+    }
+
+    CPPUNIT_ASSERT(cms_destroyRequestor(requestor) == CMS_SUCCESS);
+
+    for (int i = 0; i < count; ++i) {
+        CPPUNIT_ASSERT_EQUAL(1, expected[i].replies);
+    }
+
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(replier);
+    cms_destroyDestination(destination);
+}
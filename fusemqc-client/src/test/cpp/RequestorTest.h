@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CMS_REQUESTORTEST_H_
+#define _CMS_REQUESTORTEST_H_
+
+#include "SingleConnectionTestCase.h"
+
+namespace cms {
+
+    class RequestorTest : public SingleConnectionTestCase {
+
+        CPPUNIT_TEST_SUITE( RequestorTest );
+        CPPUNIT_TEST( testRequestor );
+        CPPUNIT_TEST( testConcurrentRequests );
+        CPPUNIT_TEST( testManyOutstandingRequests );
+        CPPUNIT_TEST_SUITE_END();
+
+    public:
+
+        RequestorTest();
+        virtual ~RequestorTest();
+
+        void testRequestor();
+        void testConcurrentRequests();
+        void testManyOutstandingRequests();
+
+    };
+
+}
+
+#endif /* _CMS_REQUESTORTEST_H_ */
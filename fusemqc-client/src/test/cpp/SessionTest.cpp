@@ -19,15 +19,56 @@
 
 #include <cms.h>
 #include <CMS_QueueBrowser.h>
+#include <CMS_Message.h>
+#include <CMS_TextMessage.h>
 #include <CMS_MessageConsumer.h>
 #include <CMS_MessageProducer.h>
 #include <CMS_Destination.h>
 #include <CMS_Session.h>
 #include <CMS_Connection.h>
 #include <CMS_ConnectionFactory.h>
+#include <CMS_Trace.h>
+
+#include <string.h>
 
 using namespace cms;
 
+////////////////////////////////////////////////////////////////////////////////
+namespace {
+
+    struct TraceCounts {
+        int sends;
+        int receives;
+        int emptyReceives;
+        int commits;
+        bool ordered;
+    };
+
+    void afterSend(CMS_MessageProducer*, CMS_Message*, cms_status status,
+                   long long start, long long end, void* userData) {
+
+        TraceCounts* counts = (TraceCounts*) userData;
+        counts->sends += status == CMS_SUCCESS ? 1 : 0;
+        counts->ordered = counts->ordered && start <= end;
+    }
+
+    void afterReceive(CMS_MessageConsumer*, CMS_Message* message, cms_status,
+                      long long start, long long end, void* userData) {
+
+        TraceCounts* counts = (TraceCounts*) userData;
+        if (message != NULL) {
+            counts->receives++;
+        } else {
+            counts->emptyReceives++;
+        }
+        counts->ordered = counts->ordered && start <= end;
+    }
+
+    void afterCommit(CMS_Session*, cms_status, long long, long long, void* userData) {
+        ((TraceCounts*) userData)->commits++;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 SessionTest::SessionTest() {
 }
@@ -39,7 +80,7 @@ SessionTest::~SessionTest() {
 ////////////////////////////////////////////////////////////////////////////////
 void SessionTest::testCreateDestination() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -61,7 +102,7 @@ void SessionTest::testCreateDestination() {
 ////////////////////////////////////////////////////////////////////////////////
 void SessionTest::testCreateProducer() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -83,7 +124,7 @@ void SessionTest::testCreateProducer() {
 ////////////////////////////////////////////////////////////////////////////////
 void SessionTest::testCreateConsumer() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -108,7 +149,7 @@ void SessionTest::testCreateConsumer() {
 ////////////////////////////////////////////////////////////////////////////////
 void SessionTest::testCreateQueueBrowser() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CMS_ConnectionFactory* factory = NULL;
     CMS_Connection* connection = NULL;
@@ -129,3 +170,118 @@ void SessionTest::testCreateQueueBrowser() {
     CPPUNIT_ASSERT(cms_destroyConnection(connection) == CMS_SUCCESS);
     CPPUNIT_ASSERT(cms_destroyConnectionFactory(factory) == CMS_SUCCESS);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+void SessionTest::testTraceHooks() {
+
+    const std::string uri = CMSTestCase::getBrokerURI();
+
+    CMS_ConnectionFactory* factory = NULL;
+    CMS_Connection* connection = NULL;
+    CMS_Session* session = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_Message* message = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    CMS_MessageProducer* producer = NULL;
+
+    TraceCounts counts = { 0, 0, 0, 0, true };
+    CMS_TraceHooks hooks;
+    memset(&hooks, 0, sizeof(hooks));
+    hooks.afterSend = afterSend;
+    hooks.afterReceive = afterReceive;
+    hooks.afterCommit = afterCommit;
+    hooks.userData = &counts;
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&factory, uri.c_str(), NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultConnection(factory, &connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createSession(connection, &session, CMS_SESSION_TRANSACTED) == CMS_SUCCESS);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_createProducer(session, destination, &producer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_setTraceHooks(&hooks) == CMS_SUCCESS);
+
+    cms_createTextMessage(session, &message, "traced");
+    cms_producerSendWithDefaults(producer, message);
+    cms_producerSend(producer, message, CMS_MSG_NON_PERSISTENT, 4, 0);
+    cms_commitSession(session);
+
+    for( int i = 0; i < 2; ++i ) {
+        CMS_Message* received = NULL;
+        CPPUNIT_ASSERT(cms_consumerReceiveWithTimeout(consumer, &received, 2000) == CMS_SUCCESS);
+        cms_destroyMessage(received);
+    }
+
+    // Both Messages were taken so the last receive comes back empty.
+    CMS_Message* received = NULL;
+    cms_consumerReceiveNoWait(consumer, &received);
+    CPPUNIT_ASSERT(received == NULL);
+
+    cms_commitSession(session);
+
+    CPPUNIT_ASSERT_EQUAL(2, counts.sends);
+    CPPUNIT_ASSERT_EQUAL(2, counts.receives);
+    CPPUNIT_ASSERT_EQUAL(1, counts.emptyReceives);
+    CPPUNIT_ASSERT_EQUAL(2, counts.commits);
+    CPPUNIT_ASSERT(counts.ordered);
+
+    // Once removed the hooks see nothing more.
+    CPPUNIT_ASSERT(cms_setTraceHooks(NULL) == CMS_SUCCESS);
+    cms_producerSendWithDefaults(producer, message);
+    cms_commitSession(session);
+    CPPUNIT_ASSERT_EQUAL(2, counts.sends);
+    CPPUNIT_ASSERT_EQUAL(2, counts.commits);
+
+    cms_destroyMessage(message);
+    cms_destroyConsumer(consumer);
+    cms_destroyProducer(producer);
+    cms_destroyDestination(destination);
+
+    CPPUNIT_ASSERT(cms_destroySession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnection(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnectionFactory(factory) == CMS_SUCCESS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void SessionTest::testPendingCountAfterEmptyRollback() {
+
+    const std::string uri = CMSTestCase::getBrokerURI();
+
+    CMS_ConnectionFactory* factory = NULL;
+    CMS_Connection* connection = NULL;
+    CMS_Session* session = NULL;
+    CMS_Destination* destination = NULL;
+    CMS_MessageConsumer* consumer = NULL;
+    int ready[1] = { -1 };
+    int readyCount = 0;
+    int pending = -1;
+
+    CPPUNIT_ASSERT(cms_createConnectionFactory(&factory, uri.c_str(), NULL, NULL) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createDefaultConnection(factory, &connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_createSession(connection, &session, CMS_SESSION_TRANSACTED) == CMS_SUCCESS);
+
+    cms_createTemporaryDestination(session, CMS_TEMPORARY_QUEUE, &destination);
+    cms_createDefaultConsumer(session, destination, &consumer);
+    cms_startConnection(connection);
+
+    CPPUNIT_ASSERT(cms_getSessionPendingCount(NULL, &pending) == CMS_ERROR);
+
+    // Nothing was delivered so nothing is returned to the prefetch buffer.
+    CPPUNIT_ASSERT(cms_rollbackSession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_rollbackSession(session) == CMS_SUCCESS);
+
+    CPPUNIT_ASSERT(cms_getConsumerPendingCount(consumer, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, pending);
+    CPPUNIT_ASSERT(cms_getSessionPendingCount(session, &pending) == CMS_SUCCESS);
+    CPPUNIT_ASSERT_EQUAL(0, pending);
+    CPPUNIT_ASSERT(cms_pollConsumers(&consumer, 1, 0, ready, &readyCount) == CMS_RECEIVE_TIMEDOUT);
+
+    cms_destroyConsumer(consumer);
+    cms_destroyDestination(destination);
+
+    CPPUNIT_ASSERT(cms_destroySession(session) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnection(connection) == CMS_SUCCESS);
+    CPPUNIT_ASSERT(cms_destroyConnectionFactory(factory) == CMS_SUCCESS);
+}
@@ -29,6 +29,8 @@ namespace cms {
         CPPUNIT_TEST( testCreateProducer );
         CPPUNIT_TEST( testCreateConsumer );
         CPPUNIT_TEST( testCreateQueueBrowser );
+        CPPUNIT_TEST( testTraceHooks );
+        CPPUNIT_TEST( testPendingCountAfterEmptyRollback );
         CPPUNIT_TEST_SUITE_END();
 
 	public:
@@ -42,6 +44,8 @@ namespace cms {
 		void testCreateProducer();
 		void testCreateConsumer();
 		void testCreateQueueBrowser();
+		void testTraceHooks();
+		void testPendingCountAfterEmptyRollback();
 
 	};
 
@@ -39,7 +39,7 @@ SingleConnectionTestCase::~SingleConnectionTestCase() {
 ////////////////////////////////////////////////////////////////////////////////
 void SingleConnectionTestCase::setUp() {
 
-    const std::string uri = std::string("tcp://") + CMSTestCase::DEFAULT_BROKER_HOST;
+    const std::string uri = CMSTestCase::getBrokerURI();
 
     CPPUNIT_ASSERT(cms_createConnectionFactory(&factory, uri.c_str(), NULL, NULL) == CMS_SUCCESS);
     CPPUNIT_ASSERT(cms_createDefaultConnection(factory, &connection) == CMS_SUCCESS);
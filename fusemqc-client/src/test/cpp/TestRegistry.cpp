@@ -27,6 +27,10 @@ CPPUNIT_TEST_SUITE_REGISTRATION( cms::MessageConsumerTest );
 CPPUNIT_TEST_SUITE_REGISTRATION( cms::MessageProducerTest );
 #include "QueueBrowserTest.h"
 CPPUNIT_TEST_SUITE_REGISTRATION( cms::QueueBrowserTest );
+#include "RequestorTest.h"
+CPPUNIT_TEST_SUITE_REGISTRATION( cms::RequestorTest );
+#include "LoopbackTest.h"
+CPPUNIT_TEST_SUITE_REGISTRATION( cms::LoopbackTest );
 
 #include "MessageTest.h"
 CPPUNIT_TEST_SUITE_REGISTRATION( cms::MessageTest );
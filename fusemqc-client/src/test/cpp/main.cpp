@@ -29,6 +29,8 @@
 #include <iostream>
 #include <memory>
 
+#include "CMSTestCase.h"
+
 int main( int argc, char **argv ) {
 
     activemq::library::ActiveMQCPP::initializeLibrary();
@@ -54,6 +56,12 @@ int main( int argc, char **argv ) {
                               << argv[i] << std::endl;
                     return -1;
                 }
+            } else if( arg == "-broker" ) {
+                if( ( i + 1 ) >= argc ) {
+                    std::cout << "-broker requires a broker URI to be specified" << std::endl;
+                    return -1;
+                }
+                cms::CMSTestCase::setBrokerURI( argv[++i] );
             } else if( arg == "-quiet" ) {
                 listener.reset( NULL );
             } else if( arg == "-xml" ) {